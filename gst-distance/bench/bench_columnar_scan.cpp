@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Records the same batches in csv and columnar mode, then counts violations
+ * per source from each (a one column query) and prints the scan times.
+ *
+ * usage: bench_columnar_scan [--batches=20000] [--frames=4] [--people=16]
+ */
+
+#include "AsyncFileMetaBroker.hpp"
+#include "ColumnarReader.hpp"
+#include "RecordingReader.hpp"
+
+#include <distance.pb.h>
+
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include <sys/mman.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static gint num_batches = 20000;
+static gint num_frames = 4;
+static gint num_people = 16;
+
+static GOptionEntry entries[] = {
+    {"batches", 'b', 0, G_OPTION_ARG_INT, &num_batches,
+     "number of batches to record", "N"},
+    {"frames", 'f', 0, G_OPTION_ARG_INT, &num_frames, "frames per batch", "N"},
+    {"people", 'p', 0, G_OPTION_ARG_INT, &num_people, "people per frame", "N"},
+    {nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr},
+};
+
+/* violations by source id (source ids are small and dense) */
+typedef std::vector<guint64> Violations;
+
+static inline void count(Violations* violations,
+                         guint32 source_id,
+                         bool is_danger) {
+  if (source_id >= violations->size()) {
+    violations->resize(source_id + 1);
+  }
+  (*violations)[source_id] += is_danger;
+}
+
+static void record(const gchar* basepath,
+                   ds::AsyncFileMetaBroker::Format format) {
+  ds::AsyncFileWriter::Options options;
+  // never drop, this is about reading
+  options.queue_size = (size_t)num_batches;
+  ds::AsyncFileMetaBroker broker(basepath, format, options);
+  broker.start();
+  GRand* rand = g_rand_new_with_seed(42);
+  for (gint b = 0; b < num_batches; b++) {
+    dp::Batch batch;
+    for (gint f = 0; f < num_frames; f++) {
+      dp::Frame* frame = batch.add_frames();
+      frame->set_source_id(f);
+      frame->set_frame_num(b);
+      frame->set_pts((guint64)b * 33333333);
+      for (gint p = 0; p < num_people; p++) {
+        dp::Person* person = frame->add_people();
+        person->set_uid(g_rand_int(rand));
+        person->set_danger_val((float)g_rand_double(rand));
+        person->set_is_danger(person->danger_val() > 0.8f);
+        dp::BBox* bbox = person->mutable_bbox();
+        bbox->set_left((float)g_rand_double_range(rand, 0.0, 1920.0));
+        bbox->set_top((float)g_rand_double_range(rand, 0.0, 1080.0));
+        bbox->set_width((float)g_rand_double_range(rand, 10.0, 200.0));
+        bbox->set_height((float)g_rand_double_range(rand, 20.0, 400.0));
+      }
+    }
+    broker.on_batch_payload(nullptr, &batch);
+  }
+  g_rand_free(rand);
+  broker.stop();
+}
+
+/* what any csv reader has to do: find every field of every line, even if
+ * only two of them are converted */
+static bool scan_csv(const std::string& path, Violations* violations) {
+  size_t size = 0;
+  const char* data = (const char*)ds::recording::map_file(path, &size);
+  if (data == nullptr) {
+    return false;
+  }
+  const char* end = data + size;
+  const char* p = (const char*)memchr(data, '\n', size);  // header
+  const char* fields[10];
+  while (p != nullptr && ++p < end) {
+    const char* field = p;
+    int n = 0;
+    for (; n < 10 && field != nullptr; n++) {
+      fields[n] = field;
+      field = (const char*)memchr(field, n < 9 ? ',' : '\n', end - field);
+      if (field != nullptr) {
+        field++;
+      }
+    }
+    if (n < 10) {
+      break;
+    }
+    count(violations, (guint32)strtoul(fields[0], nullptr, 10),
+          fields[4][0] == '1');
+    p = field == nullptr ? nullptr : field - 1;
+  }
+  munmap((void*)data, size);
+  return true;
+}
+
+/* only the two columns the query needs are read and decompressed */
+static bool scan_columnar(const std::string& path, Violations* violations) {
+  ds::columnar::ColumnarReader reader;
+  if (!reader.open(path)) {
+    return false;
+  }
+  std::vector<uint32_t> source_id;
+  std::vector<uint8_t> is_danger;
+  for (size_t g = 0; g < reader.num_row_groups(); g++) {
+    if (!reader.read_column(g, ds::columnar::COLUMN_SOURCE_ID, &source_id) ||
+        !reader.read_column(g, ds::columnar::COLUMN_IS_DANGER, &is_danger)) {
+      return false;
+    }
+    for (size_t i = 0; i < source_id.size(); i++) {
+      count(violations, source_id[i], is_danger[i]);
+    }
+  }
+  return true;
+}
+
+template <typename Scan>
+static double run(const char* name,
+                  const std::string& path,
+                  Scan scan,
+                  Violations* violations) {
+  GStatBuf st;
+  g_stat(path.c_str(), &st);
+  auto start = std::chrono::steady_clock::now();
+  if (!scan(path, violations)) {
+    g_printerr("could not scan %s\n", path.c_str());
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  g_print("%-10s %10.1f MiB %8.3f s\n", name,
+          st.st_size / (1024.0 * 1024.0), seconds);
+  return seconds;
+}
+
+int main(int argc, char** argv) {
+  GError* error = nullptr;
+  GOptionContext* context = g_option_context_new("- columnar scan benchmark");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_clear_error(&error);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  gchar* directory = g_dir_make_tmp("bench_columnar_scan-XXXXXX", &error);
+  if (directory == nullptr) {
+    g_printerr("%s\n", error->message);
+    g_clear_error(&error);
+    return 1;
+  }
+  gchar* basepath = g_build_filename(directory, "rec", nullptr);
+  std::string csv_path = std::string(basepath) + ".csv";
+  std::string columnar_path = std::string(basepath) + ds::columnar::EXTENSION;
+  record(basepath, ds::AsyncFileMetaBroker::csv);
+  record(basepath, ds::AsyncFileMetaBroker::columnar);
+
+  g_print("%d batches x %d frames x %d people, violations per source "
+          "(warm page cache)\n",
+          num_batches, num_frames, num_people);
+  Violations from_csv, from_columnar;
+  double csv_seconds = run("csv", csv_path, scan_csv, &from_csv);
+  double columnar_seconds =
+      run("columnar", columnar_path, scan_columnar, &from_columnar);
+  g_print("speedup    %10.1fx\n", csv_seconds / columnar_seconds);
+  int ret = 0;
+  if (from_csv != from_columnar) {
+    g_printerr("results differ\n");
+    ret = 1;
+  }
+
+  g_unlink(csv_path.c_str());
+  g_unlink(columnar_path.c_str());
+  g_rmdir(directory);
+  g_free(basepath);
+  g_free(directory);
+  return ret;
+}
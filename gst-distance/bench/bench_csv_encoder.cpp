@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Formats the same batches with the previous snprintf based csv encoding
+ * and with CsvEncoder, and prints rows per second for each.
+ *
+ * usage: bench_csv_encoder [--batches=2000] [--frames=4] [--people=64]
+ */
+
+#include "CsvEncoder.hpp"
+
+#include <distance.pb.h>
+
+#include <glib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static gint num_batches = 2000;
+static gint num_frames = 4;
+static gint num_people = 64;
+
+static GOptionEntry entries[] = {
+    {"batches", 'b', 0, G_OPTION_ARG_INT, &num_batches,
+     "number of batches to format", "N"},
+    {"frames", 'f', 0, G_OPTION_ARG_INT, &num_frames, "frames per batch", "N"},
+    {"people", 'p', 0, G_OPTION_ARG_INT, &num_people, "people per frame", "N"},
+    {nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr},
+};
+
+/* csv mode before CsvEncoder */
+static std::string encode_snprintf(const dp::Batch& batch) {
+  std::string record;
+  char row[256];
+  for (const auto& frame : batch.frames()) {
+    for (const auto& person : frame.people()) {
+      int len = snprintf(
+          row, sizeof(row),
+          "%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%d,%f,%f,%f,%f,%f\n",
+          (unsigned)frame.source_id(), (uint64_t)frame.frame_num(),
+          (uint64_t)frame.pts(), (uint64_t)person.uid(),
+          (int)person.is_danger(), person.danger_val(), person.bbox().left(),
+          person.bbox().top(), person.bbox().width(), person.bbox().height());
+      if (len > 0) {
+        record.append(row, std::min((size_t)len, sizeof(row) - 1));
+      }
+    }
+  }
+  return record;
+}
+
+static std::vector<dp::Batch> make_batches() {
+  GRand* rand = g_rand_new_with_seed(42);
+  std::vector<dp::Batch> batches(num_batches);
+  for (gint b = 0; b < num_batches; b++) {
+    for (gint f = 0; f < num_frames; f++) {
+      dp::Frame* frame = batches[b].add_frames();
+      frame->set_source_id(f);
+      frame->set_frame_num(b);
+      frame->set_pts((guint64)b * 33333333);
+      for (gint p = 0; p < num_people; p++) {
+        dp::Person* person = frame->add_people();
+        person->set_uid(g_rand_int(rand));
+        person->set_danger_val((float)g_rand_double(rand));
+        person->set_is_danger(person->danger_val() > 0.8f);
+        dp::BBox* bbox = person->mutable_bbox();
+        bbox->set_left((float)g_rand_double_range(rand, 0.0, 1920.0));
+        bbox->set_top((float)g_rand_double_range(rand, 0.0, 1080.0));
+        bbox->set_width((float)g_rand_double_range(rand, 10.0, 200.0));
+        bbox->set_height((float)g_rand_double_range(rand, 20.0, 400.0));
+      }
+    }
+  }
+  g_rand_free(rand);
+  return batches;
+}
+
+template <typename Encode>
+static void run(const char* name,
+                const std::vector<dp::Batch>& batches,
+                Encode encode) {
+  guint64 bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& batch : batches) {
+    bytes += encode(batch).size();
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  double rows = (double)num_batches * num_frames * num_people;
+  g_print("%-10s %8.3f s %14.0f rows/s %10.1f MiB/s\n", name, seconds,
+          rows / seconds, bytes / (1024.0 * 1024.0) / seconds);
+}
+
+int main(int argc, char** argv) {
+  GError* error = nullptr;
+  GOptionContext* context = g_option_context_new("- csv encoder benchmark");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_clear_error(&error);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  std::vector<dp::Batch> batches = make_batches();
+  g_print("%d batches x %d frames x %d people\n", num_batches, num_frames,
+          num_people);
+  run("snprintf", batches, encode_snprintf);
+  ds::CsvEncoder encoder;
+  // the broker copies the encoded batch into a record for the writer
+  run("encoder", batches, [&encoder](const dp::Batch& batch) {
+    encoder.encode(batch);
+    return encoder.str();
+  });
+  return 0;
+}
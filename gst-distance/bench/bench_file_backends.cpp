@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* Runs many AsyncFileWriters in parallel (one per simulated broker), each
+ * fed by its own producer thread, once per available backend, and prints
+ * throughput and drop counts.
+ *
+ * usage: bench_file_backends [--brokers=64] [--records=20000] [--size=2048]
+ */
+
+#include "AsyncFileWriter.hpp"
+#include "UringFileWriter.hpp"
+
+#include <glib/gstdio.h>
+#include <gst/gst.h>
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+static gint num_brokers = 64;
+static gint num_records = 20000;
+static gint record_size = 2048;
+static gchar* directory = nullptr;
+
+static GOptionEntry entries[] = {
+    {"brokers", 'b', 0, G_OPTION_ARG_INT, &num_brokers,
+     "number of parallel writers", "N"},
+    {"records", 'r', 0, G_OPTION_ARG_INT, &num_records,
+     "records pushed per writer", "N"},
+    {"size", 's', 0, G_OPTION_ARG_INT, &record_size, "bytes per record", "N"},
+    {"directory", 'd', 0, G_OPTION_ARG_FILENAME, &directory,
+     "where to write (default: a new temporary directory)", "DIR"},
+    {nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr},
+};
+
+struct Result {
+  double seconds;
+  guint64 bytes;
+  guint64 dropped;
+};
+
+static Result run(ds::AsyncFileWriter::Backend backend, const gchar* dir) {
+  std::vector<std::unique_ptr<ds::AsyncFileWriter>> writers;
+  for (gint i = 0; i < num_brokers; i++) {
+    ds::AsyncFileWriter::Options options;
+    gchar* name = g_strdup_printf("broker-%03d", i);
+    gchar* basepath = g_build_filename(dir, name, nullptr);
+    options.basepath = basepath;
+    options.extension = ".pb";
+    options.backend = backend;
+    g_free(basepath);
+    g_free(name);
+    writers.push_back(ds::AsyncFileWriter::create(options));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (auto& writer : writers) {
+    writer->start();
+  }
+  std::vector<std::thread> producers;
+  for (auto& writer : writers) {
+    ds::AsyncFileWriter* w = writer.get();
+    producers.emplace_back([w] {
+      const std::string record(record_size, 'x');
+      for (gint i = 0; i < num_records; i++) {
+        w->push(std::string(record));
+      }
+    });
+  }
+  for (auto& producer : producers) {
+    producer.join();
+  }
+  Result result = {0, 0, 0};
+  for (auto& writer : writers) {
+    gchar* path = g_strdup(writer->current_path().c_str());
+    writer->stop();
+    result.bytes += writer->bytes_written();
+    result.dropped += writer->dropped();
+    g_unlink(path);
+    g_free(path);
+  }
+  result.seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  return result;
+}
+
+static void report(const char* name, const Result& result) {
+  g_print("%-10s %8.3f s %10.1f MiB/s %12" G_GUINT64_FORMAT " dropped\n",
+          name, result.seconds,
+          result.bytes / (1024.0 * 1024.0) / result.seconds, result.dropped);
+}
+
+int main(int argc, char** argv) {
+  GError* error = nullptr;
+  GOptionContext* context = g_option_context_new("- file backend benchmark");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_clear_error(&error);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  gboolean own_directory = directory == nullptr;
+  if (own_directory) {
+    directory = g_dir_make_tmp("bench_file_backends-XXXXXX", &error);
+    if (directory == nullptr) {
+      g_printerr("%s\n", error->message);
+      g_clear_error(&error);
+      return 1;
+    }
+  }
+
+  g_print("%d brokers x %d records x %d bytes in %s\n", num_brokers,
+          num_records, record_size, directory);
+  report("posix", run(ds::AsyncFileWriter::BACKEND_POSIX, directory));
+  if (ds::UringFileWriter::supported()) {
+    report("io_uring", run(ds::AsyncFileWriter::BACKEND_URING, directory));
+  } else {
+    g_print("%-10s unavailable\n", "io_uring");
+  }
+
+  if (own_directory) {
+    g_rmdir(directory);
+  }
+  g_free(directory);
+  return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/* Times DistanceFilter, ProtoPayloadFilter and the file broker encoders on
+ * synthetic metadata (see FakeScene.hpp) across batch sizes and object
+ * counts, and prints ns per batch for each. No GPU is needed.
+ *
+ * With --json the results are also written in Google Benchmark's json
+ * format, so runs can be compared across releases with its tools.
+ *
+ * usage: bench_filters [--min-time=0.05] [--json=FILE]
+ */
+
+#include "ColumnarFormat.hpp"
+#include "CsvEncoder.hpp"
+#include "FakeBatchMeta.hpp"
+#include "FakeScene.hpp"
+#include "RecordArrayBroker.hpp"
+
+#include <DistanceFilter.hpp>
+#include <PayloadBroker.hpp>
+#include <ProtoPayloadFilter.hpp>
+#include <distance.pb.h>
+
+#include <gst/gst.h>
+#include <time.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static const guint BATCH_SIZES[] = {1, 4, 8, 16, 32};
+static const guint OBJECT_COUNTS[] = {1, 10, 50, 100, 250, 500};
+/** buffers made (untimed) between timed runs of a filter */
+static const guint CHUNK = 8;
+/** distinct batches cycled through by the encoders */
+static const guint NUM_BATCHES = 8;
+
+static gdouble min_time = 0.05;
+static gchar* json_path = nullptr;
+
+static GOptionEntry entries[] = {
+    {"min-time", 't', 0, G_OPTION_ARG_DOUBLE, &min_time,
+     "minimum seconds to run each case", "S"},
+    {"json", 'j', 0, G_OPTION_ARG_FILENAME, &json_path,
+     "also write results to FILE as json", "FILE"},
+    {nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr},
+};
+
+struct Result {
+  std::string name;
+  guint64 iterations;
+  double real_ns;
+  double cpu_ns;
+  double items_per_second;
+};
+
+/* wall and thread cpu time in ns */
+struct Clock {
+  double real;
+  double cpu;
+
+  static Clock now() {
+    timespec wall, cpu;
+    clock_gettime(CLOCK_MONOTONIC, &wall);
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    return {wall.tv_sec * 1e9 + wall.tv_nsec, cpu.tv_sec * 1e9 + cpu.tv_nsec};
+  }
+};
+
+/* keeps a copy of the last payload */
+class CaptureBroker : public ds::PayloadBroker {
+ public:
+  virtual bool on_batch_payload(NvDsBatchMeta*, dp::Batch* batch) override {
+    last = *batch;
+    return true;
+  }
+  dp::Batch last;
+};
+
+static GstBuffer* make_buffer(ds::FakeScene* scene, guint64 frame_num) {
+  scene->step();
+  GstBuffer* buf = gst_buffer_new();
+  GST_BUFFER_PTS(buf) = frame_num * GST_SECOND / 30;
+  ds::add_fake_batch_meta(buf, *scene, frame_num, 0);
+  return buf;
+}
+
+static Result report(const char* bench,
+                     guint batch_size,
+                     guint objects,
+                     guint64 iterations,
+                     Clock elapsed) {
+  Result result;
+  result.name = std::string(bench) + "/batch:" + std::to_string(batch_size) +
+                "/objects:" + std::to_string(objects);
+  result.iterations = iterations;
+  result.real_ns = elapsed.real / iterations;
+  result.cpu_ns = elapsed.cpu / iterations;
+  result.items_per_second =
+      (double)batch_size * objects * iterations * 1e9 / elapsed.real;
+  g_print("%-32s %12.0f ns/batch %14.0f objects/s\n", result.name.c_str(),
+          result.real_ns, result.items_per_second);
+  return result;
+}
+
+/* time filter->on_buffer() on fresh buffers (made untimed, in chunks) */
+static Result run_filter(const char* bench,
+                         ds::BaseFilter* filter,
+                         guint batch_size,
+                         guint objects) {
+  ds::FakeScene scene(batch_size, objects, ds::FakeScene::MOTION_RANDOM, 0.01,
+                      1920, 1080, 42);
+  GstBuffer* bufs[CHUNK];
+  Clock elapsed = {0.0, 0.0};
+  guint64 iterations = 0;
+  while (elapsed.real < min_time * 1e9) {
+    for (guint i = 0; i < CHUNK; i++) {
+      bufs[i] = make_buffer(&scene, iterations + i);
+    }
+    Clock start = Clock::now();
+    for (guint i = 0; i < CHUNK; i++) {
+      filter->on_buffer(bufs[i]);
+    }
+    Clock end = Clock::now();
+    elapsed.real += end.real - start.real;
+    elapsed.cpu += end.cpu - start.cpu;
+    iterations += CHUNK;
+    for (guint i = 0; i < CHUNK; i++) {
+      gst_buffer_unref(bufs[i]);
+    }
+  }
+  return report(bench, batch_size, objects, iterations, elapsed);
+}
+
+/* time encode() on payloads made by a PayloadBroker from synthetic meta */
+template <typename Encode>
+static Result run_encoder(const char* bench,
+                          guint batch_size,
+                          guint objects,
+                          Encode encode) {
+  ds::FakeScene scene(batch_size, objects, ds::FakeScene::MOTION_RANDOM, 0.01,
+                      1920, 1080, 42);
+  CaptureBroker capture;
+  std::vector<dp::Batch> batches(NUM_BATCHES);
+  for (guint i = 0; i < NUM_BATCHES; i++) {
+    GstBuffer* buf = make_buffer(&scene, i);
+    capture.on_buffer(buf);
+    gst_buffer_unref(buf);
+    batches[i] = capture.last;
+  }
+
+  guint64 iterations = 0;
+  Clock start = Clock::now();
+  Clock now = start;
+  while (now.real - start.real < min_time * 1e9) {
+    for (guint i = 0; i < 64; i++, iterations++) {
+      encode(batches[iterations % NUM_BATCHES]);
+    }
+    now = Clock::now();
+  }
+  return report(bench, batch_size, objects, iterations,
+                {now.real - start.real, now.cpu - start.cpu});
+}
+
+static bool write_json(const char* path, const std::vector<Result>& results) {
+  FILE* f = fopen(path, "w");
+  if (f == nullptr) {
+    return false;
+  }
+  GDateTime* now = g_date_time_new_now_local();
+  gchar* date = g_date_time_format(now, "%FT%T%z");
+  fprintf(f, "{\n  \"context\": {\n");
+  fprintf(f, "    \"date\": \"%s\",\n", date);
+  fprintf(f, "    \"executable\": \"bench_filters\",\n");
+  fprintf(f, "    \"num_cpus\": %u\n  },\n", g_get_num_processors());
+  fprintf(f, "  \"benchmarks\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    fprintf(f,
+            "    {\"name\": \"%s\", \"run_name\": \"%s\", "
+            "\"run_type\": \"iteration\", \"iterations\": %" G_GUINT64_FORMAT
+            ", \"real_time\": %.1f, \"cpu_time\": %.1f, "
+            "\"time_unit\": \"ns\", \"items_per_second\": %.1f}%s\n",
+            r.name.c_str(), r.name.c_str(), r.iterations, r.real_ns, r.cpu_ns,
+            r.items_per_second, i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  g_free(date);
+  g_date_time_unref(now);
+  return fclose(f) == 0;
+}
+
+int main(int argc, char** argv) {
+  GError* error = nullptr;
+  GOptionContext* context = g_option_context_new("- filter benchmark");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_clear_error(&error);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  std::vector<Result> results;
+  for (guint batch_size : BATCH_SIZES) {
+    for (guint objects : OBJECT_COUNTS) {
+      ds::DistanceFilter distance;
+      distance.class_id = 0;
+      distance.do_drawing = true;
+      results.push_back(
+          run_filter("distance", &distance, batch_size, objects));
+      ds::ProtoPayloadFilter proto_payload;
+      results.push_back(
+          run_filter("protopayload", &proto_payload, batch_size, objects));
+
+      std::string proto;
+      results.push_back(run_encoder(
+          "encode_proto", batch_size, objects,
+          [&proto](const dp::Batch& batch) {
+            batch.SerializeToString(&proto);
+          }));
+      ds::CsvEncoder csv;
+      results.push_back(run_encoder(
+          "encode_csv", batch_size, objects,
+          [&csv](const dp::Batch& batch) { csv.encode(batch); }));
+      ds::columnar::RowGroupBuilder row_group;
+      std::string meta;
+      results.push_back(run_encoder(
+          "encode_columnar", batch_size, objects,
+          [&row_group, &meta](const dp::Batch& batch) {
+            row_group.add(batch);
+            // the broker's default row-group-size
+            if (row_group.num_batches() == 256) {
+              row_group.take(&meta);
+            }
+          }));
+      results.push_back(run_encoder(
+          "encode_records", batch_size, objects, [](const dp::Batch& batch) {
+            g_bytes_unref(ds::RecordArrayBroker::encode(batch));
+          }));
+    }
+  }
+
+  if (json_path != nullptr && !write_json(json_path, results)) {
+    g_printerr("could not write %s\n", json_path);
+    return 1;
+  }
+  return 0;
+}
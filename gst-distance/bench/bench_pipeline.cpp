@@ -0,0 +1,294 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/* Runs the whole chain on synthetic metadata as fast as it will go:
+ *
+ *   dsfakemetasrc ! dsdistance ! dsprotopayload ! dspayloadbroker ! fakesink
+ *
+ * and prints batches per second and p50/p99/p99.9 per buffer latency of
+ * each element (from its sink pad to its src pad) and of the whole chain.
+ * Every combination of the listed batch sizes and object counts is run.
+ *
+ * usage: bench_pipeline [--batch-size=1,8,32] [--objects=10,100]
+ *                       [--motion=random] [--id-churn=0.01] [--buffers=2000]
+ *                       [--broker="mode=records"] [--json=FILE]
+ */
+
+#include <gst/gst.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static gchar* batch_sizes_str = nullptr;
+static gchar* objects_str = nullptr;
+static gchar* motion = nullptr;
+static gdouble id_churn = 0.01;
+static gint num_buffers = 2000;
+static gchar* broker_props = nullptr;
+static gchar* json_path = nullptr;
+
+static GOptionEntry entries[] = {
+    {"batch-size", 'b', 0, G_OPTION_ARG_STRING, &batch_sizes_str,
+     "comma separated batch sizes (default: 1,8,32)", "N,..."},
+    {"objects", 'o', 0, G_OPTION_ARG_STRING, &objects_str,
+     "comma separated objects per frame (default: 10,100)", "N,..."},
+    {"motion", 'm', 0, G_OPTION_ARG_STRING, &motion,
+     "static, linear or random (default: random)", "MOTION"},
+    {"id-churn", 'c', 0, G_OPTION_ARG_DOUBLE, &id_churn,
+     "chance per person per frame of a new tracker id", "P"},
+    {"buffers", 'n', 0, G_OPTION_ARG_INT, &num_buffers,
+     "batches per run", "N"},
+    {"broker", 0, 0, G_OPTION_ARG_STRING, &broker_props,
+     "dspayloadbroker properties (default: mode=property)", "PROPS"},
+    {"json", 'j', 0, G_OPTION_ARG_FILENAME, &json_path,
+     "also write results to FILE as json", "FILE"},
+    {nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr},
+};
+
+/** the elements timed, by name in the pipeline */
+static const char* const STAGES[] = {
+    "dsdistance",
+    "dsprotopayload",
+    "dspayloadbroker",
+};
+static const size_t NUM_STAGES = G_N_ELEMENTS(STAGES);
+
+static guint64 now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/* per buffer latency between two pads. Buffers pass through every element
+ * on the source's streaming thread (there are no queues), so the time a
+ * buffer entered is all that needs keeping. */
+struct Stage {
+  std::string name;
+  guint64 entered;
+  std::vector<guint64> samples;
+};
+
+struct Result {
+  guint batch_size;
+  guint objects;
+  double seconds;
+  std::vector<Stage> stages;
+};
+
+static GstPadProbeReturn on_enter(GstPad*, GstPadProbeInfo*, gpointer data) {
+  ((Stage*)data)->entered = now_ns();
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn on_leave(GstPad*, GstPadProbeInfo*, gpointer data) {
+  Stage* stage = (Stage*)data;
+  stage->samples.push_back(now_ns() - stage->entered);
+  return GST_PAD_PROBE_OK;
+}
+
+static void add_probes(GstElement* pipeline,
+                       const char* enter_element,
+                       const char* enter_pad,
+                       const char* leave_element,
+                       const char* leave_pad,
+                       Stage* stage) {
+  GstElement* enter = gst_bin_get_by_name(GST_BIN(pipeline), enter_element);
+  GstElement* leave = gst_bin_get_by_name(GST_BIN(pipeline), leave_element);
+  GstPad* enter_p = gst_element_get_static_pad(enter, enter_pad);
+  GstPad* leave_p = gst_element_get_static_pad(leave, leave_pad);
+  gst_pad_add_probe(enter_p, GST_PAD_PROBE_TYPE_BUFFER, on_enter, stage,
+                    nullptr);
+  gst_pad_add_probe(leave_p, GST_PAD_PROBE_TYPE_BUFFER, on_leave, stage,
+                    nullptr);
+  gst_object_unref(enter_p);
+  gst_object_unref(leave_p);
+  gst_object_unref(enter);
+  gst_object_unref(leave);
+}
+
+static bool run(guint batch_size, guint objects, Result* result) {
+  gchar* description = g_strdup_printf(
+      "dsfakemetasrc name=src num-buffers=%d batch-size=%u "
+      "objects-per-frame=%u motion=%s id-churn=%f ! "
+      "dsdistance name=dsdistance ! dsprotopayload name=dsprotopayload ! "
+      "dspayloadbroker name=dspayloadbroker %s ! "
+      "fakesink name=sink sync=false",
+      num_buffers, batch_size, objects, motion, id_churn, broker_props);
+  GError* error = nullptr;
+  GstElement* pipeline = gst_parse_launch(description, &error);
+  g_free(description);
+  if (pipeline == nullptr || error != nullptr) {
+    g_printerr("%s\n", error ? error->message : "could not make pipeline");
+    g_clear_error(&error);
+    if (pipeline) {
+      gst_object_unref(pipeline);
+    }
+    return false;
+  }
+
+  result->batch_size = batch_size;
+  result->objects = objects;
+  result->stages.resize(NUM_STAGES + 1);
+  for (size_t i = 0; i < NUM_STAGES; i++) {
+    result->stages[i].name = STAGES[i];
+    result->stages[i].samples.reserve(num_buffers);
+    add_probes(pipeline, STAGES[i], "sink", STAGES[i], "src",
+               &result->stages[i]);
+  }
+  Stage& chain = result->stages[NUM_STAGES];
+  chain.name = "pipeline";
+  chain.samples.reserve(num_buffers);
+  add_probes(pipeline, STAGES[0], "sink", "sink", "sink", &chain);
+
+  guint64 start = now_ns();
+  gst_element_set_state(pipeline, GST_STATE_PLAYING);
+  GstBus* bus = gst_element_get_bus(pipeline);
+  GstMessage* msg = gst_bus_timed_pop_filtered(
+      bus, GST_CLOCK_TIME_NONE,
+      GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  result->seconds = (now_ns() - start) / 1e9;
+  bool ok = GST_MESSAGE_TYPE(msg) == GST_MESSAGE_EOS;
+  if (!ok) {
+    gst_message_parse_error(msg, &error, nullptr);
+    g_printerr("%s\n", error->message);
+    g_clear_error(&error);
+  }
+  gst_message_unref(msg);
+  gst_object_unref(bus);
+  gst_element_set_state(pipeline, GST_STATE_NULL);
+  gst_object_unref(pipeline);
+  return ok;
+}
+
+/* the q quantile of sorted `samples` (nearest rank) */
+static guint64 quantile(const std::vector<guint64>& samples, double q) {
+  if (samples.empty()) {
+    return 0;
+  }
+  size_t rank = (size_t)std::ceil(q * samples.size());
+  return samples[std::min(std::max(rank, (size_t)1), samples.size()) - 1];
+}
+
+static void report(Result* result) {
+  g_print("batch %2u x %3u objects: %10.1f batches/s\n", result->batch_size,
+          result->objects, num_buffers / result->seconds);
+  for (auto& stage : result->stages) {
+    std::sort(stage.samples.begin(), stage.samples.end());
+    g_print("  %-16s p50 %8.1f us  p99 %8.1f us  p99.9 %8.1f us\n",
+            stage.name.c_str(), quantile(stage.samples, 0.5) / 1e3,
+            quantile(stage.samples, 0.99) / 1e3,
+            quantile(stage.samples, 0.999) / 1e3);
+  }
+}
+
+static bool write_json(const char* path, const std::vector<Result>& results) {
+  FILE* f = fopen(path, "w");
+  if (f == nullptr) {
+    return false;
+  }
+  fprintf(f, "{\n  \"motion\": \"%s\",\n  \"id_churn\": %f,\n", motion,
+          id_churn);
+  fprintf(f, "  \"broker\": \"%s\",\n  \"buffers\": %d,\n", broker_props,
+          num_buffers);
+  fprintf(f, "  \"runs\": [\n");
+  for (size_t i = 0; i < results.size(); i++) {
+    const Result& r = results[i];
+    fprintf(f,
+            "    {\"batch_size\": %u, \"objects\": %u, "
+            "\"batches_per_second\": %.1f, \"latency_ns\": {",
+            r.batch_size, r.objects, num_buffers / r.seconds);
+    for (size_t s = 0; s < r.stages.size(); s++) {
+      const Stage& stage = r.stages[s];
+      fprintf(f,
+              "%s\"%s\": {\"p50\": %" G_GUINT64_FORMAT
+              ", \"p99\": %" G_GUINT64_FORMAT ", \"p99.9\": %" G_GUINT64_FORMAT
+              "}",
+              s ? ", " : "", stage.name.c_str(), quantile(stage.samples, 0.5),
+              quantile(stage.samples, 0.99), quantile(stage.samples, 0.999));
+    }
+    fprintf(f, "}}%s\n", i + 1 < results.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+  return fclose(f) == 0;
+}
+
+/* parse "1,8,32" */
+static bool parse_list(const gchar* str, std::vector<guint>* values) {
+  gchar** parts = g_strsplit(str, ",", -1);
+  bool ok = parts[0] != nullptr;
+  for (gchar** part = parts; ok && *part; part++) {
+    guint64 value = 0;
+    ok = g_ascii_string_to_unsigned(g_strstrip(*part), 10, 1, G_MAXUINT32,
+                                    &value, nullptr);
+    values->push_back((guint)value);
+  }
+  g_strfreev(parts);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  GError* error = nullptr;
+  GOptionContext* context = g_option_context_new("- pipeline benchmark");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  g_option_context_add_group(context, gst_init_get_option_group());
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_clear_error(&error);
+    return 1;
+  }
+  g_option_context_free(context);
+
+  std::vector<guint> batch_sizes;
+  std::vector<guint> object_counts;
+  if (!parse_list(batch_sizes_str ? batch_sizes_str : "1,8,32",
+                  &batch_sizes) ||
+      !parse_list(objects_str ? objects_str : "10,100", &object_counts)) {
+    g_printerr("--batch-size and --objects take lists of numbers\n");
+    return 1;
+  }
+  if (motion == nullptr) {
+    motion = g_strdup("random");
+  }
+  if (broker_props == nullptr) {
+    broker_props = g_strdup("mode=property");
+  }
+
+  std::vector<Result> results;
+  for (guint batch_size : batch_sizes) {
+    for (guint objects : object_counts) {
+      Result result;
+      if (!run(batch_size, objects, &result)) {
+        return 1;
+      }
+      report(&result);
+      results.push_back(std::move(result));
+    }
+  }
+
+  if (json_path != nullptr && !write_json(json_path, results)) {
+    g_printerr("could not write %s\n", json_path);
+    return 1;
+  }
+  return 0;
+}
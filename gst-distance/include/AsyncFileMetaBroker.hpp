@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef ASYNC_FILE_META_BROKER_HPP__
+#define ASYNC_FILE_META_BROKER_HPP__
+
+#include "AsyncFileWriter.hpp"
+#include "ColumnarFormat.hpp"
+#include "CsvEncoder.hpp"
+#include "WindowAggregator.hpp"
+
+#include <PayloadBroker.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ds {
+
+/**
+ * A FileMetaBroker that never blocks the streaming thread.
+ *
+ * Batches are encoded on the streaming thread (proto: length delimited coded
+ * `Batch`, csv: one row per person, smart_distancing format, see
+ * CsvEncoder.hpp, columnar: row groups of buffered batches, compressed on
+ * the writer, see ColumnarFormat.hpp, aggregate: a csv row per source
+ * per time window, see WindowAggregator.hpp) and handed to
+ * an AsyncFileWriter, which owns the file. The writer backend (posix or
+ * io_uring) is chosen by AsyncFileWriter::create().
+ */
+class AsyncFileMetaBroker : public PayloadBroker {
+ public:
+  enum Format {
+    proto,
+    csv,
+    columnar,
+    aggregate,
+  };
+
+  /**
+   * @param basepath the full path minus extension
+   * @param format the on-disk format
+   * @param options writer options (basepath, extension and header are
+   * filled in from the other arguments)
+   * @param sync_interval in proto format, if nonzero, write a sync marker
+   * every this many batches and keep a sidecar index (see RecordingIndex.hpp)
+   * @param row_group_size in columnar format, batches per row group
+   * @param window in aggregate format, the window length in ns
+   * @param cluster_distance in aggregate format, in person heights
+   * @param limits in aggregate format, how long and how many sources are
+   * kept open
+   */
+  AsyncFileMetaBroker(const std::string& basepath,
+                      Format format,
+                      AsyncFileWriter::Options options,
+                      unsigned sync_interval = 0,
+                      unsigned row_group_size = 256,
+                      uint64_t window = 5000000000ull,
+                      float cluster_distance = 1.0f,
+                      SourceTableLimits limits = SourceTableLimits());
+  virtual ~AsyncFileMetaBroker() = default;
+
+  /** open the file and start the writer */
+  bool start();
+  /**
+   * flush everything (including a partial row group or open windows) and
+   * close the file
+   */
+  void stop();
+
+  virtual bool on_batch_payload(NvDsBatchMeta* batch_meta,
+                                dp::Batch* batch) override;
+
+  /**
+   * write the open window (in aggregate format) of a source that went away
+   * (from the streaming thread)
+   */
+  void remove_source(uint32_t source_id);
+  /** bytes held for open windows (may be read from any thread) */
+  size_t source_memory() const { return aggregator_.memory(); }
+
+  const AsyncFileWriter& writer() const { return *writer_; }
+
+ private:
+  static AsyncFileWriter::Options make_options(const std::string& basepath,
+                                               Format format,
+                                               AsyncFileWriter::Options options,
+                                               bool indexed);
+  void flush_row_group();
+  void push_windows();
+
+  Format format_;
+  unsigned sync_interval_;
+  unsigned since_sync_;
+  /** reused for every batch in csv format */
+  CsvEncoder csv_;
+  unsigned row_group_size_;
+  /** batches not yet written in columnar format */
+  columnar::RowGroupBuilder row_group_;
+  /** open windows in aggregate format */
+  WindowAggregator aggregator_;
+  /** closed windows, reused between batches */
+  std::vector<WindowRecord> windows_;
+  std::unique_ptr<AsyncFileWriter> writer_;
+};
+
+}  // namespace ds
+
+#endif  // ASYNC_FILE_META_BROKER_HPP__
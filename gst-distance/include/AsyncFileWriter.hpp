@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef ASYNC_FILE_WRITER_HPP__
+#define ASYNC_FILE_WRITER_HPP__
+
+#include "WorkerPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace ds {
+
+/**
+ * Writes records to a file from a WorkerPool strand.
+ *
+ * Records are handed over through a bounded queue so the streaming thread
+ * never waits on the disk. When the queue is full, records are dropped and
+ * counted instead. The writer coalesces records into large, page aligned
+ * chunks, optionally fsyncs, and rotates the output file by size and/or by
+ * time. Records are never split across files, and existing files are never
+ * overwritten: a name that is taken is skipped.
+ *
+ * The writer has no thread of its own. Its work runs as tasks on a strand
+ * of WorkerPool::io(), one at a time, and a few hundred records per task at
+ * most so the other writers get a turn. Writes and fsyncs block, which is
+ * why that pool is kept apart from the CPU bound WorkerPool::shared().
+ */
+class AsyncFileWriter {
+ public:
+  /**
+   * Optional hooks called from the writer's tasks (never two at once), eg.
+   * to keep a sidecar index in step with the data file.
+   */
+  class Observer {
+   public:
+    virtual ~Observer() = default;
+    /** a new data file was opened at `path` */
+    virtual void on_open(const std::string& path) = 0;
+    /** a record with `meta` was placed at `offset` in the current file */
+    virtual void on_record(uint64_t offset,
+                           size_t length,
+                           const std::string& meta) = 0;
+    /** the first `durable` bytes of the current file were handed over */
+    virtual void on_flush(uint64_t durable) = 0;
+    /** bytes to append to the current file just before it is closed */
+    virtual std::string trailer() { return std::string(); }
+    /** the current data file was closed */
+    virtual void on_close() = 0;
+  };
+
+  enum Backend {
+    /** io_uring if available, otherwise posix */
+    BACKEND_AUTO,
+    /** plain blocking write(2) */
+    BACKEND_POSIX,
+    /** io_uring with registered buffers (falls back to posix) */
+    BACKEND_URING,
+  };
+
+  enum FsyncPolicy {
+    /** leave syncing to the kernel */
+    FSYNC_NEVER,
+    /** fsync every `fsync_interval_ms` */
+    FSYNC_INTERVAL,
+    /** fsync every `fsync_bytes` written */
+    FSYNC_BYTES,
+  };
+
+  struct Options {
+    /** full path minus extension */
+    std::string basepath;
+    /** extension including the dot, eg. ".csv" */
+    std::string extension;
+    /** written at the start of every file (eg. a csv header) */
+    std::string header;
+    /** maximum number of queued records before dropping */
+    size_t queue_size = 4096;
+    /** size of a coalesced write (rounded up to a page) */
+    size_t chunk_size = 1 << 20;
+    /**
+     * flush a partial chunk if nothing arrives for this long (or for
+     * fsync_interval_ms, if that is shorter and the policy is FSYNC_INTERVAL)
+     */
+    unsigned flush_interval_ms = 500;
+    FsyncPolicy fsync_policy = FSYNC_NEVER;
+    unsigned fsync_interval_ms = 1000;
+    size_t fsync_bytes = 16 << 20;
+    /** rotate when a file reaches this size (0 to disable) */
+    size_t rotate_bytes = 0;
+    /** rotate when a file is this old (0 to disable) */
+    unsigned rotate_seconds = 0;
+    /** which I/O backend create() should pick */
+    Backend backend = BACKEND_AUTO;
+    /** called from the writer's tasks (may be null) */
+    std::shared_ptr<Observer> observer;
+    /**
+     * Applied to every record by the writer before it is written (may be
+     * empty), eg. to move compression off the streaming thread.
+     */
+    std::function<void(std::string* record)> transform;
+    /** where the writing runs (nullptr for WorkerPool::io()) */
+    WorkerPool* pool = nullptr;
+  };
+
+  /**
+   * Create a writer using the backend requested in `options`, falling back
+   * to the posix backend if io_uring is not compiled in or not permitted
+   * by the kernel.
+   */
+  static std::unique_ptr<AsyncFileWriter> create(Options options);
+
+  explicit AsyncFileWriter(Options options);
+  /**
+   * Subclasses overriding the backend must call stop() in their own
+   * destructor, since virtual dispatch is gone by the time this runs.
+   */
+  virtual ~AsyncFileWriter();
+
+  /**
+   * Open the first file and start taking records.
+   *
+   * @return false if the file could not be opened.
+   */
+  bool start();
+  /**
+   * Wait for a running task, then drain the queue, flush, sync and close
+   * the file.
+   */
+  void stop();
+
+  /**
+   * Queue a record for writing. Never blocks on I/O.
+   *
+   * @return false if the record was dropped because the queue is full.
+   */
+  bool push(std::string&& record);
+  /**
+   * Queue a record along with opaque `meta` for the Observer.
+   */
+  bool push(std::string&& record, std::string&& meta);
+
+  /** number of records waiting to be written */
+  size_t queue_depth() const;
+  /** number of records dropped because the queue was full */
+  uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+  /** number of record bytes queued by push() (dropped ones don't count) */
+  uint64_t bytes_pushed() const {
+    return bytes_pushed_.load(std::memory_order_relaxed);
+  }
+  /** number of bytes handed to the kernel */
+  uint64_t bytes_written() const {
+    return bytes_written_.load(std::memory_order_relaxed);
+  }
+  /** number of fsyncs done */
+  uint64_t syncs() const { return syncs_.load(std::memory_order_relaxed); }
+  /** path of the file currently being written */
+  std::string current_path() const;
+  /** name of the I/O backend, for logging */
+  virtual const char* backend_name() const { return "posix"; }
+
+ protected:
+  /**
+   * Create `path` for writing, failing with EEXIST if it is already there.
+   * Backends override the open/write/sync/close
+   * quartet; the default implementation uses plain POSIX calls.
+   */
+  virtual bool backend_open(const std::string& path);
+  virtual bool backend_write(const char* data, size_t len);
+  virtual bool backend_sync();
+  virtual void backend_close();
+  /**
+   * Return a page aligned buffer of chunk_capacity() bytes to coalesce the
+   * next chunk into. `previous` is the chunk that was just passed to
+   * backend_write() (or nullptr on start). The default reuses a single
+   * buffer since posix writes complete synchronously.
+   */
+  virtual char* backend_acquire_chunk(char* previous);
+  /** free buffers on stop; `current` is the last acquired chunk */
+  virtual void backend_release_chunks(char* current);
+
+  size_t chunk_capacity() const { return chunk_capacity_; }
+
+  /** the open file descriptor, or -1 */
+  int fd_;
+
+ private:
+  typedef std::chrono::steady_clock clock;
+
+  struct Record {
+    std::string data;
+    std::string meta;
+  };
+
+  /** write a slice of the queue, and post another drain if needed */
+  void drain();
+  /** flush a partial chunk (and maybe sync) once nothing is queued */
+  void tick();
+  void schedule_tick();
+  void write_records(std::deque<Record>* records);
+  bool open_next();
+  void close_current();
+  bool append(const std::string& record);
+  bool flush_chunk(bool partial);
+  void maybe_sync(bool force);
+  bool rotation_due() const;
+
+  Options options_;
+
+  // queue shared with the streaming thread
+  mutable std::mutex lock_;
+  std::deque<Record> queue_;
+  bool running_;
+  /** a drain() or tick() is posted (so pushes don't post another) */
+  bool drain_posted_;
+  bool tick_posted_;
+  /** between start() and stop() */
+  std::unique_ptr<WorkerPool::Strand> strand_;
+
+  // state for the writer's tasks
+  std::deque<Record> batch_;
+  char* chunk_;
+  size_t chunk_capacity_;
+  size_t chunk_used_;
+  uint64_t file_bytes_;
+  uint64_t unsynced_bytes_;
+  unsigned file_index_;
+  std::string path_;
+  clock::time_point file_opened_;
+  clock::time_point last_sync_;
+
+  std::atomic<uint64_t> dropped_;
+  std::atomic<uint64_t> bytes_pushed_;
+  std::atomic<uint64_t> bytes_written_;
+  std::atomic<uint64_t> syncs_;
+};
+
+}  // namespace ds
+
+#endif  // ASYNC_FILE_WRITER_HPP__
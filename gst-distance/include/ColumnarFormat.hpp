@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef COLUMNAR_FORMAT_HPP__
+#define COLUMNAR_FORMAT_HPP__
+
+#include "AsyncFileWriter.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dp {
+class Batch;
+}  // namespace dp
+
+namespace ds {
+
+/**
+ * Columnar recordings.
+ *
+ * The table is the csv mode table (one row per person) stored column by
+ * column, so a scan only reads the columns it needs:
+ *
+ *   file      := FileHeader RowGroup* Footer
+ *   RowGroup  := RowGroupHeader ColumnChunk[num_columns] column data
+ *   Footer    := FooterEntry[num_groups] FooterTail
+ *
+ * Column data is an array of fixed width values, optionally delta encoded
+ * (ENCODING_DELTA, for pts and frame_num), stored with the narrowest width
+ * that holds every value of the chunk (integer columns only) and then
+ * optionally zlib compressed. Every row group is self describing, so a file without a
+ * footer (eg. still being written) can be read by walking the row groups
+ * from the start. All integers are host (little) endian.
+ */
+namespace columnar {
+
+static const char FILE_MAGIC[8] = {'D', 'S', 'C', 'O', 'L', '0', '0', '1'};
+static const char ROW_GROUP_MAGIC[4] = {'D', 'S', 'R', 'G'};
+static const char FOOTER_MAGIC[8] = {'D', 'S', 'C', 'O', 'L', 'E', 'N', 'D'};
+static const uint32_t VERSION = 1;
+static const char EXTENSION[] = ".col";
+
+enum Column {
+  COLUMN_PTS,
+  COLUMN_SOURCE_ID,
+  COLUMN_FRAME_NUM,
+  COLUMN_UID,
+  COLUMN_IS_DANGER,
+  COLUMN_DANGER_VAL,
+  COLUMN_LEFT,
+  COLUMN_TOP,
+  COLUMN_WIDTH,
+  COLUMN_HEIGHT,
+  NUM_COLUMNS,
+};
+
+/** width in bytes of a (decoded) value in each column */
+static const uint8_t VALUE_SIZE[NUM_COLUMNS] = {8, 4, 8, 8, 1, 4, 4, 4, 4, 4};
+/** whether a column holds unsigned integers (and may be stored narrower) */
+static const bool IS_INTEGER[NUM_COLUMNS] = {true,  true,  true,  true,  true,
+                                             false, false, false, false, false};
+
+enum Encoding {
+  ENCODING_PLAIN = 0,
+  /** each value minus the previous one (wrapping) */
+  ENCODING_DELTA = 1,
+};
+
+enum Compression {
+  COMPRESSION_NONE = 0,
+  COMPRESSION_ZLIB = 1,
+};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_columns;
+};
+
+struct RowGroupHeader {
+  char magic[4];
+  uint32_t num_rows;
+  uint32_t num_columns;
+  /** of the whole row group, including this header */
+  uint32_t size;
+  uint64_t min_pts;
+  uint64_t max_pts;
+};
+
+struct ColumnChunk {
+  uint16_t column;
+  /** of a decoded value */
+  uint8_t width;
+  uint8_t encoding;
+  uint8_t compression;
+  /** of a stored value (<= width) */
+  uint8_t packed_width;
+  uint8_t reserved[2];
+  /** of the data, from the start of the row group */
+  uint32_t offset;
+  uint32_t stored_size;
+  /** num_rows * packed_width */
+  uint32_t raw_size;
+  uint32_t reserved2;
+};
+
+struct FooterEntry {
+  /** of the row group, from the start of the file */
+  uint64_t offset;
+  uint64_t min_pts;
+  uint64_t max_pts;
+  uint32_t num_rows;
+  uint32_t size;
+};
+
+struct FooterTail {
+  uint64_t num_groups;
+  char magic[8];
+};
+
+static_assert(sizeof(FileHeader) == 16, "FileHeader must be packed");
+static_assert(sizeof(RowGroupHeader) == 32, "RowGroupHeader must be packed");
+static_assert(sizeof(ColumnChunk) == 24, "ColumnChunk must be packed");
+static_assert(sizeof(FooterEntry) == 32, "FooterEntry must be packed");
+static_assert(sizeof(FooterTail) == 16, "FooterTail must be packed");
+
+/** the FileHeader, as a string for AsyncFileWriter::Options::header */
+std::string file_header();
+
+/**
+ * Buffers batches as per column arrays on the streaming thread. take()
+ * hands back an uncompressed row group; compress_row_group() is meant to
+ * run by the writer.
+ */
+class RowGroupBuilder {
+ public:
+  /** keeps a row group well within its 32 bit sizes */
+  static const size_t MAX_ROWS = 1 << 20;
+
+  RowGroupBuilder();
+
+  /** append a row for every person in `batch` */
+  void add(const dp::Batch& batch);
+
+  size_t num_batches() const { return num_batches_; }
+  size_t num_rows() const { return num_rows_; }
+
+  /**
+   * Serialize and clear the buffered rows.
+   *
+   * @param meta set to a FooterEntry (without offset) for the FooterWriter
+   * @return the uncompressed row group
+   */
+  std::string take(std::string* meta);
+
+ private:
+  std::vector<uint8_t> columns_[NUM_COLUMNS];
+  size_t num_batches_;
+  size_t num_rows_;
+  uint64_t min_pts_;
+  uint64_t max_pts_;
+};
+
+/**
+ * zlib compress every column chunk of a row group from take() in place,
+ * keeping chunks that do not get smaller as they are.
+ */
+void compress_row_group(std::string* row_group);
+
+/**
+ * Collects the row groups of the current file and writes the footer when
+ * the file is closed.
+ */
+class FooterWriter : public AsyncFileWriter::Observer {
+ public:
+  virtual void on_open(const std::string& path) override;
+  virtual void on_record(uint64_t offset,
+                         size_t length,
+                         const std::string& meta) override;
+  virtual void on_flush(uint64_t durable) override;
+  virtual std::string trailer() override;
+  virtual void on_close() override;
+
+ private:
+  std::vector<FooterEntry> entries_;
+};
+
+}  // namespace columnar
+}  // namespace ds
+
+#endif  // COLUMNAR_FORMAT_HPP__
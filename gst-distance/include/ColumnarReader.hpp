@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef COLUMNAR_READER_HPP__
+#define COLUMNAR_READER_HPP__
+
+#include "ColumnarFormat.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ds {
+namespace columnar {
+
+/**
+ * Reads a columnar mode recording through a read-only memory map. Only the
+ * column chunks asked for are decompressed.
+ */
+class ColumnarReader {
+ public:
+  ColumnarReader();
+  ~ColumnarReader();
+
+  /**
+   * Map `path` and find its row groups, from the footer if there is one,
+   * otherwise by walking the file (a truncated last row group is ignored).
+   *
+   * @return false if the file could not be mapped or is not columnar.
+   */
+  bool open(const std::string& path);
+  void close();
+
+  /** whether the row groups were listed by a footer */
+  bool has_footer() const { return has_footer_; }
+  size_t num_row_groups() const { return groups_.size(); }
+  /** offset, size, row count and pts range of a row group */
+  const FooterEntry& row_group(size_t i) const { return groups_[i]; }
+  uint64_t num_rows() const;
+
+  /**
+   * Decode `column` of row group `group` into `out`, which must be exactly
+   * num_rows * VALUE_SIZE[column] bytes.
+   *
+   * @return false if the column is missing or malformed
+   */
+  bool read_column(size_t group,
+                   Column column,
+                   void* out,
+                   size_t out_size) const;
+
+  /** decode into a vector of the column's value type */
+  template <typename T>
+  bool read_column(size_t group, Column column, std::vector<T>* values) const {
+    if (sizeof(T) != VALUE_SIZE[column]) {
+      return false;
+    }
+    values->resize(groups_[group].num_rows);
+    return read_column(group, column, values->data(),
+                       values->size() * sizeof(T));
+  }
+
+ private:
+  bool read_footer();
+  void walk_row_groups();
+
+  const uint8_t* data_;
+  size_t size_;
+  bool has_footer_;
+  std::vector<FooterEntry> groups_;
+};
+
+/** whether `path` starts with the columnar FileHeader magic */
+bool is_columnar(const std::string& path);
+
+}  // namespace columnar
+}  // namespace ds
+
+#endif  // COLUMNAR_READER_HPP__
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef CSV_ENCODER_HPP__
+#define CSV_ENCODER_HPP__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dp {
+class Batch;
+}  // namespace dp
+
+namespace ds {
+
+/**
+ * Formats smart_distancing csv rows, one per person:
+ *
+ *   source_id,frame_num,pts,uid,is_danger,danger_val,left,top,width,height
+ *
+ * Output is byte for byte what printf("%u,%lu,%lu,%lu,%d,%f,%f,%f,%f,%f\n")
+ * gives. Numbers are formatted with std::to_chars where the standard library
+ * supports it (snprintf otherwise), the frame columns are formatted once per
+ * frame and copied into each row, and rows are written into a buffer that is
+ * reused from batch to batch (or handed over with take()).
+ */
+class CsvEncoder {
+ public:
+  /** the header line, including the newline */
+  static const char HEADER[];
+  /** the longest possible row, including the newline */
+  static const size_t MAX_ROW_SIZE;
+
+  CsvEncoder();
+
+  /** start a new frame; following rows share these columns */
+  void begin_frame(uint32_t source_id, uint64_t frame_num, uint64_t pts);
+  /** append one row for the current frame */
+  void add_person(uint64_t uid,
+                  bool is_danger,
+                  float danger_val,
+                  float left,
+                  float top,
+                  float width,
+                  float height);
+
+  /** replace the buffer contents with a row for every person in `batch` */
+  void encode(const dp::Batch& batch);
+
+  const char* data() const { return buffer_.data(); }
+  size_t size() const { return size_; }
+  std::string str() const { return std::string(buffer_.data(), size_); }
+  /**
+   * hand over the rows without copying them, leaving the encoder empty (the
+   * next encode() allocates a buffer of the size it needs)
+   */
+  std::string take();
+  /** empty the buffer (capacity is kept) */
+  void clear() { size_ = 0; }
+
+ private:
+  /** make room for at least `rows` more rows */
+  void reserve_rows(size_t rows);
+
+  /** "source_id,frame_num,pts," of the current frame */
+  char prefix_[64];
+  size_t prefix_size_;
+  std::string buffer_;
+  size_t size_;
+};
+
+}  // namespace ds
+
+#endif  // CSV_ENCODER_HPP__
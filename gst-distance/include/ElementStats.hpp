@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef ELEMENT_STATS_HPP__
+#define ELEMENT_STATS_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ds {
+
+/**
+ * Counters for an element's `stats` property, updated on every buffer.
+ *
+ * Each thread updates one of NUM_SLOTS slots (threads beyond that share),
+ * each on its own cache lines, so streaming threads never contend with
+ * each other or with a poller. snapshot() sums the slots.
+ */
+class ElementStats {
+ public:
+  static const size_t NUM_SLOTS = 16;
+  /** processing time buckets, the last one unbounded */
+  static const size_t NUM_BUCKETS = 13;
+  /** upper bound (inclusive, in ns) of each bucket but the last */
+  static const uint64_t BUCKET_BOUNDS[NUM_BUCKETS - 1];
+
+  struct Snapshot {
+    uint64_t buffers;
+    uint64_t objects;
+    /** object pairs whose distance was evaluated */
+    uint64_t pairs;
+    /** filled in by the element from its outputs */
+    uint64_t bytes_serialized;
+    uint64_t bytes_written;
+    /** processing time in ns */
+    uint64_t total_time;
+    uint64_t max_time;
+    /** buffers per processing time bucket (not cumulative) */
+    uint64_t time_buckets[NUM_BUCKETS];
+
+    uint64_t mean_time() const { return buffers ? total_time / buffers : 0; }
+  };
+
+  ElementStats();
+
+  /** count a buffer with `objects` and `pairs` that took `time` ns */
+  void add(uint64_t objects, uint64_t pairs, uint64_t time);
+
+  /** may be called from any thread */
+  Snapshot snapshot() const;
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> buffers;
+    std::atomic<uint64_t> objects;
+    std::atomic<uint64_t> pairs;
+    std::atomic<uint64_t> total_time;
+    std::atomic<uint64_t> max_time;
+    std::atomic<uint64_t> time_buckets[NUM_BUCKETS];
+    /** whole cache line pairs, so slots never share a line however aligned */
+    char padding[256 - (5 + NUM_BUCKETS) * sizeof(std::atomic<uint64_t>)];
+  };
+
+  Slot& this_thread_slot();
+
+  Slot slots_[NUM_SLOTS];
+};
+
+}  // namespace ds
+
+#endif  // ELEMENT_STATS_HPP__
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef FAKE_BATCH_META_HPP__
+#define FAKE_BATCH_META_HPP__
+
+#include "FakeScene.hpp"
+
+#include <gst/gst.h>
+
+#include <cstdint>
+
+namespace ds {
+
+/**
+ * Attach an NvDsBatchMeta to `buf` with a frame for each source of `scene`
+ * and an object for each person, as nvinfer and nvtracker would leave it.
+ * Uses DeepStream's host-side meta API only (no GPU is needed).
+ *
+ * Frames get source ids from `first_source_id` up (as if those sources were
+ * linked to nvstreammux's first pads).
+ */
+void add_fake_batch_meta(GstBuffer* buf,
+                         const FakeScene& scene,
+                         uint64_t frame_num,
+                         int class_id,
+                         uint32_t first_source_id = 0);
+
+}  // namespace ds
+
+#endif  // FAKE_BATCH_META_HPP__
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef FAKE_SCENE_HPP__
+#define FAKE_SCENE_HPP__
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace ds {
+
+/** a person in a FakeScene (in pixels, velocity in pixels per frame) */
+struct FakeObject {
+  uint64_t id;
+  float left;
+  float top;
+  float width;
+  float height;
+  float dx;
+  float dy;
+};
+
+/**
+ * Synthetic people for load testing, a fixed number per source.
+ *
+ * People are placed at random with heights of 10-30% of the frame and move
+ * according to `motion`. Each step every person's tracker id is replaced
+ * with probability `churn`, as when a tracker loses and reacquires someone.
+ * The same seed always produces the same scene.
+ */
+class FakeScene {
+ public:
+  enum Motion {
+    /** people stand still */
+    MOTION_STATIC,
+    /** people walk in straight lines and bounce off the frame edges */
+    MOTION_LINEAR,
+    /** like MOTION_LINEAR, but people change direction at random */
+    MOTION_RANDOM,
+  };
+
+  FakeScene(uint32_t sources,
+            uint32_t objects,
+            Motion motion,
+            double churn,
+            uint32_t width,
+            uint32_t height,
+            uint64_t seed = 0);
+
+  /** advance every source by one frame */
+  void step();
+
+  uint32_t sources() const { return (uint32_t)sources_.size(); }
+  uint32_t width() const { return (uint32_t)width_; }
+  uint32_t height() const { return (uint32_t)height_; }
+  const std::vector<FakeObject>& objects(uint32_t source) const {
+    return sources_[source];
+  }
+  /** tracker ids handed out so far (ids start at 1) */
+  uint64_t ids() const { return next_id_ - 1; }
+
+ private:
+  FakeObject spawn();
+  void move(FakeObject* object);
+
+  Motion motion_;
+  double churn_;
+  float width_;
+  float height_;
+  uint64_t next_id_;
+  std::mt19937_64 rng_;
+  std::vector<std::vector<FakeObject>> sources_;
+};
+
+}  // namespace ds
+
+#endif  // FAKE_SCENE_HPP__
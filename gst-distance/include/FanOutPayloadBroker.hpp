@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef FAN_OUT_PAYLOAD_BROKER_HPP__
+#define FAN_OUT_PAYLOAD_BROKER_HPP__
+
+#include "PayloadSampler.hpp"
+
+#include <PayloadBroker.hpp>
+
+#include <memory>
+#include <vector>
+
+namespace ds {
+
+/**
+ * A PayloadBroker that drives several other PayloadBrokers.
+ *
+ * The metadata is walked and the `Batch` payload built once (by this
+ * broker's on_buffer), then the same payload is handed to every output in
+ * the order they were added. Outputs only see on_batch_payload, so they must
+ * not depend on their own on_buffer/on_batch_meta being called, and must not
+ * modify the batch. File outputs (AsyncFileMetaBroker) each write from their
+ * own WorkerPool strand, so a slow output does not hold up the others.
+ *
+ * Sampled outputs only get the frames the PayloadSampler keeps, and nothing
+ * at all for a skipped batch, so skipped frames are never encoded or queued.
+ * Unsampled outputs (eg. aggregates) get every frame first.
+ */
+class FanOutPayloadBroker : public PayloadBroker {
+ public:
+  explicit FanOutPayloadBroker(
+      PayloadSampler::Policy policy = PayloadSampler::POLICY_NONE,
+      double max_rate = 1.0,
+      SourceTableLimits limits = SourceTableLimits());
+  virtual ~FanOutPayloadBroker() = default;
+
+  /**
+   * add an output, taking ownership of it
+   *
+   * @param sampled whether the output only gets sampled frames
+   */
+  void add(PayloadBroker* output, bool sampled = true);
+
+  size_t size() const { return outputs_.size() + unsampled_.size(); }
+
+  const PayloadSampler& sampler() const { return sampler_; }
+  /** forget the sampler's state for a source that went away */
+  void remove_source(uint32_t source_id) {
+    sampler_.remove_source(source_id);
+  }
+  /**
+   * the pairs of people in the same frame, summed over every batch handed to
+   * on_batch_payload since the last call (counted from the payload, so the
+   * metadata is not walked again)
+   */
+  uint64_t take_pairs() {
+    uint64_t pairs = pairs_;
+    pairs_ = 0;
+    return pairs;
+  }
+
+  /**
+   * Hand `batch` to every unsampled output, sample it, then hand what is
+   * left to every sampled output.
+   *
+   * @return true if every output returned true (all outputs are called
+   * either way)
+   */
+  virtual bool on_batch_payload(NvDsBatchMeta* batch_meta,
+                                dp::Batch* batch) override;
+
+ private:
+  PayloadSampler sampler_;
+  std::vector<std::unique_ptr<PayloadBroker>> outputs_;
+  std::vector<std::unique_ptr<PayloadBroker>> unsampled_;
+  uint64_t pairs_ = 0;
+};
+
+}  // namespace ds
+
+#endif  // FAN_OUT_PAYLOAD_BROKER_HPP__
@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef FRAME_SCHEDULER_HPP__
+#define FRAME_SCHEDULER_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ds {
+
+/**
+ * Per source priorities and a per batch time budget.
+ *
+ * Frames are processed critical first, then normal, then best effort (in
+ * batch order within a priority). Once a batch has used its budget, only
+ * critical frames are processed, so the sources that matter get the same
+ * treatment however loaded the box is.
+ *
+ * The setters may be called from any thread.
+ */
+class FrameScheduler {
+ public:
+  enum Priority {
+    PRIORITY_CRITICAL,
+    PRIORITY_NORMAL,
+    PRIORITY_BEST_EFFORT,
+  };
+
+  FrameScheduler();
+
+  /**
+   * Set priorities from eg. "0:critical,3:critical,7:best-effort" (sources
+   * not listed are normal).
+   *
+   * @return false (leaving the priorities alone) if `spec` is malformed
+   */
+  bool set_priorities(const std::string& spec);
+  /** the priorities in set_priorities() form */
+  std::string priorities() const;
+  Priority priority(unsigned source_id) const;
+
+  /** time budget per batch in ns (0 for no budget) */
+  void set_budget(uint64_t ns) {
+    budget_.store(ns, std::memory_order_relaxed);
+  }
+  uint64_t budget() const { return budget_.load(std::memory_order_relaxed); }
+
+  /** whether there is anything to schedule (otherwise process everything) */
+  bool active() const;
+
+  /**
+   * The order to process frames from `source_ids` in, as indices into it,
+   * along with each frame's priority.
+   */
+  void order(const std::vector<unsigned>& source_ids,
+             std::vector<size_t>* indices,
+             std::vector<Priority>* priorities) const;
+
+  /**
+   * whether to process a frame of `priority` when the batch has taken
+   * `elapsed` ns so far (counts the frame as skipped if not)
+   */
+  bool should_process(Priority priority, uint64_t elapsed);
+
+  /**
+   * whether to process a batch of frames from `source_ids` as a whole,
+   * expecting it to take `cost` ns: always if a frame is critical, otherwise
+   * only within budget (counts every frame as skipped if not)
+   */
+  bool should_process_batch(const std::vector<unsigned>& source_ids,
+                            uint64_t cost);
+
+  /** number of frames skipped for being over budget */
+  uint64_t skipped() const { return skipped_.load(std::memory_order_relaxed); }
+
+  static const char* priority_name(Priority priority);
+
+ private:
+  mutable std::mutex lock_;
+  std::map<unsigned, Priority> priorities_;
+  std::atomic<uint64_t> budget_;
+  std::atomic<uint64_t> skipped_;
+};
+
+}  // namespace ds
+
+#endif  // FRAME_SCHEDULER_HPP__
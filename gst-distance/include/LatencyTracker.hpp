@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef LATENCY_TRACKER_HPP__
+#define LATENCY_TRACKER_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ds {
+
+/**
+ * A log-linear (HDR style) histogram of latencies in ns, with 16 buckets
+ * per power of two (about 6% precision) up to 2^40 ns.
+ *
+ * record() must only be called from one thread; the counts may be read
+ * from any thread at the same time.
+ */
+class LatencyHistogram {
+ public:
+  static const unsigned SUB_BITS = 4;
+  static const unsigned SUB_BUCKETS = 1 << SUB_BITS;
+  static const unsigned MAX_BITS = 40;
+  static const size_t NUM_BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_BUCKETS;
+
+  LatencyHistogram();
+
+  void record(uint64_t ns);
+
+  /** add the counts to `counts` (of size NUM_BUCKETS) */
+  void add_to(std::vector<uint64_t>* counts) const;
+
+  /** the bucket `ns` is counted in */
+  static size_t bucket(uint64_t ns);
+  /** the smallest value counted in `bucket` */
+  static uint64_t lower_bound(size_t bucket);
+  /** the value at quantile `q` (0-1) of `counts`, or 0 if empty */
+  static uint64_t quantile(const std::vector<uint64_t>& counts, double q);
+
+ private:
+  std::atomic<uint64_t> counts_[NUM_BUCKETS];
+};
+
+/**
+ * Latency histograms by element and number of objects per batch, kept per
+ * thread so that recording never takes a lock or shares a cache line.
+ *
+ * Elements are registered by name the first time a thread records for
+ * them (under a lock); after that a thread only touches its own
+ * histograms. dump() merges every thread's histograms.
+ */
+class LatencyTracker {
+ public:
+  /** elements after this many are not tracked */
+  static const size_t MAX_ELEMENTS = 32;
+  /** objects per batch: 0, 1-10, 11-50, 51-100, 101-250, 251-500, more */
+  static const size_t NUM_OBJECT_BUCKETS = 7;
+
+  LatencyTracker();
+  ~LatencyTracker();
+
+  /**
+   * Record a latency for the element named `name` (which `element`
+   * identifies on this thread, eg. its address).
+   */
+  void record(const void* element,
+              const char* name,
+              size_t objects,
+              uint64_t ns);
+
+  /**
+   * One line per element and object bucket with any samples:
+   * `name objects=11-50 n=... p50=...us p90=... p99=... p99.9=...`
+   */
+  std::string dump() const;
+
+  static size_t object_bucket(size_t objects);
+  static const char* object_bucket_name(size_t bucket);
+
+ private:
+  struct ThreadHistograms {
+    /** owned, allocated by the owning thread on first use */
+    std::atomic<LatencyHistogram*> histograms[MAX_ELEMENTS]
+                                             [NUM_OBJECT_BUCKETS];
+    /** element to slot, only used by the owning thread */
+    std::unordered_map<const void*, int> slots;
+
+    ThreadHistograms();
+    ~ThreadHistograms();
+  };
+
+  ThreadHistograms* this_thread();
+  int slot(ThreadHistograms* thread, const void* element, const char* name);
+
+  /** tells trackers apart in the per thread cache */
+  const uint64_t id_;
+  mutable std::mutex lock_;
+  /** element names by slot */
+  std::vector<std::string> names_;
+  std::vector<std::unique_ptr<ThreadHistograms>> threads_;
+};
+
+}  // namespace ds
+
+#endif  // LATENCY_TRACKER_HPP__
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef LOAD_SHEDDER_HPP__
+#define LOAD_SHEDDER_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace ds {
+
+/**
+ * Decides which buffers an element fully processes when downstream is late.
+ *
+ * Quality of service reports (lateness and proportion, as in a GStreamer
+ * QoS event) move the level up after ESCALATE_AFTER late reports in a row
+ * and back down after RECOVER_AFTER on time reports in a row. At level n
+ * only every (1 << n)th buffer is processed, so some results always get
+ * through, and the level never changes on a single report.
+ *
+ * on_qos() may be called from any thread; should_process() is for the
+ * streaming thread only and costs a relaxed load and an increment.
+ */
+class LoadShedder {
+ public:
+  static const unsigned MAX_LEVEL = 3;
+  static const unsigned ESCALATE_AFTER = 4;
+  static const unsigned RECOVER_AFTER = 32;
+
+  LoadShedder();
+
+  /**
+   * Account for a QoS report.
+   *
+   * @param proportion the rate downstream needs relative to the current one
+   * @param diff how late (positive) or early (negative) a buffer was, in ns
+   *
+   * @return true if the level changed
+   */
+  bool on_qos(double proportion, int64_t diff);
+
+  /** whether to fully process the next buffer */
+  bool should_process();
+
+  unsigned level() const { return level_.load(std::memory_order_relaxed); }
+  /** process every interval()th buffer */
+  unsigned interval() const { return 1u << level(); }
+
+  /** back to full processing (eg. on stop or flush) */
+  void reset();
+
+ private:
+  std::mutex lock_;
+  std::atomic<unsigned> level_;
+  unsigned late_;
+  unsigned on_time_;
+  uint64_t count_;
+};
+
+}  // namespace ds
+
+#endif  // LOAD_SHEDDER_HPP__
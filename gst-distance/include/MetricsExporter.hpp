@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef METRICS_EXPORTER_HPP__
+#define METRICS_EXPORTER_HPP__
+
+#include "MetricsRegistry.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace ds {
+
+/**
+ * A low priority background thread exposing a MetricsRegistry in the
+ * Prometheus text format, either by rewriting a file every interval (eg.
+ * for node_exporter's textfile collector) or by serving a scrape to every
+ * connection on a Unix socket (eg. `socat - UNIX-CONNECT:path`).
+ */
+class MetricsExporter {
+ public:
+  enum Mode {
+    /** rewrite `path` every `interval_ms` */
+    MODE_FILE,
+    /** write a scrape to each connection on the Unix socket at `path` */
+    MODE_SOCKET,
+  };
+
+  struct Options {
+    Mode mode = MODE_FILE;
+    std::string path;
+    /** how often the file is rewritten (MODE_FILE only) */
+    unsigned interval_ms = 5000;
+  };
+
+  MetricsExporter(MetricsRegistry* registry, Options options);
+  ~MetricsExporter();
+
+  /**
+   * Open the socket (in MODE_SOCKET) and start the thread.
+   *
+   * @return false if the socket could not be opened.
+   */
+  bool start();
+  /** Stop and join the thread, removing the socket (but not the file). */
+  void stop();
+
+ private:
+  void run();
+  void write_file();
+  void serve(int client);
+
+  MetricsRegistry* registry_;
+  Options options_;
+  int listen_fd_;
+  bool running_;
+  std::mutex lock_;
+  std::condition_variable cond_;
+  std::thread thread_;
+};
+
+}  // namespace ds
+
+#endif  // METRICS_EXPORTER_HPP__
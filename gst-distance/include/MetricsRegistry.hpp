@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef METRICS_REGISTRY_HPP__
+#define METRICS_REGISTRY_HPP__
+
+#include "ElementStats.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ds {
+
+/** what one element reports to the metrics exporter */
+struct MetricsSample {
+  /** the element's name, used as the `element` label */
+  std::string element;
+  /** the element's factory name, used as the `kind` label */
+  std::string kind;
+  ElementStats::Snapshot stats;
+  /** whether the element has writer queues (queue_depth and dropped) */
+  bool has_queue;
+  uint64_t queue_depth;
+  uint64_t dropped;
+};
+
+/**
+ * Every live element in the process that exports metrics, and their
+ * Prometheus text exposition.
+ *
+ * Elements add a collector when created and remove it when finalized.
+ * Collectors run only when metrics are scraped, so they cost the streaming
+ * thread nothing; the counters they read are updated with relaxed atomics.
+ */
+class MetricsRegistry {
+ public:
+  typedef std::function<void(MetricsSample* sample)> Collector;
+
+  /** the process wide registry */
+  static MetricsRegistry& instance();
+
+  /** add `collector` under `key` (eg. the element) */
+  void add(const void* key, Collector collector);
+  /**
+   * remove the collector under `key`. Once this returns the collector is
+   * not running and will not run again.
+   */
+  void remove(const void* key);
+
+  /** collect every element's sample */
+  std::vector<MetricsSample> collect() const;
+
+  /** the Prometheus text exposition of `samples` */
+  static std::string format(const std::vector<MetricsSample>& samples);
+  /** format(collect()) */
+  std::string scrape() const { return format(collect()); }
+
+ private:
+  mutable std::mutex lock_;
+  std::vector<std::pair<const void*, Collector>> collectors_;
+};
+
+}  // namespace ds
+
+#endif  // METRICS_REGISTRY_HPP__
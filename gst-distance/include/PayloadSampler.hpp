@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef PAYLOAD_SAMPLER_HPP__
+#define PAYLOAD_SAMPLER_HPP__
+
+#include "SourceTable.hpp"
+
+#include <atomic>
+#include <cstdint>
+
+namespace dp {
+class Batch;
+class Frame;
+}  // namespace dp
+
+namespace ds {
+
+/**
+ * Drops frames from a `Batch` before it is encoded anywhere.
+ *
+ * POLICY_RATE keeps at most `max_rate` frames per second of pts per source
+ * (the first frame in each 1 / max_rate slot). POLICY_ADAPTIVE keeps every
+ * frame with a violation and rate limits the quiet ones the same way.
+ * Decisions use pts rather than the wall clock, so they are the same
+ * however fast the pipeline runs. A source that is forgotten (removed, idle
+ * or over the memory cap, see SourceTable.hpp) starts over with its next
+ * frame kept.
+ */
+class PayloadSampler {
+ public:
+  enum Policy {
+    POLICY_NONE,
+    POLICY_RATE,
+    POLICY_ADAPTIVE,
+  };
+
+  PayloadSampler(Policy policy = POLICY_NONE,
+                 double max_rate = 1.0,
+                 SourceTableLimits limits = SourceTableLimits());
+
+  Policy policy() const { return policy_; }
+
+  /**
+   * Remove the frames that are not sampled from `batch`.
+   *
+   * @return false if no frame is left (the batch should be skipped)
+   */
+  bool sample(dp::Batch* batch);
+
+  /** forget a source that went away (eg. on stream eos) */
+  void remove_source(uint32_t source_id);
+  /** number of sources remembered */
+  size_t sources() const { return last_slot_.size(); }
+  /** bytes held for the sources (may be read from any thread) */
+  size_t memory() const { return last_slot_.memory(); }
+
+  /** batches with at least one frame kept (may be read from any thread) */
+  uint64_t emitted() const { return emitted_; }
+  /** batches with every frame dropped (may be read from any thread) */
+  uint64_t skipped() const { return skipped_; }
+
+ private:
+  bool keep(const dp::Frame& frame);
+
+  Policy policy_;
+  /** in ns of pts */
+  uint64_t interval_;
+  /** the last slot a frame was kept in, by source */
+  SourceTable<uint64_t> last_slot_;
+  std::atomic<uint64_t> emitted_;
+  std::atomic<uint64_t> skipped_;
+};
+
+}  // namespace ds
+
+#endif  // PAYLOAD_SAMPLER_HPP__
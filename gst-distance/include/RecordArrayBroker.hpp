@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef RECORD_ARRAY_BROKER_HPP__
+#define RECORD_ARRAY_BROKER_HPP__
+
+#include <PayloadBroker.hpp>
+
+#include <glib.h>
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace ds {
+
+/**
+ * One person in a flat results array. The layout is fixed (56 bytes, host
+ * (little) endian, no padding between arrays), so Python can read it with:
+ *
+ *   dtype = numpy.dtype([
+ *       ('pts', '<u8'), ('frame_num', '<u8'), ('uid', '<u8'),
+ *       ('source_id', '<u4'), ('danger_val', '<f4'),
+ *       ('left', '<f4'), ('top', '<f4'), ('width', '<f4'), ('height', '<f4'),
+ *       ('is_danger', 'u1'), ('reserved', 'V7')])
+ *   records = numpy.frombuffer(element.props.records.get_data(), dtype)
+ */
+struct PersonRecord {
+  uint64_t pts;
+  uint64_t frame_num;
+  uint64_t uid;
+  uint32_t source_id;
+  float danger_val;
+  float left;
+  float top;
+  float width;
+  float height;
+  uint8_t is_danger;
+  uint8_t reserved[7];
+};
+
+static_assert(sizeof(PersonRecord) == 56, "PersonRecord must be packed");
+
+/**
+ * A PayloadBroker that keeps the latest batch as an array of PersonRecord
+ * (one per person, in frame order) in a GBytes.
+ *
+ * Each batch gets a new GBytes; the broker drops its reference to the old
+ * one, so a reader holding a reference keeps a valid, unchanging array
+ * without any copy.
+ */
+class RecordArrayBroker : public PayloadBroker {
+ public:
+  RecordArrayBroker();
+  virtual ~RecordArrayBroker();
+
+  virtual bool on_batch_payload(NvDsBatchMeta* batch_meta,
+                                dp::Batch* batch) override;
+
+  /**
+   * the records of the latest batch (transfer full), or nullptr before the
+   * first batch. May be called from any thread.
+   */
+  GBytes* get_records();
+
+  /** total size of every array encoded so far */
+  uint64_t bytes_serialized() const {
+    return bytes_serialized_.load(std::memory_order_relaxed);
+  }
+
+  /** encode `batch` as a new GBytes of PersonRecord (transfer full) */
+  static GBytes* encode(const dp::Batch& batch);
+
+ private:
+  std::mutex lock_;
+  GBytes* records_;
+  std::atomic<uint64_t> bytes_serialized_;
+};
+
+}  // namespace ds
+
+#endif  // RECORD_ARRAY_BROKER_HPP__
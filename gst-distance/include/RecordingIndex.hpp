@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef RECORDING_INDEX_HPP__
+#define RECORDING_INDEX_HPP__
+
+#include "AsyncFileWriter.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ds {
+
+/**
+ * Indexed proto recordings.
+ *
+ * The data file is the usual stream of varint length delimited `Batch`
+ * messages with a sync marker every so often. The marker is itself a valid
+ * length delimited `Batch` holding a single unknown field, so readers that
+ * predate the index just see an empty batch. The marker lets a reader that
+ * starts at an arbitrary byte offset find the next record boundary.
+ *
+ * The sidecar index (same path, ".idx" extension) is an IndexHeader
+ * followed by one IndexEntry per frame, in file order. All integers are
+ * host (little) endian.
+ */
+namespace recording {
+
+/** the sync marker: varint(11), field 2047 (bytes), len 8, "DSSYNC01" */
+static const uint8_t SYNC_MARKER[] = {0x0B, 0xFA, 0x7F, 0x08, 'D', 'S',
+                                      'S',  'Y',  'N',  'C',  '0', '1'};
+static const size_t SYNC_MARKER_SIZE = sizeof(SYNC_MARKER);
+
+static const char INDEX_MAGIC[8] = {'D', 'S', 'I', 'D', 'X', '0', '0', '1'};
+static const uint32_t INDEX_VERSION = 1;
+static const char INDEX_EXTENSION[] = ".idx";
+
+struct IndexHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t entry_size;
+};
+
+struct IndexEntry {
+  /** pts of this frame */
+  uint64_t pts;
+  /** highest pts in the file up to and including this frame (sorted) */
+  uint64_t max_pts;
+  /**
+   * offset of the length delimited `Batch` holding this frame (or of the
+   * sync marker just before it)
+   */
+  uint64_t offset;
+  uint64_t frame_num;
+  uint32_t source_id;
+  /** length of the record (including any marker and the varint prefix) */
+  uint32_t length;
+};
+
+/** per frame key, packed into the writer's record meta */
+struct IndexKey {
+  uint64_t pts;
+  uint64_t frame_num;
+  uint32_t source_id;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(IndexHeader) == 16, "IndexHeader must be packed");
+static_assert(sizeof(IndexEntry) == 40, "IndexEntry must be packed");
+static_assert(sizeof(IndexKey) == 24, "IndexKey must be packed");
+
+/** `path` with its extension replaced by ".idx" */
+std::string index_path(const std::string& data_path);
+
+/**
+ * Keeps a sidecar index in step with an AsyncFileWriter. Entries are only
+ * written once the data they point to has been handed to the kernel, so a
+ * reader never finds an entry past the end of the data file.
+ */
+class IndexWriter : public AsyncFileWriter::Observer {
+ public:
+  IndexWriter();
+  virtual ~IndexWriter();
+
+  virtual void on_open(const std::string& path) override;
+  virtual void on_record(uint64_t offset,
+                         size_t length,
+                         const std::string& meta) override;
+  virtual void on_flush(uint64_t durable) override;
+  virtual void on_close() override;
+
+ private:
+  void write_entries(size_t count);
+
+  int fd_;
+  uint64_t max_pts_;
+  std::vector<IndexEntry> pending_;
+};
+
+}  // namespace recording
+}  // namespace ds
+
+#endif  // RECORDING_INDEX_HPP__
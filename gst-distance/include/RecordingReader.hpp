@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef RECORDING_READER_HPP__
+#define RECORDING_READER_HPP__
+
+#include "RecordingIndex.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace dp {
+class Batch;
+}
+
+namespace ds {
+namespace recording {
+
+/**
+ * Reads a proto mode recording (and its sidecar index, if any) through
+ * read-only memory maps.
+ */
+class RecordingReader {
+ public:
+  RecordingReader();
+  ~RecordingReader();
+
+  /**
+   * Map `data_path` and, if present, its ".idx" sidecar.
+   *
+   * @return false if the data file could not be mapped.
+   */
+  bool open(const std::string& data_path);
+  void close();
+
+  bool has_index() const { return entries_ != nullptr; }
+  size_t num_entries() const { return num_entries_; }
+  const IndexEntry& entry(size_t i) const { return entries_[i]; }
+
+  /**
+   * Position the reader at the first record that may hold a frame with
+   * pts >= `pts`. O(log n) with an index, a linear scan without one.
+   */
+  void seek(uint64_t pts);
+  /** position the reader at a byte offset known to be a record boundary */
+  void seek_offset(uint64_t offset) { position_ = offset; }
+  uint64_t tell() const { return position_; }
+
+  /**
+   * The next record (sync markers are skipped). The returned pointer is
+   * into the mapping and valid until close().
+   *
+   * @return false at the end of the file or on a truncated record.
+   */
+  bool next(const uint8_t** data, size_t* len);
+  /** parse the next record into `batch` */
+  bool next(dp::Batch* batch);
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  const IndexEntry* entries_;
+  size_t num_entries_;
+  const void* index_map_;
+  size_t index_map_size_;
+  uint64_t position_;
+};
+
+/**
+ * Map a whole file read-only.
+ *
+ * @return the mapping (munmap it with `size`), or nullptr on failure or if
+ * the file is empty.
+ */
+const void* map_file(const std::string& path, size_t* size);
+
+/**
+ * Decode the varint length prefix at `p` (at most `avail` bytes).
+ *
+ * @return the size of the prefix, or 0 if it is truncated or invalid.
+ */
+size_t read_length_prefix(const uint8_t* p, size_t avail, uint32_t* length);
+
+/** whether the record at `p` is a sync marker */
+bool is_sync_marker(const uint8_t* p, size_t avail);
+
+}  // namespace recording
+}  // namespace ds
+
+#endif  // RECORDING_READER_HPP__
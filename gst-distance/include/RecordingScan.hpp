@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef RECORDING_SCAN_HPP__
+#define RECORDING_SCAN_HPP__
+
+#include "RecordingReader.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ds {
+namespace recording {
+
+/**
+ * A person, decoded straight from the mapped wire bytes.
+ */
+struct PersonView {
+  uint64_t uid;
+  bool is_danger;
+  float danger_val;
+  float left;
+  float top;
+  float width;
+  float height;
+};
+
+/**
+ * A frame, decoded straight from the mapped wire bytes. People are decoded
+ * lazily with for_each_person(), so scans that only need frame level
+ * fields never touch them.
+ */
+struct FrameView {
+  uint64_t pts;
+  uint64_t frame_num;
+  uint32_t source_id;
+  float sum_danger;
+  uint32_t num_people;
+  uint32_t num_danger;
+  /** people are the repeated field in [begin, end) of the frame message */
+  const uint8_t* begin;
+  const uint8_t* end;
+};
+
+class FrameVisitor {
+ public:
+  virtual ~FrameVisitor() = default;
+  virtual void on_frame(const FrameView& frame) = 0;
+};
+
+class PersonVisitor {
+ public:
+  virtual ~PersonVisitor() = default;
+  virtual void on_person(const FrameView& frame, const PersonView& person) = 0;
+};
+
+/**
+ * Walk the frames of a serialized `Batch` without copying or allocating.
+ *
+ * @return false if the message is malformed
+ */
+bool for_each_frame(const uint8_t* batch, size_t len, FrameVisitor* visitor);
+
+/**
+ * Walk the people of a frame from for_each_frame().
+ *
+ * @return false if the message is malformed
+ */
+bool for_each_person(const FrameView& frame, PersonVisitor* visitor);
+
+struct ScanOptions {
+  /** only frames from these sources (empty for all) */
+  std::vector<uint32_t> sources;
+  /** only frames with begin <= pts < end */
+  uint64_t begin = 0;
+  uint64_t end = UINT64_MAX;
+};
+
+/** a byte range of the data file starting and ending on record boundaries */
+struct Chunk {
+  uint64_t begin;
+  uint64_t end;
+};
+
+/**
+ * Split the recording into up to `count` independently decodable chunks.
+ *
+ * With an index, chunk boundaries come from the index, and chunks entirely
+ * before `options.begin` are skipped. Without one, chunks are aligned to
+ * sync markers; a recording without markers is a single chunk.
+ */
+std::vector<Chunk> split_chunks(const RecordingReader& reader,
+                                unsigned count,
+                                const ScanOptions& options);
+
+/**
+ * Decode one chunk, calling `visitor` for every frame matching `options`.
+ *
+ * @return false if a malformed record was found (the scan stops there)
+ */
+bool scan_chunk(const RecordingReader& reader,
+                const Chunk& chunk,
+                const ScanOptions& options,
+                FrameVisitor* visitor);
+
+/**
+ * Decode a recording in parallel, one thread per chunk. The recording is
+ * split into up to `visitors.size()` chunks in file order and chunk i is
+ * visited by `visitors[i]`, so callers can merge results deterministically.
+ *
+ * @return false if any chunk held a malformed record
+ */
+bool scan_parallel(const RecordingReader& reader,
+                   const ScanOptions& options,
+                   const std::vector<FrameVisitor*>& visitors);
+
+}  // namespace recording
+}  // namespace ds
+
+#endif  // RECORDING_SCAN_HPP__
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef SEQLOCK_PAYLOAD_BROKER_HPP__
+#define SEQLOCK_PAYLOAD_BROKER_HPP__
+
+#include "SeqlockSlot.hpp"
+
+#include <PayloadBroker.hpp>
+
+#include <glib.h>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace ds {
+
+/**
+ * A PayloadBroker whose latest result can be polled without contending
+ * with the streaming thread.
+ *
+ * Each batch is serialized on the streaming thread into a buffer kept from
+ * batch to batch and published straight to a SeqlockSlot, so once the
+ * buffer has grown the streaming thread neither locks nor allocates.
+ * get_payload() copies from the slot, so any number of pollers never block
+ * the streaming thread or each other, and turns the copy into JSON on the
+ * poller's thread (binary protobuf doesn't survive a C string).
+ */
+class SeqlockPayloadBroker : public PayloadBroker {
+ public:
+  SeqlockPayloadBroker() = default;
+  virtual ~SeqlockPayloadBroker() = default;
+
+  virtual bool on_batch_payload(NvDsBatchMeta* batch_meta,
+                                dp::Batch* batch) override;
+
+  /**
+   * the latest result as a JSON dp::Batch (free with g_free), or nullptr
+   * before the first batch. May be called from any thread.
+   */
+  gchar* get_payload() const;
+
+  const SeqlockSlot& slot() const { return slot_; }
+
+  /** total serialized length of every result published so far */
+  uint64_t bytes_serialized() const {
+    return bytes_serialized_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /** only used by the streaming thread */
+  std::string buffer_;
+  SeqlockSlot slot_;
+  std::atomic<uint64_t> bytes_serialized_{0};
+};
+
+}  // namespace ds
+
+#endif  // SEQLOCK_PAYLOAD_BROKER_HPP__
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef SEQLOCK_SLOT_HPP__
+#define SEQLOCK_SLOT_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ds {
+
+/**
+ * A single writer, many reader "latest value" slot for byte strings.
+ *
+ * There are two buffers, each with a sequence number that is odd while the
+ * buffer is written. The writer always fills the buffer that is not
+ * published and then publishes it, so it never waits for readers. Readers
+ * copy the published buffer and retry if its sequence number changed while
+ * they copied (only possible when the writer laps them), so they never wait
+ * on a lock either.
+ *
+ * Buffers only grow. A buffer that is replaced is kept until the slot is
+ * destroyed because a slow reader may still be copying from it. Capacity
+ * at least doubles each time, so the retired buffers add up to less than
+ * the live ones.
+ */
+class SeqlockSlot {
+ public:
+  SeqlockSlot();
+
+  SeqlockSlot(const SeqlockSlot&) = delete;
+  SeqlockSlot& operator=(const SeqlockSlot&) = delete;
+
+  /** publish a copy of `data` (from a single writer thread) */
+  void write(const char* data, size_t size);
+
+  /**
+   * copy the latest value into `out` (from any thread)
+   *
+   * @return false if nothing was written yet
+   */
+  bool read(std::string* out) const;
+
+  /** number of values published */
+  uint64_t writes() const { return writes_; }
+  /** number of times a reader had to copy again */
+  uint64_t retries() const { return retries_; }
+
+ private:
+  struct Buffer {
+    /** odd while the writer is in this buffer */
+    std::atomic<uint64_t> seq;
+    std::atomic<char*> data;
+    std::atomic<size_t> size;
+    /** only used by the writer */
+    size_t capacity;
+  };
+
+  Buffer buffers_[2];
+  /** index of the published buffer, or -1 */
+  std::atomic<int> current_;
+  std::atomic<uint64_t> writes_;
+  mutable std::atomic<uint64_t> retries_;
+  /** every allocation, live or retired (only touched by the writer) */
+  std::vector<std::unique_ptr<char[]>> allocations_;
+};
+
+}  // namespace ds
+
+#endif  // SEQLOCK_SLOT_HPP__
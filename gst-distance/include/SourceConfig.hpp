@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef SOURCE_CONFIG_HPP__
+#define SOURCE_CONFIG_HPP__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace ds {
+
+/** what a config file says about one source */
+struct SourceSettings {
+  /** whether to measure distances in the source's frames at all */
+  bool enabled = true;
+  /** the class id of people, or -1 for the element's class-id */
+  int class_id = -1;
+  /** 1 or 0 to color boxes or not, or -1 for the element's do-drawing */
+  int do_drawing = -1;
+};
+
+/**
+ * Per source settings, from a key file like:
+ *
+ *   # every source not listed
+ *   [default]
+ *   class-id=0
+ *
+ *   [source-3]
+ *   class-id=2
+ *   do-drawing=false
+ *
+ *   [source-7]
+ *   enabled=false
+ *
+ * A source's group overrides [default], which overrides the element's
+ * properties. Unknown groups or keys are errors, so a typo is never silently
+ * ignored. Immutable once parsed, so it can be shared between threads.
+ */
+class SourceConfig {
+ public:
+  static const int MAX_CLASS_ID = 4096;
+
+  /**
+   * @return nullptr (with a message in `error`) if `text` is malformed
+   */
+  static std::shared_ptr<const SourceConfig> parse(const std::string& text,
+                                                   std::string* error);
+  /** parse() the file at `path` */
+  static std::shared_ptr<const SourceConfig> load(const std::string& path,
+                                                  std::string* error);
+
+  /** the settings for `source_id` ([default] if it is not listed) */
+  const SourceSettings& settings(uint32_t source_id) const;
+  /** number of sources listed */
+  size_t size() const { return sources_.size(); }
+
+ private:
+  SourceSettings defaults_;
+  /** with [default] already merged in */
+  std::unordered_map<uint32_t, SourceSettings> sources_;
+};
+
+/**
+ * A SourceConfig that follows its file.
+ *
+ * A thread watches the file's directory with inotify (so editors that save
+ * by renaming are seen too), sleeping until an event arrives, and reparses
+ * the file when it changed. A good parse is swapped in atomically, so the
+ * streaming thread picks it up at its next config() without ever waiting
+ * for a parse. A bad one is logged and the previous config stays.
+ */
+class SourceConfigWatcher {
+ public:
+  SourceConfigWatcher();
+  ~SourceConfigWatcher();
+
+  SourceConfigWatcher(const SourceConfigWatcher&) = delete;
+  SourceConfigWatcher& operator=(const SourceConfigWatcher&) = delete;
+
+  /**
+   * Load `path` now (an empty path clears the config), and watch it instead
+   * if started.
+   *
+   * @return false (with a message in `error`, and no config) if the file
+   * could not be loaded
+   */
+  bool set_path(const std::string& path, std::string* error);
+  std::string path() const;
+
+  /** start watching (the path, once there is one) */
+  bool start();
+  /** stop watching (the config stays) */
+  void stop();
+
+  /** the current config, or nullptr (from any thread, never blocks long) */
+  std::shared_ptr<const SourceConfig> config() const {
+    return std::atomic_load(&config_);
+  }
+  /** number of times the file was reloaded after a change */
+  uint64_t reloads() const { return reloads_.load(); }
+
+ private:
+  bool start_thread();
+  void stop_thread();
+  void run(int fd);
+  void reload();
+
+  /** held by set_path(), start() and stop(), which may race */
+  std::mutex control_lock_;
+  mutable std::mutex lock_;
+  std::string path_;
+  std::shared_ptr<const SourceConfig> config_;
+  std::atomic<uint64_t> reloads_;
+  /** between start() and stop() */
+  bool watching_;
+  /** an eventfd, written to wake the thread up and have it stop */
+  int stop_fd_;
+  std::thread thread_;
+};
+
+}  // namespace ds
+
+#endif  // SOURCE_CONFIG_HPP__
@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef SOURCE_TABLE_HPP__
+#define SOURCE_TABLE_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace ds {
+
+/** how long, and how much, per source state is kept */
+struct SourceTableLimits {
+  /** forget a source not seen for this many ns of pts (0 to keep it) */
+  uint64_t idle_timeout = 0;
+  /** the most bytes of entries to keep (0 for no limit) */
+  size_t max_bytes = 0;
+};
+
+/**
+ * Per source_id state that stays bounded while sources come and go.
+ *
+ * Entries live in fixed size slabs. A forgotten entry goes on a free list
+ * and is handed out again for the next new source, so once the table has
+ * seen its busiest moment it stops allocating. Sources are forgotten when
+ * remove()d (eg. on a stream eos), when idle for the idle timeout, or, to
+ * keep under the memory cap, least recently seen first.
+ *
+ * Forgetting a source calls `evict(source_id, value)` first, so the owner
+ * can emit whatever the entry holds. A reused entry is not reset: `get()`
+ * says when an entry is new, and the owner resets it then (without freeing
+ * what it owns). Time is whatever the owner passes as `now` (ns of pts in
+ * this plugin); it may go backwards (eg. after a seek).
+ *
+ * Not thread safe, except for memory().
+ */
+template <typename T>
+class SourceTable {
+ public:
+  /** entries per slab */
+  static const size_t SLAB_ENTRIES = 16;
+
+  /**
+   * @param entry_bytes what an entry costs, for the memory cap (including
+   * anything T owns on the heap)
+   */
+  explicit SourceTable(SourceTableLimits limits = SourceTableLimits(),
+                       size_t entry_bytes = sizeof(T))
+      : limits_(limits),
+        entry_bytes_(std::max(entry_bytes, sizeof(Entry))),
+        max_entries_(limits.max_bytes
+                         ? std::max(limits.max_bytes / entry_bytes_,
+                                    (size_t)1)
+                         : 0),
+        last_sweep_(0),
+        evicted_(0),
+        memory_(0) {}
+
+  SourceTable(const SourceTable&) = delete;
+  SourceTable& operator=(const SourceTable&) = delete;
+
+  /**
+   * the entry for `source_id`, added if it is new (`*added` says which),
+   * forgetting idle sources, or the least recently seen one, as needed
+   */
+  template <typename Evict>
+  T* get(uint32_t source_id, uint64_t now, bool* added, Evict evict) {
+    // a quarter of the timeout late at worst, and no scan every frame
+    if (limits_.idle_timeout &&
+        (now < last_sweep_ || now - last_sweep_ >= limits_.idle_timeout / 4)) {
+      evict_idle(now, evict);
+      last_sweep_ = now;
+    }
+    auto found = index_.find(source_id);
+    if (found != index_.end()) {
+      Entry* entry = at(found->second);
+      entry->last_seen = now;
+      *added = false;
+      return &entry->value;
+    }
+    if (max_entries_ && index_.size() >= max_entries_) {
+      evict_oldest(evict);
+    }
+    uint32_t slot = acquire();
+    Entry* entry = at(slot);
+    entry->source_id = source_id;
+    entry->last_seen = now;
+    index_.emplace(source_id, slot);
+    *added = true;
+    return &entry->value;
+  }
+
+  /** @return false if `source_id` had no entry */
+  template <typename Evict>
+  bool remove(uint32_t source_id, Evict evict) {
+    auto found = index_.find(source_id);
+    if (found == index_.end()) {
+      return false;
+    }
+    uint32_t slot = found->second;
+    index_.erase(found);
+    evict(source_id, &at(slot)->value);
+    free_.push_back(slot);
+    return true;
+  }
+
+  /** forget every source last seen a timeout or more before `now` */
+  template <typename Evict>
+  size_t evict_idle(uint64_t now, Evict evict) {
+    if (limits_.idle_timeout == 0) {
+      return 0;
+    }
+    idle_.clear();
+    for (const auto& source : index_) {
+      uint64_t last_seen = at(source.second)->last_seen;
+      if (now > last_seen && now - last_seen >= limits_.idle_timeout) {
+        idle_.push_back(source.first);
+      }
+    }
+    for (uint32_t source_id : idle_) {
+      remove(source_id, evict);
+    }
+    evicted_ += idle_.size();
+    return idle_.size();
+  }
+
+  /** call `f(source_id, value)` for every source */
+  template <typename F>
+  void for_each(F f) {
+    for (const auto& source : index_) {
+      f(source.first, &at(source.second)->value);
+    }
+  }
+
+  /** forget every source without calling evict (keeping the slabs) */
+  void clear() {
+    for (const auto& source : index_) {
+      free_.push_back(source.second);
+    }
+    index_.clear();
+  }
+
+  /** number of sources */
+  size_t size() const { return index_.size(); }
+  /** the most sources kept at once (0 for no limit) */
+  size_t max_entries() const { return max_entries_; }
+  /**
+   * bytes of slabs allocated (they are only freed with the table, and the
+   * last one may take this up to a slab over the cap)
+   */
+  size_t memory() const { return memory_.load(std::memory_order_relaxed); }
+  /** sources forgotten for being idle or over the memory cap */
+  uint64_t evicted() const { return evicted_; }
+
+ private:
+  struct Entry {
+    T value;
+    uint32_t source_id;
+    uint64_t last_seen;
+  };
+
+  Entry* at(uint32_t slot) const {
+    return &slabs_[slot / SLAB_ENTRIES][slot % SLAB_ENTRIES];
+  }
+
+  uint32_t acquire() {
+    if (free_.empty()) {
+      uint32_t first = (uint32_t)(slabs_.size() * SLAB_ENTRIES);
+      slabs_.emplace_back(new Entry[SLAB_ENTRIES]());
+      memory_.fetch_add(SLAB_ENTRIES * entry_bytes_,
+                        std::memory_order_relaxed);
+      // handed out lowest first
+      for (size_t i = SLAB_ENTRIES; i > 0; i--) {
+        free_.push_back(first + (uint32_t)i - 1);
+      }
+    }
+    uint32_t slot = free_.back();
+    free_.pop_back();
+    return slot;
+  }
+
+  template <typename Evict>
+  void evict_oldest(Evict evict) {
+    auto oldest = index_.begin();
+    for (auto it = index_.begin(); it != index_.end(); ++it) {
+      if (at(it->second)->last_seen < at(oldest->second)->last_seen) {
+        oldest = it;
+      }
+    }
+    if (oldest != index_.end()) {
+      remove(oldest->first, evict);
+      evicted_++;
+    }
+  }
+
+  SourceTableLimits limits_;
+  size_t entry_bytes_;
+  size_t max_entries_;
+  /** when idle sources were last looked for */
+  uint64_t last_sweep_;
+  uint64_t evicted_;
+  std::atomic<size_t> memory_;
+  std::vector<std::unique_ptr<Entry[]>> slabs_;
+  /** slots not in use, the next one to hand out last */
+  std::vector<uint32_t> free_;
+  /** slot by source_id */
+  std::unordered_map<uint32_t, uint32_t> index_;
+  /** scratch space for evict_idle() */
+  std::vector<uint32_t> idle_;
+};
+
+}  // namespace ds
+
+#endif  // SOURCE_TABLE_HPP__
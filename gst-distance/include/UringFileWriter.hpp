@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef URING_FILE_WRITER_HPP__
+#define URING_FILE_WRITER_HPP__
+
+#include "AsyncFileWriter.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ds {
+
+/**
+ * An AsyncFileWriter that submits chunks through io_uring.
+ *
+ * A small pool of chunk buffers is registered with the ring so the kernel
+ * doesn't have to map them on every write. Full chunks are queued as fixed
+ * buffer writes and submitted in batches; the writer only waits when
+ * every buffer is in flight. Without liburing at build time, supported()
+ * is always false and AsyncFileWriter::create() uses the posix backend.
+ */
+class UringFileWriter : public AsyncFileWriter {
+ public:
+  explicit UringFileWriter(Options options);
+  virtual ~UringFileWriter();
+
+  /** whether io_uring is compiled in and usable (probed once) */
+  static bool supported();
+
+  virtual const char* backend_name() const override { return "io_uring"; }
+
+ protected:
+  virtual bool backend_open(const std::string& path) override;
+  virtual bool backend_write(const char* data, size_t len) override;
+  virtual bool backend_sync() override;
+  virtual void backend_close() override;
+  virtual char* backend_acquire_chunk(char* previous) override;
+  virtual void backend_release_chunks(char* current) override;
+
+ private:
+  struct Ring;
+
+  bool submit_pending();
+  bool reap(bool wait);
+  bool drain();
+  int buffer_index(const char* chunk) const;
+
+  Ring* ring_;
+  std::vector<char*> buffers_;
+  std::vector<bool> in_flight_;
+  unsigned num_in_flight_;
+  unsigned num_pending_;
+  uint64_t offset_;
+  bool failed_;
+};
+
+}  // namespace ds
+
+#endif  // URING_FILE_WRITER_HPP__
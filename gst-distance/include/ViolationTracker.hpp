@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef VIOLATION_TRACKER_HPP__
+#define VIOLATION_TRACKER_HPP__
+
+#include "SourceTable.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace ds {
+
+/** how one source's violation changed over a window */
+struct ViolationChange {
+  enum State {
+    /** no violation at the start of the window, one at the end */
+    STATE_STARTED,
+    /** a violation at the start of the window, none at the end */
+    STATE_ENDED,
+    /** a violation throughout, but its cluster size changed */
+    STATE_CHANGED,
+    /** no violation at either end, but one came and went in between */
+    STATE_BRIEF,
+  };
+
+  uint32_t source_id;
+  State state;
+  /** largest cluster at the start of the window (0 for no violation) */
+  uint32_t previous_size;
+  /** largest cluster at the end of the window (0 for no violation) */
+  uint32_t size;
+  /** largest cluster at any point in the window */
+  uint32_t max_size;
+  /** number of changes coalesced into this one */
+  uint32_t changes;
+  /** pts of the last change, in ns */
+  uint64_t pts;
+};
+
+/**
+ * Follows whether each source has a violation (people closer than the
+ * violation distance), and reports only when that changes.
+ *
+ * Distances are in person heights, as in WindowAggregator: the distance
+ * between the bottom centers of two boxes over the mean of their heights.
+ * People closer than the distance are in the same cluster (transitively),
+ * and a source has a violation while its largest cluster has two or more
+ * people in it.
+ *
+ * A change opens a window of `window` ns of pts. Every change of every
+ * source until the window ends is coalesced, so a window yields at most one
+ * ViolationChange per source, and none for a source whose violation ended
+ * the window as it started it. A window of 0 reports every change at the
+ * next poll().
+ *
+ * Not thread safe, except for the setters and getters.
+ */
+class ViolationTracker {
+ public:
+  /** a person's box, as the bottom center and the height */
+  struct Person {
+    float x;
+    float y;
+    float height;
+  };
+
+  /**
+   * @param distance in person heights
+   * @param window in ns of pts
+   * @param limits how long and how many sources are kept
+   */
+  ViolationTracker(float distance,
+                   uint64_t window,
+                   SourceTableLimits limits = SourceTableLimits());
+
+  static const char* state_name(ViolationChange::State state);
+
+  void set_distance(float distance) { distance_.store(distance); }
+  float distance() const { return distance_.load(); }
+  void set_window(uint64_t window) { window_.store(window); }
+  uint64_t window() const { return window_.load(); }
+
+  /**
+   * the size of the largest cluster of `people` (0 if no two are closer
+   * than the distance)
+   */
+  uint32_t largest_cluster(const std::vector<Person>& people);
+
+  /** account for a frame of `source_id` with `people` in it */
+  void add_frame(uint32_t source_id,
+                 uint64_t pts,
+                 const std::vector<Person>& people);
+  /** end the violation of a source that went away (eg. on stream eos) */
+  void remove_source(uint32_t source_id);
+
+  /**
+   * If the open window has ended by `now` (ns of pts), append its changes
+   * to `out` and close it.
+   *
+   * @return true if anything was appended
+   */
+  bool poll(uint64_t now, std::vector<ViolationChange>* out);
+  /** append the changes of the open window now, whenever it would end */
+  bool flush(std::vector<ViolationChange>* out);
+  /** forget every source and change (eg. on stop) */
+  void reset();
+
+  /** number of sources followed */
+  size_t sources() const { return sources_.size(); }
+
+ private:
+  struct Source {
+    /** largest cluster now (0 for no violation) */
+    uint32_t size;
+    /** whether it changed in the open window */
+    bool changed;
+    /** the rest only mean anything while changed */
+    uint32_t previous_size;
+    uint32_t max_size;
+    uint32_t changes;
+    uint64_t pts;
+  };
+
+  void change(Source* source, uint32_t size, uint64_t pts);
+  /** the change a source made over the window, if any */
+  static bool net_change(uint32_t source_id,
+                         const Source& source,
+                         ViolationChange* out);
+  /** a source forgotten with a violation (or a change) ends it */
+  void forget(uint32_t source_id, Source* source);
+
+  std::atomic<float> distance_;
+  std::atomic<uint64_t> window_;
+  SourceTable<Source> sources_;
+  /** changes of sources that were forgotten in the open window */
+  std::vector<ViolationChange> gone_;
+  bool window_open_;
+  uint64_t window_start_;
+  /** the latest pts seen, for changes with no frame (eg. remove_source) */
+  uint64_t last_pts_;
+  /** scratch space reused between frames */
+  std::vector<uint32_t> parent_, size_;
+};
+
+}  // namespace ds
+
+#endif  // VIOLATION_TRACKER_HPP__
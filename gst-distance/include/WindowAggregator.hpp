@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef WINDOW_AGGREGATOR_HPP__
+#define WINDOW_AGGREGATOR_HPP__
+
+#include "SourceTable.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace dp {
+class Batch;
+class Frame;
+}  // namespace dp
+
+namespace ds {
+
+/**
+ * A bounded memory quantile sketch for positive values (DDSketch style).
+ *
+ * Values are counted in logarithmic buckets, so any quantile comes back
+ * within RELATIVE_ACCURACY of a value that was actually added (for values in
+ * [MIN_VALUE, MAX_VALUE]; smaller values are counted as 0, larger ones as
+ * MAX_VALUE). Memory is fixed at NUM_BUCKETS counters.
+ */
+class QuantileSketch {
+ public:
+  static const double RELATIVE_ACCURACY;
+  static const double MIN_VALUE;
+  static const double MAX_VALUE;
+  static const size_t NUM_BUCKETS;
+
+  QuantileSketch();
+
+  void add(double value);
+  /** forget every value (no reallocation) */
+  void clear();
+
+  uint64_t count() const { return count_; }
+  /** the q (0..1) quantile, or NaN if the sketch is empty */
+  double quantile(double q) const;
+
+ private:
+  /** bucket 0 holds everything below MIN_VALUE */
+  std::vector<uint32_t> buckets_;
+  uint64_t count_;
+};
+
+/** the aggregates of one source over one window */
+struct WindowRecord {
+  uint32_t source_id;
+  /** pts of the window bounds, in ns (start inclusive, end exclusive) */
+  uint64_t start;
+  uint64_t end;
+  uint64_t frames;
+  /** people summed over frames (people / frames is the mean) */
+  uint64_t people;
+  uint32_t max_people;
+  /** people flagged is_danger, summed over frames */
+  uint64_t violations;
+  /** the most people in one cluster in any frame */
+  uint32_t max_cluster;
+  /** of the pairwise distances, in person heights (NaN if no pairs) */
+  float p95_distance;
+};
+
+/**
+ * Folds batches into per source, fixed length windows of pts.
+ *
+ * Windows are aligned to multiples of the window length. A source's window
+ * is closed (and its record emitted) by the first frame of that source with
+ * a pts in a later window, or by flush(). Frames with a pts before the open
+ * window (eg. after a seek) are counted in the open window. A source that is
+ * removed, idle or evicted to stay under the memory cap has its window
+ * closed early (see SourceTable.hpp).
+ *
+ * The distance between two people is the distance between the bottom
+ * centers of their boxes divided by the mean of the box heights, so it is
+ * roughly in person heights whatever the distance to the camera. People
+ * closer than the cluster distance are in the same cluster (transitively).
+ */
+class WindowAggregator {
+ public:
+  /** the csv header line, including the newline */
+  static const char CSV_HEADER[];
+
+  /**
+   * @param window the window length in ns
+   * @param cluster_distance in person heights
+   * @param limits how long and how many sources are kept
+   */
+  WindowAggregator(uint64_t window,
+                   float cluster_distance,
+                   SourceTableLimits limits = SourceTableLimits());
+
+  /** fold every frame of `batch`, appending any closed windows to `out` */
+  void add(const dp::Batch& batch, std::vector<WindowRecord>* out);
+  /** close every open window, appending the records to `out` */
+  void flush(std::vector<WindowRecord>* out);
+  /** close the window of a source that went away (eg. on stream eos) */
+  void remove_source(uint32_t source_id, std::vector<WindowRecord>* out);
+
+  /** number of sources with an open window */
+  size_t sources() const { return sources_.size(); }
+  /** bytes held for open windows (may be read from any thread) */
+  size_t memory() const { return sources_.memory(); }
+
+  /** a csv row (with newline) for `record`, matching CSV_HEADER */
+  static std::string csv_row(const WindowRecord& record);
+
+ private:
+  struct Accumulator {
+    WindowRecord record;
+    QuantileSketch distances;
+  };
+
+  void add_frame(const dp::Frame& frame, std::vector<WindowRecord>* out);
+  void close(Accumulator* acc, std::vector<WindowRecord>* out);
+
+  uint64_t window_;
+  float cluster_distance_;
+  SourceTable<Accumulator> sources_;
+  /** scratch space reused between frames */
+  std::vector<float> x_, y_, height_;
+  std::vector<uint32_t> parent_, size_;
+};
+
+}  // namespace ds
+
+#endif  // WINDOW_AGGREGATOR_HPP__
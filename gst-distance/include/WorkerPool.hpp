@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef WORKER_POOL_HPP__
+#define WORKER_POOL_HPP__
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ds {
+
+/**
+ * Worker threads shared by every element in the process, so many pipelines
+ * don't each bring their own threads and oversubscribe the cores.
+ *
+ * Work is submitted through a Strand, a queue whose tasks run one at a time
+ * and in order (eg. everything one file writer does). A strand with work is
+ * queued on one worker's deque. Workers take strands from the front of
+ * their own deque, and steal from the back of the others' when theirs is
+ * empty. A strand runs a single task per turn and then goes to the back of
+ * the deque, so a busy strand (eg. the writer of a crowded camera) can't
+ * keep the others from running.
+ *
+ * Strands can also post a task after a delay, eg. to flush a partial chunk
+ * once a writer has been idle for a while.
+ */
+class WorkerPool {
+ public:
+  struct Options {
+    /** number of workers (0 for one per available core) */
+    size_t threads = 0;
+    /** pin worker n to the nth core the process may run on */
+    bool pin = false;
+  };
+
+ private:
+  typedef std::chrono::steady_clock clock;
+
+  struct StrandState {
+    WorkerPool* pool;
+    std::mutex lock;
+    std::condition_variable idle;
+    std::deque<std::function<void()>> tasks;
+    /** queued on a worker's deque or running */
+    bool scheduled = false;
+    bool running = false;
+    bool closed = false;
+    std::thread::id runner;
+  };
+
+ public:
+  /**
+   * A queue of tasks that run one at a time, in the order posted, on
+   * whichever worker gets to the strand. Must be closed (or destroyed)
+   * before anything its tasks use is freed.
+   */
+  class Strand {
+   public:
+    explicit Strand(WorkerPool* pool);
+    /** close() */
+    ~Strand();
+
+    Strand(const Strand&) = delete;
+    Strand& operator=(const Strand&) = delete;
+
+    /**
+     * Run `task` after the tasks already posted.
+     *
+     * @return false if the strand is closed (and `task` won't run)
+     */
+    bool post(std::function<void()> task);
+    /** post() `task` once `delay` has passed */
+    bool post_after(std::chrono::milliseconds delay,
+                    std::function<void()> task);
+    /**
+     * Drop the tasks that haven't started and wait for one that has (unless
+     * called from that task). Nothing posted afterwards runs.
+     */
+    void close();
+
+   private:
+    friend class WorkerPool;
+
+    static bool post_to(const std::shared_ptr<StrandState>& state,
+                        std::function<void()> task);
+
+    std::shared_ptr<StrandState> state_;
+  };
+
+  /**
+   * The pool for the whole process, created on first use with the options
+   * from configure() (or the defaults). Never destroyed, so strands closed
+   * at exit still have a pool.
+   */
+  static WorkerPool& shared();
+  /**
+   * Set the options of the shared() pool.
+   *
+   * @return false if the shared pool is already running (and unchanged)
+   */
+  static bool configure(Options options);
+
+  /**
+   * The pool for blocking file I/O (writes and fsyncs), apart from shared()
+   * so a slow disk holds up other writers at worst, never the CPU work.
+   * Created on first use with the options from configure_io() (or four
+   * workers), and never destroyed either.
+   */
+  static WorkerPool& io();
+  /**
+   * Set the options of the io() pool.
+   *
+   * @return false if the io pool is already running (and unchanged)
+   */
+  static bool configure_io(Options options);
+
+  /** Start the workers. Strands must be closed before the pool is freed. */
+  explicit WorkerPool(Options options);
+  /** Stop and join the workers (tasks still queued are dropped). */
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  size_t threads() const { return workers_.size(); }
+  /** number of strands a worker took from another's deque */
+  uint64_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+ private:
+  struct Worker {
+    std::mutex lock;
+    std::deque<std::shared_ptr<StrandState>> ready;
+    std::thread thread;
+  };
+
+  void schedule(std::shared_ptr<StrandState> strand);
+  void add_timer(clock::time_point deadline,
+                 std::shared_ptr<StrandState> strand,
+                 std::function<void()> task);
+  std::shared_ptr<StrandState> take(size_t index);
+  void run_one(const std::shared_ptr<StrandState>& strand);
+  void run(size_t index, int cpu);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::atomic<size_t> next_;
+  std::atomic<uint64_t> steals_;
+
+  /** guards sleeping, timers_ and stopping_ */
+  std::mutex sleep_lock_;
+  std::condition_variable wake_;
+  /**
+   * strands on the deques, or about to be (only incremented under
+   * sleep_lock_, and before the strand is pushed)
+   */
+  std::atomic<size_t> pending_;
+  std::multimap<clock::time_point,
+                std::pair<std::shared_ptr<StrandState>, std::function<void()>>>
+      timers_;
+  bool stopping_;
+};
+
+}  // namespace ds
+
+#endif  // WORKER_POOL_HPP__
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef GST_DSANALYTICS_H__
+#define GST_DSANALYTICS_H__
+
+#include <gst/gst.h>
+
+#include <DistanceFilter.hpp>
+#include <ProtoPayloadFilter.hpp>
+
+#include "FrameScheduler.hpp"
+#include "LoadShedder.hpp"
+#include "SourceConfig.hpp"
+#include "ViolationTracker.hpp"
+#include "gstdspayloadbroker.h"
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_DSANALYTICS (gst_dsanalytics_get_type())
+G_DECLARE_FINAL_TYPE(GstDsAnalytics,
+                     gst_dsanalytics,
+                     GST,
+                     DSANALYTICS,
+                     GstDsPayloadBroker)
+
+struct _GstDsAnalytics {
+  // The outputs, their properties and stats.
+  GstDsPayloadBroker broker;
+
+  // The distance calculating filter.
+  ds::DistanceFilter* distance;
+  // The protobuf payload filter.
+  ds::ProtoPayloadFilter* payload;
+  // Which buffers to process when downstream is late.
+  ds::LoadShedder* shedder;
+  // Source priorities and the per batch budget (of the distance stage).
+  ds::FrameScheduler* scheduler;
+  // The config-file, reloaded when it changes.
+  ds::SourceConfigWatcher* config;
+  // Who is in violation, for the ds-violations messages.
+  ds::ViolationTracker* violations;
+
+  // properties:
+  // as set, for sources the config file doesn't override
+  gint class_id;
+  gboolean do_drawing;
+  gboolean post_violations;
+};
+
+G_END_DECLS
+
+#endif  // GST_DSANALYTICS_H__
@@ -28,6 +28,12 @@
 
 #include <DistanceFilter.hpp>
 
+#include "ElementStats.hpp"
+#include "FrameScheduler.hpp"
+#include "LoadShedder.hpp"
+#include "SourceConfig.hpp"
+#include "ViolationTracker.hpp"
+
 G_BEGIN_DECLS
 
 typedef ds::DistanceFilter DistanceFilter;
@@ -44,9 +50,23 @@ struct _GstDsDistance {
 
   // The distance calculating filter.
   DistanceFilter* filter;
+  // Counters for the stats property.
+  ds::ElementStats* stats;
+  // Which buffers to process when downstream is late.
+  ds::LoadShedder* shedder;
+  // Source priorities and the per batch budget.
+  ds::FrameScheduler* scheduler;
+  // The config-file, reloaded when it changes.
+  ds::SourceConfigWatcher* config;
+  // Who is in violation, for the ds-violations messages.
+  ds::ViolationTracker* violations;
 
   // properties:
   gboolean silent;
+  // as set, for sources the config file doesn't override
+  gint class_id;
+  gboolean do_drawing;
+  gboolean post_violations;
 };
 
 G_END_DECLS
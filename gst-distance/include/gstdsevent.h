@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef GST_DSEVENT_H__
+#define GST_DSEVENT_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* if event is a stream eos or pad deleted event from nvstreammux, set
+ * source_id to the source that is gone and return TRUE
+ */
+gboolean gst_ds_event_parse_source_gone(GstEvent* event, guint* source_id);
+
+G_END_DECLS
+
+#endif /* GST_DSEVENT_H__ */
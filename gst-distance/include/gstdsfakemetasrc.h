@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef GST_DSFAKEMETASRC_H__
+#define GST_DSFAKEMETASRC_H__
+
+#include <gst/base/gstpushsrc.h>
+#include <gst/gst.h>
+
+#include "FakeScene.hpp"
+
+G_BEGIN_DECLS
+
+typedef enum {
+  FAKE_META_SRC_MOTION_STATIC,
+  FAKE_META_SRC_MOTION_LINEAR,
+  FAKE_META_SRC_MOTION_RANDOM
+} GstDsFakeMetaSrcMotion;
+
+#define GST_TYPE_DSFAKEMETASRC (gst_dsfakemetasrc_get_type())
+G_DECLARE_FINAL_TYPE(GstDsFakeMetaSrc,
+                     gst_dsfakemetasrc,
+                     GST,
+                     DSFAKEMETASRC,
+                     GstPushSrc)
+
+struct _GstDsFakeMetaSrc {
+  GstPushSrc element;
+
+  // The simulated people (created when caps are set).
+  ds::FakeScene* scene;
+  // negotiated caps:
+  gint width;
+  gint height;
+  gint fps_n;
+  gint fps_d;
+  // The next frame number.
+  guint64 frame_num;
+
+  // properties:
+  gboolean silent;
+  guint batch_size;
+  guint objects_per_frame;
+  GstDsFakeMetaSrcMotion motion;
+  gdouble id_churn;
+  gint class_id;
+  guint64 seed;
+  guint source_churn;
+};
+
+G_END_DECLS
+
+#endif /* GST_DSFAKEMETASRC_H__ */
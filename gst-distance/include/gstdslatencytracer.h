@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef GST_DSLATENCYTRACER_H__
+#define GST_DSLATENCYTRACER_H__
+
+#include <gst/gst.h>
+#include <gst/gsttracer.h>
+
+#include "LatencyTracker.hpp"
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_DSLATENCYTRACER (gst_dslatencytracer_get_type())
+G_DECLARE_FINAL_TYPE(GstDsLatencyTracer,
+                     gst_dslatencytracer,
+                     GST,
+                     DSLATENCYTRACER,
+                     GstTracer)
+
+struct _GstDsLatencyTracer {
+  GstTracer parent;
+
+  // Histograms by element and objects per batch.
+  ds::LatencyTracker* tracker;
+  // Dumps the histograms every interval (nullptr if interval is 0).
+  std::thread* dumper;
+  std::mutex* lock;
+  std::condition_variable* wake;
+  gboolean stopping;
+
+  // params:
+  guint interval;
+  gchar* file;
+};
+
+G_END_DECLS
+
+#endif /* GST_DSLATENCYTRACER_H__ */
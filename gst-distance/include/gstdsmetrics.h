@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef GST_DSMETRICS_H__
+#define GST_DSMETRICS_H__
+
+#include <gst/gst.h>
+
+#include "ElementStats.hpp"
+#include "MetricsRegistry.hpp"
+
+G_BEGIN_DECLS
+
+/* the environment variable configuring the exporter, eg.
+ *
+ *   GST_DISTANCE_METRICS="socket=/tmp/distance.sock"
+ *   GST_DISTANCE_METRICS="file=/var/lib/node_exporter/distance.prom,interval=5"
+ *
+ * (interval in seconds, file only)
+ */
+#define GST_DS_METRICS_ENV "GST_DISTANCE_METRICS"
+
+/* start the process wide metrics exporter if GST_DISTANCE_METRICS is set
+ * (only the first call does anything)
+ */
+void gst_ds_metrics_init(void);
+
+/* export element's metrics until gst_ds_metrics_remove (collector only
+ * needs to fill in the counters; the labels are filled in from element)
+ */
+void gst_ds_metrics_add(GstElement* element,
+                        ds::MetricsRegistry::Collector collector);
+
+/* export element's stats until gst_ds_metrics_remove
+ */
+void gst_ds_metrics_add_stats(GstElement* element, ds::ElementStats* stats);
+
+/* stop exporting element's metrics (call before freeing what the
+ * collector reads)
+ */
+void gst_ds_metrics_remove(GstElement* element);
+
+G_END_DECLS
+
+#endif /* GST_DSMETRICS_H__ */
@@ -28,6 +28,8 @@
 
 #include <BaseFilter.hpp>
 
+#include "ElementStats.hpp"
+
 G_BEGIN_DECLS
 
 typedef ds::BaseFilter BaseFilter;
@@ -35,26 +37,77 @@ typedef ds::BaseFilter BaseFilter;
 typedef enum {
   PAYLOAD_BROKER_MODE_PROPERTY,
   PAYLOAD_BROKER_MODE_PROTO,
-  PAYLOAD_BROKER_MODE_CSV
+  PAYLOAD_BROKER_MODE_CSV,
+  PAYLOAD_BROKER_MODE_COLUMNAR,
+  PAYLOAD_BROKER_MODE_AGGREGATE,
+  PAYLOAD_BROKER_MODE_RECORDS
 } GstDsPayloadBrokerMode;
 
+#define PAYLOAD_BROKER_NUM_MODES (PAYLOAD_BROKER_MODE_RECORDS + 1)
+
+typedef enum {
+  PAYLOAD_BROKER_FSYNC_NEVER,
+  PAYLOAD_BROKER_FSYNC_INTERVAL,
+  PAYLOAD_BROKER_FSYNC_SIZE
+} GstDsPayloadBrokerFsyncMode;
+
+typedef enum {
+  PAYLOAD_BROKER_IO_BACKEND_AUTO,
+  PAYLOAD_BROKER_IO_BACKEND_POSIX,
+  PAYLOAD_BROKER_IO_BACKEND_URING
+} GstDsPayloadBrokerIoBackend;
+
+typedef enum {
+  PAYLOAD_BROKER_SAMPLING_NONE,
+  PAYLOAD_BROKER_SAMPLING_RATE,
+  PAYLOAD_BROKER_SAMPLING_ADAPTIVE
+} GstDsPayloadBrokerSampling;
+
 #define GST_TYPE_DSPAYLOADBROKER (gst_dspayloadbroker_get_type())
-G_DECLARE_FINAL_TYPE(GstDsPayloadBroker,
-                     gst_dspayloadbroker,
-                     GST,
-                     DSPAYLOADBROKER,
-                     GstBaseTransform)
+G_DECLARE_DERIVABLE_TYPE(GstDsPayloadBroker,
+                         gst_dspayloadbroker,
+                         GST,
+                         DSPAYLOADBROKER,
+                         GstBaseTransform)
+
+// derivable, so dsanalytics can reuse the outputs and their properties
+struct _GstDsPayloadBrokerClass {
+  GstBaseTransformClass parent_class;
+};
 
 struct _GstDsPayloadBroker {
   GstBaseTransform element;
 
-  // The protobuf payload broker.
+  // The protobuf payload broker (a FanOutPayloadBroker).
   BaseFilter* filter;
+  // The outputs of filter by mode (not owned, nullptr if not in use).
+  BaseFilter* by_mode[PAYLOAD_BROKER_NUM_MODES];
+  // Counters for the stats property.
+  ds::ElementStats* stats;
 
   // properties:
   gboolean silent;
   gchararray basepath;
   GstDsPayloadBrokerMode mode;
+  gchararray outputs;
+  GstDsPayloadBrokerSampling sampling;
+  gdouble max_rate;
+  // file mode properties:
+  guint queue_size;
+  GstDsPayloadBrokerFsyncMode fsync_mode;
+  guint fsync_interval;
+  guint fsync_size;
+  guint rotate_size;
+  guint rotate_interval;
+  GstDsPayloadBrokerIoBackend io_backend;
+  gboolean index;
+  guint sync_interval;
+  guint row_group_size;
+  guint window;
+  gfloat cluster_distance;
+  // per source state limits:
+  guint source_timeout;
+  guint source_memory;
 };
 
 G_END_DECLS
@@ -28,6 +28,10 @@
 
 #include <ProtoPayloadFilter.hpp>
 
+#include "ElementStats.hpp"
+#include "FrameScheduler.hpp"
+#include "LoadShedder.hpp"
+
 G_BEGIN_DECLS
 
 typedef ds::ProtoPayloadFilter ProtoPayloadFilter;
@@ -44,6 +48,14 @@ struct _GstDsProtoPayload {
 
   // The protobuf payload filter.
   ProtoPayloadFilter* filter;
+  // Counters for the stats property.
+  ds::ElementStats* stats;
+  // Which buffers to process when downstream is late.
+  ds::LoadShedder* shedder;
+  // Source priorities and the per batch budget.
+  ds::FrameScheduler* scheduler;
+  // Recent serialization time in ns, to compare with the budget.
+  GstClockTime cost;
 
   // properties:
   gboolean silent;
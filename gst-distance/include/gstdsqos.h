@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef GST_DSQOS_H__
+#define GST_DSQOS_H__
+
+#include <gst/base/gstbasetransform.h>
+#include <gst/gst.h>
+
+#include "LoadShedder.hpp"
+
+G_BEGIN_DECLS
+
+/* the name of the element message posted when the QoS level changes, with
+ * fields level (guint, 0 for full processing), interval (guint, every
+ * interval'th buffer is processed), proportion (gdouble) and diff (gint64)
+ */
+#define GST_DS_QOS_MESSAGE_NAME "ds-qos"
+
+/* feed a QoS event to shedder (if the qos property is set), post a message
+ * if the level changed, and send the event upstream (transfer full)
+ *
+ * basetransform's own QoS handling is bypassed, since it drops late
+ * buffers rather than just processing less of them.
+ */
+gboolean gst_ds_qos_src_event(GstBaseTransform* base,
+                              ds::LoadShedder* shedder,
+                              GstEvent* event);
+
+/* whether base should fully process the next buffer
+ */
+gboolean gst_ds_qos_should_process(GstBaseTransform* base,
+                                   ds::LoadShedder* shedder);
+
+G_END_DECLS
+
+#endif /* GST_DSQOS_H__ */
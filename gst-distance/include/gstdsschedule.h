@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef GST_DSSCHEDULE_H__
+#define GST_DSSCHEDULE_H__
+
+#include <gst/gst.h>
+
+#include <BaseFilter.hpp>
+
+#include "FrameScheduler.hpp"
+
+G_BEGIN_DECLS
+
+/* the "priorities", "budget" and "skipped-frames" properties shared by
+ * dsdistance, dsprotopayload and dsanalytics
+ */
+GParamSpec* gst_ds_schedule_priorities_param_spec(void);
+GParamSpec* gst_ds_schedule_budget_param_spec(void);
+GParamSpec* gst_ds_schedule_skipped_param_spec(void);
+
+/* set the "priorities" property, warning about a malformed value
+ */
+void gst_ds_schedule_set_priorities(GObject* object,
+                                    ds::FrameScheduler* scheduler,
+                                    const GValue* value);
+
+/* called before each frame is processed, eg. to apply per source settings
+ * (return FALSE to skip the frame)
+ */
+typedef gboolean (*GstDsSchedulePrepareFunc)(NvDsFrameMeta* frame_meta,
+                                             gpointer user_data);
+
+/* run filter's on_frame_meta on the frames in buf, most important sources
+ * first, until the batch (started at start) is over budget
+ */
+GstFlowReturn gst_ds_schedule_frames(ds::FrameScheduler* scheduler,
+                                     ds::BaseFilter* filter,
+                                     GstBuffer* buf,
+                                     GstClockTime start,
+                                     GstDsSchedulePrepareFunc prepare,
+                                     gpointer user_data);
+
+/* whether a batch expected to take cost ns should be processed at all
+ */
+gboolean gst_ds_schedule_batch(ds::FrameScheduler* scheduler,
+                               GstBuffer* buf,
+                               GstClockTime cost);
+
+G_END_DECLS
+
+#endif /* GST_DSSCHEDULE_H__ */
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef GST_DSSTATS_H__
+#define GST_DSSTATS_H__
+
+#include <gst/gst.h>
+
+#include "ElementStats.hpp"
+
+G_BEGIN_DECLS
+
+/* the read-only "stats" property shared by the elements
+ */
+GParamSpec* gst_ds_stats_param_spec(void);
+
+/* count the objects in buf's batch meta (from each frame's num_obj_meta) and
+ * add them to stats with pairs (counted by the caller where it already walks
+ * the people, or 0)
+ */
+void gst_ds_stats_add(ds::ElementStats* stats,
+                      GstBuffer* buf,
+                      guint64 pairs,
+                      GstClockTime elapsed);
+
+/* a new "stats" structure for snapshot (transfer full)
+ */
+GstStructure* gst_ds_stats_new_structure(
+    const ds::ElementStats::Snapshot& snapshot);
+
+G_END_DECLS
+
+#endif /* GST_DSSTATS_H__ */
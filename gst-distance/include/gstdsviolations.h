@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#ifndef GST_DSVIOLATIONS_H__
+#define GST_DSVIOLATIONS_H__
+
+#include <gst/gst.h>
+
+#include "SourceConfig.hpp"
+#include "ViolationTracker.hpp"
+
+G_BEGIN_DECLS
+
+/* the name of the element message posted when violations change, with a
+ * changes field (GstValueArray) of GST_DS_VIOLATION_NAME structures, one per
+ * source that changed since the last message
+ */
+#define GST_DS_VIOLATIONS_MESSAGE_NAME "ds-violations"
+
+/* one source's change, with fields source-id (guint), state (gchararray:
+ * started, ended, changed or brief), cluster-size, previous-cluster-size and
+ * max-cluster-size (guint, 0 for no violation), changes (guint, how many were
+ * coalesced) and pts (guint64, of the last one)
+ */
+#define GST_DS_VIOLATION_NAME "ds-violation"
+
+/* the "post-violations", "violation-distance" and "violation-window"
+ * properties
+ */
+GParamSpec* gst_ds_violations_post_param_spec(void);
+GParamSpec* gst_ds_violations_distance_param_spec(gfloat default_distance);
+GParamSpec* gst_ds_violations_window_param_spec(guint default_window);
+
+/* feed the people (objects of class_id, or of a source's class-id in config)
+ * in buf's frames to tracker, and post a message if a window of changes is
+ * over (config may be nullptr)
+ *
+ * returns the pairs of people in the same frame (for the stats)
+ */
+guint64 gst_ds_violations_add(GstElement* element,
+                           ds::ViolationTracker* tracker,
+                           GstBuffer* buf,
+                           const ds::SourceConfig* config,
+                           gint class_id);
+
+/* end the violations of sources nvstreammux says are gone, and post what is
+ * pending on eos (does not take the event)
+ */
+void gst_ds_violations_sink_event(GstElement* element,
+                                  ds::ViolationTracker* tracker,
+                                  GstEvent* event);
+
+G_END_DECLS
+
+#endif /* GST_DSVIOLATIONS_H__ */
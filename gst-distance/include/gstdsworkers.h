@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#ifndef GST_DSWORKERS_H__
+#define GST_DSWORKERS_H__
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* the environment variable configuring the shared worker pool, eg.
+ *
+ *   GST_DISTANCE_WORKERS="threads=4"
+ *   GST_DISTANCE_WORKERS="threads=8,pin=true,io-threads=2"
+ *
+ * (threads defaults to one per available core, pin to false, and io-threads,
+ * the workers doing file I/O, to 4)
+ */
+#define GST_DS_WORKERS_ENV "GST_DISTANCE_WORKERS"
+
+/* configure the process wide worker pools from GST_DISTANCE_WORKERS, before
+ * anything uses them (only the first call does anything)
+ */
+void gst_ds_workers_init(void);
+
+G_END_DECLS
+
+#endif /* GST_DSWORKERS_H__ */
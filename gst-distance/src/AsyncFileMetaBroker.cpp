@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "AsyncFileMetaBroker.hpp"
+
+#include "RecordingIndex.hpp"
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace ds {
+
+AsyncFileMetaBroker::AsyncFileMetaBroker(const std::string& basepath,
+                                         Format format,
+                                         AsyncFileWriter::Options options,
+                                         unsigned sync_interval,
+                                         unsigned row_group_size,
+                                         uint64_t window,
+                                         float cluster_distance,
+                                         SourceTableLimits limits)
+    : format_(format),
+      sync_interval_(format == proto ? sync_interval : 0),
+      since_sync_(0),
+      row_group_size_(std::max(row_group_size, 1u)),
+      aggregator_(window, cluster_distance, limits),
+      writer_(AsyncFileWriter::create(make_options(basepath,
+                                                   format,
+                                                   std::move(options),
+                                                   sync_interval_ != 0))) {}
+
+AsyncFileWriter::Options AsyncFileMetaBroker::make_options(
+    const std::string& basepath,
+    Format format,
+    AsyncFileWriter::Options options,
+    bool indexed) {
+  options.basepath = basepath;
+  if (indexed) {
+    options.observer = std::make_shared<recording::IndexWriter>();
+  }
+  switch (format) {
+    case csv:
+      options.extension = ".csv";
+      options.header = CsvEncoder::HEADER;
+      break;
+    case columnar:
+      options.extension = columnar::EXTENSION;
+      options.header = columnar::file_header();
+      options.observer = std::make_shared<columnar::FooterWriter>();
+      options.transform = columnar::compress_row_group;
+      break;
+    case aggregate:
+      options.extension = ".agg.csv";
+      options.header = WindowAggregator::CSV_HEADER;
+      break;
+    case proto:
+    default:
+      options.extension = ".pb";
+      options.header.clear();
+      break;
+  }
+  return options;
+}
+
+bool AsyncFileMetaBroker::start() {
+  return writer_->start();
+}
+
+void AsyncFileMetaBroker::stop() {
+  if (format_ == columnar) {
+    flush_row_group();
+  } else if (format_ == aggregate) {
+    aggregator_.flush(&windows_);
+    push_windows();
+  }
+  writer_->stop();
+}
+
+void AsyncFileMetaBroker::remove_source(uint32_t source_id) {
+  if (format_ != aggregate) {
+    return;
+  }
+  aggregator_.remove_source(source_id, &windows_);
+  push_windows();
+}
+
+void AsyncFileMetaBroker::flush_row_group() {
+  if (row_group_.num_batches() == 0) {
+    return;
+  }
+  bool empty = row_group_.num_rows() == 0;
+  std::string meta;
+  std::string group = row_group_.take(&meta);
+  if (!empty) {
+    writer_->push(std::move(group), std::move(meta));
+  }
+}
+
+void AsyncFileMetaBroker::push_windows() {
+  if (windows_.empty()) {
+    return;
+  }
+  std::string record;
+  for (const auto& window : windows_) {
+    record += WindowAggregator::csv_row(window);
+  }
+  windows_.clear();
+  writer_->push(std::move(record));
+}
+
+/* the length delimited batch, after a sync marker if `sync` */
+static std::string encode_proto(const dp::Batch& batch, bool sync) {
+  using google::protobuf::io::CodedOutputStream;
+  // same framing as CodedOutputStream::WriteVarint32 + SerializeToCodedStream
+  // so existing readers keep working.
+  size_t size = batch.ByteSizeLong();
+  size_t prefix = CodedOutputStream::VarintSize32((uint32_t)size);
+  size_t marker = sync ? recording::SYNC_MARKER_SIZE : 0;
+  std::string record(marker + prefix + size, '\0');
+  uint8_t* target = (uint8_t*)&record[0];
+  memcpy(target, recording::SYNC_MARKER, marker);
+  target += marker;
+  target = CodedOutputStream::WriteVarint32ToArray((uint32_t)size, target);
+  batch.SerializeWithCachedSizesToArray(target);
+  return record;
+}
+
+static std::string encode_index_keys(const dp::Batch& batch) {
+  std::string meta;
+  meta.reserve(batch.frames_size() * sizeof(recording::IndexKey));
+  for (const auto& frame : batch.frames()) {
+    recording::IndexKey key;
+    key.pts = (uint64_t)frame.pts();
+    key.frame_num = (uint64_t)frame.frame_num();
+    key.source_id = (uint32_t)frame.source_id();
+    key.reserved = 0;
+    meta.append((const char*)&key, sizeof(key));
+  }
+  return meta;
+}
+
+bool AsyncFileMetaBroker::on_batch_payload(NvDsBatchMeta* batch_meta,
+                                           dp::Batch* batch) {
+  (void)batch_meta;
+  if (batch == nullptr) {
+    return true;
+  }
+  if (format_ == columnar) {
+    row_group_.add(*batch);
+    if (row_group_.num_batches() >= row_group_size_ ||
+        row_group_.num_rows() >= columnar::RowGroupBuilder::MAX_ROWS) {
+      flush_row_group();
+    }
+    return true;
+  }
+  if (format_ == aggregate) {
+    aggregator_.add(*batch, &windows_);
+    push_windows();
+    return true;
+  }
+  // a full queue is counted by the writer; dropping is not an error
+  if (format_ == csv) {
+    csv_.encode(*batch);
+    if (csv_.size() != 0) {
+      writer_->push(csv_.take());
+    }
+    return true;
+  }
+  if (sync_interval_ == 0) {
+    writer_->push(encode_proto(*batch, false));
+    return true;
+  }
+  // the marker goes in the same record as the batch after it, so the two
+  // are kept or dropped together and the index stays in step with the data
+  // (the entry's offset is the marker's, which readers skip)
+  bool sync = ++since_sync_ >= sync_interval_;
+  if (sync) {
+    since_sync_ = 0;
+  }
+  writer_->push(encode_proto(*batch, sync), encode_index_keys(*batch));
+  return true;
+}
+
+}  // namespace ds
@@ -0,0 +1,464 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "AsyncFileWriter.hpp"
+#include "UringFileWriter.hpp"
+
+#include <gst/gst.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+#include <utility>
+
+GST_DEBUG_CATEGORY_STATIC(ds_async_file_writer_debug);
+#define GST_CAT_DEFAULT ds_async_file_writer_debug
+
+namespace ds {
+
+static const size_t PAGE_SIZE = 4096;
+/** most records written per task before the other strands get a turn */
+static const size_t DRAIN_SLICE = 256;
+/** most existing files skipped looking for a free name */
+static const unsigned MAX_NAME_COLLISIONS = 10000;
+
+static void init_debug_category() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    GST_DEBUG_CATEGORY_INIT(ds_async_file_writer_debug, "dsasyncfilewriter",
+                            0, "asynchronous file writer");
+  });
+}
+
+static size_t round_up_to_page(size_t size) {
+  return ((size + PAGE_SIZE - 1) / PAGE_SIZE) * PAGE_SIZE;
+}
+
+AsyncFileWriter::AsyncFileWriter(Options options)
+    : fd_(-1),
+      options_(std::move(options)),
+      running_(false),
+      drain_posted_(false),
+      tick_posted_(false),
+      chunk_(nullptr),
+      chunk_capacity_(round_up_to_page(options_.chunk_size ? options_.chunk_size
+                                                           : PAGE_SIZE)),
+      chunk_used_(0),
+      file_bytes_(0),
+      unsynced_bytes_(0),
+      file_index_(0),
+      dropped_(0),
+      bytes_pushed_(0),
+      bytes_written_(0),
+      syncs_(0) {
+  init_debug_category();
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+  stop();
+}
+
+bool AsyncFileWriter::start() {
+  if (strand_ != nullptr) {
+    return true;
+  }
+  if (chunk_ == nullptr) {
+    chunk_ = backend_acquire_chunk(nullptr);
+  }
+  if (chunk_ == nullptr) {
+    GST_ERROR("could not set up %zu byte write buffers", chunk_capacity_);
+    return false;
+  }
+  if (!open_next()) {
+    return false;
+  }
+  WorkerPool* pool = options_.pool ? options_.pool : &WorkerPool::io();
+  std::lock_guard<std::mutex> guard(lock_);
+  strand_.reset(new WorkerPool::Strand(pool));
+  running_ = true;
+  // for records pushed before start()
+  if (!queue_.empty()) {
+    drain_posted_ = strand_->post([this] { drain(); });
+  }
+  return true;
+}
+
+void AsyncFileWriter::stop() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    running_ = false;
+  }
+  // nothing posts once running_ is false, so the strand can go
+  if (strand_ != nullptr) {
+    strand_->close();
+    strand_.reset();
+    drain_posted_ = false;
+    tick_posted_ = false;
+    // whatever the tasks didn't get to, on this thread
+    std::deque<Record> rest;
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      rest.swap(queue_);
+    }
+    write_records(&rest);
+  }
+  close_current();
+  if (chunk_ != nullptr) {
+    backend_release_chunks(chunk_);
+    chunk_ = nullptr;
+  }
+}
+
+bool AsyncFileWriter::push(std::string&& record) {
+  return push(std::move(record), std::string());
+}
+
+bool AsyncFileWriter::push(std::string&& record, std::string&& meta) {
+  size_t size = record.size();
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (queue_.size() >= options_.queue_size) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    queue_.push_back(Record{std::move(record), std::move(meta)});
+    if (running_ && !drain_posted_) {
+      drain_posted_ = strand_->post([this] { drain(); });
+    }
+  }
+  bytes_pushed_.fetch_add(size, std::memory_order_relaxed);
+  return true;
+}
+
+size_t AsyncFileWriter::queue_depth() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return queue_.size();
+}
+
+std::string AsyncFileWriter::current_path() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return path_;
+}
+
+void AsyncFileWriter::drain() {
+  bool more = false;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    // take a slice at once so the streaming thread can keep pushing while
+    // we do (slow) I/O without holding the lock
+    size_t n = std::min(queue_.size(), DRAIN_SLICE);
+    std::move(queue_.begin(), queue_.begin() + n, std::back_inserter(batch_));
+    queue_.erase(queue_.begin(), queue_.begin() + n);
+    more = !queue_.empty();
+    drain_posted_ = more;
+  }
+  write_records(&batch_);
+  batch_.clear();
+  maybe_sync(false);
+  if (more) {
+    // behind the other strands' tasks rather than straight away
+    std::lock_guard<std::mutex> guard(lock_);
+    if (running_) {
+      strand_->post([this] { drain(); });
+    }
+  } else {
+    schedule_tick();
+  }
+}
+
+void AsyncFileWriter::tick() {
+  bool idle = false;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    tick_posted_ = false;
+    idle = queue_.empty();
+  }
+  // idle: don't let a partial chunk sit in memory forever
+  if (idle) {
+    flush_chunk(true);
+    maybe_sync(false);
+  }
+  schedule_tick();
+}
+
+/* how often tick() runs: often enough for both the idle flush and, if fsyncs
+ * are by interval, the fsync (which only runs once the chunk is flushed)
+ */
+static unsigned tick_interval_ms(const AsyncFileWriter::Options& options) {
+  if (options.fsync_policy == AsyncFileWriter::FSYNC_INTERVAL) {
+    return std::min(options.flush_interval_ms, options.fsync_interval_ms);
+  }
+  return options.flush_interval_ms;
+}
+
+void AsyncFileWriter::schedule_tick() {
+  // only while there is a partial chunk or an interval fsync to come
+  if (chunk_used_ == 0 &&
+      (options_.fsync_policy != FSYNC_INTERVAL || unsynced_bytes_ == 0)) {
+    return;
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  if (running_ && !tick_posted_) {
+    tick_posted_ = strand_->post_after(
+        std::chrono::milliseconds(tick_interval_ms(options_)),
+        [this] { tick(); });
+  }
+}
+
+void AsyncFileWriter::write_records(std::deque<Record>* records) {
+  for (auto& record : *records) {
+    if (options_.transform) {
+      options_.transform(&record.data);
+    }
+    if (rotation_due()) {
+      close_current();
+      if (!open_next()) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        continue;
+      }
+    }
+    if (options_.observer && !record.meta.empty()) {
+      options_.observer->on_record(file_bytes_ + chunk_used_,
+                                   record.data.size(), record.meta);
+    }
+    append(record.data);
+  }
+}
+
+bool AsyncFileWriter::rotation_due() const {
+  if (fd_ < 0) {
+    return true;
+  }
+  if (options_.rotate_bytes &&
+      file_bytes_ + chunk_used_ >= options_.rotate_bytes) {
+    return true;
+  }
+  if (options_.rotate_seconds &&
+      clock::now() - file_opened_ >=
+          std::chrono::seconds(options_.rotate_seconds)) {
+    return true;
+  }
+  return false;
+}
+
+bool AsyncFileWriter::open_next() {
+  bool numbered = options_.rotate_bytes || options_.rotate_seconds;
+  // never overwrite a file (eg. an earlier run's): numbered files carry on
+  // after the existing ones, an unnumbered one gets a "-N" suffix
+  std::string path;
+  unsigned collisions = 0;
+  for (;;) {
+    char suffix[16] = "";
+    if (numbered) {
+      snprintf(suffix, sizeof(suffix), ".%05u", file_index_ + collisions);
+    } else if (collisions) {
+      snprintf(suffix, sizeof(suffix), "-%u", collisions);
+    }
+    path = options_.basepath + suffix + options_.extension;
+    if (backend_open(path)) {
+      break;
+    }
+    if (errno != EEXIST || collisions == MAX_NAME_COLLISIONS) {
+      GST_ERROR("could not open %s for writing: %s", path.c_str(),
+                strerror(errno));
+      return false;
+    }
+    collisions++;
+  }
+  if (numbered) {
+    file_index_ += collisions + 1;
+  }
+  GST_INFO("writing to %s (%s)", path.c_str(), backend_name());
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    path_ = path;
+  }
+  file_bytes_ = 0;
+  unsynced_bytes_ = 0;
+  file_opened_ = clock::now();
+  last_sync_ = file_opened_;
+  if (options_.observer) {
+    options_.observer->on_open(path);
+  }
+  if (!options_.header.empty()) {
+    append(options_.header);
+  }
+  return true;
+}
+
+void AsyncFileWriter::close_current() {
+  if (fd_ < 0) {
+    return;
+  }
+  if (options_.observer) {
+    std::string trailer = options_.observer->trailer();
+    if (!trailer.empty()) {
+      append(trailer);
+    }
+  }
+  flush_chunk(true);
+  maybe_sync(true);
+  backend_close();
+  if (options_.observer) {
+    options_.observer->on_close();
+  }
+}
+
+bool AsyncFileWriter::append(const std::string& record) {
+  const char* data = record.data();
+  size_t remaining = record.size();
+  while (remaining) {
+    size_t n = std::min(remaining, chunk_capacity_ - chunk_used_);
+    memcpy(chunk_ + chunk_used_, data, n);
+    chunk_used_ += n;
+    data += n;
+    remaining -= n;
+    if (chunk_used_ == chunk_capacity_ && !flush_chunk(false)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool AsyncFileWriter::flush_chunk(bool partial) {
+  if (fd_ < 0) {
+    chunk_used_ = 0;
+    return false;
+  }
+  if (chunk_used_ == 0) {
+    return true;
+  }
+  if (!partial && chunk_used_ != chunk_capacity_) {
+    return true;
+  }
+  size_t len = chunk_used_;
+  chunk_used_ = 0;
+  bool ok = backend_write(chunk_, len);
+  if (!ok) {
+    GST_WARNING("write to %s failed: %s", path_.c_str(), strerror(errno));
+  }
+  chunk_ = backend_acquire_chunk(chunk_);
+  if (!ok) {
+    return false;
+  }
+  file_bytes_ += len;
+  unsynced_bytes_ += len;
+  bytes_written_.fetch_add(len, std::memory_order_relaxed);
+  if (options_.observer) {
+    options_.observer->on_flush(file_bytes_);
+  }
+  return true;
+}
+
+void AsyncFileWriter::maybe_sync(bool force) {
+  if (fd_ < 0 || unsynced_bytes_ == 0) {
+    return;
+  }
+  auto now = clock::now();
+  bool due = force;
+  switch (options_.fsync_policy) {
+    case FSYNC_INTERVAL:
+      due = due || now - last_sync_ >=
+                       std::chrono::milliseconds(options_.fsync_interval_ms);
+      break;
+    case FSYNC_BYTES:
+      due = due || unsynced_bytes_ >= options_.fsync_bytes;
+      break;
+    case FSYNC_NEVER:
+    default:
+      // the kernel will get to it, close() doesn't need an fsync
+      return;
+  }
+  if (!due) {
+    return;
+  }
+  if (!backend_sync()) {
+    GST_WARNING("fsync of %s failed: %s", path_.c_str(), strerror(errno));
+  }
+  unsynced_bytes_ = 0;
+  last_sync_ = now;
+  syncs_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool AsyncFileWriter::backend_open(const std::string& path) {
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  return fd_ >= 0;
+}
+
+bool AsyncFileWriter::backend_write(const char* data, size_t len) {
+  while (len) {
+    ssize_t n = write(fd_, data, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+bool AsyncFileWriter::backend_sync() {
+  return fdatasync(fd_) == 0;
+}
+
+void AsyncFileWriter::backend_close() {
+  close(fd_);
+  fd_ = -1;
+}
+
+char* AsyncFileWriter::backend_acquire_chunk(char* previous) {
+  if (previous != nullptr) {
+    return previous;
+  }
+  char* chunk = nullptr;
+  if (posix_memalign((void**)&chunk, PAGE_SIZE, chunk_capacity_) != 0) {
+    return nullptr;
+  }
+  return chunk;
+}
+
+void AsyncFileWriter::backend_release_chunks(char* current) {
+  free(current);
+}
+
+std::unique_ptr<AsyncFileWriter> AsyncFileWriter::create(Options options) {
+  init_debug_category();
+  if (options.backend != BACKEND_POSIX) {
+    if (UringFileWriter::supported()) {
+      return std::unique_ptr<AsyncFileWriter>(
+          new UringFileWriter(std::move(options)));
+    }
+    if (options.backend == BACKEND_URING) {
+      GST_WARNING("io_uring requested but unavailable, using posix writes");
+    }
+  }
+  return std::unique_ptr<AsyncFileWriter>(
+      new AsyncFileWriter(std::move(options)));
+}
+
+}  // namespace ds
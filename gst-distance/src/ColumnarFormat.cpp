@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "ColumnarFormat.hpp"
+
+#include <distance.pb.h>
+
+#include <zlib.h>
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace ds {
+namespace columnar {
+
+std::string file_header() {
+  FileHeader header;
+  memcpy(header.magic, FILE_MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.num_columns = NUM_COLUMNS;
+  return std::string((const char*)&header, sizeof(header));
+}
+
+template <typename T>
+static inline void put(std::vector<uint8_t>* column, T value) {
+  size_t size = column->size();
+  column->resize(size + sizeof(T));
+  memcpy(column->data() + size, &value, sizeof(T));
+}
+
+/* replace each value with its difference to the previous one */
+static void delta_encode(std::vector<uint8_t>* column) {
+  size_t count = column->size() / sizeof(uint64_t);
+  uint64_t previous = 0;
+  for (size_t i = 0; i < count; i++) {
+    uint64_t value;
+    memcpy(&value, column->data() + i * sizeof(value), sizeof(value));
+    uint64_t delta = value - previous;
+    memcpy(column->data() + i * sizeof(value), &delta, sizeof(delta));
+    previous = value;
+  }
+}
+
+static uint64_t load(const uint8_t* p, size_t width) {
+  // little endian: the low bytes come first
+  uint64_t value = 0;
+  memcpy(&value, p, width);
+  return value;
+}
+
+/* store every value of the column in the narrowest width holding them all,
+ * returns that width */
+static uint8_t pack(std::vector<uint8_t>* column, uint8_t width) {
+  size_t count = column->size() / width;
+  uint64_t max = 0;
+  for (size_t i = 0; i < count; i++) {
+    max = std::max(max, load(column->data() + i * width, width));
+  }
+  uint8_t packed = 1;
+  while (packed < width && (max >> (8 * packed)) != 0) {
+    packed *= 2;
+  }
+  if (packed == width) {
+    return width;
+  }
+  // narrowing front to back never overwrites a value not yet read
+  for (size_t i = 0; i < count; i++) {
+    uint64_t value = load(column->data() + i * width, width);
+    memcpy(column->data() + i * packed, &value, packed);
+  }
+  column->resize(count * packed);
+  return packed;
+}
+
+RowGroupBuilder::RowGroupBuilder()
+    : num_batches_(0), num_rows_(0), min_pts_(UINT64_MAX), max_pts_(0) {}
+
+void RowGroupBuilder::add(const dp::Batch& batch) {
+  num_batches_++;
+  for (const auto& frame : batch.frames()) {
+    if (frame.people_size() == 0) {
+      continue;
+    }
+    uint64_t pts = (uint64_t)frame.pts();
+    min_pts_ = std::min(min_pts_, pts);
+    max_pts_ = std::max(max_pts_, pts);
+    for (const auto& person : frame.people()) {
+      const auto& bbox = person.bbox();
+      put<uint64_t>(&columns_[COLUMN_PTS], pts);
+      put<uint32_t>(&columns_[COLUMN_SOURCE_ID], (uint32_t)frame.source_id());
+      put<uint64_t>(&columns_[COLUMN_FRAME_NUM], (uint64_t)frame.frame_num());
+      put<uint64_t>(&columns_[COLUMN_UID], (uint64_t)person.uid());
+      put<uint8_t>(&columns_[COLUMN_IS_DANGER], person.is_danger() ? 1 : 0);
+      put<float>(&columns_[COLUMN_DANGER_VAL], person.danger_val());
+      put<float>(&columns_[COLUMN_LEFT], bbox.left());
+      put<float>(&columns_[COLUMN_TOP], bbox.top());
+      put<float>(&columns_[COLUMN_WIDTH], bbox.width());
+      put<float>(&columns_[COLUMN_HEIGHT], bbox.height());
+      num_rows_++;
+    }
+  }
+}
+
+std::string RowGroupBuilder::take(std::string* meta) {
+  delta_encode(&columns_[COLUMN_PTS]);
+  delta_encode(&columns_[COLUMN_FRAME_NUM]);
+  uint8_t packed_width[NUM_COLUMNS];
+  for (unsigned i = 0; i < NUM_COLUMNS; i++) {
+    packed_width[i] =
+        IS_INTEGER[i] ? pack(&columns_[i], VALUE_SIZE[i]) : VALUE_SIZE[i];
+  }
+
+  size_t size = sizeof(RowGroupHeader) + NUM_COLUMNS * sizeof(ColumnChunk);
+  for (const auto& column : columns_) {
+    size += column.size();
+  }
+  std::string group(size, '\0');
+  char* p = &group[0];
+
+  RowGroupHeader header;
+  memcpy(header.magic, ROW_GROUP_MAGIC, sizeof(header.magic));
+  header.num_rows = (uint32_t)num_rows_;
+  header.num_columns = NUM_COLUMNS;
+  header.size = (uint32_t)size;
+  header.min_pts = num_rows_ ? min_pts_ : 0;
+  header.max_pts = max_pts_;
+  memcpy(p, &header, sizeof(header));
+
+  size_t offset = sizeof(RowGroupHeader) + NUM_COLUMNS * sizeof(ColumnChunk);
+  for (unsigned i = 0; i < NUM_COLUMNS; i++) {
+    ColumnChunk chunk;
+    memset(&chunk, 0, sizeof(chunk));
+    chunk.column = (uint16_t)i;
+    chunk.width = VALUE_SIZE[i];
+    chunk.encoding = (i == COLUMN_PTS || i == COLUMN_FRAME_NUM)
+                         ? ENCODING_DELTA
+                         : ENCODING_PLAIN;
+    chunk.compression = COMPRESSION_NONE;
+    chunk.packed_width = packed_width[i];
+    chunk.offset = (uint32_t)offset;
+    chunk.stored_size = (uint32_t)columns_[i].size();
+    chunk.raw_size = chunk.stored_size;
+    memcpy(p + sizeof(RowGroupHeader) + i * sizeof(ColumnChunk), &chunk,
+           sizeof(chunk));
+    if (!columns_[i].empty()) {
+      memcpy(p + offset, columns_[i].data(), columns_[i].size());
+    }
+    offset += columns_[i].size();
+    columns_[i].clear();
+  }
+
+  FooterEntry entry;
+  entry.offset = 0;
+  entry.min_pts = header.min_pts;
+  entry.max_pts = header.max_pts;
+  entry.num_rows = header.num_rows;
+  entry.size = header.size;
+  meta->assign((const char*)&entry, sizeof(entry));
+
+  num_batches_ = 0;
+  num_rows_ = 0;
+  min_pts_ = UINT64_MAX;
+  max_pts_ = 0;
+  return group;
+}
+
+void compress_row_group(std::string* row_group) {
+  RowGroupHeader header;
+  if (row_group->size() < sizeof(header)) {
+    return;
+  }
+  memcpy(&header, row_group->data(), sizeof(header));
+  size_t chunks_size = header.num_columns * sizeof(ColumnChunk);
+  size_t offset = sizeof(header) + chunks_size;
+  if (row_group->size() < offset) {
+    return;
+  }
+
+  std::string out;
+  out.reserve(row_group->size());
+  out.append(row_group->data(), offset);
+  for (uint32_t i = 0; i < header.num_columns; i++) {
+    ColumnChunk chunk;
+    // out may grow below, so address the chunk header by position
+    size_t chunk_at = sizeof(header) + i * sizeof(chunk);
+    memcpy(&chunk, &out[chunk_at], sizeof(chunk));
+    const Bytef* raw = (const Bytef*)row_group->data() + chunk.offset;
+
+    uLongf compressed_size = compressBound(chunk.raw_size);
+    size_t start = out.size();
+    out.resize(start + compressed_size);
+    if (chunk.compression == COMPRESSION_NONE && chunk.raw_size &&
+        compress2((Bytef*)&out[start], &compressed_size, raw, chunk.raw_size,
+                  Z_BEST_SPEED) == Z_OK &&
+        compressed_size < chunk.raw_size) {
+      out.resize(start + compressed_size);
+      chunk.compression = COMPRESSION_ZLIB;
+      chunk.stored_size = (uint32_t)compressed_size;
+    } else {
+      out.resize(start);
+      out.append((const char*)raw, chunk.stored_size);
+    }
+    chunk.offset = (uint32_t)start;
+    memcpy(&out[chunk_at], &chunk, sizeof(chunk));
+  }
+  header.size = (uint32_t)out.size();
+  memcpy(&out[0], &header, sizeof(header));
+  row_group->swap(out);
+}
+
+void FooterWriter::on_open(const std::string& path) {
+  (void)path;
+  entries_.clear();
+}
+
+void FooterWriter::on_record(uint64_t offset,
+                             size_t length,
+                             const std::string& meta) {
+  if (meta.size() != sizeof(FooterEntry)) {
+    return;
+  }
+  FooterEntry entry;
+  memcpy(&entry, meta.data(), sizeof(entry));
+  entry.offset = offset;
+  entry.size = (uint32_t)length;
+  entries_.push_back(entry);
+}
+
+void FooterWriter::on_flush(uint64_t durable) {
+  (void)durable;
+}
+
+std::string FooterWriter::trailer() {
+  FooterTail tail;
+  tail.num_groups = entries_.size();
+  memcpy(tail.magic, FOOTER_MAGIC, sizeof(tail.magic));
+  std::string footer;
+  footer.reserve(entries_.size() * sizeof(FooterEntry) + sizeof(tail));
+  if (!entries_.empty()) {
+    footer.append((const char*)entries_.data(),
+                  entries_.size() * sizeof(FooterEntry));
+  }
+  footer.append((const char*)&tail, sizeof(tail));
+  return footer;
+}
+
+void FooterWriter::on_close() {
+  entries_.clear();
+}
+
+}  // namespace columnar
+}  // namespace ds
@@ -0,0 +1,257 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "ColumnarReader.hpp"
+
+#include "RecordingReader.hpp"
+
+#include <zlib.h>
+
+#include <string.h>
+#include <sys/mman.h>
+
+#include <cstdio>
+
+namespace ds {
+namespace columnar {
+
+template <typename From, typename To>
+static void widen(const uint8_t* packed, void* out, size_t count) {
+  // front to back: value i is read before anything is written over it
+  for (size_t i = 0; i < count; i++) {
+    From value;
+    memcpy(&value, packed + i * sizeof(From), sizeof(From));
+    To wide = value;
+    memcpy((uint8_t*)out + i * sizeof(To), &wide, sizeof(To));
+  }
+}
+
+/* widen `count` unsigned values stored in the tail of `out` */
+static bool widen(const uint8_t* packed,
+                  size_t packed_width,
+                  void* out,
+                  size_t width,
+                  size_t count) {
+  switch (packed_width * 16 + width) {
+    case 1 * 16 + 4:
+      widen<uint8_t, uint32_t>(packed, out, count);
+      return true;
+    case 2 * 16 + 4:
+      widen<uint16_t, uint32_t>(packed, out, count);
+      return true;
+    case 1 * 16 + 8:
+      widen<uint8_t, uint64_t>(packed, out, count);
+      return true;
+    case 2 * 16 + 8:
+      widen<uint16_t, uint64_t>(packed, out, count);
+      return true;
+    case 4 * 16 + 8:
+      widen<uint32_t, uint64_t>(packed, out, count);
+      return true;
+    default:
+      return false;
+  }
+}
+
+ColumnarReader::ColumnarReader()
+    : data_(nullptr), size_(0), has_footer_(false) {}
+
+ColumnarReader::~ColumnarReader() {
+  close();
+}
+
+bool ColumnarReader::open(const std::string& path) {
+  close();
+  data_ = (const uint8_t*)recording::map_file(path, &size_);
+  if (data_ == nullptr) {
+    return false;
+  }
+  FileHeader header;
+  if (size_ < sizeof(header)) {
+    close();
+    return false;
+  }
+  memcpy(&header, data_, sizeof(header));
+  if (memcmp(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0 ||
+      header.version != VERSION) {
+    close();
+    return false;
+  }
+  has_footer_ = read_footer();
+  if (!has_footer_) {
+    walk_row_groups();
+  }
+  return true;
+}
+
+void ColumnarReader::close() {
+  if (data_ != nullptr) {
+    munmap((void*)data_, size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  has_footer_ = false;
+  groups_.clear();
+}
+
+bool ColumnarReader::read_footer() {
+  FooterTail tail;
+  if (size_ < sizeof(FileHeader) + sizeof(tail)) {
+    return false;
+  }
+  memcpy(&tail, data_ + size_ - sizeof(tail), sizeof(tail));
+  if (memcmp(tail.magic, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) != 0 ||
+      tail.num_groups >
+          (size_ - sizeof(FileHeader) - sizeof(tail)) / sizeof(FooterEntry)) {
+    return false;
+  }
+  size_t footer_size = tail.num_groups * sizeof(FooterEntry);
+  size_t footer_start = size_ - sizeof(tail) - footer_size;
+  groups_.resize(tail.num_groups);
+  if (footer_size) {
+    memcpy(groups_.data(), data_ + footer_start, footer_size);
+  }
+  for (const auto& group : groups_) {
+    if (group.offset < sizeof(FileHeader) ||
+        group.size < sizeof(RowGroupHeader) || group.offset > footer_start ||
+        group.size > footer_start - group.offset) {
+      groups_.clear();
+      return false;
+    }
+  }
+  return true;
+}
+
+void ColumnarReader::walk_row_groups() {
+  size_t position = sizeof(FileHeader);
+  RowGroupHeader header;
+  while (size_ - position >= sizeof(header)) {
+    memcpy(&header, data_ + position, sizeof(header));
+    if (memcmp(header.magic, ROW_GROUP_MAGIC, sizeof(ROW_GROUP_MAGIC)) != 0 ||
+        header.size < sizeof(header) || header.size > size_ - position) {
+      // a footer, or the truncated tail of a live recording
+      break;
+    }
+    FooterEntry entry;
+    entry.offset = position;
+    entry.min_pts = header.min_pts;
+    entry.max_pts = header.max_pts;
+    entry.num_rows = header.num_rows;
+    entry.size = header.size;
+    groups_.push_back(entry);
+    position += header.size;
+  }
+}
+
+uint64_t ColumnarReader::num_rows() const {
+  uint64_t rows = 0;
+  for (const auto& group : groups_) {
+    rows += group.num_rows;
+  }
+  return rows;
+}
+
+bool ColumnarReader::read_column(size_t group,
+                                 Column column,
+                                 void* out,
+                                 size_t out_size) const {
+  if (group >= groups_.size() || column >= NUM_COLUMNS) {
+    return false;
+  }
+  const FooterEntry& entry = groups_[group];
+  const uint8_t* base = data_ + entry.offset;
+  RowGroupHeader header;
+  memcpy(&header, base, sizeof(header));
+  if (header.num_columns >
+      (entry.size - sizeof(header)) / sizeof(ColumnChunk)) {
+    return false;
+  }
+  for (uint32_t i = 0; i < header.num_columns; i++) {
+    ColumnChunk chunk;
+    memcpy(&chunk, base + sizeof(header) + i * sizeof(chunk), sizeof(chunk));
+    if (chunk.column != column) {
+      continue;
+    }
+    size_t width = chunk.width;
+    size_t packed = chunk.packed_width;
+    if (width != VALUE_SIZE[column] || packed == 0 || packed > width ||
+        out_size != (uint64_t)header.num_rows * width ||
+        chunk.raw_size != (uint64_t)header.num_rows * packed ||
+        chunk.offset > entry.size ||
+        chunk.stored_size > entry.size - chunk.offset) {
+      return false;
+    }
+    const uint8_t* stored = base + chunk.offset;
+    // packed values are decoded into the tail of `out` and widened in place
+    uint8_t* raw = (uint8_t*)out + (out_size - chunk.raw_size);
+    switch (chunk.compression) {
+      case COMPRESSION_NONE:
+        if (chunk.stored_size != chunk.raw_size) {
+          return false;
+        }
+        memcpy(raw, stored, chunk.raw_size);
+        break;
+      case COMPRESSION_ZLIB: {
+        uLongf len = chunk.raw_size;
+        if (uncompress((Bytef*)raw, &len, stored, chunk.stored_size) != Z_OK ||
+            len != chunk.raw_size) {
+          return false;
+        }
+        break;
+      }
+      default:
+        return false;
+    }
+    if (packed != width && !widen(raw, packed, out, width, header.num_rows)) {
+      return false;
+    }
+    if (chunk.encoding == ENCODING_DELTA) {
+      if (width != sizeof(uint64_t)) {
+        return false;
+      }
+      uint8_t* values = (uint8_t*)out;
+      uint64_t previous = 0;
+      for (uint32_t row = 0; row < header.num_rows; row++) {
+        uint64_t value;
+        memcpy(&value, values + row * sizeof(value), sizeof(value));
+        previous += value;
+        memcpy(values + row * sizeof(value), &previous, sizeof(previous));
+      }
+    } else if (chunk.encoding != ENCODING_PLAIN) {
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+bool is_columnar(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  char magic[sizeof(FILE_MAGIC)];
+  bool result = fread(magic, 1, sizeof(magic), file) == sizeof(magic) &&
+                memcmp(magic, FILE_MAGIC, sizeof(magic)) == 0;
+  fclose(file);
+  return result;
+}
+
+}  // namespace columnar
+}  // namespace ds
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "CsvEncoder.hpp"
+
+#include <distance.pb.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__has_include)
+#if __has_include(<charconv>)
+#include <charconv>
+#endif
+#endif
+
+// GCC < 11 (DeepStream 5 / L4T ship GCC 7) has no floating point to_chars
+#if defined(__cpp_lib_to_chars)
+#define DS_CSV_TO_CHARS 1
+#endif
+
+namespace ds {
+
+const char CsvEncoder::HEADER[] =
+    "source_id,frame_num,pts,uid,is_danger,danger_val,"
+    "left,top,width,height\n";
+
+/* longest %f of a float: "-" + 39 digits + "." + 6 digits */
+static const size_t MAX_FLOAT_SIZE = 47;
+static const size_t MAX_UINT64_SIZE = 20;
+static const size_t MAX_UINT32_SIZE = 10;
+// prefix + uid,is_danger, + 5 floats with separators + newline, rounded up
+const size_t CsvEncoder::MAX_ROW_SIZE =
+    (MAX_UINT32_SIZE + 2 * MAX_UINT64_SIZE + 3) +
+    (MAX_UINT64_SIZE + 4) + (5 * MAX_FLOAT_SIZE + 4) + 1 + 8;
+
+static inline char* write_uint(char* p, uint64_t value) {
+#ifdef DS_CSV_TO_CHARS
+  return std::to_chars(p, p + MAX_UINT64_SIZE, value).ptr;
+#else
+  char digits[MAX_UINT64_SIZE];
+  char* d = digits + sizeof(digits);
+  do {
+    *--d = (char)('0' + value % 10);
+    value /= 10;
+  } while (value);
+  size_t len = (size_t)(digits + sizeof(digits) - d);
+  memcpy(p, d, len);
+  return p + len;
+#endif
+}
+
+/* same as %f (floats are promoted to double by printf) */
+static inline char* write_float(char* p, float value) {
+#ifdef DS_CSV_TO_CHARS
+  return std::to_chars(p, p + MAX_FLOAT_SIZE, (double)value,
+                       std::chars_format::fixed, 6)
+      .ptr;
+#else
+  // MAX_ROW_SIZE leaves room for the terminator
+  int len = snprintf(p, MAX_FLOAT_SIZE + 1, "%f", (double)value);
+  return p + std::max(len, 0);
+#endif
+}
+
+/* enough for a typical batch without growing */
+static const size_t INITIAL_ROWS = 64;
+
+CsvEncoder::CsvEncoder()
+    : prefix_size_(0), buffer_(INITIAL_ROWS * MAX_ROW_SIZE, '\0'), size_(0) {
+  prefix_[0] = '\0';
+}
+
+void CsvEncoder::reserve_rows(size_t rows) {
+  size_t needed = size_ + rows * MAX_ROW_SIZE;
+  if (needed > buffer_.size()) {
+    buffer_.resize(std::max(needed, buffer_.size() * 2));
+  }
+}
+
+std::string CsvEncoder::take() {
+  // shrinking keeps the capacity, so this neither copies nor allocates
+  buffer_.resize(size_);
+  std::string rows;
+  rows.swap(buffer_);
+  size_ = 0;
+  return rows;
+}
+
+void CsvEncoder::begin_frame(uint32_t source_id,
+                             uint64_t frame_num,
+                             uint64_t pts) {
+  char* p = prefix_;
+  p = write_uint(p, source_id);
+  *p++ = ',';
+  p = write_uint(p, frame_num);
+  *p++ = ',';
+  p = write_uint(p, pts);
+  *p++ = ',';
+  prefix_size_ = (size_t)(p - prefix_);
+}
+
+void CsvEncoder::add_person(uint64_t uid,
+                            bool is_danger,
+                            float danger_val,
+                            float left,
+                            float top,
+                            float width,
+                            float height) {
+  reserve_rows(1);
+  char* p = &buffer_[size_];
+  memcpy(p, prefix_, prefix_size_);
+  p += prefix_size_;
+  p = write_uint(p, uid);
+  *p++ = ',';
+  *p++ = is_danger ? '1' : '0';
+  *p++ = ',';
+  p = write_float(p, danger_val);
+  *p++ = ',';
+  p = write_float(p, left);
+  *p++ = ',';
+  p = write_float(p, top);
+  *p++ = ',';
+  p = write_float(p, width);
+  *p++ = ',';
+  p = write_float(p, height);
+  *p++ = '\n';
+  size_ = (size_t)(p - &buffer_[0]);
+}
+
+void CsvEncoder::encode(const dp::Batch& batch) {
+  clear();
+  size_t rows = 0;
+  for (const auto& frame : batch.frames()) {
+    rows += (size_t)frame.people_size();
+  }
+  reserve_rows(rows);
+  for (const auto& frame : batch.frames()) {
+    if (frame.people_size() == 0) {
+      continue;
+    }
+    begin_frame((uint32_t)frame.source_id(), (uint64_t)frame.frame_num(),
+                (uint64_t)frame.pts());
+    for (const auto& person : frame.people()) {
+      const auto& bbox = person.bbox();
+      add_person((uint64_t)person.uid(), person.is_danger(),
+                 person.danger_val(), bbox.left(), bbox.top(), bbox.width(),
+                 bbox.height());
+    }
+  }
+}
+
+}  // namespace ds
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "ElementStats.hpp"
+
+namespace ds {
+
+const uint64_t ElementStats::BUCKET_BOUNDS[NUM_BUCKETS - 1] = {
+    10000,    25000,    50000,    100000,   250000,    500000,
+    1000000,  2500000,  5000000,  10000000, 25000000,  100000000,
+};
+
+/** hands out slots to threads in turn */
+static std::atomic<size_t> next_slot(0);
+static thread_local size_t thread_slot = next_slot++;
+
+ElementStats::ElementStats() {
+  for (auto& slot : slots_) {
+    slot.buffers.store(0, std::memory_order_relaxed);
+    slot.objects.store(0, std::memory_order_relaxed);
+    slot.pairs.store(0, std::memory_order_relaxed);
+    slot.total_time.store(0, std::memory_order_relaxed);
+    slot.max_time.store(0, std::memory_order_relaxed);
+    for (auto& bucket : slot.time_buckets) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+ElementStats::Slot& ElementStats::this_thread_slot() {
+  return slots_[thread_slot % NUM_SLOTS];
+}
+
+void ElementStats::add(uint64_t objects, uint64_t pairs, uint64_t time) {
+  Slot& slot = this_thread_slot();
+  // uncontended unless more than NUM_SLOTS threads share this element
+  slot.buffers.fetch_add(1, std::memory_order_relaxed);
+  slot.objects.fetch_add(objects, std::memory_order_relaxed);
+  slot.pairs.fetch_add(pairs, std::memory_order_relaxed);
+  slot.total_time.fetch_add(time, std::memory_order_relaxed);
+  size_t bucket = 0;
+  while (bucket < NUM_BUCKETS - 1 && time > BUCKET_BOUNDS[bucket]) {
+    bucket++;
+  }
+  slot.time_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  uint64_t max = slot.max_time.load(std::memory_order_relaxed);
+  while (time > max && !slot.max_time.compare_exchange_weak(
+                           max, time, std::memory_order_relaxed)) {
+  }
+}
+
+ElementStats::Snapshot ElementStats::snapshot() const {
+  Snapshot snapshot = {};
+  for (const auto& slot : slots_) {
+    snapshot.buffers += slot.buffers.load(std::memory_order_relaxed);
+    snapshot.objects += slot.objects.load(std::memory_order_relaxed);
+    snapshot.pairs += slot.pairs.load(std::memory_order_relaxed);
+    snapshot.total_time += slot.total_time.load(std::memory_order_relaxed);
+    uint64_t max = slot.max_time.load(std::memory_order_relaxed);
+    if (max > snapshot.max_time) {
+      snapshot.max_time = max;
+    }
+    for (size_t i = 0; i < NUM_BUCKETS; i++) {
+      snapshot.time_buckets[i] +=
+          slot.time_buckets[i].load(std::memory_order_relaxed);
+    }
+  }
+  return snapshot;
+}
+
+}  // namespace ds
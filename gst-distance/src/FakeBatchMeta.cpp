@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "FakeBatchMeta.hpp"
+
+#include <gstnvdsmeta.h>
+
+namespace ds {
+
+/** the id nvinfer would have set as the source of the objects */
+static const int UNIQUE_COMPONENT_ID = 1;
+
+void add_fake_batch_meta(GstBuffer* buf,
+                         const FakeScene& scene,
+                         uint64_t frame_num,
+                         int class_id,
+                         uint32_t first_source_id) {
+  NvDsBatchMeta* batch_meta = nvds_create_batch_meta(scene.sources());
+  NvDsMeta* meta = gst_buffer_add_nvds_meta(buf, batch_meta, nullptr,
+                                            nvds_batch_meta_copy_func,
+                                            nvds_batch_meta_release_func);
+  meta->meta_type = NVDS_BATCH_GST_META;
+  batch_meta->base_meta.batch_meta = batch_meta;
+  batch_meta->base_meta.copy_func = nvds_batch_meta_copy_func;
+  batch_meta->base_meta.release_func = nvds_batch_meta_release_func;
+  batch_meta->max_frames_in_batch = scene.sources();
+
+  for (uint32_t source = 0; source < scene.sources(); source++) {
+    NvDsFrameMeta* frame_meta = nvds_acquire_frame_meta_from_pool(batch_meta);
+    frame_meta->pad_index = source;
+    frame_meta->batch_id = source;
+    frame_meta->source_id = first_source_id + source;
+    frame_meta->frame_num = (gint)frame_num;
+    frame_meta->buf_pts = GST_BUFFER_PTS(buf);
+    frame_meta->ntp_timestamp = 0;
+    frame_meta->source_frame_width = scene.width();
+    frame_meta->source_frame_height = scene.height();
+    frame_meta->bInferDone = TRUE;
+    nvds_add_frame_meta_to_batch(batch_meta, frame_meta);
+
+    for (const auto& person : scene.objects(source)) {
+      NvDsObjectMeta* obj_meta = nvds_acquire_obj_meta_from_pool(batch_meta);
+      obj_meta->unique_component_id = UNIQUE_COMPONENT_ID;
+      obj_meta->class_id = class_id;
+      obj_meta->object_id = person.id;
+      obj_meta->confidence = 1.0f;
+      obj_meta->rect_params.left = person.left;
+      obj_meta->rect_params.top = person.top;
+      obj_meta->rect_params.width = person.width;
+      obj_meta->rect_params.height = person.height;
+      nvds_add_obj_meta_to_frame(frame_meta, obj_meta, nullptr);
+    }
+  }
+}
+
+}  // namespace ds
@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "FakeScene.hpp"
+
+#include <algorithm>
+
+namespace ds {
+
+/** person heights as a fraction of the frame height */
+static const float MIN_HEIGHT = 0.1f;
+static const float MAX_HEIGHT = 0.3f;
+/** width of a person's box as a fraction of its height */
+static const float ASPECT = 0.4f;
+/** the fastest walk, as a fraction of the frame width per frame */
+static const float MAX_SPEED = 0.005f;
+
+FakeScene::FakeScene(uint32_t sources,
+                     uint32_t objects,
+                     Motion motion,
+                     double churn,
+                     uint32_t width,
+                     uint32_t height,
+                     uint64_t seed)
+    : motion_(motion),
+      churn_(churn),
+      width_((float)width),
+      height_((float)height),
+      next_id_(1),
+      rng_(seed),
+      sources_(sources) {
+  for (auto& people : sources_) {
+    people.reserve(objects);
+    for (uint32_t i = 0; i < objects; i++) {
+      people.push_back(spawn());
+    }
+  }
+}
+
+FakeObject FakeScene::spawn() {
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  FakeObject object;
+  object.id = next_id_++;
+  object.height =
+      height_ * (MIN_HEIGHT + (MAX_HEIGHT - MIN_HEIGHT) * unit(rng_));
+  object.width = object.height * ASPECT;
+  object.left = (width_ - object.width) * unit(rng_);
+  object.top = (height_ - object.height) * unit(rng_);
+  float speed = motion_ == MOTION_STATIC ? 0.0f : width_ * MAX_SPEED;
+  object.dx = speed * (2.0f * unit(rng_) - 1.0f);
+  object.dy = speed * (2.0f * unit(rng_) - 1.0f);
+  return object;
+}
+
+void FakeScene::move(FakeObject* object) {
+  if (motion_ == MOTION_RANDOM) {
+    float speed = width_ * MAX_SPEED;
+    std::normal_distribution<float> turn(0.0f, speed * 0.1f);
+    object->dx = std::max(-speed, std::min(speed, object->dx + turn(rng_)));
+    object->dy = std::max(-speed, std::min(speed, object->dy + turn(rng_)));
+  }
+  object->left += object->dx;
+  object->top += object->dy;
+  float max_left = width_ - object->width;
+  float max_top = height_ - object->height;
+  if (object->left < 0.0f || object->left > max_left) {
+    object->dx = -object->dx;
+    object->left = std::max(0.0f, std::min(max_left, object->left));
+  }
+  if (object->top < 0.0f || object->top > max_top) {
+    object->dy = -object->dy;
+    object->top = std::max(0.0f, std::min(max_top, object->top));
+  }
+}
+
+void FakeScene::step() {
+  std::bernoulli_distribution lost(churn_);
+  for (auto& people : sources_) {
+    for (auto& object : people) {
+      if (motion_ != MOTION_STATIC) {
+        move(&object);
+      }
+      if (churn_ > 0.0 && lost(rng_)) {
+        object.id = next_id_++;
+      }
+    }
+  }
+}
+
+}  // namespace ds
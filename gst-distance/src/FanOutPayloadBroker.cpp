@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "FanOutPayloadBroker.hpp"
+
+namespace ds {
+
+FanOutPayloadBroker::FanOutPayloadBroker(PayloadSampler::Policy policy,
+                                         double max_rate,
+                                         SourceTableLimits limits)
+    : sampler_(policy, max_rate, limits) {}
+
+void FanOutPayloadBroker::add(PayloadBroker* output, bool sampled) {
+  if (sampled) {
+    outputs_.emplace_back(output);
+  } else {
+    unsampled_.emplace_back(output);
+  }
+}
+
+bool FanOutPayloadBroker::on_batch_payload(NvDsBatchMeta* batch_meta,
+                                           dp::Batch* batch) {
+  if (batch != nullptr) {
+    for (const auto& frame : batch->frames()) {
+      uint64_t people = (uint64_t)frame.people_size();
+      if (people > 1) {
+        pairs_ += people * (people - 1) / 2;
+      }
+    }
+  }
+  bool ok = true;
+  for (auto& output : unsampled_) {
+    ok &= output->on_batch_payload(batch_meta, batch);
+  }
+  if (outputs_.empty() || batch == nullptr || !sampler_.sample(batch)) {
+    return ok;
+  }
+  for (auto& output : outputs_) {
+    ok &= output->on_batch_payload(batch_meta, batch);
+  }
+  return ok;
+}
+
+}  // namespace ds
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "FrameScheduler.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+namespace ds {
+
+static const FrameScheduler::Priority ALL_PRIORITIES[] = {
+    FrameScheduler::PRIORITY_CRITICAL,
+    FrameScheduler::PRIORITY_NORMAL,
+    FrameScheduler::PRIORITY_BEST_EFFORT,
+};
+
+FrameScheduler::FrameScheduler() : budget_(0), skipped_(0) {}
+
+const char* FrameScheduler::priority_name(Priority priority) {
+  switch (priority) {
+    case PRIORITY_CRITICAL:
+      return "critical";
+    case PRIORITY_BEST_EFFORT:
+      return "best-effort";
+    default:
+      return "normal";
+  }
+}
+
+bool FrameScheduler::set_priorities(const std::string& spec) {
+  std::map<unsigned, Priority> priorities;
+  size_t start = 0;
+  while (start < spec.size()) {
+    size_t end = spec.find(',', start);
+    if (end == std::string::npos) {
+      end = spec.size();
+    }
+    std::string entry = spec.substr(start, end - start);
+    start = end + 1;
+    if (entry.empty()) {
+      continue;
+    }
+    size_t colon = entry.find(':');
+    if (colon == std::string::npos || colon == 0) {
+      return false;
+    }
+    std::string id = entry.substr(0, colon);
+    char* id_end = nullptr;
+    errno = 0;
+    unsigned long source_id = strtoul(id.c_str(), &id_end, 10);
+    // no wrapping around to a smaller id
+    if (*id_end != '\0' || id[0] == '-' || errno == ERANGE ||
+        source_id > UINT_MAX) {
+      return false;
+    }
+    std::string name = entry.substr(colon + 1);
+    bool found = false;
+    for (Priority priority : ALL_PRIORITIES) {
+      if (name == priority_name(priority)) {
+        priorities[(unsigned)source_id] = priority;
+        found = true;
+      }
+    }
+    if (!found) {
+      return false;
+    }
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  priorities_.swap(priorities);
+  return true;
+}
+
+std::string FrameScheduler::priorities() const {
+  std::string spec;
+  std::lock_guard<std::mutex> guard(lock_);
+  for (const auto& entry : priorities_) {
+    if (!spec.empty()) {
+      spec += ",";
+    }
+    spec += std::to_string(entry.first) + ":" + priority_name(entry.second);
+  }
+  return spec;
+}
+
+FrameScheduler::Priority FrameScheduler::priority(unsigned source_id) const {
+  std::lock_guard<std::mutex> guard(lock_);
+  auto it = priorities_.find(source_id);
+  return it == priorities_.end() ? PRIORITY_NORMAL : it->second;
+}
+
+bool FrameScheduler::active() const {
+  if (budget() != 0) {
+    return true;
+  }
+  std::lock_guard<std::mutex> guard(lock_);
+  return !priorities_.empty();
+}
+
+void FrameScheduler::order(const std::vector<unsigned>& source_ids,
+                           std::vector<size_t>* indices,
+                           std::vector<Priority>* priorities) const {
+  indices->clear();
+  priorities->clear();
+  // each frame's priority, in batch order for now (no scratch to allocate)
+  {
+    // once per batch rather than once per frame
+    std::lock_guard<std::mutex> guard(lock_);
+    for (unsigned source_id : source_ids) {
+      auto it = priorities_.find(source_id);
+      priorities->push_back(it == priorities_.end() ? PRIORITY_NORMAL
+                                                    : it->second);
+    }
+  }
+  size_t counts[sizeof(ALL_PRIORITIES) / sizeof(ALL_PRIORITIES[0])] = {};
+  for (size_t p = 0; p < sizeof(counts) / sizeof(counts[0]); p++) {
+    for (size_t i = 0; i < priorities->size(); i++) {
+      if ((*priorities)[i] == ALL_PRIORITIES[p]) {
+        indices->push_back(i);
+        counts[p]++;
+      }
+    }
+  }
+  // then in processing order, which is just each priority's count in turn
+  size_t i = 0;
+  for (size_t p = 0; p < sizeof(counts) / sizeof(counts[0]); p++) {
+    for (size_t n = 0; n < counts[p]; n++) {
+      (*priorities)[i++] = ALL_PRIORITIES[p];
+    }
+  }
+}
+
+bool FrameScheduler::should_process(Priority priority, uint64_t elapsed) {
+  uint64_t budget = this->budget();
+  if (priority == PRIORITY_CRITICAL || budget == 0 || elapsed < budget) {
+    return true;
+  }
+  skipped_.fetch_add(1, std::memory_order_relaxed);
+  return false;
+}
+
+bool FrameScheduler::should_process_batch(
+    const std::vector<unsigned>& source_ids,
+    uint64_t cost) {
+  uint64_t budget = this->budget();
+  if (budget == 0 || cost < budget) {
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (unsigned source_id : source_ids) {
+      auto it = priorities_.find(source_id);
+      if (it != priorities_.end() && it->second == PRIORITY_CRITICAL) {
+        return true;
+      }
+    }
+  }
+  skipped_.fetch_add(source_ids.size(), std::memory_order_relaxed);
+  return false;
+}
+
+}  // namespace ds
@@ -0,0 +1,227 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "LatencyTracker.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+namespace ds {
+
+LatencyHistogram::LatencyHistogram() {
+  for (auto& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+  // only one writer, so no read-modify-write is needed
+  std::atomic<uint64_t>& count = counts_[bucket(ns)];
+  count.store(count.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+void LatencyHistogram::add_to(std::vector<uint64_t>* counts) const {
+  for (size_t i = 0; i < NUM_BUCKETS; i++) {
+    (*counts)[i] += counts_[i].load(std::memory_order_relaxed);
+  }
+}
+
+size_t LatencyHistogram::bucket(uint64_t ns) {
+  if (ns < SUB_BUCKETS) {
+    return (size_t)ns;
+  }
+  unsigned exponent = 63 - __builtin_clzll(ns);
+  if (exponent >= MAX_BITS) {
+    return NUM_BUCKETS - 1;
+  }
+  unsigned shift = exponent - SUB_BITS;
+  return (shift + 1) * SUB_BUCKETS + (size_t)((ns >> shift) - SUB_BUCKETS);
+}
+
+uint64_t LatencyHistogram::lower_bound(size_t bucket) {
+  if (bucket < SUB_BUCKETS) {
+    return bucket;
+  }
+  unsigned shift = (unsigned)(bucket / SUB_BUCKETS) - 1;
+  return (uint64_t)(SUB_BUCKETS + bucket % SUB_BUCKETS) << shift;
+}
+
+uint64_t LatencyHistogram::quantile(const std::vector<uint64_t>& counts,
+                                    double q) {
+  uint64_t total = 0;
+  for (uint64_t count : counts) {
+    total += count;
+  }
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = std::max((uint64_t)std::ceil(q * total), (uint64_t)1);
+  uint64_t seen = 0;
+  for (size_t i = 0; i < counts.size(); i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      // the highest value in the bucket, so quantiles never flatter
+      return i + 1 < NUM_BUCKETS ? lower_bound(i + 1) - 1 : lower_bound(i);
+    }
+  }
+  return lower_bound(NUM_BUCKETS - 1);
+}
+
+static std::atomic<uint64_t> next_tracker_id(1);
+/** this thread's histograms, by tracker id */
+static thread_local std::unordered_map<uint64_t, void*> thread_histograms;
+
+LatencyTracker::ThreadHistograms::ThreadHistograms() {
+  for (auto& by_objects : histograms) {
+    for (auto& histogram : by_objects) {
+      histogram.store(nullptr, std::memory_order_relaxed);
+    }
+  }
+}
+
+LatencyTracker::ThreadHistograms::~ThreadHistograms() {
+  for (auto& by_objects : histograms) {
+    for (auto& histogram : by_objects) {
+      delete histogram.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+LatencyTracker::LatencyTracker() : id_(next_tracker_id++) {}
+
+LatencyTracker::~LatencyTracker() = default;
+
+LatencyTracker::ThreadHistograms* LatencyTracker::this_thread() {
+  auto found = thread_histograms.find(id_);
+  if (found != thread_histograms.end()) {
+    return (ThreadHistograms*)found->second;
+  }
+  ThreadHistograms* thread = new ThreadHistograms();
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    threads_.emplace_back(thread);
+  }
+  thread_histograms[id_] = thread;
+  return thread;
+}
+
+int LatencyTracker::slot(ThreadHistograms* thread,
+                         const void* element,
+                         const char* name) {
+  auto found = thread->slots.find(element);
+  if (found != thread->slots.end()) {
+    return found->second;
+  }
+  int index = -1;
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    for (size_t i = 0; i < names_.size(); i++) {
+      if (names_[i] == name) {
+        index = (int)i;
+      }
+    }
+    if (index < 0 && names_.size() < MAX_ELEMENTS) {
+      index = (int)names_.size();
+      names_.push_back(name);
+    }
+  }
+  thread->slots[element] = index;
+  return index;
+}
+
+void LatencyTracker::record(const void* element,
+                            const char* name,
+                            size_t objects,
+                            uint64_t ns) {
+  ThreadHistograms* thread = this_thread();
+  int index = slot(thread, element, name);
+  if (index < 0) {
+    return;
+  }
+  std::atomic<LatencyHistogram*>& cell =
+      thread->histograms[index][object_bucket(objects)];
+  LatencyHistogram* histogram = cell.load(std::memory_order_relaxed);
+  if (histogram == nullptr) {
+    histogram = new LatencyHistogram();
+    cell.store(histogram, std::memory_order_release);
+  }
+  histogram->record(ns);
+}
+
+std::string LatencyTracker::dump() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  std::string out;
+  char line[256];
+  std::vector<uint64_t> counts(LatencyHistogram::NUM_BUCKETS);
+  for (size_t index = 0; index < names_.size(); index++) {
+    for (size_t bucket = 0; bucket < NUM_OBJECT_BUCKETS; bucket++) {
+      std::fill(counts.begin(), counts.end(), 0);
+      for (const auto& thread : threads_) {
+        const LatencyHistogram* histogram =
+            thread->histograms[index][bucket].load(std::memory_order_acquire);
+        if (histogram != nullptr) {
+          histogram->add_to(&counts);
+        }
+      }
+      uint64_t total = 0;
+      for (uint64_t count : counts) {
+        total += count;
+      }
+      if (total == 0) {
+        continue;
+      }
+      snprintf(line, sizeof(line),
+               "%s objects=%s n=%" PRIu64
+               " p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus\n",
+               names_[index].c_str(), object_bucket_name(bucket), total,
+               LatencyHistogram::quantile(counts, 0.5) / 1e3,
+               LatencyHistogram::quantile(counts, 0.9) / 1e3,
+               LatencyHistogram::quantile(counts, 0.99) / 1e3,
+               LatencyHistogram::quantile(counts, 0.999) / 1e3,
+               LatencyHistogram::quantile(counts, 1.0) / 1e3);
+      out += line;
+    }
+  }
+  return out;
+}
+
+/** upper bounds of the object buckets */
+static const size_t OBJECT_BUCKET_MAX[] = {0, 10, 50, 100, 250, 500};
+static const char* const OBJECT_BUCKET_NAMES[] = {
+    "0", "1-10", "11-50", "51-100", "101-250", "251-500", "501+",
+};
+
+size_t LatencyTracker::object_bucket(size_t objects) {
+  size_t bucket = 0;
+  while (bucket < NUM_OBJECT_BUCKETS - 1 &&
+         objects > OBJECT_BUCKET_MAX[bucket]) {
+    bucket++;
+  }
+  return bucket;
+}
+
+const char* LatencyTracker::object_bucket_name(size_t bucket) {
+  return OBJECT_BUCKET_NAMES[bucket];
+}
+
+}  // namespace ds
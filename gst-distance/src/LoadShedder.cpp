@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "LoadShedder.hpp"
+
+namespace ds {
+
+LoadShedder::LoadShedder() : level_(0), late_(0), on_time_(0), count_(0) {}
+
+bool LoadShedder::on_qos(double proportion, int64_t diff) {
+  std::lock_guard<std::mutex> guard(lock_);
+  unsigned level = level_.load(std::memory_order_relaxed);
+  if (diff > 0) {
+    on_time_ = 0;
+    if (++late_ >= ESCALATE_AFTER && level < MAX_LEVEL) {
+      late_ = 0;
+      level_.store(level + 1, std::memory_order_relaxed);
+      return true;
+    }
+  } else if (proportion <= 1.0) {
+    late_ = 0;
+    if (++on_time_ >= RECOVER_AFTER && level > 0) {
+      on_time_ = 0;
+      level_.store(level - 1, std::memory_order_relaxed);
+      return true;
+    }
+  } else {
+    // on time, but only just keeping up
+    late_ = 0;
+    on_time_ = 0;
+  }
+  return false;
+}
+
+bool LoadShedder::should_process() {
+  unsigned level = level_.load(std::memory_order_relaxed);
+  if (level == 0) {
+    return true;
+  }
+  return (count_++ & ((1u << level) - 1)) == 0;
+}
+
+void LoadShedder::reset() {
+  std::lock_guard<std::mutex> guard(lock_);
+  level_.store(0, std::memory_order_relaxed);
+  late_ = 0;
+  on_time_ = 0;
+  count_ = 0;
+}
+
+}  // namespace ds
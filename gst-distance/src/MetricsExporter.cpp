@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "MetricsExporter.hpp"
+
+#include <gst/gst.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <utility>
+
+GST_DEBUG_CATEGORY_STATIC(ds_metrics_exporter_debug);
+#define GST_CAT_DEFAULT ds_metrics_exporter_debug
+
+namespace ds {
+
+/** how often the socket thread checks whether it should stop */
+static const int POLL_INTERVAL_MS = 100;
+/** nice value of the exporter thread */
+static const int EXPORTER_NICENESS = 19;
+
+static void init_debug_category() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    GST_DEBUG_CATEGORY_INIT(ds_metrics_exporter_debug, "dsmetricsexporter",
+                            0, "prometheus metrics exporter");
+  });
+}
+
+MetricsExporter::MetricsExporter(MetricsRegistry* registry, Options options)
+    : registry_(registry),
+      options_(std::move(options)),
+      listen_fd_(-1),
+      running_(false) {
+  init_debug_category();
+}
+
+MetricsExporter::~MetricsExporter() {
+  stop();
+}
+
+bool MetricsExporter::start() {
+  if (options_.mode == MODE_SOCKET) {
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (options_.path.size() >= sizeof(addr.sun_path)) {
+      GST_ERROR("socket path too long: %s", options_.path.c_str());
+      return false;
+    }
+    strncpy(addr.sun_path, options_.path.c_str(), sizeof(addr.sun_path) - 1);
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+      GST_ERROR("could not create a socket: %s", strerror(errno));
+      return false;
+    }
+    // a socket left behind by a previous process
+    unlink(options_.path.c_str());
+    if (bind(listen_fd_, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+        listen(listen_fd_, 8) != 0) {
+      GST_ERROR("could not listen on %s: %s", options_.path.c_str(),
+                strerror(errno));
+      close(listen_fd_);
+      listen_fd_ = -1;
+      return false;
+    }
+  }
+  GST_INFO("exporting metrics to %s", options_.path.c_str());
+  running_ = true;
+  thread_ = std::thread(&MetricsExporter::run, this);
+  return true;
+}
+
+void MetricsExporter::stop() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    running_ = false;
+  }
+  cond_.notify_one();
+  if (thread_.joinable()) {
+    thread_.join();
+  }
+  if (listen_fd_ >= 0) {
+    close(listen_fd_);
+    listen_fd_ = -1;
+    unlink(options_.path.c_str());
+  }
+}
+
+void MetricsExporter::run() {
+  // this thread's nice value only, never the streaming threads'
+  if (setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid),
+                  EXPORTER_NICENESS) != 0) {
+    GST_DEBUG("could not lower exporter priority: %s", strerror(errno));
+  }
+
+  std::unique_lock<std::mutex> guard(lock_);
+  while (running_) {
+    guard.unlock();
+    if (options_.mode == MODE_FILE) {
+      write_file();
+    } else {
+      pollfd fd = {listen_fd_, POLLIN, 0};
+      if (poll(&fd, 1, POLL_INTERVAL_MS) > 0) {
+        int client = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client >= 0) {
+          serve(client);
+          close(client);
+        }
+      }
+    }
+    guard.lock();
+    if (options_.mode == MODE_FILE) {
+      cond_.wait_for(guard, std::chrono::milliseconds(options_.interval_ms),
+                     [this] { return !running_; });
+    }
+  }
+  guard.unlock();
+
+  // leave the final counts behind
+  if (options_.mode == MODE_FILE) {
+    write_file();
+  }
+}
+
+void MetricsExporter::write_file() {
+  // written aside and renamed, so a reader never sees a partial file
+  std::string tmp = options_.path + ".tmp";
+  std::string text = registry_->scrape();
+  FILE* file = fopen(tmp.c_str(), "w");
+  if (file == nullptr) {
+    GST_WARNING("could not open %s: %s", tmp.c_str(), strerror(errno));
+    return;
+  }
+  bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+  ok = fclose(file) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), options_.path.c_str()) != 0) {
+    GST_WARNING("could not write %s: %s", options_.path.c_str(),
+                strerror(errno));
+    unlink(tmp.c_str());
+  }
+}
+
+void MetricsExporter::serve(int client) {
+  std::string text = registry_->scrape();
+  size_t sent = 0;
+  while (sent < text.size()) {
+    ssize_t n =
+        send(client, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      GST_DEBUG("scrape client went away: %s", strerror(errno));
+      return;
+    }
+    sent += (size_t)n;
+  }
+}
+
+}  // namespace ds
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "MetricsRegistry.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+namespace ds {
+
+MetricsRegistry& MetricsRegistry::instance() {
+  // never destroyed, so elements finalized at exit can still remove
+  // themselves
+  static MetricsRegistry* registry = new MetricsRegistry();
+  return *registry;
+}
+
+void MetricsRegistry::add(const void* key, Collector collector) {
+  std::lock_guard<std::mutex> guard(lock_);
+  collectors_.emplace_back(key, std::move(collector));
+}
+
+void MetricsRegistry::remove(const void* key) {
+  std::lock_guard<std::mutex> guard(lock_);
+  collectors_.erase(
+      std::remove_if(collectors_.begin(), collectors_.end(),
+                     [key](const std::pair<const void*, Collector>& entry) {
+                       return entry.first == key;
+                     }),
+      collectors_.end());
+}
+
+std::vector<MetricsSample> MetricsRegistry::collect() const {
+  std::vector<MetricsSample> samples;
+  // held while collecting, so remove() waits for a running collector
+  std::lock_guard<std::mutex> guard(lock_);
+  samples.reserve(collectors_.size());
+  for (const auto& entry : collectors_) {
+    MetricsSample sample = {};
+    entry.second(&sample);
+    samples.push_back(std::move(sample));
+  }
+  return samples;
+}
+
+/** `ns` as decimal seconds, without trailing zeros */
+static std::string seconds(uint64_t ns) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%" PRIu64 ".%09" PRIu64, ns / 1000000000,
+           ns % 1000000000);
+  std::string str(buf);
+  str.erase(str.find_last_not_of('0') + 1);
+  if (str.back() == '.') {
+    str.pop_back();
+  }
+  return str;
+}
+
+/** the label set for `sample`, with any `extra` label appended */
+static std::string labels(const MetricsSample& sample,
+                          const std::string& extra = std::string()) {
+  std::string str = "{element=\"";
+  // label values escape backslash, double quote and newline
+  for (char c : sample.element) {
+    switch (c) {
+      case '\\':
+        str += "\\\\";
+        break;
+      case '"':
+        str += "\\\"";
+        break;
+      case '\n':
+        str += "\\n";
+        break;
+      default:
+        str += c;
+        break;
+    }
+  }
+  str += "\",kind=\"" + sample.kind + "\"";
+  if (!extra.empty()) {
+    str += "," + extra;
+  }
+  return str + "}";
+}
+
+static void family(std::string* out,
+                   const char* name,
+                   const char* type,
+                   const char* help) {
+  *out += std::string("# HELP ") + name + " " + help + "\n";
+  *out += std::string("# TYPE ") + name + " " + type + "\n";
+}
+
+static void line(std::string* out,
+                 const std::string& name,
+                 const std::string& labels,
+                 const std::string& value) {
+  *out += name + labels + " " + value + "\n";
+}
+
+static void counter(std::string* out,
+                    const std::vector<MetricsSample>& samples,
+                    const char* name,
+                    const char* help,
+                    uint64_t ElementStats::Snapshot::*field) {
+  family(out, name, "counter", help);
+  for (const auto& sample : samples) {
+    line(out, name, labels(sample), std::to_string(sample.stats.*field));
+  }
+}
+
+std::string MetricsRegistry::format(const std::vector<MetricsSample>& samples) {
+  std::string out;
+
+  counter(&out, samples, "gstdistance_buffers_total",
+          "Buffers processed.", &ElementStats::Snapshot::buffers);
+  counter(&out, samples, "gstdistance_objects_total",
+          "Objects in processed buffers (rate() for objects per second).",
+          &ElementStats::Snapshot::objects);
+  counter(&out, samples, "gstdistance_pairs_total",
+          "Object pairs whose distance was evaluated.",
+          &ElementStats::Snapshot::pairs);
+  counter(&out, samples, "gstdistance_bytes_serialized_total",
+          "Bytes of payload encoded.",
+          &ElementStats::Snapshot::bytes_serialized);
+  counter(&out, samples, "gstdistance_bytes_written_total",
+          "Bytes handed to the kernel by file outputs.",
+          &ElementStats::Snapshot::bytes_written);
+
+  const char* histogram = "gstdistance_buffer_duration_seconds";
+  family(&out, histogram, "histogram", "Time spent processing a buffer.");
+  for (const auto& sample : samples) {
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < ElementStats::NUM_BUCKETS; i++) {
+      cumulative += sample.stats.time_buckets[i];
+      std::string le = i < ElementStats::NUM_BUCKETS - 1
+                           ? seconds(ElementStats::BUCKET_BOUNDS[i])
+                           : std::string("+Inf");
+      line(&out, std::string(histogram) + "_bucket",
+           labels(sample, "le=\"" + le + "\""), std::to_string(cumulative));
+    }
+    line(&out, std::string(histogram) + "_sum", labels(sample),
+         seconds(sample.stats.total_time));
+    line(&out, std::string(histogram) + "_count", labels(sample),
+         std::to_string(cumulative));
+  }
+
+  family(&out, "gstdistance_buffer_duration_max_seconds", "gauge",
+         "Longest time spent processing a buffer.");
+  for (const auto& sample : samples) {
+    line(&out, "gstdistance_buffer_duration_max_seconds", labels(sample),
+         seconds(sample.stats.max_time));
+  }
+
+  family(&out, "gstdistance_queue_depth", "gauge",
+         "Records waiting for the writers.");
+  for (const auto& sample : samples) {
+    if (sample.has_queue) {
+      line(&out, "gstdistance_queue_depth", labels(sample),
+           std::to_string(sample.queue_depth));
+    }
+  }
+
+  family(&out, "gstdistance_dropped_total", "counter",
+         "Records dropped because a writer queue was full.");
+  for (const auto& sample : samples) {
+    if (sample.has_queue) {
+      line(&out, "gstdistance_dropped_total", labels(sample),
+           std::to_string(sample.dropped));
+    }
+  }
+
+  return out;
+}
+
+}  // namespace ds
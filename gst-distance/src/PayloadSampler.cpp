@@ -0,0 +1,97 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "PayloadSampler.hpp"
+
+#include <distance.pb.h>
+
+#include <algorithm>
+
+namespace ds {
+
+static const double NS_PER_SECOND = 1e9;
+
+/* nothing to emit for a forgotten source */
+static void forget(uint32_t, uint64_t*) {}
+
+PayloadSampler::PayloadSampler(Policy policy,
+                               double max_rate,
+                               SourceTableLimits limits)
+    : policy_(policy),
+      interval_((uint64_t)std::max(
+          NS_PER_SECOND / std::max(max_rate, 1.0 / NS_PER_SECOND), 1.0)),
+      last_slot_(limits),
+      emitted_(0),
+      skipped_(0) {}
+
+bool PayloadSampler::keep(const dp::Frame& frame) {
+  if (policy_ == POLICY_ADAPTIVE) {
+    for (const auto& person : frame.people()) {
+      if (person.is_danger()) {
+        return true;
+      }
+    }
+  }
+  // slot + 1, so a first frame at pts 0 is never taken for a repeat
+  uint64_t slot = (uint64_t)frame.pts() / interval_ + 1;
+  bool added = false;
+  uint64_t* last_slot =
+      last_slot_.get(frame.source_id(), (uint64_t)frame.pts(), &added, forget);
+  // any other slot is kept, even an earlier one (eg. after a seek)
+  if (!added && slot == *last_slot) {
+    return false;
+  }
+  *last_slot = slot;
+  return true;
+}
+
+void PayloadSampler::remove_source(uint32_t source_id) {
+  last_slot_.remove(source_id, forget);
+}
+
+bool PayloadSampler::sample(dp::Batch* batch) {
+  if (policy_ == POLICY_NONE) {
+    emitted_++;
+    return true;
+  }
+  auto* frames = batch->mutable_frames();
+  int kept = 0;
+  for (int i = 0; i < frames->size(); i++) {
+    if (!keep(frames->Get(i))) {
+      continue;
+    }
+    if (i != kept) {
+      frames->SwapElements(i, kept);
+    }
+    kept++;
+  }
+  // RemoveLast keeps the cleared frames around for reuse
+  while (frames->size() > kept) {
+    frames->RemoveLast();
+  }
+  if (kept == 0) {
+    skipped_++;
+    return false;
+  }
+  emitted_++;
+  return true;
+}
+
+}  // namespace ds
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "RecordArrayBroker.hpp"
+
+#include <distance.pb.h>
+
+#include <cstring>
+#include <utility>
+
+namespace ds {
+
+RecordArrayBroker::RecordArrayBroker()
+    : records_(nullptr), bytes_serialized_(0) {}
+
+RecordArrayBroker::~RecordArrayBroker() {
+  if (records_ != nullptr) {
+    g_bytes_unref(records_);
+  }
+}
+
+GBytes* RecordArrayBroker::encode(const dp::Batch& batch) {
+  size_t count = 0;
+  for (const auto& frame : batch.frames()) {
+    count += (size_t)frame.people_size();
+  }
+  // g_bytes_new_take() wants a g_malloc'd buffer (or nullptr when empty)
+  PersonRecord* records = g_new(PersonRecord, count);
+  PersonRecord* record = records;
+  for (const auto& frame : batch.frames()) {
+    for (const auto& person : frame.people()) {
+      record->pts = (uint64_t)frame.pts();
+      record->frame_num = (uint64_t)frame.frame_num();
+      record->uid = (uint64_t)person.uid();
+      record->source_id = (uint32_t)frame.source_id();
+      record->danger_val = person.danger_val();
+      record->left = person.bbox().left();
+      record->top = person.bbox().top();
+      record->width = person.bbox().width();
+      record->height = person.bbox().height();
+      record->is_danger = person.is_danger();
+      memset(record->reserved, 0, sizeof(record->reserved));
+      record++;
+    }
+  }
+  return g_bytes_new_take(records, count * sizeof(PersonRecord));
+}
+
+bool RecordArrayBroker::on_batch_payload(NvDsBatchMeta* batch_meta,
+                                         dp::Batch* batch) {
+  (void)batch_meta;
+  if (batch == nullptr) {
+    return true;
+  }
+  GBytes* records = encode(*batch);
+  bytes_serialized_.fetch_add(g_bytes_get_size(records),
+                              std::memory_order_relaxed);
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    std::swap(records, records_);
+  }
+  // the old array lives on in any reader still holding it
+  if (records != nullptr) {
+    g_bytes_unref(records);
+  }
+  return true;
+}
+
+GBytes* RecordArrayBroker::get_records() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return records_ == nullptr ? nullptr : g_bytes_ref(records_);
+}
+
+}  // namespace ds
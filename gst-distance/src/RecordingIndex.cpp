@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "RecordingIndex.hpp"
+
+#include <gst/gst.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+GST_DEBUG_CATEGORY_STATIC(ds_recording_index_debug);
+#define GST_CAT_DEFAULT ds_recording_index_debug
+
+namespace ds {
+namespace recording {
+
+static bool write_all(int fd, const void* data, size_t len) {
+  const char* p = (const char*)data;
+  while (len) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return true;
+}
+
+IndexWriter::IndexWriter() : fd_(-1), max_pts_(0) {
+  GST_DEBUG_CATEGORY_INIT(ds_recording_index_debug, "dsrecordingindex", 0,
+                          "recording index writer");
+}
+
+IndexWriter::~IndexWriter() {
+  on_close();
+}
+
+void IndexWriter::on_open(const std::string& path) {
+  on_close();
+  std::string idx = index_path(path);
+  fd_ = open(idx.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0) {
+    GST_WARNING("could not open index %s: %s", idx.c_str(), strerror(errno));
+    return;
+  }
+  IndexHeader header;
+  memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+  header.version = INDEX_VERSION;
+  header.entry_size = sizeof(IndexEntry);
+  if (!write_all(fd_, &header, sizeof(header))) {
+    GST_WARNING("could not write index header: %s", strerror(errno));
+  }
+  max_pts_ = 0;
+  pending_.clear();
+}
+
+void IndexWriter::on_record(uint64_t offset,
+                            size_t length,
+                            const std::string& meta) {
+  size_t count = meta.size() / sizeof(IndexKey);
+  for (size_t i = 0; i < count; i++) {
+    IndexKey key;
+    memcpy(&key, meta.data() + i * sizeof(IndexKey), sizeof(key));
+    max_pts_ = std::max(max_pts_, key.pts);
+    IndexEntry entry;
+    entry.pts = key.pts;
+    entry.max_pts = max_pts_;
+    entry.offset = offset;
+    entry.frame_num = key.frame_num;
+    entry.source_id = key.source_id;
+    entry.length = (uint32_t)length;
+    pending_.push_back(entry);
+  }
+}
+
+void IndexWriter::on_flush(uint64_t durable) {
+  size_t count = 0;
+  while (count < pending_.size() &&
+         pending_[count].offset + pending_[count].length <= durable) {
+    count++;
+  }
+  write_entries(count);
+}
+
+void IndexWriter::on_close() {
+  write_entries(pending_.size());
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+}
+
+void IndexWriter::write_entries(size_t count) {
+  if (count == 0) {
+    return;
+  }
+  if (fd_ >= 0 &&
+      !write_all(fd_, pending_.data(), count * sizeof(IndexEntry))) {
+    GST_WARNING("could not write index entries: %s", strerror(errno));
+  }
+  pending_.erase(pending_.begin(), pending_.begin() + count);
+}
+
+}  // namespace recording
+}  // namespace ds
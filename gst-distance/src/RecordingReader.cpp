@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "RecordingReader.hpp"
+
+#include <distance.pb.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace ds {
+namespace recording {
+
+std::string index_path(const std::string& data_path) {
+  size_t slash = data_path.rfind('/');
+  size_t dot = data_path.rfind('.');
+  if (dot == std::string::npos ||
+      (slash != std::string::npos && dot < slash)) {
+    return data_path + INDEX_EXTENSION;
+  }
+  return data_path.substr(0, dot) + INDEX_EXTENSION;
+}
+
+size_t read_length_prefix(const uint8_t* p, size_t avail, uint32_t* length) {
+  uint32_t result = 0;
+  for (size_t i = 0; i < 5 && i < avail; i++) {
+    result |= (uint32_t)(p[i] & 0x7F) << (7 * i);
+    if (!(p[i] & 0x80)) {
+      *length = result;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+bool is_sync_marker(const uint8_t* p, size_t avail) {
+  return avail >= SYNC_MARKER_SIZE &&
+         memcmp(p, SYNC_MARKER, SYNC_MARKER_SIZE) == 0;
+}
+
+const void* map_file(const std::string& path, size_t* size) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  void* map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size > 0) {
+    map = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    return nullptr;
+  }
+  *size = (size_t)st.st_size;
+  return map;
+}
+
+RecordingReader::RecordingReader()
+    : data_(nullptr),
+      size_(0),
+      entries_(nullptr),
+      num_entries_(0),
+      index_map_(nullptr),
+      index_map_size_(0),
+      position_(0) {}
+
+RecordingReader::~RecordingReader() {
+  close();
+}
+
+bool RecordingReader::open(const std::string& data_path) {
+  close();
+  data_ = (const uint8_t*)map_file(data_path, &size_);
+  if (data_ == nullptr) {
+    return false;
+  }
+  madvise((void*)data_, size_, MADV_SEQUENTIAL);
+
+  index_map_ = map_file(index_path(data_path), &index_map_size_);
+  if (index_map_ != nullptr) {
+    const IndexHeader* header = (const IndexHeader*)index_map_;
+    if (index_map_size_ < sizeof(IndexHeader) ||
+        memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+        header->entry_size != sizeof(IndexEntry)) {
+      munmap((void*)index_map_, index_map_size_);
+      index_map_ = nullptr;
+      index_map_size_ = 0;
+    } else {
+      entries_ = (const IndexEntry*)((const char*)index_map_ +
+                                     sizeof(IndexHeader));
+      num_entries_ =
+          (index_map_size_ - sizeof(IndexHeader)) / sizeof(IndexEntry);
+      // an index written by a live writer may run ahead of a copied data
+      // file; never hand out offsets past the end
+      while (num_entries_ && entries_[num_entries_ - 1].offset +
+                                     entries_[num_entries_ - 1].length >
+                                 size_) {
+        num_entries_--;
+      }
+    }
+  }
+  position_ = 0;
+  return true;
+}
+
+void RecordingReader::close() {
+  if (data_ != nullptr) {
+    munmap((void*)data_, size_);
+  }
+  if (index_map_ != nullptr) {
+    munmap((void*)index_map_, index_map_size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  entries_ = nullptr;
+  num_entries_ = 0;
+  index_map_ = nullptr;
+  index_map_size_ = 0;
+  position_ = 0;
+}
+
+void RecordingReader::seek(uint64_t pts) {
+  if (has_index()) {
+    const IndexEntry* end = entries_ + num_entries_;
+    const IndexEntry* found = std::lower_bound(
+        entries_, end, pts, [](const IndexEntry& entry, uint64_t value) {
+          return entry.max_pts < value;
+        });
+    position_ = found == end ? size_ : found->offset;
+    return;
+  }
+
+  position_ = 0;
+  dp::Batch batch;
+  for (;;) {
+    uint64_t start = position_;
+    if (!next(&batch)) {
+      return;
+    }
+    for (const auto& frame : batch.frames()) {
+      if ((uint64_t)frame.pts() >= pts) {
+        position_ = start;
+        return;
+      }
+    }
+  }
+}
+
+bool RecordingReader::next(const uint8_t** data, size_t* len) {
+  while (position_ < size_) {
+    const uint8_t* p = data_ + position_;
+    size_t avail = size_ - position_;
+    if (is_sync_marker(p, avail)) {
+      position_ += SYNC_MARKER_SIZE;
+      continue;
+    }
+    uint32_t length = 0;
+    size_t prefix = read_length_prefix(p, avail, &length);
+    if (prefix == 0 || avail - prefix < length) {
+      // truncated tail (eg. a recording still being written)
+      return false;
+    }
+    *data = p + prefix;
+    *len = length;
+    position_ += prefix + length;
+    return true;
+  }
+  return false;
+}
+
+bool RecordingReader::next(dp::Batch* batch) {
+  const uint8_t* data = nullptr;
+  size_t len = 0;
+  if (!next(&data, &len)) {
+    return false;
+  }
+  return batch->ParseFromArray(data, (int)len);
+}
+
+}  // namespace recording
+}  // namespace ds
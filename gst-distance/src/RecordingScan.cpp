@@ -0,0 +1,402 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "RecordingScan.hpp"
+
+#include <distance.pb.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+namespace ds {
+namespace recording {
+
+/* protobuf wire types */
+enum WireType {
+  WIRE_VARINT = 0,
+  WIRE_FIXED64 = 1,
+  WIRE_LENGTH_DELIMITED = 2,
+  WIRE_FIXED32 = 5,
+};
+
+/**
+ * Minimal protobuf wire reader. Field numbers come from the generated code
+ * (k*FieldNumber) so this stays in step with libdistanceproto.
+ */
+struct Field {
+  uint32_t number;
+  uint32_t type;
+  uint64_t value;
+  const uint8_t* data;
+  size_t len;
+
+  uint64_t as_uint() const { return value; }
+
+  float as_float() const {
+    switch (type) {
+      case WIRE_FIXED32: {
+        float f;
+        uint32_t bits = (uint32_t)value;
+        memcpy(&f, &bits, sizeof(f));
+        return f;
+      }
+      case WIRE_FIXED64: {
+        double d;
+        memcpy(&d, &value, sizeof(d));
+        return (float)d;
+      }
+      default:
+        return (float)value;
+    }
+  }
+};
+
+class WireReader {
+ public:
+  WireReader(const uint8_t* begin, const uint8_t* end) : p_(begin), end_(end) {}
+
+  bool done() const { return p_ >= end_; }
+
+  bool next(Field* field) {
+    uint64_t tag;
+    if (!varint(&tag)) {
+      return false;
+    }
+    field->number = (uint32_t)(tag >> 3);
+    field->type = (uint32_t)(tag & 7);
+    field->data = nullptr;
+    field->len = 0;
+    field->value = 0;
+    switch (field->type) {
+      case WIRE_VARINT:
+        return varint(&field->value);
+      case WIRE_FIXED64:
+        return fixed(&field->value, 8);
+      case WIRE_FIXED32:
+        return fixed(&field->value, 4);
+      case WIRE_LENGTH_DELIMITED: {
+        uint64_t len;
+        if (!varint(&len) || len > (uint64_t)(end_ - p_)) {
+          return false;
+        }
+        field->data = p_;
+        field->len = (size_t)len;
+        p_ += len;
+        return true;
+      }
+      default:
+        // groups are not used by libdistanceproto
+        return false;
+    }
+  }
+
+ private:
+  bool varint(uint64_t* value) {
+    uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64 && p_ < end_; shift += 7) {
+      uint8_t byte = *p_++;
+      result |= (uint64_t)(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool fixed(uint64_t* value, size_t size) {
+    if ((size_t)(end_ - p_) < size) {
+      return false;
+    }
+    uint64_t result = 0;
+    memcpy(&result, p_, size);
+    p_ += size;
+    *value = result;
+    return true;
+  }
+
+  const uint8_t* p_;
+  const uint8_t* end_;
+};
+
+static bool parse_bbox(const Field& field, PersonView* person) {
+  WireReader reader(field.data, field.data + field.len);
+  Field f;
+  while (!reader.done()) {
+    if (!reader.next(&f)) {
+      return false;
+    }
+    switch (f.number) {
+      case dp::BBox::kLeftFieldNumber:
+        person->left = f.as_float();
+        break;
+      case dp::BBox::kTopFieldNumber:
+        person->top = f.as_float();
+        break;
+      case dp::BBox::kWidthFieldNumber:
+        person->width = f.as_float();
+        break;
+      case dp::BBox::kHeightFieldNumber:
+        person->height = f.as_float();
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+static bool parse_person(const Field& field, bool with_bbox,
+                         PersonView* person) {
+  *person = PersonView();
+  WireReader reader(field.data, field.data + field.len);
+  Field f;
+  while (!reader.done()) {
+    if (!reader.next(&f)) {
+      return false;
+    }
+    switch (f.number) {
+      case dp::Person::kUidFieldNumber:
+        person->uid = f.as_uint();
+        break;
+      case dp::Person::kIsDangerFieldNumber:
+        person->is_danger = f.as_uint() != 0;
+        break;
+      case dp::Person::kDangerValFieldNumber:
+        person->danger_val = f.as_float();
+        break;
+      case dp::Person::kBboxFieldNumber:
+        if (with_bbox && !parse_bbox(f, person)) {
+          return false;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+static bool parse_frame(const Field& field, FrameView* frame) {
+  *frame = FrameView();
+  frame->begin = field.data;
+  frame->end = field.data + field.len;
+  WireReader reader(frame->begin, frame->end);
+  Field f;
+  PersonView person;
+  while (!reader.done()) {
+    if (!reader.next(&f)) {
+      return false;
+    }
+    switch (f.number) {
+      case dp::Frame::kPtsFieldNumber:
+        frame->pts = f.as_uint();
+        break;
+      case dp::Frame::kFrameNumFieldNumber:
+        frame->frame_num = f.as_uint();
+        break;
+      case dp::Frame::kSourceIdFieldNumber:
+        frame->source_id = (uint32_t)f.as_uint();
+        break;
+      case dp::Frame::kSumDangerFieldNumber:
+        frame->sum_danger = f.as_float();
+        break;
+      case dp::Frame::kPeopleFieldNumber:
+        if (!parse_person(f, false, &person)) {
+          return false;
+        }
+        frame->num_people++;
+        frame->num_danger += person.is_danger;
+        break;
+      default:
+        break;
+    }
+  }
+  return true;
+}
+
+bool for_each_frame(const uint8_t* batch, size_t len, FrameVisitor* visitor) {
+  WireReader reader(batch, batch + len);
+  Field f;
+  FrameView frame;
+  while (!reader.done()) {
+    if (!reader.next(&f)) {
+      return false;
+    }
+    if (f.number != dp::Batch::kFramesFieldNumber) {
+      continue;
+    }
+    if (f.type != WIRE_LENGTH_DELIMITED || !parse_frame(f, &frame)) {
+      return false;
+    }
+    visitor->on_frame(frame);
+  }
+  return true;
+}
+
+bool for_each_person(const FrameView& frame, PersonVisitor* visitor) {
+  WireReader reader(frame.begin, frame.end);
+  Field f;
+  PersonView person;
+  while (!reader.done()) {
+    if (!reader.next(&f)) {
+      return false;
+    }
+    if (f.number != dp::Frame::kPeopleFieldNumber) {
+      continue;
+    }
+    if (f.type != WIRE_LENGTH_DELIMITED || !parse_person(f, true, &person)) {
+      return false;
+    }
+    visitor->on_person(frame, person);
+  }
+  return true;
+}
+
+/* the offset of the first sync marker at or after `from`, or `size` */
+static uint64_t find_sync_marker(const uint8_t* data,
+                                 uint64_t size,
+                                 uint64_t from) {
+  if (from >= size) {
+    return size;
+  }
+  const void* found = memmem(data + from, size - from, SYNC_MARKER,
+                             SYNC_MARKER_SIZE);
+  return found == nullptr ? size : (uint64_t)((const uint8_t*)found - data);
+}
+
+std::vector<Chunk> split_chunks(const RecordingReader& reader,
+                                unsigned count,
+                                const ScanOptions& options) {
+  std::vector<uint64_t> bounds;
+  count = std::max(count, 1u);
+
+  if (reader.has_index() && reader.num_entries()) {
+    // skip everything before options.begin, then split evenly by entries
+    size_t first = 0;
+    size_t last = reader.num_entries();
+    while (first < last) {
+      size_t mid = first + (last - first) / 2;
+      if (reader.entry(mid).max_pts < options.begin) {
+        first = mid + 1;
+      } else {
+        last = mid;
+      }
+    }
+    size_t remaining = reader.num_entries() - first;
+    for (unsigned i = 0; i < count && first < reader.num_entries(); i++) {
+      bounds.push_back(reader.entry(first + remaining * i / count).offset);
+    }
+  } else if (find_sync_marker(reader.data(), reader.size(), 0) <
+             reader.size()) {
+    bounds.push_back(0);
+    for (unsigned i = 1; i < count; i++) {
+      bounds.push_back(find_sync_marker(reader.data(), reader.size(),
+                                        reader.size() * i / count));
+    }
+  } else {
+    bounds.push_back(0);
+  }
+  bounds.push_back(reader.size());
+
+  std::vector<Chunk> chunks;
+  for (size_t i = 0; i + 1 < bounds.size(); i++) {
+    if (bounds[i] < bounds[i + 1]) {
+      chunks.push_back({bounds[i], bounds[i + 1]});
+    }
+  }
+  return chunks;
+}
+
+/* forwards frames matching the options */
+class FilteringVisitor : public FrameVisitor {
+ public:
+  FilteringVisitor(const ScanOptions& options, FrameVisitor* visitor)
+      : options_(options), visitor_(visitor) {}
+
+  virtual void on_frame(const FrameView& frame) override {
+    if (frame.pts < options_.begin || frame.pts >= options_.end) {
+      return;
+    }
+    if (!options_.sources.empty() &&
+        std::find(options_.sources.begin(), options_.sources.end(),
+                  frame.source_id) == options_.sources.end()) {
+      return;
+    }
+    visitor_->on_frame(frame);
+  }
+
+ private:
+  const ScanOptions& options_;
+  FrameVisitor* visitor_;
+};
+
+bool scan_chunk(const RecordingReader& reader,
+                const Chunk& chunk,
+                const ScanOptions& options,
+                FrameVisitor* visitor) {
+  FilteringVisitor filter(options, visitor);
+  const uint8_t* data = reader.data();
+  uint64_t position = chunk.begin;
+  while (position < chunk.end) {
+    const uint8_t* p = data + position;
+    size_t avail = (size_t)(chunk.end - position);
+    if (is_sync_marker(p, avail)) {
+      position += SYNC_MARKER_SIZE;
+      continue;
+    }
+    uint32_t length = 0;
+    size_t prefix = read_length_prefix(p, avail, &length);
+    if (prefix == 0 || avail - prefix < length) {
+      // a truncated tail is normal for a live recording
+      return chunk.end == reader.size();
+    }
+    if (!for_each_frame(p + prefix, length, &filter)) {
+      return false;
+    }
+    position += prefix + length;
+  }
+  return true;
+}
+
+bool scan_parallel(const RecordingReader& reader,
+                   const ScanOptions& options,
+                   const std::vector<FrameVisitor*>& visitors) {
+  std::vector<Chunk> chunks =
+      split_chunks(reader, (unsigned)visitors.size(), options);
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> workers;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    workers.emplace_back([&reader, &options, &chunks, &visitors, &ok, i] {
+      if (!scan_chunk(reader, chunks[i], options, visitors[i])) {
+        ok = false;
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return ok;
+}
+
+}  // namespace recording
+}  // namespace ds
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "SeqlockPayloadBroker.hpp"
+
+#include <google/protobuf/util/json_util.h>
+
+#include <string>
+
+namespace ds {
+
+bool SeqlockPayloadBroker::on_batch_payload(NvDsBatchMeta* batch_meta,
+                                            dp::Batch* batch) {
+  (void)batch_meta;
+  if (!batch->SerializeToString(&buffer_)) {
+    return false;
+  }
+  slot_.write(buffer_.data(), buffer_.size());
+  bytes_serialized_.fetch_add(buffer_.size(), std::memory_order_relaxed);
+  return true;
+}
+
+gchar* SeqlockPayloadBroker::get_payload() const {
+  std::string payload;
+  if (!slot_.read(&payload)) {
+    return nullptr;
+  }
+  dp::Batch batch;
+  std::string json;
+  google::protobuf::util::JsonPrintOptions options;
+  // the same names as the csv columns
+  options.preserve_proto_field_names = true;
+  if (!batch.ParseFromString(payload) ||
+      !google::protobuf::util::MessageToJsonString(batch, &json, options)
+           .ok()) {
+    return nullptr;
+  }
+  return g_strndup(json.data(), json.size());
+}
+
+}  // namespace ds
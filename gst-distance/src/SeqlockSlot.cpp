@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "SeqlockSlot.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace ds {
+
+static const size_t MIN_CAPACITY = 256;
+
+SeqlockSlot::SeqlockSlot() : current_(-1), writes_(0), retries_(0) {
+  for (auto& buffer : buffers_) {
+    buffer.seq = 0;
+    buffer.data = nullptr;
+    buffer.size = 0;
+    buffer.capacity = 0;
+  }
+}
+
+void SeqlockSlot::write(const char* data, size_t size) {
+  int next = current_.load(std::memory_order_relaxed) == 0 ? 1 : 0;
+  Buffer& buffer = buffers_[next];
+
+  uint64_t seq = buffer.seq.load(std::memory_order_relaxed);
+  buffer.seq.store(seq + 1, std::memory_order_relaxed);
+  // the odd sequence number is visible before any of the writes below
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (size > buffer.capacity) {
+    size_t capacity = std::max({size, buffer.capacity * 2, MIN_CAPACITY});
+    allocations_.emplace_back(new char[capacity]);
+    // the old buffer stays allocated for readers still copying from it
+    buffer.data.store(allocations_.back().get(), std::memory_order_release);
+    buffer.capacity = capacity;
+  }
+  memcpy(buffer.data.load(std::memory_order_relaxed), data, size);
+  // stored after data, so a reader that sees this size sees a data pointer
+  // at least this large
+  buffer.size.store(size, std::memory_order_release);
+
+  buffer.seq.store(seq + 2, std::memory_order_release);
+  current_.store(next, std::memory_order_release);
+  writes_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SeqlockSlot::read(std::string* out) const {
+  for (;;) {
+    int current = current_.load(std::memory_order_acquire);
+    if (current < 0) {
+      return false;
+    }
+    const Buffer& buffer = buffers_[current];
+    uint64_t seq = buffer.seq.load(std::memory_order_acquire);
+    if (!(seq & 1)) {
+      size_t size = buffer.size.load(std::memory_order_acquire);
+      const char* data = buffer.data.load(std::memory_order_acquire);
+      // may be torn if the writer got back to this buffer; checked below
+      out->assign(data, size);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (buffer.seq.load(std::memory_order_relaxed) == seq) {
+        return true;
+      }
+    }
+    retries_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+}  // namespace ds
@@ -0,0 +1,364 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "SourceConfig.hpp"
+
+#include <gst/gst.h>
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
+GST_DEBUG_CATEGORY_STATIC(ds_source_config_debug);
+#define GST_CAT_DEFAULT ds_source_config_debug
+
+namespace ds {
+
+static void init_debug_category() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    GST_DEBUG_CATEGORY_INIT(ds_source_config_debug, "dssourceconfig", 0,
+                            "per source config files");
+  });
+}
+
+static std::string strip(const std::string& s) {
+  size_t first = s.find_first_not_of(" \t\r");
+  if (first == std::string::npos) {
+    return std::string();
+  }
+  size_t last = s.find_last_not_of(" \t\r");
+  return s.substr(first, last - first + 1);
+}
+
+static bool parse_uint(const std::string& s, unsigned long max,
+                       unsigned long* out) {
+  if (s.empty() || s[0] < '0' || s[0] > '9') {
+    return false;
+  }
+  char* end = nullptr;
+  errno = 0;
+  unsigned long value = strtoul(s.c_str(), &end, 10);
+  if (*end != '\0' || errno != 0 || value > max) {
+    return false;
+  }
+  *out = value;
+  return true;
+}
+
+static bool parse_bool(const std::string& s, bool* out) {
+  if (s == "true" || s == "1") {
+    *out = true;
+  } else if (s == "false" || s == "0") {
+    *out = false;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+namespace {
+
+/** a group as written, so [default] is only merged into unset keys */
+struct Group {
+  SourceSettings settings;
+  bool has_enabled = false;
+  bool has_class_id = false;
+  bool has_do_drawing = false;
+};
+
+}  // namespace
+
+std::shared_ptr<const SourceConfig> SourceConfig::parse(
+    const std::string& text,
+    std::string* error) {
+  static const char SOURCE_PREFIX[] = "source-";
+  Group defaults;
+  std::unordered_map<uint32_t, Group> sources;
+  Group* group = nullptr;
+  bool seen_default = false;
+
+  std::istringstream lines(text);
+  std::string line;
+  for (unsigned num = 1; std::getline(lines, line); num++) {
+    line = strip(line);
+    if (line.empty() || line[0] == '#' || line[0] == ';') {
+      continue;
+    }
+    std::string where = "line " + std::to_string(num) + ": ";
+
+    if (line[0] == '[') {
+      if (line.back() != ']') {
+        *error = where + "unterminated group name";
+        return nullptr;
+      }
+      std::string name = strip(line.substr(1, line.size() - 2));
+      unsigned long source_id = 0;
+      if (name == "default") {
+        if (seen_default) {
+          *error = where + "[default] appears twice";
+          return nullptr;
+        }
+        seen_default = true;
+        group = &defaults;
+      } else if (name.compare(0, sizeof(SOURCE_PREFIX) - 1, SOURCE_PREFIX) ==
+                     0 &&
+                 parse_uint(name.substr(sizeof(SOURCE_PREFIX) - 1),
+                            UINT32_MAX, &source_id)) {
+        if (sources.count((uint32_t)source_id)) {
+          *error = where + "[" + name + "] appears twice";
+          return nullptr;
+        }
+        group = &sources[(uint32_t)source_id];
+      } else {
+        *error = where + "unknown group [" + name +
+                 "] (expected [default] or [source-N])";
+        return nullptr;
+      }
+      continue;
+    }
+
+    size_t equals = line.find('=');
+    if (equals == std::string::npos) {
+      *error = where + "expected key=value";
+      return nullptr;
+    }
+    if (group == nullptr) {
+      *error = where + "key outside of a group";
+      return nullptr;
+    }
+    std::string key = strip(line.substr(0, equals));
+    std::string value = strip(line.substr(equals + 1));
+    bool ok = true;
+    if (key == "enabled") {
+      ok = parse_bool(value, &group->settings.enabled);
+      group->has_enabled = true;
+    } else if (key == "do-drawing") {
+      bool do_drawing = false;
+      ok = parse_bool(value, &do_drawing);
+      group->settings.do_drawing = do_drawing ? 1 : 0;
+      group->has_do_drawing = true;
+    } else if (key == "class-id") {
+      unsigned long class_id = 0;
+      ok = parse_uint(value, MAX_CLASS_ID, &class_id);
+      group->settings.class_id = (int)class_id;
+      group->has_class_id = true;
+    } else {
+      *error = where + "unknown key " + key +
+               " (expected enabled, class-id or do-drawing)";
+      return nullptr;
+    }
+    if (!ok) {
+      *error = where + "bad value for " + key + ": " + value;
+      return nullptr;
+    }
+  }
+
+  auto config = std::make_shared<SourceConfig>();
+  config->defaults_ = defaults.settings;
+  for (const auto& source : sources) {
+    const Group& g = source.second;
+    SourceSettings merged = defaults.settings;
+    if (g.has_enabled) {
+      merged.enabled = g.settings.enabled;
+    }
+    if (g.has_class_id) {
+      merged.class_id = g.settings.class_id;
+    }
+    if (g.has_do_drawing) {
+      merged.do_drawing = g.settings.do_drawing;
+    }
+    config->sources_[source.first] = merged;
+  }
+  return config;
+}
+
+std::shared_ptr<const SourceConfig> SourceConfig::load(
+    const std::string& path,
+    std::string* error) {
+  std::ifstream file(path);
+  if (!file) {
+    *error = path + ": " + strerror(errno);
+    return nullptr;
+  }
+  std::ostringstream text;
+  text << file.rdbuf();
+  auto config = parse(text.str(), error);
+  if (config == nullptr) {
+    *error = path + ": " + *error;
+  }
+  return config;
+}
+
+const SourceSettings& SourceConfig::settings(uint32_t source_id) const {
+  auto found = sources_.find(source_id);
+  return found == sources_.end() ? defaults_ : found->second;
+}
+
+SourceConfigWatcher::SourceConfigWatcher()
+    : reloads_(0), watching_(false), stop_fd_(-1) {
+  init_debug_category();
+}
+
+SourceConfigWatcher::~SourceConfigWatcher() {
+  stop();
+}
+
+bool SourceConfigWatcher::set_path(const std::string& path,
+                                   std::string* error) {
+  std::lock_guard<std::mutex> control(control_lock_);
+  stop_thread();
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    path_ = path;
+  }
+  std::shared_ptr<const SourceConfig> config;
+  if (!path.empty()) {
+    config = SourceConfig::load(path, error);
+  }
+  std::atomic_store(&config_, config);
+  if (watching_) {
+    start_thread();
+  }
+  return path.empty() || config != nullptr;
+}
+
+std::string SourceConfigWatcher::path() const {
+  std::lock_guard<std::mutex> guard(lock_);
+  return path_;
+}
+
+bool SourceConfigWatcher::start() {
+  std::lock_guard<std::mutex> control(control_lock_);
+  watching_ = true;
+  return start_thread();
+}
+
+void SourceConfigWatcher::stop() {
+  std::lock_guard<std::mutex> control(control_lock_);
+  watching_ = false;
+  stop_thread();
+}
+
+bool SourceConfigWatcher::start_thread() {
+  std::string path = this->path();
+  if (path.empty() || thread_.joinable()) {
+    return true;
+  }
+  size_t slash = path.find_last_of('/');
+  std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+  if (dir.empty()) {
+    dir = "/";
+  }
+  int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (fd < 0) {
+    GST_ERROR("could not create an inotify instance: %s", strerror(errno));
+    return false;
+  }
+  // the directory, so a file replaced by a rename is still followed
+  if (inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+    GST_ERROR("could not watch %s: %s", dir.c_str(), strerror(errno));
+    close(fd);
+    return false;
+  }
+  stop_fd_ = eventfd(0, EFD_CLOEXEC);
+  if (stop_fd_ < 0) {
+    GST_ERROR("could not create an eventfd: %s", strerror(errno));
+    close(fd);
+    return false;
+  }
+  GST_INFO("watching %s", path.c_str());
+  thread_ = std::thread(&SourceConfigWatcher::run, this, fd);
+  return true;
+}
+
+void SourceConfigWatcher::stop_thread() {
+  if (thread_.joinable()) {
+    uint64_t one = 1;
+    if (write(stop_fd_, &one, sizeof(one)) != sizeof(one)) {
+      GST_ERROR("could not wake the watch thread: %s", strerror(errno));
+    }
+    thread_.join();
+  }
+  if (stop_fd_ >= 0) {
+    close(stop_fd_);
+    stop_fd_ = -1;
+  }
+}
+
+void SourceConfigWatcher::run(int fd) {
+  std::string path = this->path();
+  size_t slash = path.find_last_of('/');
+  std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+  alignas(inotify_event) char buf[4096];
+
+  for (;;) {
+    // asleep until the directory changes or stop_thread() says so
+    pollfd fds[] = {{fd, POLLIN, 0}, {stop_fd_, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      GST_ERROR("could not wait for inotify events: %s", strerror(errno));
+      break;
+    }
+    if (fds[1].revents) {
+      break;
+    }
+    bool changed = false;
+    ssize_t len;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+      for (ssize_t i = 0; i < len;) {
+        auto* event = (const inotify_event*)&buf[i];
+        if (event->len && name == event->name) {
+          changed = true;
+        }
+        i += (ssize_t)(sizeof(inotify_event) + event->len);
+      }
+    }
+    // one parse however many events a save made
+    if (changed) {
+      reload();
+    }
+  }
+  close(fd);
+}
+
+void SourceConfigWatcher::reload() {
+  std::string path = this->path();
+  std::string error;
+  auto config = SourceConfig::load(path, &error);
+  if (config == nullptr) {
+    GST_WARNING("keeping the previous config: %s", error.c_str());
+    return;
+  }
+  std::atomic_store(&config_, config);
+  reloads_++;
+  GST_INFO("reloaded %s (%zu sources)", path.c_str(), config->size());
+}
+
+}  // namespace ds
@@ -0,0 +1,339 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "UringFileWriter.hpp"
+
+#include <gst/gst.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <utility>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC(ds_uring_file_writer_debug);
+#define GST_CAT_DEFAULT ds_uring_file_writer_debug
+
+namespace ds {
+
+/** number of chunk buffers registered with the ring */
+static const unsigned NUM_BUFFERS = 8;
+/** number of prepared writes to collect before io_uring_submit */
+static const unsigned SUBMIT_BATCH = 4;
+
+struct UringFileWriter::Ring {
+#ifdef HAVE_LIBURING
+  struct io_uring ring;
+#endif
+  bool registered = false;
+  std::vector<size_t> lengths;
+  std::vector<uint64_t> offsets;
+};
+
+/* write whatever the kernel didn't, synchronously */
+static bool pwrite_all(int fd, const char* data, size_t len, uint64_t offset) {
+  while (len) {
+    ssize_t n = pwrite(fd, data, len, (off_t)offset);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += n;
+    len -= (size_t)n;
+    offset += (uint64_t)n;
+  }
+  return true;
+}
+
+UringFileWriter::UringFileWriter(Options options)
+    : AsyncFileWriter(std::move(options)),
+      ring_(nullptr),
+      num_in_flight_(0),
+      num_pending_(0),
+      offset_(0),
+      failed_(false) {
+  GST_DEBUG_CATEGORY_INIT(ds_uring_file_writer_debug, "dsuringfilewriter", 0,
+                          "io_uring file writer");
+}
+
+UringFileWriter::~UringFileWriter() {
+  // the base destructor can't reach our overrides
+  stop();
+}
+
+bool UringFileWriter::supported() {
+#ifdef HAVE_LIBURING
+  static bool result = false;
+  static std::once_flag once;
+  std::call_once(once, [] {
+    // seccomp profiles (eg. docker's default) may refuse io_uring_setup
+    struct io_uring probe;
+    if (io_uring_queue_init(4, &probe, 0) == 0) {
+      io_uring_queue_exit(&probe);
+      result = true;
+    }
+  });
+  return result;
+#else
+  return false;
+#endif
+}
+
+int UringFileWriter::buffer_index(const char* chunk) const {
+  for (size_t i = 0; i < buffers_.size(); i++) {
+    if (buffers_[i] == chunk) {
+      return (int)i;
+    }
+  }
+  return -1;
+}
+
+bool UringFileWriter::backend_open(const std::string& path) {
+  fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  offset_ = 0;
+  failed_ = false;
+  return fd_ >= 0;
+}
+
+#ifdef HAVE_LIBURING
+
+char* UringFileWriter::backend_acquire_chunk(char* previous) {
+  if (previous == nullptr) {
+    ring_ = new Ring();
+    if (io_uring_queue_init(NUM_BUFFERS * 2, &ring_->ring, 0) < 0) {
+      delete ring_;
+      ring_ = nullptr;
+      return nullptr;
+    }
+    std::vector<struct iovec> iovecs;
+    for (unsigned i = 0; i < NUM_BUFFERS; i++) {
+      char* buffer = nullptr;
+      if (posix_memalign((void**)&buffer, 4096, chunk_capacity()) != 0) {
+        backend_release_chunks(nullptr);
+        return nullptr;
+      }
+      buffers_.push_back(buffer);
+      iovecs.push_back({buffer, chunk_capacity()});
+    }
+    in_flight_.assign(NUM_BUFFERS, false);
+    ring_->lengths.assign(NUM_BUFFERS, 0);
+    ring_->offsets.assign(NUM_BUFFERS, 0);
+    // registration can fail on RLIMIT_MEMLOCK; plain writes still work
+    ring_->registered = io_uring_register_buffers(&ring_->ring, iovecs.data(),
+                                                  iovecs.size()) == 0;
+    if (!ring_->registered) {
+      GST_INFO("could not register buffers, using unregistered writes");
+    }
+    return buffers_[0];
+  }
+
+  for (;;) {
+    for (size_t i = 0; i < buffers_.size(); i++) {
+      if (!in_flight_[i]) {
+        return buffers_[i];
+      }
+    }
+    // everything is in flight: this is the only place we wait on the disk
+    submit_pending();
+    if (!reap(true)) {
+      return previous;
+    }
+  }
+}
+
+void UringFileWriter::backend_release_chunks(char* current) {
+  (void)current;  // one of buffers_
+  if (ring_ != nullptr) {
+    drain();
+    if (ring_->registered) {
+      io_uring_unregister_buffers(&ring_->ring);
+    }
+    io_uring_queue_exit(&ring_->ring);
+    delete ring_;
+    ring_ = nullptr;
+  }
+  for (char* buffer : buffers_) {
+    free(buffer);
+  }
+  buffers_.clear();
+  in_flight_.clear();
+}
+
+bool UringFileWriter::backend_write(const char* data, size_t len) {
+  int index = buffer_index(data);
+  struct io_uring_sqe* sqe = nullptr;
+  if (ring_ != nullptr && index >= 0) {
+    sqe = io_uring_get_sqe(&ring_->ring);
+    if (sqe == nullptr) {
+      submit_pending();
+      sqe = io_uring_get_sqe(&ring_->ring);
+    }
+  }
+  if (sqe == nullptr) {
+    // offsets are explicit, so stay on pwrite rather than write
+    if (!drain() || !pwrite_all(fd_, data, len, offset_)) {
+      return false;
+    }
+    offset_ += len;
+    return true;
+  }
+
+  if (ring_->registered) {
+    io_uring_prep_write_fixed(sqe, fd_, data, (unsigned)len, offset_, index);
+  } else {
+    io_uring_prep_write(sqe, fd_, data, (unsigned)len, offset_);
+  }
+  io_uring_sqe_set_data(sqe, (void*)(uintptr_t)index);
+  ring_->lengths[index] = len;
+  ring_->offsets[index] = offset_;
+  offset_ += len;
+  in_flight_[index] = true;
+  num_in_flight_++;
+  num_pending_++;
+
+  if (num_pending_ >= SUBMIT_BATCH) {
+    submit_pending();
+  }
+  reap(false);
+
+  bool ok = !failed_;
+  failed_ = false;
+  return ok;
+}
+
+bool UringFileWriter::submit_pending() {
+  if (ring_ == nullptr || num_pending_ == 0) {
+    return true;
+  }
+  int ret = io_uring_submit(&ring_->ring);
+  if (ret < 0) {
+    errno = -ret;
+    return false;
+  }
+  num_pending_ = 0;
+  return true;
+}
+
+bool UringFileWriter::reap(bool wait) {
+  if (ring_ == nullptr) {
+    return false;
+  }
+  bool reaped = false;
+  while (num_in_flight_) {
+    struct io_uring_cqe* cqe = nullptr;
+    int ret = wait ? io_uring_wait_cqe(&ring_->ring, &cqe)
+                   : io_uring_peek_cqe(&ring_->ring, &cqe);
+    if (ret < 0 || cqe == nullptr) {
+      break;
+    }
+    size_t index = (size_t)(uintptr_t)io_uring_cqe_get_data(cqe);
+    int res = cqe->res;
+    io_uring_cqe_seen(&ring_->ring, cqe);
+
+    size_t len = ring_->lengths[index];
+    if (res < 0) {
+      errno = -res;
+      GST_WARNING("io_uring write failed: %s", strerror(errno));
+      failed_ = true;
+    } else if ((size_t)res < len &&
+               !pwrite_all(fd_, buffers_[index] + res, len - (size_t)res,
+                           ring_->offsets[index] + (uint64_t)res)) {
+      failed_ = true;
+    }
+    in_flight_[index] = false;
+    num_in_flight_--;
+    reaped = true;
+    // after the first completion, only collect what's already there
+    wait = false;
+  }
+  return reaped;
+}
+
+bool UringFileWriter::drain() {
+  if (ring_ == nullptr) {
+    return true;
+  }
+  if (!submit_pending()) {
+    return false;
+  }
+  while (num_in_flight_) {
+    if (!reap(true)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#else  // HAVE_LIBURING
+
+/* never instantiated by create() without liburing, but keep it linkable */
+
+char* UringFileWriter::backend_acquire_chunk(char* previous) {
+  return AsyncFileWriter::backend_acquire_chunk(previous);
+}
+
+void UringFileWriter::backend_release_chunks(char* current) {
+  AsyncFileWriter::backend_release_chunks(current);
+}
+
+bool UringFileWriter::backend_write(const char* data, size_t len) {
+  if (!pwrite_all(fd_, data, len, offset_)) {
+    return false;
+  }
+  offset_ += len;
+  return true;
+}
+
+bool UringFileWriter::submit_pending() {
+  return true;
+}
+
+bool UringFileWriter::reap(bool wait) {
+  (void)wait;
+  return false;
+}
+
+bool UringFileWriter::drain() {
+  return true;
+}
+
+#endif  // HAVE_LIBURING
+
+bool UringFileWriter::backend_sync() {
+  bool drained = drain();
+  return fdatasync(fd_) == 0 && drained;
+}
+
+void UringFileWriter::backend_close() {
+  drain();
+  close(fd_);
+  fd_ = -1;
+}
+
+}  // namespace ds
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "ViolationTracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ds {
+
+ViolationTracker::ViolationTracker(float distance,
+                                   uint64_t window,
+                                   SourceTableLimits limits)
+    : distance_(distance),
+      window_(window),
+      sources_(limits),
+      window_open_(false),
+      window_start_(0),
+      last_pts_(0) {}
+
+const char* ViolationTracker::state_name(ViolationChange::State state) {
+  switch (state) {
+    case ViolationChange::STATE_STARTED:
+      return "started";
+    case ViolationChange::STATE_ENDED:
+      return "ended";
+    case ViolationChange::STATE_CHANGED:
+      return "changed";
+    case ViolationChange::STATE_BRIEF:
+      return "brief";
+  }
+  return "unknown";
+}
+
+static uint32_t find_root(std::vector<uint32_t>* parent, uint32_t i) {
+  while ((*parent)[i] != i) {
+    // path halving
+    (*parent)[i] = (*parent)[(*parent)[i]];
+    i = (*parent)[i];
+  }
+  return i;
+}
+
+uint32_t ViolationTracker::largest_cluster(const std::vector<Person>& people) {
+  float max_distance = distance_.load();
+  uint32_t num_people = (uint32_t)people.size();
+  parent_.resize(num_people);
+  size_.resize(num_people);
+  for (uint32_t i = 0; i < num_people; i++) {
+    parent_[i] = i;
+    size_[i] = 1;
+  }
+
+  uint32_t max_cluster = 0;
+  for (uint32_t i = 0; i < num_people; i++) {
+    for (uint32_t j = i + 1; j < num_people; j++) {
+      float scale = (people[i].height + people[j].height) / 2.0f;
+      if (!(scale > 0.0f)) {
+        continue;
+      }
+      float distance =
+          std::hypot(people[i].x - people[j].x, people[i].y - people[j].y) /
+          scale;
+      if (!(distance < max_distance)) {
+        continue;
+      }
+      uint32_t a = find_root(&parent_, i);
+      uint32_t b = find_root(&parent_, j);
+      if (a == b) {
+        continue;
+      }
+      if (size_[a] < size_[b]) {
+        std::swap(a, b);
+      }
+      parent_[b] = a;
+      size_[a] += size_[b];
+      max_cluster = std::max(max_cluster, size_[a]);
+    }
+  }
+  return max_cluster;
+}
+
+void ViolationTracker::change(Source* source, uint32_t size, uint64_t pts) {
+  if (!source->changed) {
+    source->changed = true;
+    source->previous_size = source->size;
+    source->max_size = source->size;
+    source->changes = 0;
+  }
+  source->size = size;
+  source->max_size = std::max(source->max_size, size);
+  source->changes++;
+  source->pts = pts;
+  if (!window_open_) {
+    window_open_ = true;
+    window_start_ = pts;
+  }
+}
+
+bool ViolationTracker::net_change(uint32_t source_id,
+                                  const Source& source,
+                                  ViolationChange* out) {
+  if (!source.changed) {
+    return false;
+  }
+  uint32_t from = source.previous_size;
+  uint32_t to = source.size;
+  if (from == to && from != 0) {
+    // back where it started
+    return false;
+  }
+  out->source_id = source_id;
+  if (from == 0 && to == 0) {
+    out->state = ViolationChange::STATE_BRIEF;
+  } else if (from == 0) {
+    out->state = ViolationChange::STATE_STARTED;
+  } else if (to == 0) {
+    out->state = ViolationChange::STATE_ENDED;
+  } else {
+    out->state = ViolationChange::STATE_CHANGED;
+  }
+  out->previous_size = from;
+  out->size = to;
+  out->max_size = source.max_size;
+  out->changes = source.changes;
+  out->pts = source.pts;
+  return true;
+}
+
+void ViolationTracker::forget(uint32_t source_id, Source* source) {
+  if (source->size != 0) {
+    change(source, 0, last_pts_);
+  }
+  ViolationChange ended;
+  if (net_change(source_id, *source, &ended)) {
+    gone_.push_back(ended);
+  }
+}
+
+void ViolationTracker::add_frame(uint32_t source_id,
+                                 uint64_t pts,
+                                 const std::vector<Person>& people) {
+  last_pts_ = pts;
+  bool added = false;
+  Source* source = sources_.get(
+      source_id, pts, &added,
+      [this](uint32_t id, Source* evicted) { forget(id, evicted); });
+  if (added) {
+    *source = Source();
+  }
+  uint32_t size = largest_cluster(people);
+  if (size != source->size) {
+    change(source, size, pts);
+  }
+}
+
+void ViolationTracker::remove_source(uint32_t source_id) {
+  sources_.remove(source_id, [this](uint32_t id, Source* removed) {
+    forget(id, removed);
+  });
+}
+
+bool ViolationTracker::poll(uint64_t now, std::vector<ViolationChange>* out) {
+  if (!window_open_) {
+    return false;
+  }
+  uint64_t window = window_.load();
+  // pts going backwards (eg. after a seek) ends the window too
+  if (window != 0 && now >= window_start_ && now - window_start_ < window) {
+    return false;
+  }
+  return flush(out);
+}
+
+bool ViolationTracker::flush(std::vector<ViolationChange>* out) {
+  size_t first = out->size();
+  out->insert(out->end(), gone_.begin(), gone_.end());
+  gone_.clear();
+  sources_.for_each([out](uint32_t source_id, Source* source) {
+    ViolationChange net;
+    if (net_change(source_id, *source, &net)) {
+      out->push_back(net);
+    }
+    source->changed = false;
+  });
+  window_open_ = false;
+  // a source that went and came back in the window ends before it restarts
+  std::stable_sort(out->begin() + first, out->end(),
+                   [](const ViolationChange& a, const ViolationChange& b) {
+                     return a.source_id < b.source_id;
+                   });
+  return out->size() > first;
+}
+
+void ViolationTracker::reset() {
+  sources_.clear();
+  gone_.clear();
+  window_open_ = false;
+  last_pts_ = 0;
+}
+
+}  // namespace ds
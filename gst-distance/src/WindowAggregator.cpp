@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "WindowAggregator.hpp"
+
+#include <distance.pb.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+namespace ds {
+
+const double QuantileSketch::RELATIVE_ACCURACY = 0.01;
+const double QuantileSketch::MIN_VALUE = 1e-3;
+const double QuantileSketch::MAX_VALUE = 1e3;
+
+static const double GAMMA =
+    (1.0 + QuantileSketch::RELATIVE_ACCURACY) /
+    (1.0 - QuantileSketch::RELATIVE_ACCURACY);
+static const double LOG_GAMMA = std::log(GAMMA);
+/** the log index of MIN_VALUE, so the first log bucket is 1 */
+static const int MIN_INDEX =
+    (int)std::ceil(std::log(QuantileSketch::MIN_VALUE) / LOG_GAMMA);
+
+static size_t bucket_index(double value) {
+  if (!(value >= QuantileSketch::MIN_VALUE)) {
+    // below range, zero or NaN
+    return 0;
+  }
+  value = std::min(value, QuantileSketch::MAX_VALUE);
+  return (size_t)((int)std::ceil(std::log(value) / LOG_GAMMA) - MIN_INDEX +
+                  1);
+}
+
+/* the value a bucket stands for: within RELATIVE_ACCURACY of its contents */
+static double bucket_value(size_t index) {
+  if (index == 0) {
+    return 0.0;
+  }
+  int log_index = (int)index - 1 + MIN_INDEX;
+  return 2.0 * std::pow(GAMMA, log_index) / (GAMMA + 1.0);
+}
+
+const size_t QuantileSketch::NUM_BUCKETS =
+    bucket_index(QuantileSketch::MAX_VALUE) + 1;
+
+QuantileSketch::QuantileSketch() : buckets_(NUM_BUCKETS, 0), count_(0) {}
+
+void QuantileSketch::add(double value) {
+  buckets_[bucket_index(value)]++;
+  count_++;
+}
+
+void QuantileSketch::clear() {
+  std::fill(buckets_.begin(), buckets_.end(), 0);
+  count_ = 0;
+}
+
+double QuantileSketch::quantile(double q) const {
+  if (count_ == 0) {
+    return std::numeric_limits<double>::quiet_NaN();
+  }
+  q = std::min(std::max(q, 0.0), 1.0);
+  // nearest rank
+  uint64_t rank = (uint64_t)(q * (double)(count_ - 1));
+  uint64_t seen = 0;
+  for (size_t i = 0; i < buckets_.size(); i++) {
+    seen += buckets_[i];
+    if (seen > rank) {
+      return bucket_value(i);
+    }
+  }
+  return bucket_value(buckets_.size() - 1);
+}
+
+const char WindowAggregator::CSV_HEADER[] =
+    "source_id,start,end,frames,mean_people,max_people,violations,"
+    "max_cluster,p95_distance\n";
+
+WindowAggregator::WindowAggregator(uint64_t window,
+                                   float cluster_distance,
+                                   SourceTableLimits limits)
+    : window_(std::max(window, (uint64_t)1)),
+      cluster_distance_(cluster_distance),
+      sources_(limits,
+               sizeof(Accumulator) +
+                   QuantileSketch::NUM_BUCKETS * sizeof(uint32_t)) {}
+
+void WindowAggregator::add(const dp::Batch& batch,
+                           std::vector<WindowRecord>* out) {
+  for (const auto& frame : batch.frames()) {
+    add_frame(frame, out);
+  }
+}
+
+static uint32_t find_root(std::vector<uint32_t>* parent, uint32_t i) {
+  while ((*parent)[i] != i) {
+    // path halving
+    (*parent)[i] = (*parent)[(*parent)[i]];
+    i = (*parent)[i];
+  }
+  return i;
+}
+
+void WindowAggregator::add_frame(const dp::Frame& frame,
+                                 std::vector<WindowRecord>* out) {
+  uint64_t pts = (uint64_t)frame.pts();
+  bool added = false;
+  Accumulator* acc = sources_.get(
+      frame.source_id(), pts, &added,
+      [this, out](uint32_t, Accumulator* evicted) { close(evicted, out); });
+  if (added) {
+    // a reused entry, so clear rather than reallocate the sketch
+    acc->record = WindowRecord();
+    acc->record.source_id = frame.source_id();
+    acc->record.start = pts - pts % window_;
+    acc->record.end = acc->record.start + window_;
+    acc->distances.clear();
+  } else if (pts >= acc->record.end) {
+    close(acc, out);
+    acc->record.start = pts - pts % window_;
+    acc->record.end = acc->record.start + window_;
+  }
+
+  WindowRecord& record = acc->record;
+  uint32_t num_people = (uint32_t)frame.people_size();
+  record.frames++;
+  record.people += num_people;
+  record.max_people = std::max(record.max_people, num_people);
+
+  x_.resize(num_people);
+  y_.resize(num_people);
+  height_.resize(num_people);
+  parent_.resize(num_people);
+  size_.resize(num_people);
+  for (uint32_t i = 0; i < num_people; i++) {
+    const auto& person = frame.people((int)i);
+    const auto& bbox = person.bbox();
+    record.violations += person.is_danger();
+    x_[i] = bbox.left() + bbox.width() / 2.0f;
+    y_[i] = bbox.top() + bbox.height();
+    height_[i] = bbox.height();
+    parent_[i] = i;
+    size_[i] = 1;
+  }
+
+  uint32_t max_cluster = num_people ? 1 : 0;
+  for (uint32_t i = 0; i < num_people; i++) {
+    for (uint32_t j = i + 1; j < num_people; j++) {
+      float scale = (height_[i] + height_[j]) / 2.0f;
+      if (!(scale > 0.0f)) {
+        continue;
+      }
+      float distance = std::hypot(x_[i] - x_[j], y_[i] - y_[j]) / scale;
+      acc->distances.add(distance);
+      if (distance >= cluster_distance_) {
+        continue;
+      }
+      uint32_t a = find_root(&parent_, i);
+      uint32_t b = find_root(&parent_, j);
+      if (a == b) {
+        continue;
+      }
+      if (size_[a] < size_[b]) {
+        std::swap(a, b);
+      }
+      parent_[b] = a;
+      size_[a] += size_[b];
+      max_cluster = std::max(max_cluster, size_[a]);
+    }
+  }
+  record.max_cluster = std::max(record.max_cluster, max_cluster);
+}
+
+void WindowAggregator::close(Accumulator* acc,
+                             std::vector<WindowRecord>* out) {
+  if (acc->record.frames) {
+    acc->record.p95_distance = (float)acc->distances.quantile(0.95);
+    out->push_back(acc->record);
+  }
+  uint32_t source_id = acc->record.source_id;
+  acc->record = WindowRecord();
+  acc->record.source_id = source_id;
+  acc->distances.clear();
+}
+
+void WindowAggregator::flush(std::vector<WindowRecord>* out) {
+  size_t first = out->size();
+  sources_.for_each(
+      [this, out](uint32_t, Accumulator* acc) { close(acc, out); });
+  std::sort(out->begin() + first, out->end(),
+            [](const WindowRecord& a, const WindowRecord& b) {
+              return a.source_id < b.source_id;
+            });
+  sources_.clear();
+}
+
+void WindowAggregator::remove_source(uint32_t source_id,
+                                     std::vector<WindowRecord>* out) {
+  sources_.remove(source_id, [this, out](uint32_t, Accumulator* acc) {
+    close(acc, out);
+  });
+}
+
+std::string WindowAggregator::csv_row(const WindowRecord& record) {
+  char row[256];
+  double mean_people =
+      record.frames ? (double)record.people / (double)record.frames : 0.0;
+  int len = snprintf(row, sizeof(row),
+                     "%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%f,%u,%" PRIu64
+                     ",%u,%f\n",
+                     record.source_id, record.start, record.end, record.frames,
+                     mean_people, record.max_people, record.violations,
+                     record.max_cluster, (double)record.p95_distance);
+  return std::string(row, (size_t)std::max(len, 0));
+}
+
+}  // namespace ds
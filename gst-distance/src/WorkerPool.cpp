@@ -0,0 +1,338 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "WorkerPool.hpp"
+
+#include <gst/gst.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <string.h>
+
+GST_DEBUG_CATEGORY_STATIC(ds_worker_pool_debug);
+#define GST_CAT_DEFAULT ds_worker_pool_debug
+
+namespace ds {
+
+/** io() workers unless configure_io() says otherwise */
+static const size_t DEFAULT_IO_THREADS = 4;
+
+// the pool and index of the worker running on this thread, if any
+static thread_local WorkerPool* current_pool = nullptr;
+static thread_local size_t current_index = 0;
+
+static void init_debug_category() {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    GST_DEBUG_CATEGORY_INIT(ds_worker_pool_debug, "dsworkerpool", 0,
+                            "shared worker threads");
+  });
+}
+
+/* the cores the process may run on, in order
+ */
+static std::vector<int> available_cpus() {
+  std::vector<int> cpus;
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+  return cpus;
+}
+
+/* a process wide pool, created on first use with the options set before
+ */
+struct ProcessPool {
+  explicit ProcessPool(size_t threads) { options.threads = threads; }
+  std::mutex lock;
+  WorkerPool::Options options;
+  WorkerPool* pool = nullptr;
+};
+
+static ProcessPool shared_pool(0);
+static ProcessPool io_pool(DEFAULT_IO_THREADS);
+
+static WorkerPool& process_pool(ProcessPool* process) {
+  std::lock_guard<std::mutex> guard(process->lock);
+  if (process->pool == nullptr) {
+    // never destroyed, like the metrics registry
+    process->pool = new WorkerPool(process->options);
+  }
+  return *process->pool;
+}
+
+static bool configure_process_pool(ProcessPool* process,
+                                   WorkerPool::Options options) {
+  std::lock_guard<std::mutex> guard(process->lock);
+  if (process->pool != nullptr) {
+    return false;
+  }
+  process->options = options;
+  return true;
+}
+
+WorkerPool& WorkerPool::shared() {
+  return process_pool(&shared_pool);
+}
+
+bool WorkerPool::configure(Options options) {
+  return configure_process_pool(&shared_pool, options);
+}
+
+WorkerPool& WorkerPool::io() {
+  return process_pool(&io_pool);
+}
+
+bool WorkerPool::configure_io(Options options) {
+  return configure_process_pool(&io_pool, options);
+}
+
+WorkerPool::WorkerPool(Options options)
+    : next_(0), steals_(0), pending_(0), stopping_(false) {
+  init_debug_category();
+  std::vector<int> cpus = available_cpus();
+  size_t threads = options.threads;
+  if (threads == 0) {
+    threads = cpus.empty() ? std::thread::hardware_concurrency()
+                           : cpus.size();
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  for (size_t i = 0; i < threads; i++) {
+    workers_.emplace_back(new Worker());
+  }
+  // only once every deque exists, since workers steal from all of them
+  for (size_t i = 0; i < threads; i++) {
+    int cpu = options.pin && !cpus.empty() ? cpus[i % cpus.size()] : -1;
+    workers_[i]->thread = std::thread(&WorkerPool::run, this, i, cpu);
+  }
+  GST_INFO("started %zu workers%s", threads, options.pin ? " (pinned)" : "");
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> guard(sleep_lock_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+void WorkerPool::schedule(std::shared_ptr<StrandState> strand) {
+  // a strand made ready by a task stays on that worker, where it's warm
+  size_t index = current_pool == this
+                     ? current_index
+                     : next_.fetch_add(1, std::memory_order_relaxed) %
+                           workers_.size();
+  // counted before it can be taken, so take()'s decrement never comes first
+  // and pending_ never wraps below zero (a worker that sees the count before
+  // the push just looks again)
+  {
+    std::lock_guard<std::mutex> guard(sleep_lock_);
+    pending_++;
+  }
+  {
+    std::lock_guard<std::mutex> guard(workers_[index]->lock);
+    workers_[index]->ready.push_back(std::move(strand));
+  }
+  wake_.notify_one();
+}
+
+void WorkerPool::add_timer(clock::time_point deadline,
+                           std::shared_ptr<StrandState> strand,
+                           std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(sleep_lock_);
+    timers_.emplace(deadline, std::make_pair(std::move(strand),
+                                             std::move(task)));
+  }
+  // it may be sooner than whatever the sleepers are waiting for
+  wake_.notify_one();
+}
+
+std::shared_ptr<WorkerPool::StrandState> WorkerPool::take(size_t index) {
+  std::shared_ptr<StrandState> strand;
+  {
+    Worker& own = *workers_[index];
+    std::lock_guard<std::mutex> guard(own.lock);
+    if (!own.ready.empty()) {
+      strand = std::move(own.ready.front());
+      own.ready.pop_front();
+    }
+  }
+  for (size_t i = 1; strand == nullptr && i < workers_.size(); i++) {
+    Worker& victim = *workers_[(index + i) % workers_.size()];
+    std::lock_guard<std::mutex> guard(victim.lock);
+    if (!victim.ready.empty()) {
+      strand = std::move(victim.ready.back());
+      victim.ready.pop_back();
+      steals_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+  if (strand != nullptr) {
+    pending_--;
+  }
+  return strand;
+}
+
+void WorkerPool::run_one(const std::shared_ptr<StrandState>& strand) {
+  std::function<void()> task;
+  {
+    std::lock_guard<std::mutex> guard(strand->lock);
+    if (strand->closed || strand->tasks.empty()) {
+      strand->scheduled = false;
+      return;
+    }
+    task = std::move(strand->tasks.front());
+    strand->tasks.pop_front();
+    strand->running = true;
+    strand->runner = std::this_thread::get_id();
+  }
+  task();
+  bool again = false;
+  {
+    std::lock_guard<std::mutex> guard(strand->lock);
+    strand->running = false;
+    strand->runner = std::thread::id();
+    again = !strand->closed && !strand->tasks.empty();
+    strand->scheduled = again;
+  }
+  strand->idle.notify_all();
+  // to the back of the deque, behind the strands that were waiting
+  if (again) {
+    schedule(strand);
+  }
+}
+
+void WorkerPool::run(size_t index, int cpu) {
+  current_pool = this;
+  current_index = index;
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    if (err != 0) {
+      GST_WARNING("could not pin worker %zu to cpu %d: %s", index, cpu,
+                  strerror(err));
+    }
+  }
+
+  std::vector<std::pair<std::shared_ptr<StrandState>, std::function<void()>>>
+      due;
+  for (;;) {
+    std::shared_ptr<StrandState> strand = take(index);
+    if (strand != nullptr) {
+      run_one(strand);
+      continue;
+    }
+    {
+      std::unique_lock<std::mutex> guard(sleep_lock_);
+      if (stopping_) {
+        return;
+      }
+      auto now = clock::now();
+      while (!timers_.empty() && timers_.begin()->first <= now) {
+        due.push_back(std::move(timers_.begin()->second));
+        timers_.erase(timers_.begin());
+      }
+      if (due.empty() && pending_ == 0) {
+        if (timers_.empty()) {
+          wake_.wait(guard);
+        } else {
+          // a copy, since another worker may fire (and erase) the timer
+          clock::time_point deadline = timers_.begin()->first;
+          wake_.wait_until(guard, deadline);
+        }
+      }
+    }
+    for (auto& timer : due) {
+      Strand::post_to(timer.first, std::move(timer.second));
+    }
+    due.clear();
+  }
+}
+
+WorkerPool::Strand::Strand(WorkerPool* pool)
+    : state_(std::make_shared<StrandState>()) {
+  state_->pool = pool;
+}
+
+WorkerPool::Strand::~Strand() {
+  close();
+}
+
+bool WorkerPool::Strand::post_to(const std::shared_ptr<StrandState>& state,
+                                 std::function<void()> task) {
+  bool schedule = false;
+  {
+    std::lock_guard<std::mutex> guard(state->lock);
+    if (state->closed) {
+      return false;
+    }
+    state->tasks.push_back(std::move(task));
+    if (!state->scheduled) {
+      state->scheduled = true;
+      schedule = true;
+    }
+  }
+  if (schedule) {
+    state->pool->schedule(state);
+  }
+  return true;
+}
+
+bool WorkerPool::Strand::post(std::function<void()> task) {
+  return post_to(state_, std::move(task));
+}
+
+bool WorkerPool::Strand::post_after(std::chrono::milliseconds delay,
+                                    std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> guard(state_->lock);
+    if (state_->closed) {
+      return false;
+    }
+  }
+  // the timer keeps the state alive, and drops the task if closed by then
+  state_->pool->add_timer(clock::now() + delay, state_, std::move(task));
+  return true;
+}
+
+void WorkerPool::Strand::close() {
+  std::unique_lock<std::mutex> guard(state_->lock);
+  state_->closed = true;
+  state_->tasks.clear();
+  if (state_->running && state_->runner == std::this_thread::get_id()) {
+    return;
+  }
+  state_->idle.wait(guard, [this] { return !state_->running; });
+}
+
+}  // namespace ds
@@ -22,9 +22,14 @@
 #include "gstdistance.h"
 
 #include "config.h"
+#include "gstdsanalytics.h"
 #include "gstdsdistance.h"
+#include "gstdsfakemetasrc.h"
+#include "gstdsmetrics.h"
+#include "gstdslatencytracer.h"
 #include "gstdsprotopayload.h"
 #include "gstdspayloadbroker.h"
+#include "gstdsworkers.h"
 
 static gboolean distance_init(GstPlugin* plugin) {
   if (!gst_element_register(plugin, "dsdistance", GST_RANK_NONE,
@@ -42,6 +47,22 @@ static gboolean distance_init(GstPlugin* plugin) {
     GST_ERROR("could not register dspayloadbroker");
     return false;
   };
+  if (!gst_element_register(plugin, "dsanalytics", GST_RANK_NONE,
+                            GST_TYPE_DSANALYTICS)) {
+    GST_ERROR("could not register dsanalytics");
+    return false;
+  };
+  if (!gst_element_register(plugin, "dsfakemetasrc", GST_RANK_NONE,
+                            GST_TYPE_DSFAKEMETASRC)) {
+    GST_ERROR("could not register dsfakemetasrc");
+    return false;
+  };
+  if (!gst_tracer_register(plugin, "dslatency", GST_TYPE_DSLATENCYTRACER)) {
+    GST_ERROR("could not register dslatency");
+    return false;
+  };
+  gst_ds_metrics_init();
+  gst_ds_workers_init();
   return true;
 }
 
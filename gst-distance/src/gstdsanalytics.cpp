@@ -0,0 +1,509 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * SECTION:element-dsanalytics
+ *
+ * DsAnalytics is dsdistance, dsprotopayload and dspayloadbroker in one
+ * element.
+ *
+ * The batch meta is looked up once per buffer and handed to the distance
+ * filter, the payload filter and the outputs in turn, on the same thread,
+ * without the pad pushes and per element overhead between three separate
+ * elements. It has dspayloadbroker's properties (it is one), plus
+ * dsdistance's: class-id, do-drawing, qos, priorities, budget,
+ * skipped-frames, config-file, config-reloads, post-violations,
+ * violation-distance and violation-window. They work as they do on
+ * dsdistance; priorities, budget and the config file's per source settings
+ * apply to the distance stage, and every frame still gets a payload.
+ *
+ * <refsect2>
+ * <title>Example usage</title>
+ * |[
+ * ... ! nvinfer ! nvtracker ! dsanalytics outputs=property,csv \
+ *   basepath=/tmp/rec ! nvosd ...
+ * ]|
+ * is equivalent to
+ * |[
+ * ... ! nvtracker ! dsdistance ! dsprotopayload ! dspayloadbroker \
+ *   outputs=property,csv basepath=/tmp/rec ! nvosd ...
+ * ]|
+ * |[
+ * ... ! nvtracker ! dsanalytics post-violations=true \
+ *   config-file=/etc/dsdistance/sources.conf ! ...
+ * ]|
+ * </refsect2>
+ */
+
+#include "gstdsanalytics.h"
+#include "gstdsqos.h"
+#include "gstdsschedule.h"
+#include "gstdsstats.h"
+#include "gstdsviolations.h"
+
+#include "FanOutPayloadBroker.hpp"
+
+#include "config.h"
+
+// gstreamer
+#include <gst/base/base.h>
+#include <gst/controller/controller.h>
+#include <gst/gst.h>
+
+// deepstream
+#include <gstnvdsmeta.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_dsanalytics_debug);
+#define GST_CAT_DEFAULT gst_dsanalytics_debug
+
+static const char ELEMENT_NAME[] = "dsanalytics";
+static const char ELEMENT_LONG_NAME[] = "DeepStream social distancing analytics";
+static const char ELEMENT_TYPE[] = "Filter";
+static const char ELEMENT_DESCRIPTION[] =
+    "Make close objects red and send the results around, in one pass.";
+static const char ELEMENT_AUTHOR_AND_EMAIL[] = PACKAGE_AUTHOR " " PACKAGE_EMAIL;
+
+/**
+ * The maximum class id that can be set.
+ */
+static const int MAX_CLASS_ID = 4096;
+static const int DEFAULT_CLASS_ID = 0;
+static const bool DEFAULT_DO_DRAWING = true;
+static const gfloat DEFAULT_VIOLATION_DISTANCE = 1.0f;  // person heights
+static const guint DEFAULT_VIOLATION_WINDOW = 1000;  // ms of pts
+/* forget a source's violation after this long without a frame from it */
+static const guint64 VIOLATION_SOURCE_TIMEOUT = 60 * GST_SECOND;
+
+/* the properties added to dspayloadbroker's (GObject keeps the ids apart)
+ */
+enum {
+  PROP_0,
+  PROP_CLASS_ID,
+  PROP_DO_DRAWING,
+  PROP_PRIORITIES,
+  PROP_BUDGET,
+  PROP_SKIPPED_FRAMES,
+  PROP_CONFIG_FILE,
+  PROP_CONFIG_RELOADS,
+  PROP_POST_VIOLATIONS,
+  PROP_VIOLATION_DISTANCE,
+  PROP_VIOLATION_WINDOW,
+};
+
+#define gst_dsanalytics_parent_class parent_class
+G_DEFINE_TYPE(GstDsAnalytics, gst_dsanalytics, GST_TYPE_DSPAYLOADBROKER);
+
+static void gst_dsanalytics_set_property(GObject* object,
+                                         guint prop_id,
+                                         const GValue* value,
+                                         GParamSpec* pspec);
+static void gst_dsanalytics_get_property(GObject* object,
+                                         guint prop_id,
+                                         GValue* value,
+                                         GParamSpec* pspec);
+
+static void gst_dsanalytics_finalize(GObject* object);
+
+static GstFlowReturn gst_dsanalytics_transform_ip(GstBaseTransform* base,
+                                                  GstBuffer* outbuf);
+static gboolean gst_dsanalytics_start(GstBaseTransform* base);
+static gboolean gst_dsanalytics_src_event(GstBaseTransform* base,
+                                          GstEvent* event);
+static gboolean gst_dsanalytics_sink_event(GstBaseTransform* base,
+                                           GstEvent* event);
+static gboolean gst_dsanalytics_stop(GstBaseTransform* base);
+
+/* GObject vmethod implementations */
+
+/* initialize the dsanalytics's class (dspayloadbroker's is already done)
+ */
+static void gst_dsanalytics_class_init(GstDsAnalyticsClass* klass) {
+  GObjectClass* gobject_class;
+  GstElementClass* gstelement_class;
+
+  gobject_class = (GObjectClass*)klass;
+  gstelement_class = (GstElementClass*)klass;
+
+  gobject_class->set_property = gst_dsanalytics_set_property;
+  gobject_class->get_property = gst_dsanalytics_get_property;
+  gobject_class->finalize = gst_dsanalytics_finalize;
+
+  // do-drawing property
+  g_object_class_install_property(
+      gobject_class, PROP_DO_DRAWING,
+      g_param_spec_boolean(
+          "do-drawing", "Do Drawing",
+          "Modify osd metadata for nvdsosd (make stuff red).",
+          (gboolean) DEFAULT_DO_DRAWING,
+          GParamFlags(G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE)));
+
+  // class-id property
+  g_object_class_install_property(
+      gobject_class, PROP_CLASS_ID,
+      g_param_spec_int(
+          "class-id", "ClassID", "Class id of a person.", 0, MAX_CLASS_ID, DEFAULT_CLASS_ID,
+          GParamFlags(G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE)));
+
+  // priorities, budget and skipped-frames properties
+  g_object_class_install_property(gobject_class, PROP_PRIORITIES,
+                                  gst_ds_schedule_priorities_param_spec());
+  g_object_class_install_property(gobject_class, PROP_BUDGET,
+                                  gst_ds_schedule_budget_param_spec());
+  g_object_class_install_property(gobject_class, PROP_SKIPPED_FRAMES,
+                                  gst_ds_schedule_skipped_param_spec());
+
+  // config-file property
+  g_object_class_install_property(
+      gobject_class, PROP_CONFIG_FILE,
+      g_param_spec_string(
+          "config-file", "ConfigFile",
+          "Per source settings (enabled, class-id, do-drawing), reloaded "
+          "whenever the file changes.",
+          nullptr, GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  // config-reloads property
+  g_object_class_install_property(
+      gobject_class, PROP_CONFIG_RELOADS,
+      g_param_spec_uint64(
+          "config-reloads", "ConfigReloads",
+          "Number of times config-file was reloaded after a change.",
+          0, G_MAXUINT64, 0,
+          GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  // post-violations, violation-distance and violation-window properties
+  g_object_class_install_property(gobject_class, PROP_POST_VIOLATIONS,
+                                  gst_ds_violations_post_param_spec());
+  g_object_class_install_property(
+      gobject_class, PROP_VIOLATION_DISTANCE,
+      gst_ds_violations_distance_param_spec(DEFAULT_VIOLATION_DISTANCE));
+  g_object_class_install_property(
+      gobject_class, PROP_VIOLATION_WINDOW,
+      gst_ds_violations_window_param_spec(DEFAULT_VIOLATION_WINDOW));
+
+  // the pad templates are inherited
+  gst_element_class_set_details_simple(gstelement_class, ELEMENT_LONG_NAME,
+                                       ELEMENT_TYPE, ELEMENT_DESCRIPTION,
+                                       ELEMENT_AUTHOR_AND_EMAIL);
+
+  /* register vmethods (start, stop and sink_event chain up to
+   * dspayloadbroker's)
+   */
+  GST_BASE_TRANSFORM_CLASS(klass)->transform_ip =
+      GST_DEBUG_FUNCPTR(gst_dsanalytics_transform_ip);
+  GST_BASE_TRANSFORM_CLASS(klass)->start =
+      GST_DEBUG_FUNCPTR(gst_dsanalytics_start);
+  GST_BASE_TRANSFORM_CLASS(klass)->stop =
+      GST_DEBUG_FUNCPTR(gst_dsanalytics_stop);
+  GST_BASE_TRANSFORM_CLASS(klass)->src_event =
+      GST_DEBUG_FUNCPTR(gst_dsanalytics_src_event);
+  GST_BASE_TRANSFORM_CLASS(klass)->sink_event =
+      GST_DEBUG_FUNCPTR(gst_dsanalytics_sink_event);
+
+  /* debug category for fltering log messages
+   */
+  GST_DEBUG_CATEGORY_INIT(gst_dsanalytics_debug, ELEMENT_NAME, 0,
+                          ELEMENT_DESCRIPTION);
+}
+
+/* initialize the new element
+ * initialize instance structure
+ */
+static void gst_dsanalytics_init(GstDsAnalytics* self) {
+  GST_DEBUG("dsanalytics init");
+
+  /* the filters live as long as the element, the outputs from start to stop
+   */
+  self->distance = new ds::DistanceFilter();
+  self->distance->class_id = DEFAULT_CLASS_ID;
+  self->distance->do_drawing = DEFAULT_DO_DRAWING;
+  self->payload = new ds::ProtoPayloadFilter();
+  self->class_id = DEFAULT_CLASS_ID;
+  self->do_drawing = DEFAULT_DO_DRAWING;
+  self->config = new ds::SourceConfigWatcher();
+
+  ds::SourceTableLimits limits;
+  limits.idle_timeout = VIOLATION_SOURCE_TIMEOUT;
+  self->violations = new ds::ViolationTracker(
+      DEFAULT_VIOLATION_DISTANCE, DEFAULT_VIOLATION_WINDOW * GST_MSECOND,
+      limits);
+  self->post_violations = FALSE;
+
+  // shed load rather than fall further behind (see the qos property)
+  self->shedder = new ds::LoadShedder();
+  self->scheduler = new ds::FrameScheduler();
+  gst_base_transform_set_qos_enabled(GST_BASE_TRANSFORM(self), TRUE);
+}
+
+/* start watching the config file, then start the outputs
+ */
+static gboolean gst_dsanalytics_start(GstBaseTransform* base) {
+  GST_DEBUG_OBJECT(base, "start");
+  GstDsAnalytics* self = GST_DSANALYTICS(base);
+  self->shedder->reset();
+  // the settings loaded so far still apply if the file can't be watched
+  // (a no-op if still watching from before the last stop)
+  if (!self->config->start()) {
+    GST_WARNING_OBJECT(self, "not watching %s for changes",
+                       self->config->path().c_str());
+  }
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->start(base);
+}
+
+/* forget the violations, then stop the outputs (the filters and the config
+ * watcher are kept until finalize, like dsdistance's)
+ */
+static gboolean gst_dsanalytics_stop(GstBaseTransform* base) {
+  GST_DEBUG_OBJECT(base, "stop");
+
+  // the next stream starts with no violations (streaming has stopped)
+  GST_DSANALYTICS(base)->violations->reset();
+
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->stop(base);
+}
+
+/* a config file's settings for one batch
+ */
+typedef struct {
+  ds::DistanceFilter* filter;
+  const ds::SourceConfig* config;
+  gint class_id;
+  gboolean do_drawing;
+} GstDsAnalyticsBatchConfig;
+
+/* apply the settings for a frame's source before its distances are
+ * calculated
+ */
+static gboolean gst_dsanalytics_prepare_frame(NvDsFrameMeta* frame_meta,
+                                              gpointer user_data) {
+  auto batch = (GstDsAnalyticsBatchConfig*) user_data;
+  const ds::SourceSettings& settings =
+      batch->config->settings(frame_meta->source_id);
+  if (!settings.enabled) {
+    return false;
+  }
+  batch->filter->class_id =
+      settings.class_id < 0 ? batch->class_id : settings.class_id;
+  batch->filter->do_drawing =
+      settings.do_drawing < 0 ? (bool) batch->do_drawing
+                              : settings.do_drawing != 0;
+  return true;
+}
+
+/* do in-place work on the buffer (override the 'transform' method for copy)
+ */
+static GstFlowReturn gst_dsanalytics_transform_ip(GstBaseTransform* base,
+                                                  GstBuffer* outbuf) {
+  GstDsAnalytics* self = GST_DSANALYTICS(base);
+  GstDsPayloadBroker* broker = GST_DSPAYLOADBROKER(base);
+  GstFlowReturn ret = GST_FLOW_OK;
+
+  if (broker->silent == FALSE)
+    GST_LOG("%s got buffer.", GST_ELEMENT_NAME(self));
+
+  if (GST_CLOCK_TIME_IS_VALID(GST_BUFFER_TIMESTAMP(outbuf)))
+    gst_object_sync_values(GST_OBJECT(self), GST_BUFFER_TIMESTAMP(outbuf));
+
+  if (!gst_ds_qos_should_process(base, self->shedder)) {
+    GST_LOG_OBJECT(self, "late, passing buffer through");
+    return GST_FLOW_OK;
+  }
+
+  GstClockTime start = gst_util_get_timestamp();
+  NvDsBatchMeta* batch_meta = gst_buffer_get_nvds_batch_meta(outbuf);
+  if (batch_meta == nullptr) {
+    GST_LOG_OBJECT(self, "no batch meta, passing buffer through");
+    return GST_FLOW_OK;
+  }
+
+  // one config for the whole batch, however often the file changes
+  std::shared_ptr<const ds::SourceConfig> config = self->config->config();
+
+  // only the distance stage is scheduled, every frame still gets a payload
+  if (config != nullptr) {
+    GstDsAnalyticsBatchConfig batch = {self->distance, config.get(),
+                                       self->class_id, self->do_drawing};
+    ret = gst_ds_schedule_frames(self->scheduler, self->distance, outbuf,
+                                 start, gst_dsanalytics_prepare_frame, &batch);
+    self->distance->class_id = batch.class_id;
+    self->distance->do_drawing = (bool) batch.do_drawing;
+  } else if (self->scheduler->active()) {
+    ret = gst_ds_schedule_frames(self->scheduler, self->distance, outbuf,
+                                 start, nullptr, nullptr);
+  } else if (!self->distance->on_batch_meta(batch_meta)) {
+    ret = GST_FLOW_ERROR;
+  }
+  // each stage reads what the one before attached to the batch
+  if (ret != GST_FLOW_OK ||
+      !self->payload->on_batch_meta(batch_meta) ||
+      !broker->filter->on_batch_meta(batch_meta)) {
+    GST_ERROR_OBJECT(self, "could not process batch meta");
+    ret = GST_FLOW_ERROR;
+  }
+  GstClockTime elapsed = gst_util_get_timestamp() - start;
+
+  // the pairs were already counted from the payload
+  if (self->post_violations) {
+    gst_ds_violations_add(GST_ELEMENT(self), self->violations, outbuf,
+                          config.get(), self->class_id);
+  }
+  gst_ds_stats_add(broker->stats, outbuf,
+                   ((ds::FanOutPayloadBroker*) broker->filter)->take_pairs(),
+                   elapsed);
+
+  return ret;
+}
+
+/* shed load on QoS events (sent upstream by a late sink)
+ */
+static gboolean gst_dsanalytics_src_event(GstBaseTransform* base,
+                                          GstEvent* event) {
+  if (GST_EVENT_TYPE(event) == GST_EVENT_QOS) {
+    return gst_ds_qos_src_event(base, GST_DSANALYTICS(base)->shedder, event);
+  }
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->src_event(base, event);
+}
+
+/* end the violations of sources that go away and post what's pending on eos,
+ * then let dspayloadbroker forget them too
+ */
+static gboolean gst_dsanalytics_sink_event(GstBaseTransform* base,
+                                           GstEvent* event) {
+  GstDsAnalytics* self = GST_DSANALYTICS(base);
+
+  // serialized, so this is the streaming thread, between buffers
+  if (self->post_violations) {
+    gst_ds_violations_sink_event(GST_ELEMENT(self), self->violations, event);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->sink_event(base, event);
+}
+
+/* __setattr__
+ */
+static void gst_dsanalytics_set_property(GObject* object,
+                                         guint prop_id,
+                                         const GValue* value,
+                                         GParamSpec* pspec) {
+  GstDsAnalytics* self = GST_DSANALYTICS(object);
+
+  switch (prop_id) {
+    case PROP_DO_DRAWING:
+      self->do_drawing = g_value_get_boolean(value);
+      self->distance->do_drawing = (bool) self->do_drawing;
+      break;
+    case PROP_CLASS_ID:
+      self->class_id = g_value_get_int(value);
+      self->distance->class_id = self->class_id;
+      break;
+    case PROP_CONFIG_FILE: {
+      const gchar* path = g_value_get_string(value);
+      std::string error;
+      if (!self->config->set_path(path == nullptr ? "" : path, &error)) {
+        GST_WARNING_OBJECT(self, "could not load config-file: %s",
+                           error.c_str());
+      }
+      break;
+    }
+    case PROP_PRIORITIES:
+      gst_ds_schedule_set_priorities(object, self->scheduler, value);
+      break;
+    case PROP_BUDGET:
+      self->scheduler->set_budget((guint64) g_value_get_uint(value) *
+                                  GST_USECOND);
+      break;
+    case PROP_POST_VIOLATIONS:
+      self->post_violations = g_value_get_boolean(value);
+      break;
+    case PROP_VIOLATION_DISTANCE:
+      self->violations->set_distance(g_value_get_float(value));
+      break;
+    case PROP_VIOLATION_WINDOW:
+      self->violations->set_window((guint64) g_value_get_uint(value) *
+                                   GST_MSECOND);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+/* __getattr__
+ */
+static void gst_dsanalytics_get_property(GObject* object,
+                                         guint prop_id,
+                                         GValue* value,
+                                         GParamSpec* pspec) {
+  GstDsAnalytics* self = GST_DSANALYTICS(object);
+
+  switch (prop_id) {
+    case PROP_DO_DRAWING:
+      g_value_set_boolean(value, self->do_drawing);
+      break;
+    case PROP_CLASS_ID:
+      g_value_set_int(value, self->class_id);
+      break;
+    case PROP_CONFIG_FILE: {
+      std::string path = self->config->path();
+      g_value_set_string(value, path.empty() ? nullptr : path.c_str());
+      break;
+    }
+    case PROP_CONFIG_RELOADS:
+      g_value_set_uint64(value, self->config->reloads());
+      break;
+    case PROP_PRIORITIES:
+      g_value_set_string(value, self->scheduler->priorities().c_str());
+      break;
+    case PROP_BUDGET:
+      g_value_set_uint(value,
+                       (guint) (self->scheduler->budget() / GST_USECOND));
+      break;
+    case PROP_SKIPPED_FRAMES:
+      g_value_set_uint64(value, self->scheduler->skipped());
+      break;
+    case PROP_POST_VIOLATIONS:
+      g_value_set_boolean(value, self->post_violations);
+      break;
+    case PROP_VIOLATION_DISTANCE:
+      g_value_set_float(value, self->violations->distance());
+      break;
+    case PROP_VIOLATION_WINDOW:
+      g_value_set_uint(value,
+                       (guint) (self->violations->window() / GST_MSECOND));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+/* stop watching, and free the filters
+ */
+static void gst_dsanalytics_finalize(GObject* object) {
+  GstDsAnalytics* self = GST_DSANALYTICS(object);
+
+  delete self->distance;
+  delete self->payload;
+  delete self->shedder;
+  delete self->scheduler;
+  delete self->config;
+  delete self->violations;
+
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
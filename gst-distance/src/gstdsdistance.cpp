@@ -26,15 +26,40 @@
  * 
  * DsDistance operates on metadata only.
  *
+ * When downstream is late (see the qos property), only every 2nd, 4th or
+ * 8th buffer is processed until it catches up, and a "ds-qos" element
+ * message is posted whenever that changes.
+ *
+ * Settings that differ per camera go in a config-file (see SourceConfig.hpp
+ * for the format). The file is reparsed off the streaming thread whenever it
+ * changes and the new settings apply from the next batch on.
+ *
+ * With post-violations set, a "ds-violations" element message is posted
+ * when a source's violation (people closer than violation-distance person
+ * heights) starts, ends or changes size. Changes within violation-window
+ * are coalesced into one message, so flickering detections don't flood the
+ * bus.
+ *
  * <refsect2>
  * <title>Example usage</title>
  * |[
  * ... ! nvinfer ! nvtracker ! dsdistance ! nvosd ...
  * ]|
+ * |[
+ * ... ! nvtracker ! dsdistance config-file=/etc/dsdistance/sources.conf ! ...
+ * ]|
+ * |[
+ * ... ! nvtracker ! dsdistance post-violations=true violation-window=2000 ! ...
+ * ]|
  * </refsect2>
  */
 
 #include "gstdsdistance.h"
+#include "gstdsmetrics.h"
+#include "gstdsqos.h"
+#include "gstdsschedule.h"
+#include "gstdsstats.h"
+#include "gstdsviolations.h"
 
 #include "config.h"
 
@@ -44,6 +69,9 @@
 #include <gst/gst.h>
 #include <gst/video/video-format.h>
 
+// deepstream
+#include <gstnvdsmeta.h>
+
 GST_DEBUG_CATEGORY_STATIC(gst_dsdistance_debug);
 #define GST_CAT_DEFAULT gst_dsdistance_debug
 
@@ -59,6 +87,10 @@ static const char ELEMENT_AUTHOR_AND_EMAIL[] = PACKAGE_AUTHOR " " PACKAGE_EMAIL;
 static const int MAX_CLASS_ID = 4096;
 static const int DEFAULT_CLASS_ID = 0;
 static const bool DEFAULT_DO_DRAWING = true;
+static const gfloat DEFAULT_VIOLATION_DISTANCE = 1.0f;  // person heights
+static const guint DEFAULT_VIOLATION_WINDOW = 1000;  // ms of pts
+/* forget a source's violation after this long without a frame from it */
+static const guint64 VIOLATION_SOURCE_TIMEOUT = 60 * GST_SECOND;
 
 /* Filter signals and args */
 enum {
@@ -71,25 +103,37 @@ enum {
   PROP_SILENT,
   PROP_CLASS_ID,
   PROP_DO_DRAWING,
+  PROP_STATS,
+  PROP_PRIORITIES,
+  PROP_BUDGET,
+  PROP_SKIPPED_FRAMES,
+  PROP_CONFIG_FILE,
+  PROP_CONFIG_RELOADS,
+  PROP_POST_VIOLATIONS,
+  PROP_VIOLATION_DISTANCE,
+  PROP_VIOLATION_WINDOW,
 };
 
 /* the capabilities of the inputs and outputs.
  *
  * static src and sink are both: video/x-raw(memory:NVMM) {NV12, RGBA}
+ * or video/x-raw {NV12, RGBA} (system memory, eg. from dsfakemetasrc)
  */
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
     "sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
     "src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 #define gst_dsdistance_parent_class parent_class
 G_DEFINE_TYPE(GstDsDistance, gst_dsdistance, GST_TYPE_BASE_TRANSFORM);
@@ -103,9 +147,15 @@ static void gst_dsdistance_get_property(GObject* object,
                                         GValue* value,
                                         GParamSpec* pspec);
 
+static void gst_dsdistance_finalize(GObject* object);
+
 static GstFlowReturn gst_dsdistance_transform_ip(GstBaseTransform* base,
                                                  GstBuffer* outbuf);
 static gboolean gst_dsdistance_start(GstBaseTransform* base);
+static gboolean gst_dsdistance_src_event(GstBaseTransform* base,
+                                         GstEvent* event);
+static gboolean gst_dsdistance_sink_event(GstBaseTransform* base,
+                                          GstEvent* event);
 static gboolean gst_dsdistance_stop(GstBaseTransform* base);
 
 /* GObject vmethod implementations */
@@ -120,6 +170,7 @@ static void gst_dsdistance_class_init(GstDsDistanceClass* klass) {
 
   gobject_class->set_property = gst_dsdistance_set_property;
   gobject_class->get_property = gst_dsdistance_get_property;
+  gobject_class->finalize = gst_dsdistance_finalize;
 
   // silent property
   g_object_class_install_property(
@@ -144,6 +195,46 @@ static void gst_dsdistance_class_init(GstDsDistanceClass* klass) {
           "class-id", "ClassID", "Class id of a person.", 0, MAX_CLASS_ID, DEFAULT_CLASS_ID,
           GParamFlags(G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE)));
 
+  // stats property
+  g_object_class_install_property(gobject_class, PROP_STATS,
+                                  gst_ds_stats_param_spec());
+
+  // priorities, budget and skipped-frames properties
+  g_object_class_install_property(gobject_class, PROP_PRIORITIES,
+                                  gst_ds_schedule_priorities_param_spec());
+  g_object_class_install_property(gobject_class, PROP_BUDGET,
+                                  gst_ds_schedule_budget_param_spec());
+  g_object_class_install_property(gobject_class, PROP_SKIPPED_FRAMES,
+                                  gst_ds_schedule_skipped_param_spec());
+
+  // config-file property
+  g_object_class_install_property(
+      gobject_class, PROP_CONFIG_FILE,
+      g_param_spec_string(
+          "config-file", "ConfigFile",
+          "Per source settings (enabled, class-id, do-drawing), reloaded "
+          "whenever the file changes.",
+          nullptr, GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  // config-reloads property
+  g_object_class_install_property(
+      gobject_class, PROP_CONFIG_RELOADS,
+      g_param_spec_uint64(
+          "config-reloads", "ConfigReloads",
+          "Number of times config-file was reloaded after a change.",
+          0, G_MAXUINT64, 0,
+          GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  // post-violations, violation-distance and violation-window properties
+  g_object_class_install_property(gobject_class, PROP_POST_VIOLATIONS,
+                                  gst_ds_violations_post_param_spec());
+  g_object_class_install_property(
+      gobject_class, PROP_VIOLATION_DISTANCE,
+      gst_ds_violations_distance_param_spec(DEFAULT_VIOLATION_DISTANCE));
+  g_object_class_install_property(
+      gobject_class, PROP_VIOLATION_WINDOW,
+      gst_ds_violations_window_param_spec(DEFAULT_VIOLATION_WINDOW));
+
   gst_element_class_set_details_simple(gstelement_class, ELEMENT_LONG_NAME,
                                        ELEMENT_TYPE, ELEMENT_DESCRIPTION,
                                        ELEMENT_AUTHOR_AND_EMAIL);
@@ -161,6 +252,10 @@ static void gst_dsdistance_class_init(GstDsDistanceClass* klass) {
       GST_DEBUG_FUNCPTR(gst_dsdistance_start);
   GST_BASE_TRANSFORM_CLASS(klass)->stop =
       GST_DEBUG_FUNCPTR(gst_dsdistance_stop);
+  GST_BASE_TRANSFORM_CLASS(klass)->src_event =
+      GST_DEBUG_FUNCPTR(gst_dsdistance_src_event);
+  GST_BASE_TRANSFORM_CLASS(klass)->sink_event =
+      GST_DEBUG_FUNCPTR(gst_dsdistance_sink_event);
 
   /* debug category for fltering log messages
    */
@@ -175,12 +270,31 @@ static void gst_dsdistance_init(GstDsDistance* self) {
   GST_DEBUG("dsdistance init");
   self->silent = false;
 
-  /* create a DistanceFilter for this instance
+  /* create a DistanceFilter for this instance, kept until finalize so a
+   * PLAYING -> READY -> PLAYING cycle reuses it
    */
   self->filter = new DistanceFilter();
 
   self->filter->class_id = DEFAULT_CLASS_ID;
   self->filter->do_drawing = DEFAULT_DO_DRAWING;
+  self->class_id = DEFAULT_CLASS_ID;
+  self->do_drawing = DEFAULT_DO_DRAWING;
+  self->config = new ds::SourceConfigWatcher();
+
+  ds::SourceTableLimits limits;
+  limits.idle_timeout = VIOLATION_SOURCE_TIMEOUT;
+  self->violations = new ds::ViolationTracker(
+      DEFAULT_VIOLATION_DISTANCE, DEFAULT_VIOLATION_WINDOW * GST_MSECOND,
+      limits);
+  self->post_violations = FALSE;
+
+  self->stats = new ds::ElementStats();
+  gst_ds_metrics_add_stats(GST_ELEMENT(self), self->stats);
+
+  // shed load rather than fall further behind (see the qos property)
+  self->shedder = new ds::LoadShedder();
+  self->scheduler = new ds::FrameScheduler();
+  gst_base_transform_set_qos_enabled(GST_BASE_TRANSFORM(self), TRUE);
 }
 
 /* start the element and create external resources
@@ -190,6 +304,14 @@ static void gst_dsdistance_init(GstDsDistance* self) {
 
 static gboolean gst_dsdistance_start(GstBaseTransform* base) {
   GST_DEBUG_OBJECT(base, "start");
+  GstDsDistance* self = GST_DSDISTANCE(base);
+  self->shedder->reset();
+  // the settings loaded so far still apply if the file can't be watched
+  // (a no-op if still watching from before the last stop)
+  if (!self->config->start()) {
+    GST_WARNING_OBJECT(self, "not watching %s for changes",
+                       self->config->path().c_str());
+  }
   return true;
 }
 
@@ -200,12 +322,41 @@ static gboolean gst_dsdistance_start(GstBaseTransform* base) {
 
 static gboolean gst_dsdistance_stop(GstBaseTransform* base) {
   GST_DEBUG_OBJECT(base, "stop");
-  GstDsDistance* self = GST_DSDISTANCE(base);
 
-  /* destroy the DistanceFilter
+  /* the filter and the config watcher outlive a stop, so a restart costs
+   * nothing (they are freed in finalize)
    */
-  delete self->filter;
 
+  // the next stream starts with no violations (streaming has stopped)
+  GST_DSDISTANCE(base)->violations->reset();
+
+  return true;
+}
+
+/* a config file's settings for one batch
+ */
+typedef struct {
+  DistanceFilter* filter;
+  const ds::SourceConfig* config;
+  gint class_id;
+  gboolean do_drawing;
+} GstDsDistanceBatchConfig;
+
+/* apply the settings for a frame's source before it's processed
+ */
+static gboolean gst_dsdistance_prepare_frame(NvDsFrameMeta* frame_meta,
+                                             gpointer user_data) {
+  auto batch = (GstDsDistanceBatchConfig*) user_data;
+  const ds::SourceSettings& settings =
+      batch->config->settings(frame_meta->source_id);
+  if (!settings.enabled) {
+    return false;
+  }
+  batch->filter->class_id =
+      settings.class_id < 0 ? batch->class_id : settings.class_id;
+  batch->filter->do_drawing =
+      settings.do_drawing < 0 ? (bool) batch->do_drawing
+                              : settings.do_drawing != 0;
   return true;
 }
 
@@ -221,7 +372,66 @@ static GstFlowReturn gst_dsdistance_transform_ip(GstBaseTransform* base,
   if (GST_CLOCK_TIME_IS_VALID(GST_BUFFER_TIMESTAMP(outbuf)))
     gst_object_sync_values(GST_OBJECT(filter), GST_BUFFER_TIMESTAMP(outbuf));
 
-  return filter->filter->on_buffer(outbuf);
+  if (!gst_ds_qos_should_process(base, filter->shedder)) {
+    GST_LOG_OBJECT(filter, "late, passing buffer through");
+    return GST_FLOW_OK;
+  }
+
+  // one config for the whole batch, however often the file changes
+  std::shared_ptr<const ds::SourceConfig> config = filter->config->config();
+
+  GstClockTime start = gst_util_get_timestamp();
+  GstFlowReturn ret = GST_FLOW_OK;
+  if (config != nullptr) {
+    GstDsDistanceBatchConfig batch = {filter->filter, config.get(),
+                                      filter->class_id, filter->do_drawing};
+    ret = gst_ds_schedule_frames(filter->scheduler, filter->filter, outbuf,
+                                 start, gst_dsdistance_prepare_frame, &batch);
+    filter->filter->class_id = batch.class_id;
+    filter->filter->do_drawing = (bool) batch.do_drawing;
+  } else if (filter->scheduler->active()) {
+    ret = gst_ds_schedule_frames(filter->scheduler, filter->filter, outbuf,
+                                 start, nullptr, nullptr);
+  } else {
+    ret = filter->filter->on_buffer(outbuf);
+  }
+  GstClockTime elapsed = gst_util_get_timestamp() - start;
+
+  // the people are only walked here if violations are posted
+  guint64 pairs = 0;
+  if (filter->post_violations) {
+    pairs = gst_ds_violations_add(GST_ELEMENT(filter), filter->violations,
+                                  outbuf, config.get(), filter->class_id);
+  }
+  gst_ds_stats_add(filter->stats, outbuf, pairs, elapsed);
+
+  return ret;
+}
+
+/* shed load on QoS events (sent upstream by a late sink)
+ */
+static gboolean gst_dsdistance_src_event(GstBaseTransform* base,
+                                         GstEvent* event) {
+  if (GST_EVENT_TYPE(event) == GST_EVENT_QOS) {
+    return gst_ds_qos_src_event(base, GST_DSDISTANCE(base)->shedder, event);
+  }
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->src_event(base, event);
+}
+
+/* end the violations of sources that go away, and post what's pending on eos
+ *
+ * https://gstreamer.freedesktop.org/documentation/base/gstbasetransform.html?gi-language=c#GstBaseTransformClass::sink_event
+ */
+static gboolean gst_dsdistance_sink_event(GstBaseTransform* base,
+                                          GstEvent* event) {
+  GstDsDistance* self = GST_DSDISTANCE(base);
+
+  // serialized, so this is the streaming thread, between buffers
+  if (self->post_violations) {
+    gst_ds_violations_sink_event(GST_ELEMENT(self), self->violations, event);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->sink_event(base, event);
 }
 
 /* __setattr__
@@ -237,10 +447,38 @@ static void gst_dsdistance_set_property(GObject* object,
       filter->silent = g_value_get_boolean(value);
       break;
     case PROP_DO_DRAWING:
-      filter->filter->do_drawing = (bool) g_value_get_boolean(value);
+      filter->do_drawing = g_value_get_boolean(value);
+      filter->filter->do_drawing = (bool) filter->do_drawing;
       break;
     case PROP_CLASS_ID:
-      filter->filter->class_id = g_value_get_int(value);
+      filter->class_id = g_value_get_int(value);
+      filter->filter->class_id = filter->class_id;
+      break;
+    case PROP_CONFIG_FILE: {
+      const gchar* path = g_value_get_string(value);
+      std::string error;
+      if (!filter->config->set_path(path == nullptr ? "" : path, &error)) {
+        GST_WARNING_OBJECT(filter, "could not load config-file: %s",
+                           error.c_str());
+      }
+      break;
+    }
+    case PROP_PRIORITIES:
+      gst_ds_schedule_set_priorities(object, filter->scheduler, value);
+      break;
+    case PROP_BUDGET:
+      filter->scheduler->set_budget((guint64) g_value_get_uint(value) *
+                                    GST_USECOND);
+      break;
+    case PROP_POST_VIOLATIONS:
+      filter->post_violations = g_value_get_boolean(value);
+      break;
+    case PROP_VIOLATION_DISTANCE:
+      filter->violations->set_distance(g_value_get_float(value));
+      break;
+    case PROP_VIOLATION_WINDOW:
+      filter->violations->set_window((guint64) g_value_get_uint(value) *
+                                     GST_MSECOND);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
@@ -261,13 +499,61 @@ static void gst_dsdistance_get_property(GObject* object,
       g_value_set_boolean(value, filter->silent);
       break;
     case PROP_DO_DRAWING:
-      g_value_set_boolean(value, (gboolean) filter->filter->do_drawing);
+      g_value_set_boolean(value, filter->do_drawing);
       break;
     case PROP_CLASS_ID:
-      g_value_set_int(value, filter->filter->class_id);
+      g_value_set_int(value, filter->class_id);
+      break;
+    case PROP_CONFIG_FILE: {
+      std::string path = filter->config->path();
+      g_value_set_string(value, path.empty() ? nullptr : path.c_str());
+      break;
+    }
+    case PROP_CONFIG_RELOADS:
+      g_value_set_uint64(value, filter->config->reloads());
+      break;
+    case PROP_PRIORITIES:
+      g_value_set_string(value, filter->scheduler->priorities().c_str());
+      break;
+    case PROP_BUDGET:
+      g_value_set_uint(value,
+                       (guint) (filter->scheduler->budget() / GST_USECOND));
+      break;
+    case PROP_SKIPPED_FRAMES:
+      g_value_set_uint64(value, filter->scheduler->skipped());
+      break;
+    case PROP_POST_VIOLATIONS:
+      g_value_set_boolean(value, filter->post_violations);
+      break;
+    case PROP_VIOLATION_DISTANCE:
+      g_value_set_float(value, filter->violations->distance());
+      break;
+    case PROP_VIOLATION_WINDOW:
+      g_value_set_uint(value,
+                       (guint) (filter->violations->window() / GST_MSECOND));
+      break;
+    case PROP_STATS:
+      g_value_take_boxed(
+          value, gst_ds_stats_new_structure(filter->stats->snapshot()));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
   }
 }
+
+/* stop exporting and watching, and free the filter and the stats
+ */
+static void gst_dsdistance_finalize(GObject* object) {
+  GstDsDistance* self = GST_DSDISTANCE(object);
+
+  gst_ds_metrics_remove(GST_ELEMENT(self));
+  delete self->filter;
+  delete self->stats;
+  delete self->shedder;
+  delete self->scheduler;
+  delete self->config;
+  delete self->violations;
+
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "gstdsevent.h"
+
+// deepstream
+#include <gst-nvevent.h>
+
+gboolean gst_ds_event_parse_source_gone(GstEvent* event, guint* source_id) {
+  switch ((GstNvEventType) GST_EVENT_TYPE(event)) {
+    case GST_NVEVENT_STREAM_EOS:
+      gst_nvevent_parse_stream_eos(event, source_id);
+      return true;
+    case GST_NVEVENT_PAD_DELETED:
+      gst_nvevent_parse_pad_deleted(event, source_id);
+      return true;
+    default:
+      return false;
+  }
+}
@@ -0,0 +1,496 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * SECTION:element-dsfakemetasrc
+ *
+ * DsFakeMetaSrc is a source of synthetic DeepStream metadata for load
+ * testing without a GPU.
+ *
+ * Each buffer carries an NvDsBatchMeta with batch-size frames and
+ * objects-per-frame people per frame, as nvinfer and nvtracker would leave
+ * it. Buffers have no pixel data (like NVMM buffers, the payload is the
+ * metadata), so only metadata-only elements and sinks should follow.
+ *
+ * <refsect2>
+ * <title>Example usage</title>
+ * |[
+ * gst-launch-1.0 dsfakemetasrc batch-size=8 objects-per-frame=40 \
+ *   motion=random id-churn=0.01 num-buffers=1000 ! dsdistance ! \
+ *   dspayloadbroker mode=records ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#include "gstdsfakemetasrc.h"
+
+#include "FakeBatchMeta.hpp"
+
+#include "config.h"
+
+// gstreamer
+#include <gst/base/base.h>
+#include <gst/gst.h>
+#include <gst/video/video-format.h>
+
+// deepstream
+#include <gst-nvevent.h>
+
+GST_DEBUG_CATEGORY_STATIC(gst_dsfakemetasrc_debug);
+#define GST_CAT_DEFAULT gst_dsfakemetasrc_debug
+
+static const char ELEMENT_NAME[] = "dsfakemetasrc";
+static const char ELEMENT_LONG_NAME[] =
+    "DeepStream synthetic metadata source";
+static const char ELEMENT_TYPE[] = "Source/Video";
+static const char ELEMENT_DESCRIPTION[] =
+    "Make batches of moving people without a GPU.";
+static const char ELEMENT_AUTHOR_AND_EMAIL[] = PACKAGE_AUTHOR " " PACKAGE_EMAIL;
+
+static const guint MAX_BATCH_SIZE = 1024;
+static const guint DEFAULT_BATCH_SIZE = 1;
+static const guint MAX_OBJECTS_PER_FRAME = 4096;
+static const guint DEFAULT_OBJECTS_PER_FRAME = 10;
+static const GstDsFakeMetaSrcMotion DEFAULT_MOTION =
+    FAKE_META_SRC_MOTION_LINEAR;
+static const gdouble DEFAULT_ID_CHURN = 0.0;
+static const int MAX_CLASS_ID = 4096;
+static const int DEFAULT_CLASS_ID = 0;
+static const guint64 DEFAULT_SEED = 0;
+static const guint DEFAULT_SOURCE_CHURN = 0;  // batches, disabled
+/** used when downstream doesn't care */
+static const int DEFAULT_WIDTH = 1920;
+static const int DEFAULT_HEIGHT = 1080;
+static const int DEFAULT_FPS_N = 30;
+static const int DEFAULT_FPS_D = 1;
+
+enum {
+  PROP_0,
+  PROP_SILENT,
+  PROP_BATCH_SIZE,
+  PROP_OBJECTS_PER_FRAME,
+  PROP_MOTION,
+  PROP_ID_CHURN,
+  PROP_CLASS_ID,
+  PROP_SEED,
+  PROP_SOURCE_CHURN,
+};
+
+#define GST_TYPE_FAKE_META_SRC_MOTION \
+  (gst_fake_meta_src_motion_get_type())
+static GType
+gst_fake_meta_src_motion_get_type (void)
+{
+  static GType dsfakemetasrc_motion_type = 0;
+  static const GEnumValue dsfakemetasrc_motion[] = {
+    {FAKE_META_SRC_MOTION_STATIC, "people stand still", "static"},
+    {FAKE_META_SRC_MOTION_LINEAR, "people walk in straight lines", "linear"},
+    {FAKE_META_SRC_MOTION_RANDOM, "people change direction at random", "random"},
+    {0, nullptr, nullptr},
+  };
+
+  if (!dsfakemetasrc_motion_type) {
+    dsfakemetasrc_motion_type =
+        g_enum_register_static ("GstDsFakeMetaSrcMotionType",
+                                dsfakemetasrc_motion);
+  }
+  return dsfakemetasrc_motion_type;
+}
+
+/* the capabilities of the output.
+ *
+ * static src is: video/x-raw {NV12, RGBA} (system memory, no pixel data)
+ */
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
+    "src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS(GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
+
+#define gst_dsfakemetasrc_parent_class parent_class
+G_DEFINE_TYPE(GstDsFakeMetaSrc, gst_dsfakemetasrc, GST_TYPE_PUSH_SRC);
+
+static void gst_dsfakemetasrc_set_property(GObject* object,
+                                           guint prop_id,
+                                           const GValue* value,
+                                           GParamSpec* pspec);
+static void gst_dsfakemetasrc_get_property(GObject* object,
+                                           guint prop_id,
+                                           GValue* value,
+                                           GParamSpec* pspec);
+
+static GstCaps* gst_dsfakemetasrc_fixate(GstBaseSrc* base, GstCaps* caps);
+static gboolean gst_dsfakemetasrc_set_caps(GstBaseSrc* base, GstCaps* caps);
+static gboolean gst_dsfakemetasrc_start(GstBaseSrc* base);
+static gboolean gst_dsfakemetasrc_stop(GstBaseSrc* base);
+static GstFlowReturn gst_dsfakemetasrc_create(GstPushSrc* src,
+                                              GstBuffer** buf);
+
+/* GObject vmethod implementations */
+
+/* initialize the dsfakemetasrc's class */
+static void gst_dsfakemetasrc_class_init(GstDsFakeMetaSrcClass* klass) {
+  GObjectClass* gobject_class;
+  GstElementClass* gstelement_class;
+
+  gobject_class = (GObjectClass*)klass;
+  gstelement_class = (GstElementClass*)klass;
+
+  gobject_class->set_property = gst_dsfakemetasrc_set_property;
+  gobject_class->get_property = gst_dsfakemetasrc_get_property;
+
+  // silent property
+  g_object_class_install_property(
+    gobject_class, PROP_SILENT,
+    g_param_spec_boolean(
+      "silent", "Silent", "Produce verbose output ?", FALSE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+
+  // batch-size property
+  g_object_class_install_property(
+    gobject_class, PROP_BATCH_SIZE,
+    g_param_spec_uint("batch-size", "Batch size",
+      "Frames (sources) per batch.",
+      1, MAX_BATCH_SIZE, DEFAULT_BATCH_SIZE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // objects-per-frame property
+  g_object_class_install_property(
+    gobject_class, PROP_OBJECTS_PER_FRAME,
+    g_param_spec_uint("objects-per-frame", "Objects per frame",
+      "People in each frame.",
+      0, MAX_OBJECTS_PER_FRAME, DEFAULT_OBJECTS_PER_FRAME,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // motion property
+  g_object_class_install_property(
+    gobject_class, PROP_MOTION,
+    g_param_spec_enum("motion", "Motion",
+      "How people move from frame to frame.",
+      GST_TYPE_FAKE_META_SRC_MOTION, DEFAULT_MOTION,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // id-churn property
+  g_object_class_install_property(
+    gobject_class, PROP_ID_CHURN,
+    g_param_spec_double("id-churn", "Id churn",
+      "Chance per person per frame that the tracker id changes.",
+      0.0, 1.0, DEFAULT_ID_CHURN,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // class-id property
+  g_object_class_install_property(
+    gobject_class, PROP_CLASS_ID,
+    g_param_spec_int("class-id", "ClassID",
+      "Class id of the people (match dsdistance's class-id).",
+      0, MAX_CLASS_ID, DEFAULT_CLASS_ID,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // seed property
+  g_object_class_install_property(
+    gobject_class, PROP_SEED,
+    g_param_spec_uint64("seed", "Seed",
+      "Random seed (the same seed always makes the same scene).",
+      0, G_MAXUINT64, DEFAULT_SEED,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // source-churn property
+  g_object_class_install_property(
+    gobject_class, PROP_SOURCE_CHURN,
+    g_param_spec_uint("source-churn", "Source churn",
+      "Replace every source with a new source id each this many batches, "
+      "sending a stream eos for the old ones like nvstreammux does when "
+      "sources are removed (0 to keep the same sources).",
+      0, G_MAXUINT, DEFAULT_SOURCE_CHURN,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  gst_element_class_set_details_simple(gstelement_class, ELEMENT_LONG_NAME,
+                                       ELEMENT_TYPE, ELEMENT_DESCRIPTION,
+                                       ELEMENT_AUTHOR_AND_EMAIL);
+
+  gst_element_class_add_pad_template(
+      gstelement_class, gst_static_pad_template_get(&src_template));
+
+  /* register vmethods
+   */
+  GST_BASE_SRC_CLASS(klass)->fixate =
+      GST_DEBUG_FUNCPTR(gst_dsfakemetasrc_fixate);
+  GST_BASE_SRC_CLASS(klass)->set_caps =
+      GST_DEBUG_FUNCPTR(gst_dsfakemetasrc_set_caps);
+  GST_BASE_SRC_CLASS(klass)->start =
+      GST_DEBUG_FUNCPTR(gst_dsfakemetasrc_start);
+  GST_BASE_SRC_CLASS(klass)->stop =
+      GST_DEBUG_FUNCPTR(gst_dsfakemetasrc_stop);
+  GST_PUSH_SRC_CLASS(klass)->create =
+      GST_DEBUG_FUNCPTR(gst_dsfakemetasrc_create);
+
+  /* debug category for fltering log messages
+   */
+  GST_DEBUG_CATEGORY_INIT(gst_dsfakemetasrc_debug, ELEMENT_NAME, 0,
+                          ELEMENT_DESCRIPTION);
+}
+
+/* initialize the new element
+ * initialize instance structure
+ */
+static void gst_dsfakemetasrc_init(GstDsFakeMetaSrc* self) {
+  GST_DEBUG("dsfakemetasrc init");
+  self->scene = nullptr;
+  self->width = DEFAULT_WIDTH;
+  self->height = DEFAULT_HEIGHT;
+  self->fps_n = DEFAULT_FPS_N;
+  self->fps_d = DEFAULT_FPS_D;
+  self->frame_num = 0;
+
+  self->silent = false;
+  self->batch_size = DEFAULT_BATCH_SIZE;
+  self->objects_per_frame = DEFAULT_OBJECTS_PER_FRAME;
+  self->motion = DEFAULT_MOTION;
+  self->id_churn = DEFAULT_ID_CHURN;
+  self->class_id = DEFAULT_CLASS_ID;
+  self->seed = DEFAULT_SEED;
+  self->source_churn = DEFAULT_SOURCE_CHURN;
+
+  gst_base_src_set_format(GST_BASE_SRC(self), GST_FORMAT_TIME);
+  gst_base_src_set_live(GST_BASE_SRC(self), FALSE);
+}
+
+/* pick the default size and framerate when downstream allows a range
+ */
+static GstCaps* gst_dsfakemetasrc_fixate(GstBaseSrc* base, GstCaps* caps) {
+  caps = gst_caps_make_writable(caps);
+  GstStructure* structure = gst_caps_get_structure(caps, 0);
+
+  gst_structure_fixate_field_nearest_int(structure, "width", DEFAULT_WIDTH);
+  gst_structure_fixate_field_nearest_int(structure, "height", DEFAULT_HEIGHT);
+  gst_structure_fixate_field_nearest_fraction(structure, "framerate",
+                                              DEFAULT_FPS_N, DEFAULT_FPS_D);
+
+  return GST_BASE_SRC_CLASS(parent_class)->fixate(base, caps);
+}
+
+/* (re)create the scene for the negotiated frame size
+ */
+static gboolean gst_dsfakemetasrc_set_caps(GstBaseSrc* base, GstCaps* caps) {
+  GstDsFakeMetaSrc* self = GST_DSFAKEMETASRC(base);
+  GstStructure* structure = gst_caps_get_structure(caps, 0);
+
+  if (!gst_structure_get_int(structure, "width", &self->width) ||
+      !gst_structure_get_int(structure, "height", &self->height) ||
+      !gst_structure_get_fraction(structure, "framerate", &self->fps_n,
+                                  &self->fps_d)) {
+    GST_ERROR_OBJECT(self, "caps are not fixed: %" GST_PTR_FORMAT, caps);
+    return false;
+  }
+
+  ds::FakeScene::Motion motion = ds::FakeScene::MOTION_LINEAR;
+  switch (self->motion) {
+    case FAKE_META_SRC_MOTION_STATIC:
+      motion = ds::FakeScene::MOTION_STATIC;
+      break;
+    case FAKE_META_SRC_MOTION_LINEAR:
+      motion = ds::FakeScene::MOTION_LINEAR;
+      break;
+    case FAKE_META_SRC_MOTION_RANDOM:
+      motion = ds::FakeScene::MOTION_RANDOM;
+      break;
+  }
+
+  delete self->scene;
+  self->scene = new ds::FakeScene(
+      self->batch_size, self->objects_per_frame, motion, self->id_churn,
+      (uint32_t)self->width, (uint32_t)self->height, self->seed);
+
+  GST_INFO_OBJECT(self, "%u sources of %u people at %dx%d", self->batch_size,
+                  self->objects_per_frame, self->width, self->height);
+  return true;
+}
+
+/* start the element and create external resources
+ *
+ * https://gstreamer.freedesktop.org/documentation/base/gstbasesrc.html?gi-language=c#GstBaseSrcClass::start
+ */
+static gboolean gst_dsfakemetasrc_start(GstBaseSrc* base) {
+  GST_DEBUG_OBJECT(base, "start");
+  GstDsFakeMetaSrc* self = GST_DSFAKEMETASRC(base);
+
+  self->frame_num = 0;
+
+  return true;
+}
+
+/* stop the element and free external resources
+ *
+ * https://gstreamer.freedesktop.org/documentation/base/gstbasesrc.html?gi-language=c#GstBaseSrcClass::stop
+ */
+static gboolean gst_dsfakemetasrc_stop(GstBaseSrc* base) {
+  GST_DEBUG_OBJECT(base, "stop");
+  GstDsFakeMetaSrc* self = GST_DSFAKEMETASRC(base);
+
+  delete self->scene;
+  self->scene = nullptr;
+
+  return true;
+}
+
+/* tell downstream sources [first, end) are gone
+ */
+static void gst_dsfakemetasrc_send_stream_eos(GstDsFakeMetaSrc* self,
+                                              guint32 first,
+                                              guint32 end) {
+  for (guint32 source_id = first; source_id < end; source_id++) {
+    gst_pad_push_event(GST_BASE_SRC_PAD(self),
+                       gst_nvevent_new_stream_eos(source_id));
+  }
+}
+
+/* make the next buffer
+ */
+static GstFlowReturn gst_dsfakemetasrc_create(GstPushSrc* src,
+                                              GstBuffer** buf) {
+  GstDsFakeMetaSrc* self = GST_DSFAKEMETASRC(src);
+
+  if (self->scene == nullptr) {
+    GST_ELEMENT_ERROR(self, CORE, NEGOTIATION, (nullptr),
+                      ("no caps set before the first buffer"));
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  if (self->frame_num > 0) {
+    self->scene->step();
+  }
+
+  GstBuffer* buffer = gst_buffer_new();
+  if (self->fps_n > 0) {
+    GST_BUFFER_PTS(buffer) = gst_util_uint64_scale(
+        self->frame_num, self->fps_d * GST_SECOND, self->fps_n);
+    GST_BUFFER_DURATION(buffer) =
+        gst_util_uint64_scale_int(GST_SECOND, self->fps_d, self->fps_n);
+  } else {
+    GST_BUFFER_PTS(buffer) = 0;
+  }
+  GST_BUFFER_DTS(buffer) = GST_BUFFER_PTS(buffer);
+  GST_BUFFER_OFFSET(buffer) = self->frame_num;
+  GST_BUFFER_OFFSET_END(buffer) = self->frame_num + 1;
+
+  guint32 first_source_id = 0;
+  if (self->source_churn) {
+    guint64 generation = self->frame_num / self->source_churn;
+    first_source_id = (guint32) (generation * self->batch_size);
+    if (generation > 0 && self->frame_num % self->source_churn == 0) {
+      gst_dsfakemetasrc_send_stream_eos(
+          self, first_source_id - self->batch_size, first_source_id);
+    }
+  }
+  ds::add_fake_batch_meta(buffer, *self->scene, self->frame_num,
+                          self->class_id, first_source_id);
+
+  if (self->silent == FALSE)
+    GST_LOG_OBJECT(self, "made frame %" G_GUINT64_FORMAT, self->frame_num);
+
+  self->frame_num++;
+  *buf = buffer;
+  return GST_FLOW_OK;
+}
+
+/* __setattr__
+ */
+static void gst_dsfakemetasrc_set_property(GObject* object,
+                                           guint prop_id,
+                                           const GValue* value,
+                                           GParamSpec* pspec) {
+  GstDsFakeMetaSrc* self = GST_DSFAKEMETASRC(object);
+
+  switch (prop_id) {
+    case PROP_SILENT:
+      self->silent = g_value_get_boolean(value);
+      break;
+    case PROP_BATCH_SIZE:
+      self->batch_size = g_value_get_uint(value);
+      break;
+    case PROP_OBJECTS_PER_FRAME:
+      self->objects_per_frame = g_value_get_uint(value);
+      break;
+    case PROP_MOTION:
+      self->motion = (GstDsFakeMetaSrcMotion) g_value_get_enum(value);
+      break;
+    case PROP_ID_CHURN:
+      self->id_churn = g_value_get_double(value);
+      break;
+    case PROP_CLASS_ID:
+      self->class_id = g_value_get_int(value);
+      break;
+    case PROP_SEED:
+      self->seed = g_value_get_uint64(value);
+      break;
+    case PROP_SOURCE_CHURN:
+      self->source_churn = g_value_get_uint(value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
+
+/* __getattr__
+ */
+static void gst_dsfakemetasrc_get_property(GObject* object,
+                                           guint prop_id,
+                                           GValue* value,
+                                           GParamSpec* pspec) {
+  GstDsFakeMetaSrc* self = GST_DSFAKEMETASRC(object);
+
+  switch (prop_id) {
+    case PROP_SILENT:
+      g_value_set_boolean(value, self->silent);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint(value, self->batch_size);
+      break;
+    case PROP_OBJECTS_PER_FRAME:
+      g_value_set_uint(value, self->objects_per_frame);
+      break;
+    case PROP_MOTION:
+      g_value_set_enum(value, self->motion);
+      break;
+    case PROP_ID_CHURN:
+      g_value_set_double(value, self->id_churn);
+      break;
+    case PROP_CLASS_ID:
+      g_value_set_int(value, self->class_id);
+      break;
+    case PROP_SEED:
+      g_value_set_uint64(value, self->seed);
+      break;
+    case PROP_SOURCE_CHURN:
+      g_value_set_uint(value, self->source_churn);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+      break;
+  }
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+/**
+ * SECTION:tracer-dslatency
+ *
+ * A tracer that keeps per buffer latency histograms for dsdistance,
+ * dsprotopayload and dspayloadbroker, broken down by the number of objects
+ * in the batch, and dumps them periodically.
+ *
+ * Latency is from the buffer being pushed into the element to the element
+ * pushing it on. Histograms are per thread, so recording never takes a
+ * lock.
+ *
+ * <refsect2>
+ * <title>Example usage</title>
+ * |[
+ * GST_TRACERS="dslatency(interval=10,file=/tmp/latency.log)" \
+ *   gst-launch-1.0 ... ! dsdistance ! dspayloadbroker ! ...
+ * ]|
+ * Without a file, histograms are logged in the dslatency debug category at
+ * INFO level (GST_DEBUG=dslatency:4). An interval of 0 dumps only when the
+ * tracer is destroyed.
+ * </refsect2>
+ */
+
+#include "gstdslatencytracer.h"
+
+#include "gstdsdistance.h"
+#include "gstdspayloadbroker.h"
+#include "gstdsprotopayload.h"
+
+// deepstream
+#include <gstnvdsmeta.h>
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+GST_DEBUG_CATEGORY_STATIC(gst_dslatencytracer_debug);
+#define GST_CAT_DEFAULT gst_dslatencytracer_debug
+
+static const guint DEFAULT_INTERVAL = 10;
+
+#define gst_dslatencytracer_parent_class parent_class
+G_DEFINE_TYPE_WITH_CODE(GstDsLatencyTracer,
+                        gst_dslatencytracer,
+                        GST_TYPE_TRACER,
+                        GST_DEBUG_CATEGORY_INIT(gst_dslatencytracer_debug,
+                                                "dslatency",
+                                                0,
+                                                "dslatency tracer"));
+
+/** a buffer inside one of our elements on this thread */
+struct Pending {
+  GstElement* element;
+  GstClockTime entered;
+  size_t objects;
+};
+
+/* buffers pass through elements one at a time per streaming thread, so
+ * a handful of entries are enough */
+static thread_local std::vector<Pending> pending;
+
+static bool is_tracked(GstObject* object) {
+  return object != nullptr &&
+         (GST_IS_DSDISTANCE(object) || GST_IS_DSPROTOPAYLOAD(object) ||
+          GST_IS_DSPAYLOADBROKER(object));
+}
+
+static size_t count_objects(GstBuffer* buffer) {
+  NvDsBatchMeta* batch_meta = gst_buffer_get_nvds_batch_meta(buffer);
+  if (batch_meta == nullptr) {
+    return 0;
+  }
+  size_t objects = 0;
+  for (NvDsMetaList* l = batch_meta->frame_meta_list; l; l = l->next) {
+    objects += ((NvDsFrameMeta*)l->data)->num_obj_meta;
+  }
+  return objects;
+}
+
+/* a push out of one of our elements ends its latency; a push into one
+ * starts it */
+static void do_push_buffer_pre(GstTracer* tracer,
+                               GstClockTime ts,
+                               GstPad* pad,
+                               GstBuffer* buffer) {
+  GstDsLatencyTracer* self = GST_DSLATENCYTRACER(tracer);
+
+  GstObject* parent = GST_OBJECT_PARENT(pad);
+  if (is_tracked(parent)) {
+    for (size_t i = 0; i < pending.size(); i++) {
+      if (pending[i].element == (GstElement*)parent) {
+        self->tracker->record(parent, GST_OBJECT_NAME(parent),
+                              pending[i].objects, ts - pending[i].entered);
+        pending[i] = pending.back();
+        pending.pop_back();
+        break;
+      }
+    }
+  }
+
+  GstPad* peer = GST_PAD_PEER(pad);
+  GstObject* peer_parent = peer ? GST_OBJECT_PARENT(peer) : nullptr;
+  if (is_tracked(peer_parent)) {
+    Pending entered = {(GstElement*)peer_parent, ts, count_objects(buffer)};
+    // replaces a buffer the element never pushed on (eg. dropped)
+    for (auto& other : pending) {
+      if (other.element == entered.element) {
+        other = entered;
+        return;
+      }
+    }
+    pending.push_back(entered);
+  }
+}
+
+static void gst_dslatencytracer_dump(GstDsLatencyTracer* self) {
+  std::string dump = self->tracker->dump();
+  if (dump.empty()) {
+    return;
+  }
+  if (self->file == nullptr) {
+    GST_INFO_OBJECT(self, "latency:\n%s", dump.c_str());
+    return;
+  }
+  FILE* f = fopen(self->file, "a");
+  if (f == nullptr) {
+    GST_WARNING_OBJECT(self, "could not open %s", self->file);
+    return;
+  }
+  GDateTime* now = g_date_time_new_now_local();
+  gchar* date = g_date_time_format(now, "%FT%T%z");
+  fprintf(f, "# %s\n%s", date, dump.c_str());
+  fclose(f);
+  g_free(date);
+  g_date_time_unref(now);
+}
+
+static void gst_dslatencytracer_parse_params(GstDsLatencyTracer* self) {
+  gchar* params = nullptr;
+  g_object_get(self, "params", &params, nullptr);
+  if (params == nullptr) {
+    return;
+  }
+  gchar* str = g_strdup_printf("dslatency,%s", params);
+  GstStructure* structure = gst_structure_from_string(str, nullptr);
+  if (structure == nullptr) {
+    GST_WARNING_OBJECT(self, "could not parse params: %s", params);
+  } else {
+    gint interval = 0;
+    if (gst_structure_get_int(structure, "interval", &interval)) {
+      self->interval = (guint)MAX(interval, 0);
+    }
+    const gchar* file = gst_structure_get_string(structure, "file");
+    if (file != nullptr) {
+      self->file = g_strdup(file);
+    }
+    gst_structure_free(structure);
+  }
+  g_free(str);
+  g_free(params);
+}
+
+static void gst_dslatencytracer_constructed(GObject* object) {
+  GstDsLatencyTracer* self = GST_DSLATENCYTRACER(object);
+
+  gst_dslatencytracer_parse_params(self);
+
+  gst_tracing_register_hook(GST_TRACER(self), "pad-push-pre",
+                            G_CALLBACK(do_push_buffer_pre));
+
+  if (self->interval > 0) {
+    self->dumper = new std::thread([self] {
+      std::unique_lock<std::mutex> guard(*self->lock);
+      while (!self->stopping) {
+        self->wake->wait_for(guard, std::chrono::seconds(self->interval));
+        if (!self->stopping) {
+          gst_dslatencytracer_dump(self);
+        }
+      }
+    });
+  }
+
+  G_OBJECT_CLASS(parent_class)->constructed(object);
+}
+
+static void gst_dslatencytracer_finalize(GObject* object) {
+  GstDsLatencyTracer* self = GST_DSLATENCYTRACER(object);
+
+  if (self->dumper != nullptr) {
+    {
+      std::lock_guard<std::mutex> guard(*self->lock);
+      self->stopping = true;
+    }
+    self->wake->notify_all();
+    self->dumper->join();
+    delete self->dumper;
+  }
+  gst_dslatencytracer_dump(self);
+
+  delete self->tracker;
+  delete self->lock;
+  delete self->wake;
+  g_free(self->file);
+
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
+
+static void gst_dslatencytracer_class_init(GstDsLatencyTracerClass* klass) {
+  GObjectClass* gobject_class = (GObjectClass*)klass;
+
+  gobject_class->constructed = gst_dslatencytracer_constructed;
+  gobject_class->finalize = gst_dslatencytracer_finalize;
+}
+
+static void gst_dslatencytracer_init(GstDsLatencyTracer* self) {
+  self->tracker = new ds::LatencyTracker();
+  self->dumper = nullptr;
+  self->lock = new std::mutex();
+  self->wake = new std::condition_variable();
+  self->stopping = false;
+  self->interval = DEFAULT_INTERVAL;
+  self->file = nullptr;
+}
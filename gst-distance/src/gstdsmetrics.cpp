@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "gstdsmetrics.h"
+
+#include "MetricsExporter.hpp"
+
+#include <mutex>
+#include <utility>
+
+GST_DEBUG_CATEGORY_STATIC(gst_ds_metrics_debug);
+#define GST_CAT_DEFAULT gst_ds_metrics_debug
+
+/* parse GST_DISTANCE_METRICS into options
+ */
+static gboolean gst_ds_metrics_parse_env(const gchar* env,
+                                         ds::MetricsExporter::Options* options) {
+  gboolean ok = false;
+  gchar* str = g_strdup_printf("metrics,%s", env);
+  GstStructure* structure = gst_structure_from_string(str, nullptr);
+  g_free(str);
+  if (structure == nullptr) {
+    return false;
+  }
+  const gchar* path = nullptr;
+  if ((path = gst_structure_get_string(structure, "socket")) != nullptr) {
+    options->mode = ds::MetricsExporter::MODE_SOCKET;
+    options->path = path;
+    ok = true;
+  } else if ((path = gst_structure_get_string(structure, "file")) != nullptr) {
+    options->mode = ds::MetricsExporter::MODE_FILE;
+    options->path = path;
+    ok = true;
+  }
+  gint interval = 0;
+  if (gst_structure_get_int(structure, "interval", &interval) &&
+      interval > 0) {
+    options->interval_ms = (unsigned)interval * 1000;
+  }
+  gst_structure_free(structure);
+  return ok;
+}
+
+void gst_ds_metrics_init(void) {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    GST_DEBUG_CATEGORY_INIT(gst_ds_metrics_debug, "dsmetrics", 0,
+                            "gstdistance metrics export");
+    const gchar* env = g_getenv(GST_DS_METRICS_ENV);
+    if (env == nullptr || *env == '\0') {
+      return;
+    }
+    ds::MetricsExporter::Options options;
+    if (!gst_ds_metrics_parse_env(env, &options)) {
+      GST_WARNING("could not parse %s=%s", GST_DS_METRICS_ENV, env);
+      return;
+    }
+    // runs for the rest of the process, like the registry
+    auto exporter = new ds::MetricsExporter(
+        &ds::MetricsRegistry::instance(), std::move(options));
+    if (!exporter->start()) {
+      delete exporter;
+    }
+  });
+}
+
+void gst_ds_metrics_add(GstElement* element,
+                        ds::MetricsRegistry::Collector collector) {
+  ds::MetricsRegistry::instance().add(
+      element, [element, collector](ds::MetricsSample* sample) {
+        GstElementFactory* factory = gst_element_get_factory(element);
+        sample->kind = factory != nullptr ? GST_OBJECT_NAME(factory)
+                                          : G_OBJECT_TYPE_NAME(element);
+        GST_OBJECT_LOCK(element);
+        if (GST_OBJECT_NAME(element) != nullptr) {
+          sample->element = GST_OBJECT_NAME(element);
+        }
+        GST_OBJECT_UNLOCK(element);
+        collector(sample);
+      });
+}
+
+void gst_ds_metrics_add_stats(GstElement* element, ds::ElementStats* stats) {
+  gst_ds_metrics_add(element, [stats](ds::MetricsSample* sample) {
+    sample->stats = stats->snapshot();
+  });
+}
+
+void gst_ds_metrics_remove(GstElement* element) {
+  ds::MetricsRegistry::instance().remove(element);
+}
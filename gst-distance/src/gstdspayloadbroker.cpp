@@ -32,13 +32,27 @@
  * |[
  * ... ! nvinfer ! nvtracker ! dspayloadbroker ! nvosd ...
  * ]|
+ * Several outputs can share one payload:
+ * |[
+ * ... ! dspayloadbroker outputs=property,proto,csv basepath=/tmp/rec ! ...
+ * ]|
+ * In records mode the records property is a GBytes of fixed layout records
+ * (see RecordArrayBroker.hpp) that Python can read without parsing:
+ * |[
+ * records = numpy.frombuffer(broker.props.records.get_data(), dtype)
+ * ]|
  * </refsect2>
  */
 
 #include "gstdspayloadbroker.h"
+#include "gstdsevent.h"
+#include "gstdsmetrics.h"
+#include "gstdsstats.h"
 
-#include "PyPayloadBroker.hpp"
-#include "FileMetaBroker.hpp"
+#include "AsyncFileMetaBroker.hpp"
+#include "FanOutPayloadBroker.hpp"
+#include "RecordArrayBroker.hpp"
+#include "SeqlockPayloadBroker.hpp"
 
 #include "config.h"
 
@@ -48,6 +62,9 @@
 #include <gst/gst.h>
 #include <gst/video/video-format.h>
 
+#include <algorithm>
+#include <vector>
+
 GST_DEBUG_CATEGORY_STATIC(gst_dspayloadbroker_debug);
 #define GST_CAT_DEFAULT gst_dspayloadbroker_debug
 
@@ -57,6 +74,24 @@ static const char ELEMENT_TYPE[] = "Filter";
 static const char ELEMENT_DESCRIPTION[] = "send string based metadata around.";
 static const char ELEMENT_AUTHOR_AND_EMAIL[] = PACKAGE_AUTHOR " " PACKAGE_EMAIL;
 
+static const guint DEFAULT_QUEUE_SIZE = 4096;
+static const guint MAX_QUEUE_SIZE = 1 << 20;
+static const guint DEFAULT_FSYNC_INTERVAL = 1000;  // ms
+static const guint DEFAULT_FSYNC_SIZE = 16;  // MiB
+static const guint DEFAULT_ROTATE_SIZE = 0;  // MiB, disabled
+static const guint DEFAULT_ROTATE_INTERVAL = 0;  // s, disabled
+static const gboolean DEFAULT_INDEX = FALSE;
+static const guint DEFAULT_SYNC_INTERVAL = 64;  // batches
+static const guint DEFAULT_ROW_GROUP_SIZE = 256;  // batches
+static const guint MAX_ROW_GROUP_SIZE = 1 << 16;
+static const guint DEFAULT_WINDOW = 5000;  // ms
+static const gfloat DEFAULT_CLUSTER_DISTANCE = 1.0f;  // person heights
+static const gdouble DEFAULT_MAX_RATE = 1.0;  // frames per second per source
+static const guint DEFAULT_SOURCE_TIMEOUT = 60000;  // ms of pts
+static const guint DEFAULT_SOURCE_MEMORY = 4096;  // KiB per table
+static const gdouble MIN_MAX_RATE = 0.001;
+static const gdouble MAX_MAX_RATE = 1000.0;
+
 /* Filter signals and args */
 enum {
   /* FILL ME */
@@ -67,8 +102,32 @@ enum {
   PROP_0,
   PROP_SILENT,
   PROP_RESULTS,
+  PROP_RECORDS,
   PROP_MODE,
+  PROP_OUTPUTS,
+  PROP_SAMPLING,
+  PROP_MAX_RATE,
   PROP_BASEPATH,
+  PROP_QUEUE_SIZE,
+  PROP_FSYNC_MODE,
+  PROP_FSYNC_INTERVAL,
+  PROP_FSYNC_SIZE,
+  PROP_ROTATE_SIZE,
+  PROP_ROTATE_INTERVAL,
+  PROP_IO_BACKEND,
+  PROP_INDEX,
+  PROP_SYNC_INTERVAL,
+  PROP_ROW_GROUP_SIZE,
+  PROP_WINDOW,
+  PROP_CLUSTER_DISTANCE,
+  PROP_QUEUE_DEPTH,
+  PROP_DROPPED,
+  PROP_EMITTED,
+  PROP_SKIPPED,
+  PROP_STATS,
+  PROP_SOURCE_TIMEOUT,
+  PROP_SOURCE_MEMORY,
+  PROP_SOURCE_BYTES,
 };
 
 #define GST_TYPE_PAYLOAD_BROKER_MODE (gst_payload_broker_mode_get_type())
@@ -80,6 +139,9 @@ gst_payload_broker_mode_get_type (void)
     {PAYLOAD_BROKER_MODE_PROPERTY, "return protobuf from results property", "property"},
     {PAYLOAD_BROKER_MODE_PROTO, "write coded protobuf to file", "proto"},
     {PAYLOAD_BROKER_MODE_CSV, "write csv to file (smart_distancing format).", "csv"},
+    {PAYLOAD_BROKER_MODE_COLUMNAR, "write compressed column chunks to file", "columnar"},
+    {PAYLOAD_BROKER_MODE_AGGREGATE, "write per source window aggregates to csv", "aggregate"},
+    {PAYLOAD_BROKER_MODE_RECORDS, "return a flat record array from records property", "records"},
     {0, nullptr, nullptr},
   };
 
@@ -90,23 +152,89 @@ gst_payload_broker_mode_get_type (void)
   return dspayloadbroker_mode_type;
 }
 
+#define GST_TYPE_PAYLOAD_BROKER_FSYNC_MODE \
+  (gst_payload_broker_fsync_mode_get_type())
+static GType
+gst_payload_broker_fsync_mode_get_type (void)
+{
+  static GType dspayloadbroker_fsync_mode_type = 0;
+  static const GEnumValue dspayloadbroker_fsync_mode[] = {
+    {PAYLOAD_BROKER_FSYNC_NEVER, "leave syncing to the kernel", "never"},
+    {PAYLOAD_BROKER_FSYNC_INTERVAL, "fsync every fsync-interval ms", "interval"},
+    {PAYLOAD_BROKER_FSYNC_SIZE, "fsync every fsync-size MiB written", "size"},
+    {0, nullptr, nullptr},
+  };
+
+  if (!dspayloadbroker_fsync_mode_type) {
+    dspayloadbroker_fsync_mode_type =
+        g_enum_register_static ("GstDsPayloadBrokerFsyncModeType",
+                                dspayloadbroker_fsync_mode);
+  }
+  return dspayloadbroker_fsync_mode_type;
+}
+
+#define GST_TYPE_PAYLOAD_BROKER_IO_BACKEND \
+  (gst_payload_broker_io_backend_get_type())
+static GType
+gst_payload_broker_io_backend_get_type (void)
+{
+  static GType dspayloadbroker_io_backend_type = 0;
+  static const GEnumValue dspayloadbroker_io_backend[] = {
+    {PAYLOAD_BROKER_IO_BACKEND_AUTO, "io_uring if available, else posix", "auto"},
+    {PAYLOAD_BROKER_IO_BACKEND_POSIX, "blocking write(2)", "posix"},
+    {PAYLOAD_BROKER_IO_BACKEND_URING, "io_uring (falls back to posix)", "io-uring"},
+    {0, nullptr, nullptr},
+  };
+
+  if (!dspayloadbroker_io_backend_type) {
+    dspayloadbroker_io_backend_type =
+        g_enum_register_static ("GstDsPayloadBrokerIoBackendType",
+                                dspayloadbroker_io_backend);
+  }
+  return dspayloadbroker_io_backend_type;
+}
+
+#define GST_TYPE_PAYLOAD_BROKER_SAMPLING \
+  (gst_payload_broker_sampling_get_type())
+static GType
+gst_payload_broker_sampling_get_type (void)
+{
+  static GType dspayloadbroker_sampling_type = 0;
+  static const GEnumValue dspayloadbroker_sampling[] = {
+    {PAYLOAD_BROKER_SAMPLING_NONE, "emit every frame", "none"},
+    {PAYLOAD_BROKER_SAMPLING_RATE, "emit max-rate frames per second per source", "rate"},
+    {PAYLOAD_BROKER_SAMPLING_ADAPTIVE, "emit every violation, rate limit the rest", "adaptive"},
+    {0, nullptr, nullptr},
+  };
+
+  if (!dspayloadbroker_sampling_type) {
+    dspayloadbroker_sampling_type =
+        g_enum_register_static ("GstDsPayloadBrokerSamplingType",
+                                dspayloadbroker_sampling);
+  }
+  return dspayloadbroker_sampling_type;
+}
+
 /* the capabilities of the inputs and outputs.
  *
  * static src and sink are both: video/x-raw(memory:NVMM) {NV12, RGBA}
+ * or video/x-raw {NV12, RGBA} (system memory, eg. from dsfakemetasrc)
  */
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
   "sink",
   GST_PAD_SINK,
   GST_PAD_ALWAYS,
   GST_STATIC_CAPS(
-    GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+    GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+        GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
   "src",
   GST_PAD_SRC,
   GST_PAD_ALWAYS,
   GST_STATIC_CAPS(
-    GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+    GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+        GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 #define gst_dspayloadbroker_parent_class parent_class
 G_DEFINE_TYPE(GstDsPayloadBroker, gst_dspayloadbroker, GST_TYPE_BASE_TRANSFORM);
@@ -119,11 +247,17 @@ static void gst_dspayloadbroker_get_property(GObject* object,
                                            guint prop_id,
                                            GValue* value,
                                            GParamSpec* pspec);
+static void gst_dspayloadbroker_finalize(GObject* object);
 
 static GstFlowReturn gst_dspayloadbroker_transform_ip(GstBaseTransform* base,
                                                     GstBuffer* outbuf);
 static gboolean gst_dspayloadbroker_start(GstBaseTransform* base);
 static gboolean gst_dspayloadbroker_stop(GstBaseTransform* base);
+static gboolean gst_dspayloadbroker_sink_event(GstBaseTransform* base,
+                                               GstEvent* event);
+
+static void gst_dspayloadbroker_collect(GstDsPayloadBroker* self,
+                                        ds::MetricsSample* sample);
 
 /* GObject vmethod implementations */
 
@@ -137,6 +271,7 @@ static void gst_dspayloadbroker_class_init(GstDsPayloadBrokerClass* klass) {
 
   gobject_class->set_property = gst_dspayloadbroker_set_property;
   gobject_class->get_property = gst_dspayloadbroker_get_property;
+  gobject_class->finalize = gst_dspayloadbroker_finalize;
 
   // silent property
   g_object_class_install_property(
@@ -149,8 +284,18 @@ static void gst_dspayloadbroker_class_init(GstDsPayloadBrokerClass* klass) {
   g_object_class_install_property(
     gobject_class, PROP_RESULTS,
     g_param_spec_string("results", "Results",
-      "Latest serialized results as "
-      "libdistanceproto::Batch protobuf string (in property mode).", nullptr,
+      "Latest results as a libdistanceproto::Batch in protobuf's JSON "
+      "mapping (in property mode).", nullptr,
+      GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  // records property
+  g_object_class_install_property(
+    gobject_class, PROP_RECORDS,
+    g_param_spec_boxed("records", "Records",
+      "Latest results as an array of fixed layout, 56 byte records, one per "
+      "person, for numpy.frombuffer (in records mode, see "
+      "RecordArrayBroker.hpp for the dtype).",
+      G_TYPE_BYTES,
       GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
 
   // broker mode property
@@ -162,14 +307,222 @@ static void gst_dspayloadbroker_class_init(GstDsPayloadBrokerClass* klass) {
       GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
         GST_PARAM_MUTABLE_READY)));
 
+  // outputs property
+  g_object_class_install_property(
+    gobject_class, PROP_OUTPUTS,
+    g_param_spec_string("outputs", "Outputs",
+      "Comma separated modes to run at once, eg. \"property,proto,csv\". "
+      "The payload is built once and shared. Overrides mode when set.",
+      nullptr,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // sampling property
+  g_object_class_install_property(
+    gobject_class, PROP_SAMPLING,
+    g_param_spec_enum("sampling", "Sampling",
+      "Which frames are emitted. Skipped frames are never encoded "
+      "(aggregate outputs always see every frame).",
+      GST_TYPE_PAYLOAD_BROKER_SAMPLING, PAYLOAD_BROKER_SAMPLING_NONE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // max-rate property
+  g_object_class_install_property(
+    gobject_class, PROP_MAX_RATE,
+    g_param_spec_double("max-rate", "MaxRate",
+      "Frames per second (of pts) per source emitted by sampling=rate, and "
+      "quiet frames emitted by sampling=adaptive.",
+      MIN_MAX_RATE, MAX_MAX_RATE, DEFAULT_MAX_RATE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
   // basename property
   g_object_class_install_property(
     gobject_class, PROP_BASEPATH,
     g_param_spec_string("basepath", "BasePath",
-      "The full base path (minus extension) in proto or csv mode", nullptr,
+      "The full base path (minus extension) in file modes.",
+      nullptr,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // queue-size property
+  g_object_class_install_property(
+    gobject_class, PROP_QUEUE_SIZE,
+    g_param_spec_uint("queue-size", "QueueSize",
+      "Maximum number of batches waiting for the writer before "
+      "new ones are dropped (in file modes).",
+      1, MAX_QUEUE_SIZE, DEFAULT_QUEUE_SIZE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // fsync-mode property
+  g_object_class_install_property(
+    gobject_class, PROP_FSYNC_MODE,
+    g_param_spec_enum("fsync-mode", "FsyncMode",
+      "When the writer calls fsync (in file modes).",
+      GST_TYPE_PAYLOAD_BROKER_FSYNC_MODE, PAYLOAD_BROKER_FSYNC_NEVER,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // fsync-interval property
+  g_object_class_install_property(
+    gobject_class, PROP_FSYNC_INTERVAL,
+    g_param_spec_uint("fsync-interval", "FsyncInterval",
+      "Milliseconds between fsyncs in fsync-mode=interval.",
+      1, G_MAXUINT, DEFAULT_FSYNC_INTERVAL,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // fsync-size property
+  g_object_class_install_property(
+    gobject_class, PROP_FSYNC_SIZE,
+    g_param_spec_uint("fsync-size", "FsyncSize",
+      "MiB written between fsyncs in fsync-mode=size.",
+      1, G_MAXUINT / 2, DEFAULT_FSYNC_SIZE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // rotate-size property
+  g_object_class_install_property(
+    gobject_class, PROP_ROTATE_SIZE,
+    g_param_spec_uint("rotate-size", "RotateSize",
+      "Start a new file after this many MiB (0 to disable).",
+      0, G_MAXUINT / 2, DEFAULT_ROTATE_SIZE,
       GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
         GST_PARAM_MUTABLE_READY)));
 
+  // rotate-interval property
+  g_object_class_install_property(
+    gobject_class, PROP_ROTATE_INTERVAL,
+    g_param_spec_uint("rotate-interval", "RotateInterval",
+      "Start a new file after this many seconds (0 to disable).",
+      0, G_MAXUINT, DEFAULT_ROTATE_INTERVAL,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // io-backend property
+  g_object_class_install_property(
+    gobject_class, PROP_IO_BACKEND,
+    g_param_spec_enum("io-backend", "IoBackend",
+      "How the writer talks to the disk (in file modes).",
+      GST_TYPE_PAYLOAD_BROKER_IO_BACKEND, PAYLOAD_BROKER_IO_BACKEND_AUTO,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // index property
+  g_object_class_install_property(
+    gobject_class, PROP_INDEX,
+    g_param_spec_boolean("index", "Index",
+      "In proto mode, write sync markers and a seekable sidecar .idx file "
+      "mapping pts, frame number and source id to byte offsets.",
+      DEFAULT_INDEX,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // sync-interval property
+  g_object_class_install_property(
+    gobject_class, PROP_SYNC_INTERVAL,
+    g_param_spec_uint("sync-interval", "SyncInterval",
+      "Batches between sync markers when index is enabled.",
+      1, G_MAXUINT, DEFAULT_SYNC_INTERVAL,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // row-group-size property
+  g_object_class_install_property(
+    gobject_class, PROP_ROW_GROUP_SIZE,
+    g_param_spec_uint("row-group-size", "RowGroupSize",
+      "Batches buffered into each row group in columnar mode.",
+      1, MAX_ROW_GROUP_SIZE, DEFAULT_ROW_GROUP_SIZE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // window property
+  g_object_class_install_property(
+    gobject_class, PROP_WINDOW,
+    g_param_spec_uint("window", "Window",
+      "Milliseconds of pts per window in aggregate mode.",
+      1, G_MAXUINT, DEFAULT_WINDOW,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // cluster-distance property
+  g_object_class_install_property(
+    gobject_class, PROP_CLUSTER_DISTANCE,
+    g_param_spec_float("cluster-distance", "ClusterDistance",
+      "People closer than this many person heights are in the same cluster "
+      "(in aggregate mode).",
+      0.0f, G_MAXFLOAT, DEFAULT_CLUSTER_DISTANCE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // queue-depth property
+  g_object_class_install_property(
+    gobject_class, PROP_QUEUE_DEPTH,
+    g_param_spec_uint("queue-depth", "QueueDepth",
+      "Number of batches currently waiting for the writers.",
+      0, G_MAXUINT, 0,
+      GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  // dropped property
+  g_object_class_install_property(
+    gobject_class, PROP_DROPPED,
+    g_param_spec_uint64("dropped", "Dropped",
+      "Number of batches dropped because a writer queue was full.",
+      0, G_MAXUINT64, 0,
+      GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  // emitted property
+  g_object_class_install_property(
+    gobject_class, PROP_EMITTED,
+    g_param_spec_uint64("emitted", "Emitted",
+      "Number of batches with at least one frame emitted.",
+      0, G_MAXUINT64, 0,
+      GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  // skipped property
+  g_object_class_install_property(
+    gobject_class, PROP_SKIPPED,
+    g_param_spec_uint64("skipped", "Skipped",
+      "Number of batches with every frame skipped by sampling.",
+      0, G_MAXUINT64, 0,
+      GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  // stats property
+  g_object_class_install_property(gobject_class, PROP_STATS,
+                                  gst_ds_stats_param_spec());
+
+  // source-timeout property
+  g_object_class_install_property(
+    gobject_class, PROP_SOURCE_TIMEOUT,
+    g_param_spec_uint("source-timeout", "SourceTimeout",
+      "Milliseconds of pts after which sampling and aggregate state for a "
+      "source that sent no frames is dropped (0 to keep it until stream "
+      "eos or pad removal).",
+      0, G_MAXUINT, DEFAULT_SOURCE_TIMEOUT,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // source-memory property
+  g_object_class_install_property(
+    gobject_class, PROP_SOURCE_MEMORY,
+    g_param_spec_uint("source-memory", "SourceMemory",
+      "KiB of per source state kept by the sampler and each aggregate "
+      "output. The least recently seen source is dropped to stay under it "
+      "(0 for no limit).",
+      0, G_MAXUINT / 1024, DEFAULT_SOURCE_MEMORY,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+        GST_PARAM_MUTABLE_READY)));
+
+  // source-bytes property
+  g_object_class_install_property(
+    gobject_class, PROP_SOURCE_BYTES,
+    g_param_spec_uint64("source-bytes", "SourceBytes",
+      "Bytes currently held for per source state.",
+      0, G_MAXUINT64, 0,
+      GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
   gst_element_class_set_details_simple(
     gstelement_class, ELEMENT_LONG_NAME,
     ELEMENT_TYPE, ELEMENT_DESCRIPTION,
@@ -188,6 +541,8 @@ static void gst_dspayloadbroker_class_init(GstDsPayloadBrokerClass* klass) {
     GST_DEBUG_FUNCPTR(gst_dspayloadbroker_start);
   GST_BASE_TRANSFORM_CLASS(klass)->stop =
     GST_DEBUG_FUNCPTR(gst_dspayloadbroker_stop);
+  GST_BASE_TRANSFORM_CLASS(klass)->sink_event =
+    GST_DEBUG_FUNCPTR(gst_dspayloadbroker_sink_event);
 
   /* debug category for fltering log messages
    */
@@ -210,8 +565,222 @@ static void gst_dspayloadbroker_init(GstDsPayloadBroker* self) {
    * Eventually the hope is to set a python callback, but this work for now.
    */
   self->mode = PAYLOAD_BROKER_MODE_PROPERTY;
+  self->outputs = nullptr;
+  self->sampling = PAYLOAD_BROKER_SAMPLING_NONE;
+  self->max_rate = DEFAULT_MAX_RATE;
   self->filter = nullptr;
+  for (auto& output : self->by_mode) {
+    output = nullptr;
+  }
   self->basepath = nullptr;
+  self->queue_size = DEFAULT_QUEUE_SIZE;
+  self->fsync_mode = PAYLOAD_BROKER_FSYNC_NEVER;
+  self->fsync_interval = DEFAULT_FSYNC_INTERVAL;
+  self->fsync_size = DEFAULT_FSYNC_SIZE;
+  self->rotate_size = DEFAULT_ROTATE_SIZE;
+  self->rotate_interval = DEFAULT_ROTATE_INTERVAL;
+  self->io_backend = PAYLOAD_BROKER_IO_BACKEND_AUTO;
+  self->index = DEFAULT_INDEX;
+  self->sync_interval = DEFAULT_SYNC_INTERVAL;
+  self->row_group_size = DEFAULT_ROW_GROUP_SIZE;
+  self->window = DEFAULT_WINDOW;
+  self->cluster_distance = DEFAULT_CLUSTER_DISTANCE;
+  self->source_timeout = DEFAULT_SOURCE_TIMEOUT;
+  self->source_memory = DEFAULT_SOURCE_MEMORY;
+  self->stats = new ds::ElementStats();
+  gst_ds_metrics_add(GST_ELEMENT(self), [self](ds::MetricsSample* sample) {
+    gst_dspayloadbroker_collect(self, sample);
+  });
+}
+
+/* writer options from the file mode properties
+ */
+static ds::AsyncFileWriter::Options
+gst_dspayloadbroker_writer_options(GstDsPayloadBroker* self) {
+  ds::AsyncFileWriter::Options options;
+  options.queue_size = self->queue_size;
+  switch (self->fsync_mode) {
+    case PAYLOAD_BROKER_FSYNC_INTERVAL:
+      options.fsync_policy = ds::AsyncFileWriter::FSYNC_INTERVAL;
+      break;
+    case PAYLOAD_BROKER_FSYNC_SIZE:
+      options.fsync_policy = ds::AsyncFileWriter::FSYNC_BYTES;
+      break;
+    default:
+      options.fsync_policy = ds::AsyncFileWriter::FSYNC_NEVER;
+      break;
+  }
+  options.fsync_interval_ms = self->fsync_interval;
+  options.fsync_bytes = (size_t)self->fsync_size << 20;
+  options.rotate_bytes = (size_t)self->rotate_size << 20;
+  options.rotate_seconds = self->rotate_interval;
+  switch (self->io_backend) {
+    case PAYLOAD_BROKER_IO_BACKEND_POSIX:
+      options.backend = ds::AsyncFileWriter::BACKEND_POSIX;
+      break;
+    case PAYLOAD_BROKER_IO_BACKEND_URING:
+      options.backend = ds::AsyncFileWriter::BACKEND_URING;
+      break;
+    default:
+      options.backend = ds::AsyncFileWriter::BACKEND_AUTO;
+      break;
+  }
+  return options;
+}
+
+/* per source state limits from the source-* properties
+ */
+static ds::SourceTableLimits
+gst_dspayloadbroker_source_limits(GstDsPayloadBroker* self) {
+  ds::SourceTableLimits limits;
+  limits.idle_timeout = (guint64) self->source_timeout * GST_MSECOND;
+  limits.max_bytes = (size_t) self->source_memory << 10;
+  return limits;
+}
+
+/* the file broker for a mode, or nullptr if it's not a running file output
+ */
+static ds::AsyncFileMetaBroker*
+gst_dspayloadbroker_file_broker(GstDsPayloadBroker* self,
+                                GstDsPayloadBrokerMode mode) {
+  switch (mode) {
+    case PAYLOAD_BROKER_MODE_PROTO:
+    case PAYLOAD_BROKER_MODE_CSV:
+    case PAYLOAD_BROKER_MODE_COLUMNAR:
+    case PAYLOAD_BROKER_MODE_AGGREGATE:
+      return (ds::AsyncFileMetaBroker*)self->by_mode[mode];
+    default:
+      return nullptr;
+  }
+}
+
+/* the stats, queue depth and drops summed over all outputs
+ */
+static void gst_dspayloadbroker_collect(GstDsPayloadBroker* self,
+                                        ds::MetricsSample* sample) {
+  sample->stats = self->stats->snapshot();
+  sample->has_queue = true;
+  // the outputs are replaced on start and stop
+  GST_OBJECT_LOCK(self);
+  for (int mode = 0; mode < PAYLOAD_BROKER_NUM_MODES; mode++) {
+    ds::AsyncFileMetaBroker* broker =
+      gst_dspayloadbroker_file_broker(self, (GstDsPayloadBrokerMode)mode);
+    if (broker != nullptr) {
+      sample->queue_depth += broker->writer().queue_depth();
+      sample->dropped += broker->writer().dropped();
+      sample->stats.bytes_serialized += broker->writer().bytes_pushed();
+      sample->stats.bytes_written += broker->writer().bytes_written();
+    }
+  }
+  auto pybroker = (ds::SeqlockPayloadBroker*)
+    self->by_mode[PAYLOAD_BROKER_MODE_PROPERTY];
+  if (pybroker != nullptr) {
+    sample->stats.bytes_serialized += pybroker->bytes_serialized();
+  }
+  auto records =
+    (ds::RecordArrayBroker*) self->by_mode[PAYLOAD_BROKER_MODE_RECORDS];
+  if (records != nullptr) {
+    sample->stats.bytes_serialized += records->bytes_serialized();
+  }
+  GST_OBJECT_UNLOCK(self);
+}
+
+/* the modes to run, from the outputs property (or mode if outputs is unset)
+ */
+static gboolean gst_dspayloadbroker_parse_outputs(
+    GstDsPayloadBroker* self, std::vector<GstDsPayloadBrokerMode>* modes) {
+  if (self->outputs == nullptr) {
+    modes->push_back(self->mode);
+    return true;
+  }
+
+  gboolean ok = true;
+  GEnumClass* klass =
+    (GEnumClass*)g_type_class_ref(GST_TYPE_PAYLOAD_BROKER_MODE);
+  gchar** names = g_strsplit(self->outputs, ",", -1);
+  for (gchar** name = names; *name != nullptr; name++) {
+    g_strstrip(*name);
+    if (**name == '\0') {
+      continue;
+    }
+    GEnumValue* value = g_enum_get_value_by_nick(klass, *name);
+    if (value == nullptr) {
+      GST_ERROR_OBJECT(self, "unknown output: %s", *name);
+      ok = false;
+      break;
+    }
+    GstDsPayloadBrokerMode mode = (GstDsPayloadBrokerMode)value->value;
+    if (std::find(modes->begin(), modes->end(), mode) != modes->end()) {
+      GST_ERROR_OBJECT(self, "output listed twice: %s", *name);
+      ok = false;
+      break;
+    }
+    modes->push_back(mode);
+  }
+  g_strfreev(names);
+  g_type_class_unref(klass);
+
+  if (ok && modes->empty()) {
+    GST_ERROR_OBJECT(self, "outputs is set but lists no modes");
+    ok = false;
+  }
+  return ok;
+}
+
+/* create and start the output for one mode, or return nullptr
+ */
+static ds::PayloadBroker*
+gst_dspayloadbroker_make_output(GstDsPayloadBroker* self,
+                                GstDsPayloadBrokerMode mode) {
+  ds::AsyncFileMetaBroker::Format format = ds::AsyncFileMetaBroker::proto;
+  const gchar* mode_name = nullptr;
+  ds::AsyncFileMetaBroker* broker = nullptr;
+
+  switch (mode)
+  {
+    case PAYLOAD_BROKER_MODE_PROPERTY:
+      return new ds::SeqlockPayloadBroker();
+    case PAYLOAD_BROKER_MODE_RECORDS:
+      return new ds::RecordArrayBroker();
+    case PAYLOAD_BROKER_MODE_PROTO:
+      format = ds::AsyncFileMetaBroker::proto;
+      mode_name = "proto";
+      break;
+    case PAYLOAD_BROKER_MODE_CSV:
+      format = ds::AsyncFileMetaBroker::csv;
+      mode_name = "csv";
+      break;
+    case PAYLOAD_BROKER_MODE_COLUMNAR:
+      format = ds::AsyncFileMetaBroker::columnar;
+      mode_name = "columnar";
+      break;
+    case PAYLOAD_BROKER_MODE_AGGREGATE:
+      format = ds::AsyncFileMetaBroker::aggregate;
+      mode_name = "aggregate";
+      break;
+    default:
+      GST_ERROR_OBJECT(self, "mode property broken");
+      return nullptr;
+      break;
+  }
+
+  if (self->basepath == nullptr) {
+    GST_ERROR_OBJECT(self, "basepath must be set for %s mode", mode_name);
+    return nullptr;
+  }
+  GST_DEBUG("creating AsyncFileMetaBroker with path %s and mode: %s",
+    self->basepath, mode_name);
+  broker = new ds::AsyncFileMetaBroker(self->basepath, format,
+    gst_dspayloadbroker_writer_options(self),
+    self->index ? self->sync_interval : 0, self->row_group_size,
+    (guint64) self->window * GST_MSECOND, self->cluster_distance,
+    gst_dspayloadbroker_source_limits(self));
+  if (!broker->start()) {
+    GST_ERROR_OBJECT(self, "could not open %s for writing", self->basepath);
+    delete broker;
+    return nullptr;
+  }
+  return broker;
 }
 
 /* start the element and create external resources
@@ -221,36 +790,45 @@ static void gst_dspayloadbroker_init(GstDsPayloadBroker* self) {
 
 static gboolean gst_dspayloadbroker_start(GstBaseTransform* base) {
   GstDsPayloadBroker* self = GST_DSPAYLOADBROKER(base);
+  std::vector<GstDsPayloadBrokerMode> modes;
+  ds::PayloadSampler::Policy policy = ds::PayloadSampler::POLICY_NONE;
   GST_DEBUG_OBJECT(self, "dspayloadbroker start");
 
-  switch (self->mode)
-  {
-    case PAYLOAD_BROKER_MODE_PROPERTY:
-      self->filter = new ds::PyPayloadBroker();
-      break;
-    case PAYLOAD_BROKER_MODE_PROTO:
-      if (self->basepath == nullptr) {
-        GST_ERROR_OBJECT(self, "basepath must be set for proto mode");
-        return false;
-      }
-      GST_DEBUG("creating FileMetaBroker with path %s and mode: proto", self->basepath);
-      self->filter = new ds::FileMetaBroker(self->basepath, ds::FileMetaBroker::proto);
-      ((ds::FileMetaBroker*)self->filter)->start();
+  if (!gst_dspayloadbroker_parse_outputs(self, &modes)) {
+    return false;
+  }
+
+  /* every output shares the payload built by the fan out broker, and every
+   * file output has its own writer (on the io worker pool)
+   */
+  switch (self->sampling) {
+    case PAYLOAD_BROKER_SAMPLING_RATE:
+      policy = ds::PayloadSampler::POLICY_RATE;
       break;
-    case PAYLOAD_BROKER_MODE_CSV:
-      if (self->basepath == nullptr) {
-        GST_ERROR_OBJECT(self, "basepath must be set for csv mode");
-        return false;
-      }
-      GST_DEBUG("creating FileMetaBroker with path %s and mode: csv", self->basepath);
-      self->filter = new ds::FileMetaBroker(self->basepath, ds::FileMetaBroker::csv);
-      ((ds::FileMetaBroker*)self->filter)->start();
+    case PAYLOAD_BROKER_SAMPLING_ADAPTIVE:
+      policy = ds::PayloadSampler::POLICY_ADAPTIVE;
       break;
     default:
-      GST_ERROR_OBJECT(self, "mode property broken");
-      return false;
+      policy = ds::PayloadSampler::POLICY_NONE;
       break;
   }
+  auto fan_out = new ds::FanOutPayloadBroker(policy, self->max_rate,
+    gst_dspayloadbroker_source_limits(self));
+  GST_OBJECT_LOCK(self);
+  self->filter = fan_out;
+  GST_OBJECT_UNLOCK(self);
+  for (auto mode : modes) {
+    ds::PayloadBroker* output = gst_dspayloadbroker_make_output(self, mode);
+    if (output == nullptr) {
+      gst_dspayloadbroker_stop(base);
+      return false;
+    }
+    // aggregates are only right if they see every frame
+    fan_out->add(output, mode != PAYLOAD_BROKER_MODE_AGGREGATE);
+    GST_OBJECT_LOCK(self);
+    self->by_mode[mode] = output;
+    GST_OBJECT_UNLOCK(self);
+  }
   return true;
 }
 
@@ -265,22 +843,68 @@ static gboolean gst_dspayloadbroker_stop(GstBaseTransform* base) {
   /* destroy the DistanceFilter
    */
 
-  switch (self->mode)
-  {
-    case PAYLOAD_BROKER_MODE_PROTO:
-    case PAYLOAD_BROKER_MODE_CSV:
-      ((ds::FileMetaBroker*)self->filter)->stop();
-      break;
-    default:
-      break;
+  for (int mode = 0; mode < PAYLOAD_BROKER_NUM_MODES; mode++) {
+    ds::AsyncFileMetaBroker* broker =
+      gst_dspayloadbroker_file_broker(self, (GstDsPayloadBrokerMode)mode);
+    if (broker != nullptr) {
+      broker->stop();
+    }
   }
-
-  delete self->filter;
+  GST_OBJECT_LOCK(self);
+  for (auto& output : self->by_mode) {
+    output = nullptr;
+  }
+  BaseFilter* filter = self->filter;
   self->filter = nullptr;
+  GST_OBJECT_UNLOCK(self);
+
+  delete filter;
 
   return true;
 }
 
+/* forget a source that nvstreammux says is gone, so state doesn't pile up
+ * as sources are added and removed at runtime
+ *
+ * https://gstreamer.freedesktop.org/documentation/base/gstbasetransform.html?gi-language=c#GstBaseTransformClass::sink_event
+ */
+static gboolean gst_dspayloadbroker_sink_event(GstBaseTransform* base,
+                                               GstEvent* event) {
+  GstDsPayloadBroker* self = GST_DSPAYLOADBROKER(base);
+  guint source_id = 0;
+
+  // serialized, so this is the streaming thread, between buffers
+  if (self->filter != nullptr &&
+      gst_ds_event_parse_source_gone(event, &source_id)) {
+    GST_DEBUG_OBJECT(self, "source %u is gone", source_id);
+    ((ds::FanOutPayloadBroker*) self->filter)->remove_source(source_id);
+    auto aggregate = (ds::AsyncFileMetaBroker*)
+      self->by_mode[PAYLOAD_BROKER_MODE_AGGREGATE];
+    if (aggregate != nullptr) {
+      aggregate->remove_source(source_id);
+    }
+  }
+
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->sink_event(base, event);
+}
+
+/* bytes of per source state in the sampler and aggregate output
+ */
+static guint64 gst_dspayloadbroker_source_bytes(GstDsPayloadBroker* self) {
+  guint64 bytes = 0;
+  GST_OBJECT_LOCK(self);
+  if (self->filter != nullptr) {
+    bytes += ((ds::FanOutPayloadBroker*) self->filter)->sampler().memory();
+  }
+  auto aggregate = (ds::AsyncFileMetaBroker*)
+    self->by_mode[PAYLOAD_BROKER_MODE_AGGREGATE];
+  if (aggregate != nullptr) {
+    bytes += aggregate->source_memory();
+  }
+  GST_OBJECT_UNLOCK(self);
+  return bytes;
+}
+
 /* do in-place work on the buffer (override the 'transform' method for copy)
  */
 static GstFlowReturn gst_dspayloadbroker_transform_ip(GstBaseTransform* object,
@@ -293,7 +917,13 @@ static GstFlowReturn gst_dspayloadbroker_transform_ip(GstBaseTransform* object,
   if (GST_CLOCK_TIME_IS_VALID(GST_BUFFER_TIMESTAMP(outbuf)))
     gst_object_sync_values(GST_OBJECT(self), GST_BUFFER_TIMESTAMP(outbuf));
 
-  return self->filter->on_buffer(outbuf);
+  GstClockTime start = gst_util_get_timestamp();
+  GstFlowReturn ret = self->filter->on_buffer(outbuf);
+  gst_ds_stats_add(self->stats, outbuf,
+                   ((ds::FanOutPayloadBroker*) self->filter)->take_pairs(),
+                   gst_util_get_timestamp() - start);
+
+  return ret;
 }
 
 /* __setattr__
@@ -311,13 +941,68 @@ static void gst_dspayloadbroker_set_property(GObject* object,
     case PROP_RESULTS:
       G_OBJECT_WARN_INVALID_PSPEC(object, "results", prop_id, pspec);
       break;
+    case PROP_RECORDS:
+      G_OBJECT_WARN_INVALID_PSPEC(object, "records", prop_id, pspec);
+      break;
     case PROP_MODE:
       self->mode = (GstDsPayloadBrokerMode) g_value_get_enum(value);
       break;
+    case PROP_OUTPUTS:
+      g_free(self->outputs);
+      self->outputs = g_value_dup_string(value);
+      break;
+    case PROP_SAMPLING:
+      self->sampling = (GstDsPayloadBrokerSampling) g_value_get_enum(value);
+      break;
+    case PROP_MAX_RATE:
+      self->max_rate = g_value_get_double(value);
+      break;
     case PROP_BASEPATH:
       g_free(self->basepath);
       self->basepath = g_value_dup_string(value);
       break;
+    case PROP_QUEUE_SIZE:
+      self->queue_size = g_value_get_uint(value);
+      break;
+    case PROP_FSYNC_MODE:
+      self->fsync_mode = (GstDsPayloadBrokerFsyncMode) g_value_get_enum(value);
+      break;
+    case PROP_FSYNC_INTERVAL:
+      self->fsync_interval = g_value_get_uint(value);
+      break;
+    case PROP_FSYNC_SIZE:
+      self->fsync_size = g_value_get_uint(value);
+      break;
+    case PROP_ROTATE_SIZE:
+      self->rotate_size = g_value_get_uint(value);
+      break;
+    case PROP_ROTATE_INTERVAL:
+      self->rotate_interval = g_value_get_uint(value);
+      break;
+    case PROP_IO_BACKEND:
+      self->io_backend = (GstDsPayloadBrokerIoBackend) g_value_get_enum(value);
+      break;
+    case PROP_INDEX:
+      self->index = g_value_get_boolean(value);
+      break;
+    case PROP_SYNC_INTERVAL:
+      self->sync_interval = g_value_get_uint(value);
+      break;
+    case PROP_ROW_GROUP_SIZE:
+      self->row_group_size = g_value_get_uint(value);
+      break;
+    case PROP_WINDOW:
+      self->window = g_value_get_uint(value);
+      break;
+    case PROP_CLUSTER_DISTANCE:
+      self->cluster_distance = g_value_get_float(value);
+      break;
+    case PROP_SOURCE_TIMEOUT:
+      self->source_timeout = g_value_get_uint(value);
+      break;
+    case PROP_SOURCE_MEMORY:
+      self->source_memory = g_value_get_uint(value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
@@ -332,33 +1017,134 @@ static void gst_dspayloadbroker_get_property(GObject* object,
                                            GParamSpec* pspec) {
   GstDsPayloadBroker* self = GST_DSPAYLOADBROKER(object);
   gchararray results = nullptr;
-  ds::PyPayloadBroker* pybroker = nullptr;
+  ds::SeqlockPayloadBroker* pybroker = nullptr;
+  ds::RecordArrayBroker* records = nullptr;
+  ds::MetricsSample sample = {};
   switch (prop_id) {
     case PROP_SILENT:
       g_value_set_boolean(value, self->silent);
       break;
     case PROP_RESULTS:
-      if (self->mode != PAYLOAD_BROKER_MODE_PROPERTY 
-          || self->filter == nullptr) {
-        // i don't know if this is necessary but it (probably)
-        // can't hurt
-        g_value_set_string(value, nullptr);
-        break;
-      }
-      pybroker = (ds::PyPayloadBroker*) self->filter;
-      results = pybroker->get_payload();
-      if (results != nullptr) {
-        g_value_take_string(value, results);
+      // stop() may free the outputs meanwhile
+      GST_OBJECT_LOCK(self);
+      pybroker = (ds::SeqlockPayloadBroker*)
+        self->by_mode[PAYLOAD_BROKER_MODE_PROPERTY];
+      if (pybroker != nullptr) {
+        results = pybroker->get_payload();
       }
+      GST_OBJECT_UNLOCK(self);
+      // nullptr if not in property mode
+      g_value_take_string(value, results);
+      break;
+    case PROP_RECORDS:
+      GST_OBJECT_LOCK(self);
+      records =
+        (ds::RecordArrayBroker*) self->by_mode[PAYLOAD_BROKER_MODE_RECORDS];
+      g_value_take_boxed(value,
+        records == nullptr ? nullptr : records->get_records());
+      GST_OBJECT_UNLOCK(self);
       break;
     case PROP_MODE:
       g_value_set_enum(value, self->mode);
       break;
+    case PROP_OUTPUTS:
+      g_value_set_string(value, self->outputs);
+      break;
+    case PROP_SAMPLING:
+      g_value_set_enum(value, self->sampling);
+      break;
+    case PROP_MAX_RATE:
+      g_value_set_double(value, self->max_rate);
+      break;
     case PROP_BASEPATH:
       g_value_set_string(value, self->basepath);
       break;
+    case PROP_QUEUE_SIZE:
+      g_value_set_uint(value, self->queue_size);
+      break;
+    case PROP_FSYNC_MODE:
+      g_value_set_enum(value, self->fsync_mode);
+      break;
+    case PROP_FSYNC_INTERVAL:
+      g_value_set_uint(value, self->fsync_interval);
+      break;
+    case PROP_FSYNC_SIZE:
+      g_value_set_uint(value, self->fsync_size);
+      break;
+    case PROP_ROTATE_SIZE:
+      g_value_set_uint(value, self->rotate_size);
+      break;
+    case PROP_ROTATE_INTERVAL:
+      g_value_set_uint(value, self->rotate_interval);
+      break;
+    case PROP_IO_BACKEND:
+      g_value_set_enum(value, self->io_backend);
+      break;
+    case PROP_INDEX:
+      g_value_set_boolean(value, self->index);
+      break;
+    case PROP_SYNC_INTERVAL:
+      g_value_set_uint(value, self->sync_interval);
+      break;
+    case PROP_ROW_GROUP_SIZE:
+      g_value_set_uint(value, self->row_group_size);
+      break;
+    case PROP_WINDOW:
+      g_value_set_uint(value, self->window);
+      break;
+    case PROP_CLUSTER_DISTANCE:
+      g_value_set_float(value, self->cluster_distance);
+      break;
+    case PROP_QUEUE_DEPTH:
+      // summed over all file outputs
+      gst_dspayloadbroker_collect(self, &sample);
+      g_value_set_uint(value, (guint) sample.queue_depth);
+      break;
+    case PROP_DROPPED:
+      gst_dspayloadbroker_collect(self, &sample);
+      g_value_set_uint64(value, sample.dropped);
+      break;
+    case PROP_EMITTED:
+      GST_OBJECT_LOCK(self);
+      g_value_set_uint64(value, self->filter == nullptr ? 0 :
+        ((ds::FanOutPayloadBroker*) self->filter)->sampler().emitted());
+      GST_OBJECT_UNLOCK(self);
+      break;
+    case PROP_SKIPPED:
+      GST_OBJECT_LOCK(self);
+      g_value_set_uint64(value, self->filter == nullptr ? 0 :
+        ((ds::FanOutPayloadBroker*) self->filter)->sampler().skipped());
+      GST_OBJECT_UNLOCK(self);
+      break;
+    case PROP_SOURCE_TIMEOUT:
+      g_value_set_uint(value, self->source_timeout);
+      break;
+    case PROP_SOURCE_MEMORY:
+      g_value_set_uint(value, self->source_memory);
+      break;
+    case PROP_SOURCE_BYTES:
+      g_value_set_uint64(value, gst_dspayloadbroker_source_bytes(self));
+      break;
+    case PROP_STATS:
+      // the encoders count their own bytes
+      gst_dspayloadbroker_collect(self, &sample);
+      g_value_take_boxed(value, gst_ds_stats_new_structure(sample.stats));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
   }
 }
+
+/* stop exporting and free the property strings and stats
+ */
+static void gst_dspayloadbroker_finalize(GObject* object) {
+  GstDsPayloadBroker* self = GST_DSPAYLOADBROKER(object);
+
+  g_free(self->basepath);
+  g_free(self->outputs);
+  gst_ds_metrics_remove(GST_ELEMENT(self));
+  delete self->stats;
+
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
@@ -27,6 +27,10 @@
  * 
  * DsProtoPayload operates on metadata only.
  *
+ * When downstream is late (see the qos property), only every 2nd, 4th or
+ * 8th buffer gets a payload until it catches up, and a "ds-qos" element
+ * message is posted whenever that changes.
+ *
  * <refsect2>
  * <title>Example usage</title>
  * |[
@@ -36,6 +40,10 @@
  */
 
 #include "gstdsprotopayload.h"
+#include "gstdsmetrics.h"
+#include "gstdsqos.h"
+#include "gstdsschedule.h"
+#include "gstdsstats.h"
 
 #include "config.h"
 
@@ -63,25 +71,32 @@ enum {
 enum {
   PROP_0,
   PROP_SILENT,
+  PROP_STATS,
+  PROP_PRIORITIES,
+  PROP_BUDGET,
+  PROP_SKIPPED_FRAMES,
 };
 
 /* the capabilities of the inputs and outputs.
  *
  * static src and sink are both: video/x-raw(memory:NVMM) {NV12, RGBA}
+ * or video/x-raw {NV12, RGBA} (system memory, eg. from dsfakemetasrc)
  */
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
     "sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
     "src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 #define gst_dsprotopayload_parent_class parent_class
 G_DEFINE_TYPE(GstDsProtoPayload, gst_dsprotopayload, GST_TYPE_BASE_TRANSFORM);
@@ -95,9 +110,13 @@ static void gst_dsprotopayload_get_property(GObject* object,
                                         GValue* value,
                                         GParamSpec* pspec);
 
+static void gst_dsprotopayload_finalize(GObject* object);
+
 static GstFlowReturn gst_dsprotopayload_transform_ip(GstBaseTransform* base,
                                                  GstBuffer* outbuf);
 static gboolean gst_dsprotopayload_start(GstBaseTransform* base);
+static gboolean gst_dsprotopayload_src_event(GstBaseTransform* base,
+                                             GstEvent* event);
 static gboolean gst_dsprotopayload_stop(GstBaseTransform* base);
 
 /* GObject vmethod implementations */
@@ -112,6 +131,7 @@ static void gst_dsprotopayload_class_init(GstDsProtoPayloadClass* klass) {
 
   gobject_class->set_property = gst_dsprotopayload_set_property;
   gobject_class->get_property = gst_dsprotopayload_get_property;
+  gobject_class->finalize = gst_dsprotopayload_finalize;
 
   // silent property
   g_object_class_install_property(
@@ -120,6 +140,18 @@ static void gst_dsprotopayload_class_init(GstDsProtoPayloadClass* klass) {
           "silent", "Silent", "Produce verbose output ?", FALSE,
           GParamFlags(G_PARAM_READWRITE | GST_PARAM_CONTROLLABLE)));
 
+  // stats property
+  g_object_class_install_property(gobject_class, PROP_STATS,
+                                  gst_ds_stats_param_spec());
+
+  // priorities, budget and skipped-frames properties
+  g_object_class_install_property(gobject_class, PROP_PRIORITIES,
+                                  gst_ds_schedule_priorities_param_spec());
+  g_object_class_install_property(gobject_class, PROP_BUDGET,
+                                  gst_ds_schedule_budget_param_spec());
+  g_object_class_install_property(gobject_class, PROP_SKIPPED_FRAMES,
+                                  gst_ds_schedule_skipped_param_spec());
+
   gst_element_class_set_details_simple(gstelement_class, ELEMENT_LONG_NAME,
                                        ELEMENT_TYPE, ELEMENT_DESCRIPTION,
                                        ELEMENT_AUTHOR_AND_EMAIL);
@@ -137,6 +169,8 @@ static void gst_dsprotopayload_class_init(GstDsProtoPayloadClass* klass) {
       GST_DEBUG_FUNCPTR(gst_dsprotopayload_start);
   GST_BASE_TRANSFORM_CLASS(klass)->stop =
       GST_DEBUG_FUNCPTR(gst_dsprotopayload_stop);
+  GST_BASE_TRANSFORM_CLASS(klass)->src_event =
+      GST_DEBUG_FUNCPTR(gst_dsprotopayload_src_event);
 
   /* debug category for fltering log messages
    */
@@ -151,9 +185,19 @@ static void gst_dsprotopayload_init(GstDsProtoPayload* filter) {
   GST_DEBUG("dsprotopayload init");
 
   filter->silent = FALSE;
-  /* create a DistanceFilter for this instance
+  /* create a ProtoPayloadFilter for this instance, kept until finalize so a
+   * PLAYING -> READY -> PLAYING cycle reuses it
    */
   filter->filter = new ProtoPayloadFilter();
+
+  filter->stats = new ds::ElementStats();
+  gst_ds_metrics_add_stats(GST_ELEMENT(filter), filter->stats);
+
+  // shed load rather than fall further behind (see the qos property)
+  filter->shedder = new ds::LoadShedder();
+  filter->scheduler = new ds::FrameScheduler();
+  filter->cost = 0;
+  gst_base_transform_set_qos_enabled(GST_BASE_TRANSFORM(filter), TRUE);
 }
 
 /* start the element and create external resources
@@ -161,13 +205,11 @@ static void gst_dsprotopayload_init(GstDsProtoPayload* filter) {
  * https://gstreamer.freedesktop.org/documentation/base/gstbasetransform.html?gi-language=c#GstBaseTransformClass::start
  */
 
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-parameter"
 static gboolean gst_dsprotopayload_start(GstBaseTransform* base) {
   GST_DEBUG("dsprotopayload start");
+  GST_DSPROTOPAYLOAD(base)->shedder->reset();
   return true;
 }
-#pragma GCC diagnostic pop
 
 /* stop the element and free external resources
  *
@@ -175,12 +217,11 @@ static gboolean gst_dsprotopayload_start(GstBaseTransform* base) {
  */
 
 static gboolean gst_dsprotopayload_stop(GstBaseTransform* base) {
-  GST_DEBUG("dsprotopayload stop");
-  GstDsProtoPayload* filter = GST_DSPROTOPAYLOAD(base);
+  GST_DEBUG_OBJECT(base, "dsprotopayload stop");
 
-  /* destroy the DistanceFilter
+  /* the filter outlives a stop, so a restart costs nothing (it's freed in
+   * finalize)
    */
-  delete filter->filter;
 
   return true;
 }
@@ -197,7 +238,42 @@ static GstFlowReturn gst_dsprotopayload_transform_ip(GstBaseTransform* base,
   if (GST_CLOCK_TIME_IS_VALID(GST_BUFFER_TIMESTAMP(outbuf)))
     gst_object_sync_values(GST_OBJECT(filter), GST_BUFFER_TIMESTAMP(outbuf));
 
-  return filter->filter->on_buffer(outbuf);
+  // a skipped buffer just has no payload for the broker
+  if (!gst_ds_qos_should_process(base, filter->shedder)) {
+    GST_LOG_OBJECT(filter, "late, not serializing");
+    return GST_FLOW_OK;
+  }
+
+  // the payload is built for the whole batch, so the budget can only keep
+  // or skip a batch (one with a critical source is always kept)
+  if (filter->scheduler->active() &&
+      !gst_ds_schedule_batch(filter->scheduler, outbuf, filter->cost)) {
+    GST_LOG_OBJECT(filter, "over budget, not serializing");
+    // a skipped batch costs nothing, so after a slow spike the average
+    // falls back under budget and the next batch is measured again
+    filter->cost -= filter->cost / 8;
+    return GST_FLOW_OK;
+  }
+
+  GstClockTime start = gst_util_get_timestamp();
+  GstFlowReturn ret = filter->filter->on_buffer(outbuf);
+  GstClockTime elapsed = gst_util_get_timestamp() - start;
+  gst_ds_stats_add(filter->stats, outbuf, 0, elapsed);
+  // a moving average, so one slow batch doesn't skip the next ones
+  filter->cost = (filter->cost * 7 + elapsed) / 8;
+
+  return ret;
+}
+
+/* shed load on QoS events (sent upstream by a late sink)
+ */
+static gboolean gst_dsprotopayload_src_event(GstBaseTransform* base,
+                                             GstEvent* event) {
+  if (GST_EVENT_TYPE(event) == GST_EVENT_QOS) {
+    return gst_ds_qos_src_event(base, GST_DSPROTOPAYLOAD(base)->shedder,
+                                event);
+  }
+  return GST_BASE_TRANSFORM_CLASS(parent_class)->src_event(base, event);
 }
 
 /* __setattr__
@@ -212,6 +288,13 @@ static void gst_dsprotopayload_set_property(GObject* object,
     case PROP_SILENT:
       filter->silent = g_value_get_boolean(value);
       break;
+    case PROP_PRIORITIES:
+      gst_ds_schedule_set_priorities(object, filter->scheduler, value);
+      break;
+    case PROP_BUDGET:
+      filter->scheduler->set_budget((guint64) g_value_get_uint(value) *
+                                    GST_USECOND);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
@@ -230,8 +313,36 @@ static void gst_dsprotopayload_get_property(GObject* object,
     case PROP_SILENT:
       g_value_set_boolean(value, filter->silent);
       break;
+    case PROP_PRIORITIES:
+      g_value_set_string(value, filter->scheduler->priorities().c_str());
+      break;
+    case PROP_BUDGET:
+      g_value_set_uint(value,
+                       (guint) (filter->scheduler->budget() / GST_USECOND));
+      break;
+    case PROP_SKIPPED_FRAMES:
+      g_value_set_uint64(value, filter->scheduler->skipped());
+      break;
+    case PROP_STATS:
+      g_value_take_boxed(
+          value, gst_ds_stats_new_structure(filter->stats->snapshot()));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
       break;
   }
 }
+
+/* stop exporting, and free the filter and the stats
+ */
+static void gst_dsprotopayload_finalize(GObject* object) {
+  GstDsProtoPayload* filter = GST_DSPROTOPAYLOAD(object);
+
+  gst_ds_metrics_remove(GST_ELEMENT(filter));
+  delete filter->filter;
+  delete filter->stats;
+  delete filter->shedder;
+  delete filter->scheduler;
+
+  G_OBJECT_CLASS(parent_class)->finalize(object);
+}
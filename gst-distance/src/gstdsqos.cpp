@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "gstdsqos.h"
+
+#include <mutex>
+
+GST_DEBUG_CATEGORY_STATIC(gst_ds_qos_debug);
+#define GST_CAT_DEFAULT gst_ds_qos_debug
+
+static void gst_ds_qos_init_debug_category(void) {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    GST_DEBUG_CATEGORY_INIT(gst_ds_qos_debug, "dsqos", 0,
+                            "gstdistance load shedding");
+  });
+}
+
+gboolean gst_ds_qos_src_event(GstBaseTransform* base,
+                              ds::LoadShedder* shedder,
+                              GstEvent* event) {
+  gst_ds_qos_init_debug_category();
+  if (gst_base_transform_is_qos_enabled(base)) {
+    GstQOSType type;
+    gdouble proportion = 1.0;
+    GstClockTimeDiff diff = 0;
+    GstClockTime timestamp = GST_CLOCK_TIME_NONE;
+    gst_event_parse_qos(event, &type, &proportion, &diff, &timestamp);
+    if (shedder->on_qos(proportion, diff)) {
+      GST_INFO_OBJECT(base, "qos level %u (every %u buffers), proportion %f",
+                      shedder->level(), shedder->interval(), proportion);
+      gst_element_post_message(
+          GST_ELEMENT(base),
+          gst_message_new_element(
+              GST_OBJECT(base),
+              gst_structure_new(GST_DS_QOS_MESSAGE_NAME,
+                  "level", G_TYPE_UINT, shedder->level(),
+                  "interval", G_TYPE_UINT, shedder->interval(),
+                  "proportion", G_TYPE_DOUBLE, proportion,
+                  "diff", G_TYPE_INT64, (gint64)diff,
+                  nullptr)));
+    }
+  }
+  return gst_pad_push_event(GST_BASE_TRANSFORM_SINK_PAD(base), event);
+}
+
+gboolean gst_ds_qos_should_process(GstBaseTransform* base,
+                                   ds::LoadShedder* shedder) {
+  // turning qos off mid-stream goes straight back to full processing
+  return !gst_base_transform_is_qos_enabled(base) ||
+         shedder->should_process();
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "gstdsschedule.h"
+
+// deepstream
+#include <gstnvdsmeta.h>
+
+#include <vector>
+
+GParamSpec* gst_ds_schedule_priorities_param_spec(void) {
+  return g_param_spec_string("priorities", "Priorities",
+      "Source priorities under load, eg. \"0:critical,7:best-effort\" "
+      "(critical, normal or best-effort; unlisted sources are normal).",
+      nullptr,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+GParamSpec* gst_ds_schedule_budget_param_spec(void) {
+  return g_param_spec_uint("budget", "Budget",
+      "Microseconds per batch, after which only critical sources are "
+      "processed (0 for no budget).",
+      0, G_MAXUINT, 0,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+GParamSpec* gst_ds_schedule_skipped_param_spec(void) {
+  return g_param_spec_uint64("skipped-frames", "SkippedFrames",
+      "Number of frames skipped for being over budget.",
+      0, G_MAXUINT64, 0,
+      GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+void gst_ds_schedule_set_priorities(GObject* object,
+                                    ds::FrameScheduler* scheduler,
+                                    const GValue* value) {
+  const gchar* spec = g_value_get_string(value);
+  if (!scheduler->set_priorities(spec == nullptr ? "" : spec)) {
+    GST_WARNING_OBJECT(object, "ignoring malformed priorities: %s", spec);
+  }
+}
+
+/* the frames of batch_meta and their sources (reusing the vectors)
+ */
+static void gst_ds_schedule_list_frames(NvDsBatchMeta* batch_meta,
+                                        std::vector<NvDsFrameMeta*>* frames,
+                                        std::vector<unsigned>* source_ids) {
+  frames->clear();
+  source_ids->clear();
+  for (NvDsMetaList* l = batch_meta->frame_meta_list; l; l = l->next) {
+    NvDsFrameMeta* frame_meta = (NvDsFrameMeta*)l->data;
+    frames->push_back(frame_meta);
+    source_ids->push_back(frame_meta->source_id);
+  }
+}
+
+GstFlowReturn gst_ds_schedule_frames(ds::FrameScheduler* scheduler,
+                                     ds::BaseFilter* filter,
+                                     GstBuffer* buf,
+                                     GstClockTime start,
+                                     GstDsSchedulePrepareFunc prepare,
+                                     gpointer user_data) {
+  // per streaming thread, so they stop allocating after the first batch
+  static thread_local std::vector<NvDsFrameMeta*> frames;
+  static thread_local std::vector<unsigned> source_ids;
+  static thread_local std::vector<size_t> order;
+  static thread_local std::vector<ds::FrameScheduler::Priority> priorities;
+
+  NvDsBatchMeta* batch_meta = gst_buffer_get_nvds_batch_meta(buf);
+  if (batch_meta == nullptr) {
+    return GST_FLOW_OK;
+  }
+
+  GstFlowReturn ret = GST_FLOW_OK;
+  nvds_acquire_meta_lock(batch_meta);
+  gst_ds_schedule_list_frames(batch_meta, &frames, &source_ids);
+  scheduler->order(source_ids, &order, &priorities);
+  for (size_t i = 0; i < order.size(); i++) {
+    if (prepare != nullptr && !prepare(frames[order[i]], user_data)) {
+      continue;
+    }
+    if (!scheduler->should_process(priorities[i],
+                                   gst_util_get_timestamp() - start)) {
+      continue;
+    }
+    if (!filter->on_frame_meta(batch_meta, frames[order[i]])) {
+      ret = GST_FLOW_ERROR;
+      break;
+    }
+  }
+  nvds_release_meta_lock(batch_meta);
+  return ret;
+}
+
+gboolean gst_ds_schedule_batch(ds::FrameScheduler* scheduler,
+                               GstBuffer* buf,
+                               GstClockTime cost) {
+  static thread_local std::vector<NvDsFrameMeta*> frames;
+  static thread_local std::vector<unsigned> source_ids;
+
+  NvDsBatchMeta* batch_meta = gst_buffer_get_nvds_batch_meta(buf);
+  if (batch_meta == nullptr) {
+    return true;
+  }
+  gst_ds_schedule_list_frames(batch_meta, &frames, &source_ids);
+  return scheduler->should_process_batch(source_ids, cost);
+}
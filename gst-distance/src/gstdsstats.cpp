@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "gstdsstats.h"
+
+// deepstream
+#include <gstnvdsmeta.h>
+
+GParamSpec* gst_ds_stats_param_spec(void) {
+  return g_param_spec_boxed("stats", "Stats",
+      "Counters since the element was created: buffers, objects, pairs "
+      "(of people in the same frame, counted by dspayloadbroker and "
+      "dsanalytics, and by dsdistance while it posts violations), "
+      "bytes-serialized and bytes-written (by dspayloadbroker outputs), "
+      "mean-time and max-time (ns per buffer).",
+      GST_TYPE_STRUCTURE,
+      GParamFlags(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+}
+
+void gst_ds_stats_add(ds::ElementStats* stats,
+                      GstBuffer* buf,
+                      guint64 pairs,
+                      GstClockTime elapsed) {
+  guint64 objects = 0;
+  NvDsBatchMeta* batch_meta = gst_buffer_get_nvds_batch_meta(buf);
+  if (batch_meta != nullptr) {
+    // the frames know how many objects they have, so the objects are not
+    // walked
+    for (NvDsMetaList* l = batch_meta->frame_meta_list; l; l = l->next) {
+      objects += ((NvDsFrameMeta*)l->data)->num_obj_meta;
+    }
+  }
+  stats->add(objects, pairs, elapsed);
+}
+
+GstStructure* gst_ds_stats_new_structure(
+    const ds::ElementStats::Snapshot& snapshot) {
+  return gst_structure_new("stats",
+      "buffers", G_TYPE_UINT64, (guint64)snapshot.buffers,
+      "objects", G_TYPE_UINT64, (guint64)snapshot.objects,
+      "pairs", G_TYPE_UINT64, (guint64)snapshot.pairs,
+      "bytes-serialized", G_TYPE_UINT64, (guint64)snapshot.bytes_serialized,
+      "bytes-written", G_TYPE_UINT64, (guint64)snapshot.bytes_written,
+      "mean-time", G_TYPE_UINT64, (guint64)snapshot.mean_time(),
+      "max-time", G_TYPE_UINT64, (guint64)snapshot.max_time,
+      nullptr);
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "gstdsviolations.h"
+#include "gstdsevent.h"
+
+// deepstream
+#include <gstnvdsmeta.h>
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+GST_DEBUG_CATEGORY_STATIC(gst_ds_violations_debug);
+#define GST_CAT_DEFAULT gst_ds_violations_debug
+
+static void gst_ds_violations_init_debug_category(void) {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    GST_DEBUG_CATEGORY_INIT(gst_ds_violations_debug, "dsviolations", 0,
+                            "gstdistance violation messages");
+  });
+}
+
+GParamSpec* gst_ds_violations_post_param_spec(void) {
+  return g_param_spec_boolean("post-violations", "PostViolations",
+      "Post a \"" GST_DS_VIOLATIONS_MESSAGE_NAME "\" element message when a "
+      "source's violation starts, ends or changes size.",
+      FALSE,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+GParamSpec* gst_ds_violations_distance_param_spec(gfloat default_distance) {
+  return g_param_spec_float("violation-distance", "ViolationDistance",
+      "People closer than this many person heights are in violation.",
+      0.0f, G_MAXFLOAT, default_distance,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+GParamSpec* gst_ds_violations_window_param_spec(guint default_window) {
+  return g_param_spec_uint("violation-window", "ViolationWindow",
+      "Milliseconds of pts over which violation changes are coalesced into "
+      "one message (0 for a message per change).",
+      0, G_MAXUINT, default_window,
+      GParamFlags(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+/* post changes as one message, if there are any
+ */
+static void gst_ds_violations_post(
+    GstElement* element,
+    const std::vector<ds::ViolationChange>& changes) {
+  if (changes.empty()) {
+    return;
+  }
+  GValue array = G_VALUE_INIT;
+  g_value_init(&array, GST_TYPE_ARRAY);
+  for (const auto& change : changes) {
+    GValue value = G_VALUE_INIT;
+    g_value_init(&value, GST_TYPE_STRUCTURE);
+    g_value_take_boxed(&value, gst_structure_new(GST_DS_VIOLATION_NAME,
+        "source-id", G_TYPE_UINT, change.source_id,
+        "state", G_TYPE_STRING,
+            ds::ViolationTracker::state_name(change.state),
+        "cluster-size", G_TYPE_UINT, change.size,
+        "previous-cluster-size", G_TYPE_UINT, change.previous_size,
+        "max-cluster-size", G_TYPE_UINT, change.max_size,
+        "changes", G_TYPE_UINT, change.changes,
+        "pts", G_TYPE_UINT64, (guint64)change.pts,
+        nullptr));
+    gst_value_array_append_and_take_value(&array, &value);
+  }
+  GstStructure* s = gst_structure_new_empty(GST_DS_VIOLATIONS_MESSAGE_NAME);
+  gst_structure_take_value(s, "changes", &array);
+  GST_DEBUG_OBJECT(element, "posting %u violation changes",
+                   (guint) changes.size());
+  gst_element_post_message(
+      element, gst_message_new_element(GST_OBJECT(element), s));
+}
+
+guint64 gst_ds_violations_add(GstElement* element,
+                              ds::ViolationTracker* tracker,
+                              GstBuffer* buf,
+                              const ds::SourceConfig* config,
+                              gint class_id) {
+  gst_ds_violations_init_debug_category();
+  NvDsBatchMeta* batch_meta = gst_buffer_get_nvds_batch_meta(buf);
+  if (batch_meta == nullptr) {
+    return 0;
+  }
+
+  // reused for every frame in the batch
+  std::vector<ds::ViolationTracker::Person> people;
+  guint64 pairs = 0;
+  guint64 now = 0;
+  for (NvDsMetaList* l = batch_meta->frame_meta_list; l; l = l->next) {
+    NvDsFrameMeta* frame_meta = (NvDsFrameMeta*)l->data;
+    gint frame_class_id = class_id;
+    if (config != nullptr) {
+      const ds::SourceSettings& settings =
+          config->settings(frame_meta->source_id);
+      if (!settings.enabled) {
+        continue;
+      }
+      if (settings.class_id >= 0) {
+        frame_class_id = settings.class_id;
+      }
+    }
+    people.clear();
+    for (NvDsMetaList* o = frame_meta->obj_meta_list; o; o = o->next) {
+      NvDsObjectMeta* obj_meta = (NvDsObjectMeta*)o->data;
+      if (obj_meta->class_id != frame_class_id) {
+        continue;
+      }
+      const NvOSD_RectParams& rect = obj_meta->rect_params;
+      people.push_back(ds::ViolationTracker::Person{
+          rect.left + rect.width / 2.0f, rect.top + rect.height,
+          rect.height});
+    }
+    if (people.size() > 1) {
+      pairs += (guint64)people.size() * (people.size() - 1) / 2;
+    }
+    tracker->add_frame(frame_meta->source_id, frame_meta->buf_pts, people);
+    now = std::max(now, frame_meta->buf_pts);
+  }
+
+  std::vector<ds::ViolationChange> changes;
+  tracker->poll(now, &changes);
+  gst_ds_violations_post(element, changes);
+  return pairs;
+}
+
+void gst_ds_violations_sink_event(GstElement* element,
+                                  ds::ViolationTracker* tracker,
+                                  GstEvent* event) {
+  gst_ds_violations_init_debug_category();
+  guint source_id = 0;
+  if (gst_ds_event_parse_source_gone(event, &source_id)) {
+    GST_DEBUG_OBJECT(element, "source %u is gone", source_id);
+    // posted with the next batch's changes (or on eos)
+    tracker->remove_source(source_id);
+  } else if (GST_EVENT_TYPE(event) == GST_EVENT_EOS) {
+    std::vector<ds::ViolationChange> changes;
+    tracker->flush(&changes);
+    gst_ds_violations_post(element, changes);
+  }
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "gstdsworkers.h"
+
+#include "WorkerPool.hpp"
+
+#include <mutex>
+
+GST_DEBUG_CATEGORY_STATIC(gst_ds_workers_debug);
+#define GST_CAT_DEFAULT gst_ds_workers_debug
+
+/* parse GST_DISTANCE_WORKERS into the options of both pools
+ */
+static gboolean gst_ds_workers_parse_env(const gchar* env,
+                                         ds::WorkerPool::Options* options,
+                                         ds::WorkerPool::Options* io_options) {
+  gchar* str = g_strdup_printf("workers,%s", env);
+  GstStructure* structure = gst_structure_from_string(str, nullptr);
+  g_free(str);
+  if (structure == nullptr) {
+    return false;
+  }
+  gboolean ok = true;
+  gint threads = 0;
+  if (gst_structure_has_field(structure, "threads")) {
+    ok = gst_structure_get_int(structure, "threads", &threads) &&
+         threads > 0;
+    options->threads = (size_t)threads;
+  }
+  gboolean pin = false;
+  if (ok && gst_structure_has_field(structure, "pin")) {
+    ok = gst_structure_get_boolean(structure, "pin", &pin);
+    options->pin = pin;
+  }
+  gint io_threads = 0;
+  if (ok && gst_structure_has_field(structure, "io-threads")) {
+    ok = gst_structure_get_int(structure, "io-threads", &io_threads) &&
+         io_threads > 0;
+    io_options->threads = (size_t)io_threads;
+  }
+  gst_structure_free(structure);
+  return ok;
+}
+
+void gst_ds_workers_init(void) {
+  static std::once_flag once;
+  std::call_once(once, [] {
+    GST_DEBUG_CATEGORY_INIT(gst_ds_workers_debug, "dsworkers", 0,
+                            "gstdistance worker pool setup");
+    const gchar* env = g_getenv(GST_DS_WORKERS_ENV);
+    if (env == nullptr || *env == '\0') {
+      return;
+    }
+    ds::WorkerPool::Options options;
+    // threads=0 leaves the io pool's default alone
+    ds::WorkerPool::Options io_options;
+    if (!gst_ds_workers_parse_env(env, &options, &io_options)) {
+      GST_WARNING("could not parse %s=%s", GST_DS_WORKERS_ENV, env);
+      return;
+    }
+    if (!ds::WorkerPool::configure(options)) {
+      GST_WARNING("worker pool already running, ignoring %s",
+                  GST_DS_WORKERS_ENV);
+    }
+    if (io_options.threads && !ds::WorkerPool::configure_io(io_options)) {
+      GST_WARNING("io worker pool already running, ignoring io-threads");
+    }
+  });
+}
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "CsvEncoder.hpp"
+
+#include <distance.pb.h>
+
+#include <gst/check/check.h>
+
+#include <cfloat>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+/* the reference formatting (what FileMetaBroker csv mode always wrote) */
+static std::string reference_csv(const dp::Batch& batch) {
+  std::string out;
+  char row[512];
+  for (const auto& frame : batch.frames()) {
+    for (const auto& person : frame.people()) {
+      int len = snprintf(
+          row, sizeof(row),
+          "%u,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%d,%f,%f,%f,%f,%f\n",
+          (unsigned)frame.source_id(), (uint64_t)frame.frame_num(),
+          (uint64_t)frame.pts(), (uint64_t)person.uid(),
+          (int)person.is_danger(), person.danger_val(), person.bbox().left(),
+          person.bbox().top(), person.bbox().width(), person.bbox().height());
+      out.append(row, (size_t)len);
+    }
+  }
+  return out;
+}
+
+static dp::Person* add_person(dp::Frame* frame,
+                              uint64_t uid,
+                              bool is_danger,
+                              float danger_val,
+                              float left,
+                              float top,
+                              float width,
+                              float height) {
+  dp::Person* person = frame->add_people();
+  person->set_uid(uid);
+  person->set_is_danger(is_danger);
+  person->set_danger_val(danger_val);
+  person->mutable_bbox()->set_left(left);
+  person->mutable_bbox()->set_top(top);
+  person->mutable_bbox()->set_width(width);
+  person->mutable_bbox()->set_height(height);
+  return person;
+}
+
+/* the batch tests/data/csv_golden.csv was made from (keep them in step) */
+static void make_golden_batch(dp::Batch* batch) {
+  dp::Frame* frame = batch->add_frames();
+  add_person(frame, 0, false, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+
+  frame = batch->add_frames();
+  frame->set_source_id(3);
+  frame->set_frame_num(12345);
+  frame->set_pts(411500000);
+  add_person(frame, 7, true, 0.75f, 100.5f, 200.25f, 50.125f, 120.0f);
+  add_person(frame, 8, false, 1.0f / 3.0f, 1279.999f, 0.1f, 33.3f, 719.5f);
+
+  // no people, no rows
+  frame = batch->add_frames();
+  frame->set_source_id(4);
+
+  // rounding: ties, values below the last digit, negative zero
+  frame = batch->add_frames();
+  frame->set_source_id(5);
+  frame->set_frame_num(1);
+  frame->set_pts(33333333);
+  add_person(frame, 42, true, 0.0078125f, 0.0000005f, 1e-7f, -0.0f,
+             -2.5e-6f);
+  add_person(frame, 43, false, 0.9999999f, -1.0f, 123456.789f, 1e10f,
+             16777217.0f);
+
+  // limits
+  frame = batch->add_frames();
+  frame->set_source_id(UINT32_MAX);
+  frame->set_frame_num(UINT64_MAX);
+  frame->set_pts(UINT64_MAX);
+  add_person(frame, UINT64_MAX, true, FLT_MAX, -FLT_MAX, FLT_MIN,
+             FLT_EPSILON, -FLT_MIN);
+  add_person(frame, 1, false, INFINITY, -INFINITY, NAN, 0.0f, 0.0f);
+}
+
+static std::string read_golden(const char* name) {
+  const gchar* dir = g_getenv("TEST_DATA_DIR");
+  ck_assert_msg(dir != nullptr, "TEST_DATA_DIR is not set");
+  gchar* path = g_build_filename(dir, name, nullptr);
+  gchar* contents = nullptr;
+  gsize length = 0;
+  ck_assert_msg(g_file_get_contents(path, &contents, &length, nullptr),
+                "could not read %s", path);
+  std::string golden(contents, length);
+  g_free(contents);
+  g_free(path);
+  return golden;
+}
+
+GST_START_TEST(test_golden) {
+  dp::Batch batch;
+  make_golden_batch(&batch);
+  ds::CsvEncoder encoder;
+  encoder.encode(batch);
+  std::string golden = read_golden("csv_golden.csv");
+  ck_assert_str_eq((ds::CsvEncoder::HEADER + encoder.str()).c_str(),
+                   golden.c_str());
+  // and the golden file is what the old formatting produced
+  ck_assert_str_eq((ds::CsvEncoder::HEADER + reference_csv(batch)).c_str(),
+                   golden.c_str());
+}
+GST_END_TEST;
+
+GST_START_TEST(test_take) {
+  dp::Batch batch;
+  make_golden_batch(&batch);
+  ds::CsvEncoder encoder;
+  encoder.encode(batch);
+  std::string rows = encoder.str();
+  const char* data = encoder.data();
+
+  // the rows are handed over, not copied
+  std::string taken = encoder.take();
+  ck_assert(taken.data() == data);
+  ck_assert_str_eq(taken.c_str(), rows.c_str());
+  ck_assert_uint_eq(encoder.size(), 0);
+
+  // and the encoder still works afterwards
+  encoder.encode(batch);
+  ck_assert_str_eq(encoder.str().c_str(), rows.c_str());
+}
+GST_END_TEST;
+
+static float random_float(GRand* rand) {
+  switch (g_rand_int_range(rand, 0, 4)) {
+    case 0:  // pixel coordinates
+      return (float)g_rand_double_range(rand, -10.0, 4096.0);
+    case 1:  // danger values
+      return (float)g_rand_double(rand);
+    case 2:  // any bit pattern that is a finite float
+    {
+      guint32 bits = g_rand_int(rand);
+      float value;
+      memcpy(&value, &bits, sizeof(value));
+      return std::isfinite(value) ? value : 0.0f;
+    }
+    default:  // exact multiples of the last printed digit and halfway points
+      return (float)(g_rand_int_range(rand, -2000000, 2000000) / 2e6);
+  }
+}
+
+GST_START_TEST(test_matches_printf) {
+  GRand* rand = g_rand_new_with_seed(20201);
+  ds::CsvEncoder encoder;
+  for (int i = 0; i < 200; i++) {
+    dp::Batch batch;
+    int num_frames = g_rand_int_range(rand, 0, 8);
+    for (int f = 0; f < num_frames; f++) {
+      dp::Frame* frame = batch.add_frames();
+      frame->set_source_id(g_rand_int(rand));
+      frame->set_frame_num(((guint64)g_rand_int(rand) << 32) |
+                           g_rand_int(rand));
+      frame->set_pts(((guint64)g_rand_int(rand) << 16) | g_rand_int(rand));
+      int num_people = g_rand_int_range(rand, 0, 40);
+      for (int p = 0; p < num_people; p++) {
+        add_person(frame, g_rand_int(rand), g_rand_boolean(rand),
+                   random_float(rand), random_float(rand), random_float(rand),
+                   random_float(rand), random_float(rand));
+      }
+    }
+    // the buffer is reused between batches
+    encoder.encode(batch);
+    ck_assert_str_eq(encoder.str().c_str(), reference_csv(batch).c_str());
+  }
+  g_rand_free(rand);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_rows) {
+  ds::CsvEncoder encoder;
+  ck_assert_uint_eq(encoder.size(), 0);
+  encoder.begin_frame(2, 10, 20);
+  encoder.add_person(5, true, 0.5f, 1.0f, 2.0f, 3.0f, 4.0f);
+  encoder.add_person(6, false, 0.25f, 5.0f, 6.0f, 7.0f, 8.0f);
+  ck_assert_str_eq(encoder.str().c_str(),
+                   "2,10,20,5,1,0.500000,1.000000,2.000000,3.000000,"
+                   "4.000000\n"
+                   "2,10,20,6,0,0.250000,5.000000,6.000000,7.000000,"
+                   "8.000000\n");
+  encoder.clear();
+  ck_assert_uint_eq(encoder.size(), 0);
+  dp::Batch batch;
+  encoder.encode(batch);
+  ck_assert_uint_eq(encoder.size(), 0);
+}
+GST_END_TEST;
+
+static Suite* csvencoder_suite(void) {
+  Suite* s = suite_create("CsvEncoder");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_rows);
+  tcase_add_test(bc, test_golden);
+  tcase_add_test(bc, test_take);
+  tcase_add_test(bc, test_matches_printf);
+
+  return s;
+}
+
+GST_CHECK_MAIN(csvencoder);
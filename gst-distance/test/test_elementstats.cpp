@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "ElementStats.hpp"
+
+#include <gst/check/check.h>
+
+#include <thread>
+#include <vector>
+
+GST_START_TEST(test_empty) {
+  ds::ElementStats stats;
+  ds::ElementStats::Snapshot snapshot = stats.snapshot();
+  ck_assert_uint_eq(snapshot.buffers, 0);
+  ck_assert_uint_eq(snapshot.max_time, 0);
+  ck_assert_uint_eq(snapshot.mean_time(), 0);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_add) {
+  ds::ElementStats stats;
+  stats.add(10, 45, 1000);
+  stats.add(20, 190, 3000);
+  ds::ElementStats::Snapshot snapshot = stats.snapshot();
+  ck_assert_uint_eq(snapshot.buffers, 2);
+  ck_assert_uint_eq(snapshot.objects, 30);
+  ck_assert_uint_eq(snapshot.pairs, 235);
+  ck_assert_uint_eq(snapshot.total_time, 4000);
+  ck_assert_uint_eq(snapshot.mean_time(), 2000);
+  ck_assert_uint_eq(snapshot.max_time, 3000);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_buckets) {
+  ds::ElementStats stats;
+  stats.add(0, 0, 0);
+  stats.add(0, 0, 10000);  // bounds are inclusive
+  stats.add(0, 0, 10001);
+  stats.add(0, 0, 1000000000);
+  ds::ElementStats::Snapshot snapshot = stats.snapshot();
+  ck_assert_uint_eq(snapshot.time_buckets[0], 2);
+  ck_assert_uint_eq(snapshot.time_buckets[1], 1);
+  ck_assert_uint_eq(snapshot.time_buckets[ds::ElementStats::NUM_BUCKETS - 1],
+                    1);
+  uint64_t total = 0;
+  for (uint64_t count : snapshot.time_buckets) {
+    total += count;
+  }
+  ck_assert_uint_eq(total, snapshot.buffers);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_threads) {
+  ds::ElementStats stats;
+  // more threads than slots, so some share
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 20; t++) {
+    threads.emplace_back([&stats, t] {
+      for (int i = 0; i < 10000; i++) {
+        stats.add(2, 1, (uint64_t)(t * 100 + i % 7));
+      }
+    });
+  }
+  // polling while they run
+  for (int i = 0; i < 1000; i++) {
+    ck_assert_uint_le(stats.snapshot().buffers, 200000);
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ds::ElementStats::Snapshot snapshot = stats.snapshot();
+  ck_assert_uint_eq(snapshot.buffers, 200000);
+  ck_assert_uint_eq(snapshot.objects, 400000);
+  ck_assert_uint_eq(snapshot.pairs, 200000);
+  ck_assert_uint_eq(snapshot.max_time, 1906);
+}
+GST_END_TEST;
+
+static Suite* elementstats_suite(void) {
+  Suite* s = suite_create("ElementStats");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_empty);
+  tcase_add_test(bc, test_add);
+  tcase_add_test(bc, test_buckets);
+  tcase_add_test(bc, test_threads);
+
+  return s;
+}
+
+GST_CHECK_MAIN(elementstats);
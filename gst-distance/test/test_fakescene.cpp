@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "FakeScene.hpp"
+
+#include <gst/check/check.h>
+
+#include <set>
+
+static const uint32_t WIDTH = 1920;
+static const uint32_t HEIGHT = 1080;
+
+static void check_in_frame(const ds::FakeScene& scene) {
+  for (uint32_t s = 0; s < scene.sources(); s++) {
+    for (const auto& object : scene.objects(s)) {
+      ck_assert(object.left >= 0.0f && object.top >= 0.0f);
+      ck_assert(object.left + object.width <= WIDTH + 0.01f);
+      ck_assert(object.top + object.height <= HEIGHT + 0.01f);
+      ck_assert(object.height >= HEIGHT * 0.1f - 0.01f);
+      ck_assert(object.height <= HEIGHT * 0.3f + 0.01f);
+    }
+  }
+}
+
+GST_START_TEST(test_population) {
+  ds::FakeScene scene(4, 50, ds::FakeScene::MOTION_STATIC, 0.0, WIDTH, HEIGHT);
+  ck_assert_uint_eq(scene.sources(), 4);
+  std::set<uint64_t> ids;
+  for (uint32_t s = 0; s < scene.sources(); s++) {
+    ck_assert_uint_eq(scene.objects(s).size(), 50);
+    for (const auto& object : scene.objects(s)) {
+      ids.insert(object.id);
+    }
+  }
+  // ids are unique across sources
+  ck_assert_uint_eq(ids.size(), 200);
+  ck_assert_uint_eq(scene.ids(), 200);
+  check_in_frame(scene);
+
+  // static people stay put
+  float left = scene.objects(2)[7].left;
+  for (int i = 0; i < 100; i++) {
+    scene.step();
+  }
+  ck_assert(scene.objects(2)[7].left == left);
+  ck_assert_uint_eq(scene.ids(), 200);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_motion) {
+  ds::FakeScene::Motion motions[] = {
+      ds::FakeScene::MOTION_LINEAR,
+      ds::FakeScene::MOTION_RANDOM,
+  };
+  for (auto motion : motions) {
+    ds::FakeScene scene(2, 100, motion, 0.0, WIDTH, HEIGHT, 42);
+    float left = scene.objects(0)[0].left;
+    float top = scene.objects(0)[0].top;
+    // long enough for everyone to hit an edge a few times
+    for (int i = 0; i < 2000; i++) {
+      scene.step();
+      check_in_frame(scene);
+    }
+    ck_assert(scene.objects(0)[0].left != left ||
+              scene.objects(0)[0].top != top);
+  }
+}
+GST_END_TEST;
+
+GST_START_TEST(test_churn) {
+  ds::FakeScene scene(1, 100, ds::FakeScene::MOTION_LINEAR, 0.1, WIDTH,
+                      HEIGHT);
+  for (int i = 0; i < 100; i++) {
+    scene.step();
+  }
+  // 100 people * 100 steps * 0.1, give or take
+  uint64_t new_ids = scene.ids() - 100;
+  ck_assert_uint_gt(new_ids, 800);
+  ck_assert_uint_lt(new_ids, 1200);
+  // and the population stays the same size
+  ck_assert_uint_eq(scene.objects(0).size(), 100);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_seed) {
+  ds::FakeScene a(2, 20, ds::FakeScene::MOTION_RANDOM, 0.05, WIDTH, HEIGHT, 7);
+  ds::FakeScene b(2, 20, ds::FakeScene::MOTION_RANDOM, 0.05, WIDTH, HEIGHT, 7);
+  ds::FakeScene c(2, 20, ds::FakeScene::MOTION_RANDOM, 0.05, WIDTH, HEIGHT, 8);
+  for (int i = 0; i < 50; i++) {
+    a.step();
+    b.step();
+    c.step();
+  }
+  ck_assert(a.objects(1)[3].left == b.objects(1)[3].left);
+  ck_assert_uint_eq(a.objects(1)[3].id, b.objects(1)[3].id);
+  ck_assert(a.objects(1)[3].left != c.objects(1)[3].left);
+}
+GST_END_TEST;
+
+static Suite* fakescene_suite(void) {
+  Suite* s = suite_create("FakeScene");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_population);
+  tcase_add_test(bc, test_motion);
+  tcase_add_test(bc, test_churn);
+  tcase_add_test(bc, test_seed);
+
+  return s;
+}
+
+GST_CHECK_MAIN(fakescene);
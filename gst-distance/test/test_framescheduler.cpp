@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "FrameScheduler.hpp"
+
+#include <gst/check/check.h>
+
+#include <vector>
+
+typedef ds::FrameScheduler FS;
+
+GST_START_TEST(test_priorities) {
+  ds::FrameScheduler scheduler;
+  ck_assert(!scheduler.active());
+  ck_assert(scheduler.set_priorities("7:best-effort,0:critical,3:critical"));
+  ck_assert(scheduler.active());
+  ck_assert_str_eq(scheduler.priorities().c_str(),
+                   "0:critical,3:critical,7:best-effort");
+  ck_assert_int_eq(scheduler.priority(0), FS::PRIORITY_CRITICAL);
+  ck_assert_int_eq(scheduler.priority(1), FS::PRIORITY_NORMAL);
+  ck_assert_int_eq(scheduler.priority(7), FS::PRIORITY_BEST_EFFORT);
+
+  // malformed specs leave the priorities alone
+  ck_assert(!scheduler.set_priorities("0:urgent"));
+  ck_assert(!scheduler.set_priorities("zero:critical"));
+  ck_assert(!scheduler.set_priorities("-1:critical"));
+  ck_assert(!scheduler.set_priorities("4294967297:critical"));
+  ck_assert(!scheduler.set_priorities("99999999999999999999999:critical"));
+  ck_assert(!scheduler.set_priorities("1"));
+  ck_assert_str_eq(scheduler.priorities().c_str(),
+                   "0:critical,3:critical,7:best-effort");
+
+  ck_assert(scheduler.set_priorities(""));
+  ck_assert(!scheduler.active());
+}
+GST_END_TEST;
+
+GST_START_TEST(test_order) {
+  ds::FrameScheduler scheduler;
+  ck_assert(scheduler.set_priorities("2:critical,4:best-effort,5:critical"));
+  std::vector<unsigned> source_ids = {4, 1, 5, 3, 2};
+  std::vector<size_t> indices;
+  std::vector<FS::Priority> priorities;
+  scheduler.order(source_ids, &indices, &priorities);
+
+  // critical first, batch order within a priority
+  std::vector<size_t> expected = {2, 4, 1, 3, 0};
+  ck_assert(indices == expected);
+  ck_assert_int_eq(priorities[0], FS::PRIORITY_CRITICAL);
+  ck_assert_int_eq(priorities[2], FS::PRIORITY_NORMAL);
+  ck_assert_int_eq(priorities[4], FS::PRIORITY_BEST_EFFORT);
+  std::vector<FS::Priority> expected_priorities = {
+      FS::PRIORITY_CRITICAL, FS::PRIORITY_CRITICAL, FS::PRIORITY_NORMAL,
+      FS::PRIORITY_NORMAL, FS::PRIORITY_BEST_EFFORT};
+  ck_assert(priorities == expected_priorities);
+
+  // the next batch reuses the vectors rather than allocating
+  const size_t* data = indices.data();
+  scheduler.order({5, 4, 3}, &indices, &priorities);
+  ck_assert(indices.data() == data);
+  expected = {0, 2, 1};
+  ck_assert(indices == expected);
+  ck_assert_int_eq(priorities[2], FS::PRIORITY_BEST_EFFORT);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_budget) {
+  ds::FrameScheduler scheduler;
+  // no budget, nothing is skipped
+  ck_assert(scheduler.should_process(FS::PRIORITY_BEST_EFFORT, 1000000000));
+
+  scheduler.set_budget(1000);
+  ck_assert(scheduler.active());
+  ck_assert(scheduler.should_process(FS::PRIORITY_NORMAL, 999));
+  ck_assert(!scheduler.should_process(FS::PRIORITY_NORMAL, 1000));
+  ck_assert(!scheduler.should_process(FS::PRIORITY_BEST_EFFORT, 5000));
+  // critical frames are processed whatever the time
+  ck_assert(scheduler.should_process(FS::PRIORITY_CRITICAL, 5000));
+  ck_assert_uint_eq(scheduler.skipped(), 2);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_batch) {
+  ds::FrameScheduler scheduler;
+  ck_assert(scheduler.set_priorities("1:critical"));
+  scheduler.set_budget(1000);
+  ck_assert(scheduler.should_process_batch({0, 2}, 500));
+  ck_assert(!scheduler.should_process_batch({0, 2, 3}, 2000));
+  ck_assert_uint_eq(scheduler.skipped(), 3);
+  ck_assert(scheduler.should_process_batch({0, 1}, 2000));
+  ck_assert_uint_eq(scheduler.skipped(), 3);
+}
+GST_END_TEST;
+
+static Suite* framescheduler_suite(void) {
+  Suite* s = suite_create("FrameScheduler");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_priorities);
+  tcase_add_test(bc, test_order);
+  tcase_add_test(bc, test_budget);
+  tcase_add_test(bc, test_batch);
+
+  return s;
+}
+
+GST_CHECK_MAIN(framescheduler);
@@ -0,0 +1,353 @@
+/* GStreamer
+ *
+ * Copyright (C) 2020 Micheal de Gans <michael.john.degans@gmail.com>
+ * Copyright (C) 2006 Thomas Vander Stichele <thomas at apestaart dot org>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "FakeBatchMeta.hpp"
+#include "gstdsanalytics.h"
+#include "gstdsviolations.h"
+
+#include <gst/check/check.h>
+
+static const char* ELEMENT_NAME = "dsanalytics";
+static const char* ELEMENT_TYPE_NAME = "GstDsAnalytics";
+
+// test pad formats
+static const char* ELEMENT_CAPS_TEST_NV12_STR =
+    "video/x-raw(memory:NVMM), format=(string)NV12, width=1280, height=720, "
+    "framerate=(fraction)1/30";
+static const char* ELEMENT_CAPS_TEST_SYSMEM_STR =
+    "video/x-raw, format=(string)RGBA, width=1280, height=720, "
+    "framerate=(fraction)1/30";
+
+// the same fake people for the fused element and the separate ones
+static const char* FAKE_SRC_STR =
+    "dsfakemetasrc batch-size=2 objects-per-frame=8 motion=random seed=42";
+
+// pad templates
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
+    "sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS(
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
+    "src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS(
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
+
+/* basic tests */
+
+GST_START_TEST(test_setup_teardown) {
+  GstElement* filter = gst_check_setup_element(ELEMENT_NAME);
+  gst_check_teardown_element(filter);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_type) {
+  GstElement* filter = gst_check_setup_element(ELEMENT_NAME);
+
+  ck_assert(GST_IS_ELEMENT(filter));
+  ck_assert(GST_IS_DSANALYTICS(filter));
+  // everything dspayloadbroker can do, dsanalytics can
+  ck_assert(GST_IS_DSPAYLOADBROKER(filter));
+  ck_assert_str_eq(G_OBJECT_TYPE_NAME(filter), ELEMENT_TYPE_NAME);
+
+  gst_check_teardown_element(filter);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_autoptr) {
+  // this just tests it doensn't crash
+  g_autoptr(GstElement) filter = gst_element_factory_make(ELEMENT_NAME, nullptr);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_properties) {
+  GstElement* filter = gst_element_factory_make(ELEMENT_NAME, nullptr);
+  gint class_id = -1;
+  gboolean do_drawing = FALSE;
+  GstDsPayloadBrokerMode mode = PAYLOAD_BROKER_MODE_PROPERTY;
+
+  // dsdistance's
+  g_object_get(filter, "class-id", &class_id, "do-drawing", &do_drawing,
+               nullptr);
+  fail_unless_equals_int(class_id, 0);
+  g_assert_true(do_drawing);
+  g_object_set(filter, "class-id", 2, "do-drawing", FALSE, nullptr);
+  g_object_get(filter, "class-id", &class_id, "do-drawing", &do_drawing,
+               nullptr);
+  fail_unless_equals_int(class_id, 2);
+  g_assert_false(do_drawing);
+
+  // and dsdistance's load and violation controls, with its defaults
+  gboolean qos = FALSE;
+  gboolean post_violations = TRUE;
+  guint budget = 1;
+  guint64 skipped = 1;
+  gchar* config_file = nullptr;
+  g_object_get(filter, "qos", &qos, "post-violations", &post_violations,
+               "budget", &budget, "skipped-frames", &skipped, "config-file",
+               &config_file, nullptr);
+  g_assert_true(qos);
+  g_assert_false(post_violations);
+  fail_unless_equals_int(budget, 0);
+  fail_unless_equals_uint64(skipped, 0);
+  g_assert_null(config_file);
+  g_object_set(filter, "priorities", "0:critical", "budget", 500, nullptr);
+  gchar* priorities = nullptr;
+  g_object_get(filter, "priorities", &priorities, "budget", &budget,
+               nullptr);
+  fail_unless_equals_string(priorities, "0:critical");
+  fail_unless_equals_int(budget, 500);
+  g_free(priorities);
+
+  // dspayloadbroker's
+  g_object_set(filter, "mode", PAYLOAD_BROKER_MODE_RECORDS, nullptr);
+  g_object_get(filter, "mode", &mode, nullptr);
+  fail_unless_equals_int(mode, PAYLOAD_BROKER_MODE_RECORDS);
+
+  gst_object_unref(filter);
+}
+GST_END_TEST;
+
+
+// https://gstreamer.freedesktop.org/documentation/check/gstcheck.html?gi-language=c#gst_check_setup_src_pad_by_name
+static inline void _test_pads(const gchar* caps_str) {
+  GstElement* filter = gst_check_setup_element(ELEMENT_NAME);
+  GstPad* src_pad = gst_check_setup_src_pad(filter, &src_template);
+  GstPad* sink_pad = gst_check_setup_sink_pad(filter, &sink_template);
+  GstCaps* caps = gst_caps_from_string(caps_str);
+
+  // activate pads
+  ck_assert(gst_pad_set_active(src_pad, TRUE));
+  ck_assert(gst_pad_set_active(sink_pad, TRUE));
+
+  // activate element
+  ck_assert(gst_element_set_state(filter, GST_STATE_PLAYING) ==
+            GST_STATE_CHANGE_SUCCESS);
+
+  // check source and sink pad setup
+  gst_check_setup_events(src_pad, filter, caps, GST_FORMAT_TIME);
+
+  // shutdown element
+  ck_assert(gst_element_set_state(filter, GST_STATE_NULL) ==
+            GST_STATE_CHANGE_SUCCESS);
+
+  // check cleanup
+  gst_caps_unref(caps);
+  gst_check_object_destroyed_on_unref(src_pad);
+  gst_check_object_destroyed_on_unref(sink_pad);
+  gst_check_teardown_element(filter);
+}
+
+
+GST_START_TEST(test_pads_nv12) {
+  _test_pads(ELEMENT_CAPS_TEST_NV12_STR);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_pads_sysmem) {
+  _test_pads(ELEMENT_CAPS_TEST_SYSMEM_STR);
+}
+GST_END_TEST;
+
+
+/* harness tests */
+/* https://gstreamer.freedesktop.org/documentation/check/gstharness.html */
+
+GST_START_TEST(test_harness_passthrough) {
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  g_assert_nonnull(h);
+  gst_harness_set_src_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+  // a buffer without batch meta goes straight through
+  GstBuffer* in_buf = gst_harness_create_buffer(h, 42);
+  fail_unless_equals_int(gst_harness_push(h, in_buf), GST_FLOW_OK);
+  GstBuffer* out_buf = gst_harness_pull(h);
+  fail_unless(in_buf == out_buf);
+
+  gst_buffer_unref(out_buf);
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+
+/* push num_buffers fake batches through h and return the latest records
+ * of broker (transfer full)
+ */
+static GBytes* _run_records(GstHarness* h,
+                            GstElement* broker,
+                            guint num_buffers) {
+  GBytes* records = nullptr;
+  gst_harness_add_src_parse(h, FAKE_SRC_STR, TRUE);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  for (guint i = 0; i < num_buffers; i++) {
+    fail_unless_equals_int(gst_harness_push_from_src(h), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+  }
+  g_object_get(broker, "records", &records, nullptr);
+  return records;
+}
+
+
+GST_START_TEST(test_matches_separate_elements) {
+  const guint num_buffers = 16;
+
+  GstHarness* fused = gst_harness_new(ELEMENT_NAME);
+  g_object_set(fused->element, "mode", PAYLOAD_BROKER_MODE_RECORDS, nullptr);
+  GBytes* fused_records = _run_records(fused, fused->element, num_buffers);
+
+  GstHarness* separate = gst_harness_new_parse(
+      "dsdistance ! dsprotopayload ! dspayloadbroker name=broker mode=records");
+  GstElement* broker =
+      gst_bin_get_by_name(GST_BIN(separate->element), "broker");
+  GBytes* separate_records = _run_records(separate, broker, num_buffers);
+
+  // the same people with the same distances, in the same order
+  g_assert_nonnull(fused_records);
+  g_assert_nonnull(separate_records);
+  fail_unless_equals_uint64(g_bytes_get_size(fused_records), 2 * 8 * 56);
+  g_assert_true(g_bytes_equal(fused_records, separate_records));
+
+  g_bytes_unref(fused_records);
+  g_bytes_unref(separate_records);
+  gst_object_unref(broker);
+  gst_harness_teardown(fused);
+  gst_harness_teardown(separate);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_stats) {
+  const guint num_buffers = 4;
+  GstStructure* stats = nullptr;
+  guint64 pairs = 0;
+
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  g_object_set(h->element, "mode", PAYLOAD_BROKER_MODE_RECORDS, nullptr);
+  GBytes* records = _run_records(h, h->element, num_buffers);
+
+  // pairs are counted from the people in each frame's payload
+  g_object_get(h->element, "stats", &stats, nullptr);
+  g_assert_true(gst_structure_get_uint64(stats, "pairs", &pairs));
+  fail_unless_equals_uint64(pairs, num_buffers * 2 * 28);
+
+  gst_structure_free(stats);
+  g_bytes_unref(records);
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+
+/* push a batch of scene at pts ms and return how many ds-violation changes
+ * to state were posted for it
+ */
+static guint _push_violations(GstHarness* h,
+                              GstBus* bus,
+                              const ds::FakeScene& scene,
+                              guint64 ms,
+                              const gchar* state) {
+  GstBuffer* buf = gst_harness_create_buffer(h, 42);
+  GST_BUFFER_PTS(buf) = ms * GST_MSECOND;
+  ds::add_fake_batch_meta(buf, scene, ms, 0);
+  fail_unless_equals_int(gst_harness_push(h, buf), GST_FLOW_OK);
+  gst_buffer_unref(gst_harness_pull(h));
+  GstMessage* msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ELEMENT);
+  if (msg == nullptr) {
+    return 0;
+  }
+  const GstStructure* s = gst_message_get_structure(msg);
+  fail_unless(gst_structure_has_name(s, GST_DS_VIOLATIONS_MESSAGE_NAME));
+  const GValue* changes = gst_structure_get_value(s, "changes");
+  g_assert_nonnull(changes);
+  guint n = gst_value_array_get_size(changes);
+  for (guint i = 0; i < n; i++) {
+    fail_unless_equals_string(
+        gst_structure_get_string(
+            gst_value_get_structure(gst_value_array_get_value(changes, i)),
+            "state"),
+        state);
+  }
+  gst_message_unref(msg);
+  return n;
+}
+
+
+GST_START_TEST(test_harness_violations) {
+  ds::FakeScene scene(2, 4, ds::FakeScene::MOTION_STATIC, 0.0, 1280, 720);
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  GstBus* bus = gst_bus_new();
+  gst_element_set_bus(h->element, bus);
+  gst_harness_set_src_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+  // off by default
+  fail_unless_equals_int(_push_violations(h, bus, scene, 0, "started"), 0);
+
+  // everyone is too close, then no one is, in both sources
+  g_object_set(h->element, "post-violations", TRUE, "violation-window", 0,
+               "violation-distance", 1e6f, nullptr);
+  fail_unless_equals_int(_push_violations(h, bus, scene, 33, "started"), 2);
+  g_object_set(h->element, "violation-distance", 0.0f, nullptr);
+  fail_unless_equals_int(_push_violations(h, bus, scene, 66, "ended"), 2);
+
+  gst_element_set_bus(h->element, nullptr);
+  gst_object_unref(bus);
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+
+static Suite* dsanalytics_suite(void) {
+  Suite* s = suite_create(ELEMENT_NAME);
+  TCase* bc = tcase_create("basic");
+  TCase* cc = tcase_create("check");
+  TCase* hc = tcase_create("harness");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_setup_teardown);
+  tcase_add_test(bc, test_autoptr);
+  tcase_add_test(bc, test_type);
+  tcase_add_test(bc, test_properties);
+
+  suite_add_tcase(s, cc);
+  tcase_add_test(cc, test_pads_nv12);
+  tcase_add_test(cc, test_pads_sysmem);
+
+  suite_add_tcase(s, hc);
+  tcase_add_test(hc, test_harness_passthrough);
+  tcase_add_test(hc, test_matches_separate_elements);
+  tcase_add_test(hc, test_stats);
+  tcase_add_test(hc, test_harness_violations);
+
+  return s;
+}
+
+GST_CHECK_MAIN(dsanalytics);
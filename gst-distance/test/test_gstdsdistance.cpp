@@ -19,9 +19,13 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <glib/gstdio.h>
 #include <gst/check/check.h>
 
+#include "FakeBatchMeta.hpp"
 #include "gstdsdistance.h"
+#include "gstdsqos.h"
+#include "gstdsviolations.h"
 
 static const char* ELEMENT_NAME = "dsdistance";
 static const char* ELEMENT_TYPE_NAME = "GstDsDistance";
@@ -33,6 +37,9 @@ static const char* ELEMENT_CAPS_TEST_NV12_STR =
 static const char* ELEMENT_CAPS_TEST_RGBA_STR =
     "video/x-raw(memory:NVMM), format=(string)RGBA, width=1280, height=720, "
     "framerate=(fraction)1/30";
+static const char* ELEMENT_CAPS_TEST_SYSMEM_STR =
+    "video/x-raw, format=(string)RGBA, width=1280, height=720, "
+    "framerate=(fraction)1/30";
 
 // pad templates
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
@@ -40,14 +47,16 @@ static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
     "src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 /* basic tests */
 
@@ -124,6 +133,11 @@ GST_START_TEST(test_pads_rgba) {
 }
 GST_END_TEST;
 
+GST_START_TEST(test_pads_sysmem) {
+  _test_pads(ELEMENT_CAPS_TEST_SYSMEM_STR);
+}
+GST_END_TEST;
+
 GST_START_TEST(test_silent_property) {
   GstElement* filter;
   filter = gst_element_factory_make(ELEMENT_NAME, nullptr);
@@ -193,6 +207,299 @@ GST_START_TEST(test_harness_rgba_passthrough) {
 }
 GST_END_TEST;
 
+GST_START_TEST(test_harness_stats) {
+  const guint num_buffers = 8;
+  GstHarness* h;
+  GstStructure* stats = nullptr;
+  guint64 buffers = 0;
+  guint64 objects = 0;
+  guint64 pairs = 0;
+
+  h = gst_harness_new(ELEMENT_NAME);
+  g_assert_nonnull(h);
+  // the people are only walked (and the pairs counted) for violations
+  g_object_set(h->element, "post-violations", TRUE, nullptr);
+
+  // two frames of four people per batch
+  gst_harness_add_src_parse(
+      h, "dsfakemetasrc batch-size=2 objects-per-frame=4 class-id=0", TRUE);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+  for (guint i = 0; i < num_buffers; i++) {
+    gst_harness_push_from_src(h);
+    gst_buffer_unref(gst_harness_pull(h));
+  }
+
+  g_object_get(h->element, "stats", &stats, nullptr);
+  g_assert_nonnull(stats);
+  g_assert_true(gst_structure_get_uint64(stats, "buffers", &buffers));
+  g_assert_true(gst_structure_get_uint64(stats, "objects", &objects));
+  g_assert_true(gst_structure_get_uint64(stats, "pairs", &pairs));
+  fail_unless_equals_uint64(buffers, num_buffers);
+  fail_unless_equals_uint64(objects, num_buffers * 2 * 4);
+  // 4 choose 2 pairs per frame
+  fail_unless_equals_uint64(pairs, num_buffers * 2 * 6);
+
+  gst_structure_free(stats);
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_harness_config_reload) {
+  gchar* tmpdir = g_dir_make_tmp("dsdistance-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* path = g_build_filename(tmpdir, "sources.conf", nullptr);
+  gchar* tmp_path = g_strconcat(path, ".tmp", nullptr);
+  ck_assert(g_file_set_contents(path, "[source-1]\nenabled=false\n", -1,
+                                nullptr));
+
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  g_assert_nonnull(h);
+  g_object_set(h->element, "config-file", path, NULL);
+  gchar* config_file = nullptr;
+  g_object_get(h->element, "config-file", &config_file, NULL);
+  ck_assert_str_eq(config_file, path);
+  g_free(config_file);
+
+  gst_harness_add_src_parse(
+      h, "dsfakemetasrc batch-size=4 objects-per-frame=4 class-id=0", TRUE);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+  // save by renaming, like most editors, while buffers keep flowing
+  ck_assert(g_file_set_contents(
+      tmp_path, "[default]\nclass-id=0\n[source-2]\ndo-drawing=false\n",
+      -1, nullptr));
+  ck_assert_int_eq(g_rename(tmp_path, path), 0);
+  guint64 reloads = 0;
+  for (guint i = 0; i < 5000 && reloads == 0; i++) {
+    fail_unless_equals_int(gst_harness_push_from_src(h), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+    g_object_get(h->element, "config-reloads", &reloads, NULL);
+    g_usleep(1000);
+  }
+  fail_unless_equals_uint64(reloads, 1);
+
+  // a malformed edit keeps the old settings and streaming goes on
+  ck_assert(g_file_set_contents(path, "[source-2]\nthreshold=1\n", -1,
+                                nullptr));
+  for (guint i = 0; i < 100; i++) {
+    fail_unless_equals_int(gst_harness_push_from_src(h), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+  }
+  g_object_get(h->element, "config-reloads", &reloads, NULL);
+  fail_unless_equals_uint64(reloads, 1);
+
+  gst_harness_teardown(h);
+  g_unlink(path);
+  g_rmdir(tmpdir);
+  g_free(tmp_path);
+  g_free(path);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+/* send n QoS events upstream and return the level of the ds-qos message
+ * posted, or -1 if none was
+ */
+static gint _send_qos(GstHarness* h,
+                      GstBus* bus,
+                      guint n,
+                      gdouble proportion,
+                      GstClockTimeDiff diff) {
+  gint level = -1;
+  for (guint i = 0; i < n; i++) {
+    gst_harness_push_upstream_event(
+        h, gst_event_new_qos(GST_QOS_TYPE_UNDERFLOW, proportion, diff, 0));
+  }
+  GstMessage* msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ELEMENT);
+  if (msg != nullptr) {
+    const GstStructure* s = gst_message_get_structure(msg);
+    guint value = 0;
+    fail_unless(gst_structure_has_name(s, GST_DS_QOS_MESSAGE_NAME));
+    fail_unless(gst_structure_get_uint(s, "level", &value));
+    level = (gint)value;
+    gst_message_unref(msg);
+  }
+  return level;
+}
+
+/* PLAYING -> READY -> PLAYING, as on every camera reconnect, with a batch
+ * through the filter after each restart
+ */
+GST_START_TEST(test_harness_state_cycling) {
+  const guint num_cycles = 1000;
+  ds::FakeScene scene(2, 4, ds::FakeScene::MOTION_STATIC, 0.0, 1280, 720);
+  GstStructure* stats = nullptr;
+  guint64 buffers = 0;
+
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  g_assert_nonnull(h);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  // GST_DEBUG=4 logs every state change, thousands of lines per cycle
+  GstDebugLevel threshold = gst_debug_get_default_threshold();
+  gst_debug_set_default_threshold(GST_LEVEL_WARNING);
+
+  for (guint i = 0; i < num_cycles; i++) {
+    fail_unless_equals_int(gst_element_set_state(h->element, GST_STATE_READY),
+                           GST_STATE_CHANGE_SUCCESS);
+    fail_unless_equals_int(
+        gst_element_set_state(h->element, GST_STATE_PLAYING),
+        GST_STATE_CHANGE_SUCCESS);
+    // the sink pad dropped its sticky events on the way down
+    gst_harness_push_event(h, gst_event_new_stream_start("cycling"));
+    gst_harness_set_src_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+    GstBuffer* buf = gst_harness_create_buffer(h, 42);
+    ds::add_fake_batch_meta(buf, scene, i, 0);
+    fail_unless_equals_int(gst_harness_push(h, buf), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+  }
+  gst_debug_set_default_threshold(threshold);
+
+  // the counters are the element's, so they survive restarts too
+  g_object_get(h->element, "stats", &stats, nullptr);
+  g_assert_nonnull(stats);
+  g_assert_true(gst_structure_get_uint64(stats, "buffers", &buffers));
+  fail_unless_equals_uint64(buffers, num_cycles);
+
+  gst_structure_free(stats);
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_harness_qos) {
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  GstBus* bus = gst_bus_new();
+  gst_element_set_bus(h->element, bus);
+  gst_harness_set_src_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+  // late for a while, so only every other buffer is processed
+  fail_unless_equals_int(
+      _send_qos(h, bus, ds::LoadShedder::ESCALATE_AFTER, 1.5,
+                20 * GST_MSECOND),
+      1);
+
+  // but every buffer still goes downstream
+  for (int i = 0; i < 4; i++) {
+    fail_unless_equals_int(
+        gst_harness_push(h, gst_harness_create_buffer(h, 42)), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+  }
+
+  // on time for a while, so back to every buffer
+  fail_unless_equals_int(
+      _send_qos(h, bus, ds::LoadShedder::RECOVER_AFTER, 0.5,
+                -5 * GST_MSECOND),
+      0);
+
+  // with qos off nothing changes
+  g_object_set(h->element, "qos", FALSE, nullptr);
+  fail_unless_equals_int(
+      _send_qos(h, bus, ds::LoadShedder::ESCALATE_AFTER, 1.5,
+                20 * GST_MSECOND),
+      -1);
+
+  gst_element_set_bus(h->element, nullptr);
+  gst_object_unref(bus);
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+/* push a batch of scene at pts ms and return the ds-violations message
+ * posted for it, if any
+ */
+static GstMessage* _push_violations(GstHarness* h,
+                                    GstBus* bus,
+                                    const ds::FakeScene& scene,
+                                    guint64 ms) {
+  GstBuffer* buf = gst_harness_create_buffer(h, 42);
+  GST_BUFFER_PTS(buf) = ms * GST_MSECOND;
+  ds::add_fake_batch_meta(buf, scene, ms, 0);
+  fail_unless_equals_int(gst_harness_push(h, buf), GST_FLOW_OK);
+  gst_buffer_unref(gst_harness_pull(h));
+  GstMessage* msg = gst_bus_pop_filtered(bus, GST_MESSAGE_ELEMENT);
+  if (msg != nullptr) {
+    fail_unless(gst_structure_has_name(gst_message_get_structure(msg),
+                                       GST_DS_VIOLATIONS_MESSAGE_NAME));
+  }
+  return msg;
+}
+
+/* assert every change in a ds-violations message is to state, and return
+ * how many there are
+ */
+static guint _check_violations(GstMessage* msg,
+                               const gchar* state,
+                               guint cluster_size) {
+  g_assert_nonnull(msg);
+  const GValue* changes =
+      gst_structure_get_value(gst_message_get_structure(msg), "changes");
+  g_assert_nonnull(changes);
+  guint n = gst_value_array_get_size(changes);
+  for (guint i = 0; i < n; i++) {
+    const GstStructure* change = gst_value_get_structure(
+        gst_value_array_get_value(changes, i));
+    guint size = G_MAXUINT;
+    fail_unless(gst_structure_has_name(change, GST_DS_VIOLATION_NAME));
+    fail_unless_equals_string(gst_structure_get_string(change, "state"),
+                              state);
+    fail_unless(gst_structure_get_uint(change, "cluster-size", &size));
+    fail_unless_equals_int(size, cluster_size);
+  }
+  gst_message_unref(msg);
+  return n;
+}
+
+GST_START_TEST(test_harness_violations) {
+  ds::FakeScene scene(2, 4, ds::FakeScene::MOTION_STATIC, 0.0, 1280, 720);
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  GstBus* bus = gst_bus_new();
+  gst_element_set_bus(h->element, bus);
+  gst_harness_set_src_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+  // off by default
+  g_assert_null(_push_violations(h, bus, scene, 0));
+
+  // everyone is too close, so one cluster of 4 per source
+  g_object_set(h->element, "post-violations", TRUE, "violation-window", 0,
+               "violation-distance", 1e6f, nullptr);
+  fail_unless_equals_int(
+      _check_violations(_push_violations(h, bus, scene, 33), "started", 4),
+      2);
+  // no change, no message
+  g_assert_null(_push_violations(h, bus, scene, 66));
+  g_object_set(h->element, "violation-distance", 0.0f, nullptr);
+  fail_unless_equals_int(
+      _check_violations(_push_violations(h, bus, scene, 100), "ended", 0),
+      2);
+
+  // a violation that comes and goes within the window is one message
+  g_object_set(h->element, "violation-window", 1000, nullptr);
+  g_object_set(h->element, "violation-distance", 1e6f, nullptr);
+  g_assert_null(_push_violations(h, bus, scene, 1000));
+  g_object_set(h->element, "violation-distance", 0.0f, nullptr);
+  g_assert_null(_push_violations(h, bus, scene, 1500));
+  fail_unless_equals_int(
+      _check_violations(_push_violations(h, bus, scene, 2000), "brief", 0),
+      2);
+
+  // what's pending is posted on eos
+  g_object_set(h->element, "violation-distance", 1e6f, nullptr);
+  g_assert_null(_push_violations(h, bus, scene, 3000));
+  gst_harness_push_event(h, gst_event_new_eos());
+  fail_unless_equals_int(
+      _check_violations(gst_bus_pop_filtered(bus, GST_MESSAGE_ELEMENT),
+                        "started", 4),
+      2);
+
+  gst_element_set_bus(h->element, nullptr);
+  gst_object_unref(bus);
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
 static inline void _test_with_src(const gchar* src_str) {
   GstHarness* h;
 
@@ -233,10 +540,18 @@ static Suite* dsdistance_suite(void) {
   suite_add_tcase(s, cc);
   tcase_add_test(cc, test_pads_nv12);
   tcase_add_test(cc, test_pads_rgba);
+  tcase_add_test(cc, test_pads_sysmem);
 
+  // a thousand restarts take a while on a Jetson
+  tcase_set_timeout(hc, 120);
   suite_add_tcase(s, hc);
   tcase_add_test(hc, test_harness_nv12_passthrough);
   tcase_add_test(hc, test_harness_rgba_passthrough);
+  tcase_add_test(hc, test_harness_stats);
+  tcase_add_test(hc, test_harness_qos);
+  tcase_add_test(hc, test_harness_config_reload);
+  tcase_add_test(hc, test_harness_state_cycling);
+  tcase_add_test(hc, test_harness_violations);
 
   suite_add_tcase(s, ic);
   tcase_add_test(ic, test_simple_pipeline);
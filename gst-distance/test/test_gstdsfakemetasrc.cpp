@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include <gst/check/check.h>
+
+#include "gstdsfakemetasrc.h"
+
+#include "RecordArrayBroker.hpp"
+
+#include <gstnvdsmeta.h>
+
+static const char* ELEMENT_NAME = "dsfakemetasrc";
+static const char* ELEMENT_TYPE_NAME = "GstDsFakeMetaSrc";
+
+/* basic tests */
+
+GST_START_TEST(test_setup_teardown) {
+  GstElement* src = gst_check_setup_element(ELEMENT_NAME);
+  gst_check_teardown_element(src);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_type) {
+  GstElement* src = gst_check_setup_element(ELEMENT_NAME);
+
+  ck_assert(GST_IS_ELEMENT(src));
+  ck_assert(GST_IS_DSFAKEMETASRC(src));
+  ck_assert_str_eq(G_OBJECT_TYPE_NAME(src), ELEMENT_TYPE_NAME);
+
+  gst_check_teardown_element(src);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_properties) {
+  GstElement* src = gst_element_factory_make(ELEMENT_NAME, nullptr);
+  guint batch_size = 0;
+  guint objects_per_frame = 0;
+  GstDsFakeMetaSrcMotion motion = FAKE_META_SRC_MOTION_STATIC;
+  gdouble id_churn = 0.0;
+  guint64 seed = 0;
+
+  g_object_get(src, "batch-size", &batch_size, "objects-per-frame",
+               &objects_per_frame, "motion", &motion, nullptr);
+  ck_assert_uint_eq(batch_size, 1);
+  ck_assert_uint_eq(objects_per_frame, 10);
+  ck_assert_int_eq(motion, FAKE_META_SRC_MOTION_LINEAR);
+
+  g_object_set(src, "batch-size", 16, "objects-per-frame", 200, "motion",
+               FAKE_META_SRC_MOTION_RANDOM, "id-churn", 0.25, "seed",
+               (guint64)42, nullptr);
+  g_object_get(src, "batch-size", &batch_size, "objects-per-frame",
+               &objects_per_frame, "motion", &motion, "id-churn", &id_churn,
+               "seed", &seed, nullptr);
+  ck_assert_uint_eq(batch_size, 16);
+  ck_assert_uint_eq(objects_per_frame, 200);
+  ck_assert_int_eq(motion, FAKE_META_SRC_MOTION_RANDOM);
+  ck_assert(id_churn == 0.25);
+  ck_assert_uint_eq(seed, 42);
+
+  gst_object_unref(src);
+}
+GST_END_TEST;
+
+/* harness tests */
+/* https://gstreamer.freedesktop.org/documentation/check/gstharness.html */
+
+GST_START_TEST(test_harness_batch_meta) {
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  g_assert_nonnull(h);
+  g_object_set(h->element, "batch-size", 4, "objects-per-frame", 25, nullptr);
+  gst_harness_set_sink_caps_str(
+      h, "video/x-raw, format=RGBA, width=1280, height=720, "
+         "framerate=25/1");
+  gst_harness_play(h);
+
+  for (guint64 n = 0; n < 10; n++) {
+    GstBuffer* buf = gst_harness_pull(h);
+    g_assert_nonnull(buf);
+    ck_assert_uint_eq(GST_BUFFER_PTS(buf), n * GST_SECOND / 25);
+
+    NvDsBatchMeta* batch_meta = gst_buffer_get_nvds_batch_meta(buf);
+    g_assert_nonnull(batch_meta);
+    ck_assert_uint_eq(batch_meta->num_frames_in_batch, 4);
+    guint source = 0;
+    for (NvDsMetaList* l = batch_meta->frame_meta_list; l; l = l->next) {
+      NvDsFrameMeta* frame_meta = (NvDsFrameMeta*)l->data;
+      ck_assert_uint_eq(frame_meta->source_id, source++);
+      ck_assert_int_eq(frame_meta->frame_num, (gint)n);
+      ck_assert_uint_eq(frame_meta->num_obj_meta, 25);
+      for (NvDsMetaList* o = frame_meta->obj_meta_list; o; o = o->next) {
+        NvDsObjectMeta* obj_meta = (NvDsObjectMeta*)o->data;
+        ck_assert(obj_meta->rect_params.left >= 0.0f);
+        ck_assert(obj_meta->rect_params.left + obj_meta->rect_params.width <=
+                  1280.5f);
+        ck_assert(obj_meta->rect_params.top + obj_meta->rect_params.height <=
+                  720.5f);
+      }
+    }
+    gst_buffer_unref(buf);
+  }
+
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+/* integration tests */
+
+GST_START_TEST(test_pipeline_records) {
+  GError* err = nullptr;
+  GstElement* pipeline = gst_parse_launch(
+      "dsfakemetasrc num-buffers=30 batch-size=4 objects-per-frame=50 "
+      "id-churn=0.05 ! dsdistance ! dspayloadbroker name=broker mode=records "
+      "! fakesink",
+      &err);
+  g_assert_no_error(err);
+  g_assert_nonnull(pipeline);
+
+  ck_assert(gst_element_set_state(pipeline, GST_STATE_PLAYING) !=
+            GST_STATE_CHANGE_FAILURE);
+  GstBus* bus = gst_element_get_bus(pipeline);
+  GstMessage* msg = gst_bus_timed_pop_filtered(
+      bus, 10 * GST_SECOND,
+      GstMessageType(GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+  g_assert_nonnull(msg);
+  ck_assert_int_eq(GST_MESSAGE_TYPE(msg), GST_MESSAGE_EOS);
+  gst_message_unref(msg);
+  gst_object_unref(bus);
+
+  // the last batch: 4 sources of 50 people
+  GstElement* broker = gst_bin_get_by_name(GST_BIN(pipeline), "broker");
+  GBytes* records = nullptr;
+  g_object_get(broker, "records", &records, nullptr);
+  g_assert_nonnull(records);
+  ck_assert_uint_eq(g_bytes_get_size(records),
+                    4 * 50 * sizeof(ds::PersonRecord));
+  g_bytes_unref(records);
+  gst_object_unref(broker);
+
+  ck_assert(gst_element_set_state(pipeline, GST_STATE_NULL) ==
+            GST_STATE_CHANGE_SUCCESS);
+  gst_object_unref(pipeline);
+}
+GST_END_TEST;
+
+static Suite* dsfakemetasrc_suite(void) {
+  Suite* s = suite_create(ELEMENT_NAME);
+  TCase* bc = tcase_create("basic");
+  TCase* hc = tcase_create("harness");
+  TCase* ic = tcase_create("integration");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_setup_teardown);
+  tcase_add_test(bc, test_type);
+  tcase_add_test(bc, test_properties);
+
+  suite_add_tcase(s, hc);
+  tcase_add_test(hc, test_harness_batch_meta);
+
+  suite_add_tcase(s, ic);
+  tcase_add_test(ic, test_pipeline_records);
+
+  return s;
+}
+
+GST_CHECK_MAIN(dsfakemetasrc);
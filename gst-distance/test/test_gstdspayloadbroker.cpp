@@ -21,7 +21,25 @@
 
 #include "gstdspayloadbroker.h"
 
+#include "AsyncFileMetaBroker.hpp"
+#include "AsyncFileWriter.hpp"
+#include "ColumnarReader.hpp"
+#include "FakeBatchMeta.hpp"
+#include "FanOutPayloadBroker.hpp"
+#include "RecordingReader.hpp"
+#include "RecordingScan.hpp"
+
+#include <distance.pb.h>
+#include <google/protobuf/util/json_util.h>
+
+#include <glib/gstdio.h>
 #include <gst/check/check.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
 
 static const char* ELEMENT_NAME = "dspayloadbroker";
 static const char* ELEMENT_TYPE_NAME = "GstDsPayloadBroker";
@@ -33,6 +51,9 @@ static const char* ELEMENT_CAPS_TEST_NV12_STR =
 static const char* ELEMENT_CAPS_TEST_RGBA_STR =
     "video/x-raw(memory:NVMM), format=(string)RGBA, width=1280, height=720, "
     "framerate=(fraction)1/30";
+static const char* ELEMENT_CAPS_TEST_SYSMEM_STR =
+    "video/x-raw, format=(string)RGBA, width=1280, height=720, "
+    "framerate=(fraction)1/30";
 
 // pad templates
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
@@ -40,14 +61,16 @@ static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
     "src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 /* basic tests */
 
@@ -131,6 +154,12 @@ GST_START_TEST(test_pads_rgba) {
 GST_END_TEST;
 
 
+GST_START_TEST(test_pads_sysmem) {
+  _test_pads(ELEMENT_CAPS_TEST_SYSMEM_STR);
+}
+GST_END_TEST;
+
+
 GST_START_TEST(test_silent_property) {
   GstElement* filter;
   filter = gst_element_factory_make(ELEMENT_NAME, nullptr);
@@ -158,6 +187,594 @@ GST_START_TEST(test_silent_property) {
 GST_END_TEST;
 
 
+GST_START_TEST(test_file_properties) {
+  GstElement* filter;
+  filter = gst_element_factory_make(ELEMENT_NAME, nullptr);
+
+  guint queue_size, rotate_size, queue_depth;
+  guint64 dropped;
+  gint io_backend;
+
+  g_object_get(filter,
+    "io-backend", &io_backend,
+    "queue-size", &queue_size,
+    "rotate-size", &rotate_size,
+    "queue-depth", &queue_depth,
+    "dropped", &dropped,
+    nullptr);
+  ck_assert_int_eq(io_backend, PAYLOAD_BROKER_IO_BACKEND_AUTO);
+  ck_assert_uint_eq(queue_size, 4096);
+  ck_assert_uint_eq(rotate_size, 0);
+  // no writer yet
+  ck_assert_uint_eq(queue_depth, 0);
+  ck_assert_uint_eq(dropped, 0);
+
+  g_object_set(filter, "queue-size", 8, "rotate-size", 64, nullptr);
+  g_object_get(filter,
+    "queue-size", &queue_size,
+    "rotate-size", &rotate_size,
+    nullptr);
+  ck_assert_uint_eq(queue_size, 8);
+  ck_assert_uint_eq(rotate_size, 64);
+
+  guint row_group_size;
+  gint mode;
+  g_object_set(filter, "mode", PAYLOAD_BROKER_MODE_COLUMNAR,
+    "row-group-size", 32, nullptr);
+  g_object_get(filter, "mode", &mode, "row-group-size", &row_group_size,
+    nullptr);
+  ck_assert_int_eq(mode, PAYLOAD_BROKER_MODE_COLUMNAR);
+  ck_assert_uint_eq(row_group_size, 32);
+
+  guint window;
+  gfloat cluster_distance;
+  g_object_set(filter, "mode", PAYLOAD_BROKER_MODE_AGGREGATE,
+    "window", 1000, "cluster-distance", 1.5f, nullptr);
+  g_object_get(filter, "mode", &mode, "window", &window,
+    "cluster-distance", &cluster_distance, nullptr);
+  ck_assert_int_eq(mode, PAYLOAD_BROKER_MODE_AGGREGATE);
+  ck_assert_uint_eq(window, 1000);
+  ck_assert(cluster_distance == 1.5f);
+
+  gint sampling;
+  gdouble max_rate;
+  guint64 emitted, skipped;
+  g_object_get(filter, "sampling", &sampling, "max-rate", &max_rate,
+    "emitted", &emitted, "skipped", &skipped, nullptr);
+  ck_assert_int_eq(sampling, PAYLOAD_BROKER_SAMPLING_NONE);
+  ck_assert(max_rate == 1.0);
+  ck_assert_uint_eq(emitted, 0);
+  ck_assert_uint_eq(skipped, 0);
+  g_object_set(filter, "sampling", PAYLOAD_BROKER_SAMPLING_ADAPTIVE,
+    "max-rate", 0.5, nullptr);
+  g_object_get(filter, "sampling", &sampling, "max-rate", &max_rate, nullptr);
+  ck_assert_int_eq(sampling, PAYLOAD_BROKER_SAMPLING_ADAPTIVE);
+  ck_assert(max_rate == 0.5);
+
+  gst_object_unref(filter);
+}
+GST_END_TEST;
+
+
+/* AsyncFileWriter tests */
+
+GST_START_TEST(test_async_writer_rotation) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "out", nullptr);
+
+  ds::AsyncFileWriter::Options options;
+  options.basepath = basepath;
+  options.extension = ".csv";
+  options.header = "a,b\n";
+  options.chunk_size = 4096;
+  options.rotate_bytes = 1000;
+  options.fsync_policy = ds::AsyncFileWriter::FSYNC_BYTES;
+  options.fsync_bytes = 512;
+
+  const std::string row("1,2\n");
+  const int num_rows = 1000;
+  std::string expected_total;
+  {
+    ds::AsyncFileWriter writer(options);
+    ck_assert(writer.start());
+    for (int i = 0; i < num_rows; i++) {
+      ck_assert(writer.push(std::string(row)));
+    }
+    writer.stop();
+    ck_assert_uint_eq(writer.dropped(), 0);
+  }
+
+  // every file starts with the header, rows are never split
+  int rows = 0;
+  for (guint i = 0;; i++) {
+    gchar* name = g_strdup_printf("%s.%05u.csv", basepath, i);
+    gchar* contents = nullptr;
+    gsize len = 0;
+    gboolean exists = g_file_get_contents(name, &contents, &len, nullptr);
+    g_unlink(name);
+    g_free(name);
+    if (!exists) {
+      break;
+    }
+    ck_assert(len <= 1000 + row.size());
+    ck_assert(g_str_has_prefix(contents, "a,b\n"));
+    std::string body(contents + 4, len - 4);
+    ck_assert_uint_eq(body.size() % row.size(), 0);
+    rows += body.size() / row.size();
+    g_free(contents);
+  }
+  ck_assert_int_eq(rows, num_rows);
+
+  g_rmdir(tmpdir);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_async_writer_drops_when_full) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "out", nullptr);
+
+  ds::AsyncFileWriter::Options options;
+  options.basepath = basepath;
+  options.extension = ".pb";
+  options.queue_size = 4;
+
+  ds::AsyncFileWriter writer(options);
+  // not started: nothing drains the queue
+  for (int i = 0; i < 10; i++) {
+    writer.push(std::string("x"));
+  }
+  ck_assert_uint_eq(writer.queue_depth(), 4);
+  ck_assert_uint_eq(writer.dropped(), 6);
+  // only what was queued
+  ck_assert_uint_eq(writer.bytes_pushed(), 4);
+
+  gchar* path = g_strconcat(basepath, ".pb", nullptr);
+  g_unlink(path);
+  g_rmdir(tmpdir);
+  g_free(path);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_async_writer_no_overwrite) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "out", nullptr);
+
+  ds::AsyncFileWriter::Options options;
+  options.basepath = basepath;
+  options.extension = ".csv";
+
+  // two runs to the same basepath, then two with rotation
+  const char* rows[] = {"1\n", "2\n", "3\n", "4\n"};
+  for (int i = 0; i < 4; i++) {
+    options.rotate_seconds = i < 2 ? 0 : 3600;
+    ds::AsyncFileWriter writer(options);
+    ck_assert(writer.start());
+    ck_assert(writer.push(std::string(rows[i])));
+    writer.stop();
+  }
+
+  const char* suffixes[] = {".csv", "-1.csv", ".00000.csv", ".00001.csv"};
+  for (int i = 0; i < 4; i++) {
+    gchar* name = g_strconcat(basepath, suffixes[i], nullptr);
+    gchar* contents = nullptr;
+    ck_assert(g_file_get_contents(name, &contents, nullptr, nullptr));
+    ck_assert_str_eq(contents, rows[i]);
+    g_unlink(name);
+    g_free(contents);
+    g_free(name);
+  }
+
+  g_rmdir(tmpdir);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_async_writer_fsync_interval) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "out", nullptr);
+
+  ds::AsyncFileWriter::Options options;
+  options.basepath = basepath;
+  options.extension = ".csv";
+  options.fsync_policy = ds::AsyncFileWriter::FSYNC_INTERVAL;
+  // far shorter than the (default) flush interval
+  options.fsync_interval_ms = 20;
+  options.flush_interval_ms = 5000;
+
+  ds::AsyncFileWriter writer(options);
+  ck_assert(writer.start());
+  ck_assert(writer.push(std::string("1,2\n")));
+  // synced within a few fsync intervals, not after the flush interval
+  for (int i = 0; i < 100 && writer.syncs() == 0; i++) {
+    g_usleep(10000);
+  }
+  ck_assert_uint_ge(writer.syncs(), 1);
+  ck_assert_uint_eq(writer.bytes_written(), 4);
+  writer.stop();
+
+  gchar* path = g_strconcat(basepath, ".csv", nullptr);
+  g_unlink(path);
+  g_rmdir(tmpdir);
+  g_free(path);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+
+/* indexed recording tests */
+
+class CountingVisitor : public ds::recording::FrameVisitor {
+ public:
+  virtual void on_frame(const ds::recording::FrameView& frame) override {
+    frames++;
+    last_source = frame.source_id;
+  }
+  int frames = 0;
+  guint last_source = 0;
+};
+
+GST_START_TEST(test_indexed_recording_seek) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "rec", nullptr);
+  gchar* data_path = g_strconcat(basepath, ".pb", nullptr);
+  gchar* index_path = g_strconcat(basepath, ".idx", nullptr);
+
+  const int num_batches = 1000;
+  const guint64 frame_duration = GST_SECOND / 30;
+  {
+    ds::AsyncFileWriter::Options options;
+    options.backend = ds::AsyncFileWriter::BACKEND_POSIX;
+    ds::AsyncFileMetaBroker broker(basepath, ds::AsyncFileMetaBroker::proto,
+                                   options, 16);
+    ck_assert(broker.start());
+    for (int i = 0; i < num_batches; i++) {
+      dp::Batch batch;
+      for (guint source = 0; source < 2; source++) {
+        auto* frame = batch.add_frames();
+        frame->set_frame_num(i);
+        frame->set_source_id(source);
+        frame->set_pts(i * frame_duration);
+      }
+      broker.on_batch_payload(nullptr, &batch);
+    }
+    broker.stop();
+  }
+
+  ds::recording::RecordingReader reader;
+  ck_assert(reader.open(data_path));
+  ck_assert(reader.has_index());
+  // one entry per frame
+  ck_assert_uint_eq(reader.num_entries(), num_batches * 2);
+
+  // seek lands on the first batch at or after the requested time
+  dp::Batch batch;
+  reader.seek(500 * frame_duration);
+  ck_assert(reader.next(&batch));
+  ck_assert_uint_eq(batch.frames(0).frame_num(), 500);
+  // including a batch written right after a sync marker (every 16th)
+  reader.seek(511 * frame_duration);
+  ck_assert(reader.next(&batch));
+  ck_assert_uint_eq(batch.frames(0).frame_num(), 511);
+
+  // sync markers are invisible to the reader
+  reader.seek_offset(0);
+  int count = 0;
+  while (reader.next(&batch)) {
+    ck_assert_int_eq(batch.frames_size(), 2);
+    count++;
+  }
+  ck_assert_int_eq(count, num_batches);
+
+  // past the end
+  reader.seek(num_batches * frame_duration);
+  ck_assert(!reader.next(&batch));
+
+  // parallel zero-copy scan sees every frame exactly once
+  CountingVisitor visitors[4];
+  std::vector<ds::recording::FrameVisitor*> pointers;
+  for (auto& visitor : visitors) {
+    pointers.push_back(&visitor);
+  }
+  ds::recording::ScanOptions options;
+  ck_assert(ds::recording::scan_parallel(reader, options, pointers));
+  int frames = 0;
+  for (auto& visitor : visitors) {
+    frames += visitor.frames;
+    visitor.frames = 0;
+  }
+  ck_assert_int_eq(frames, num_batches * 2);
+
+  // filtered by source and time
+  options.sources.push_back(1);
+  options.begin = 500 * frame_duration;
+  ck_assert(ds::recording::scan_parallel(reader, options, pointers));
+  frames = 0;
+  for (auto& visitor : visitors) {
+    frames += visitor.frames;
+    if (visitor.frames) {
+      ck_assert_uint_eq(visitor.last_source, 1);
+    }
+  }
+  ck_assert_int_eq(frames, num_batches / 2);
+  reader.close();
+
+  g_unlink(data_path);
+  g_unlink(index_path);
+  g_rmdir(tmpdir);
+  g_free(index_path);
+  g_free(data_path);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+
+/* columnar recording tests */
+
+GST_START_TEST(test_columnar_recording) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "rec", nullptr);
+  gchar* data_path = g_strconcat(basepath, ".col", nullptr);
+
+  const int num_batches = 1000;
+  const int row_group_size = 64;
+  const guint64 frame_duration = GST_SECOND / 30;
+  {
+    ds::AsyncFileWriter::Options options;
+    options.backend = ds::AsyncFileWriter::BACKEND_POSIX;
+    ds::AsyncFileMetaBroker broker(basepath,
+                                   ds::AsyncFileMetaBroker::columnar,
+                                   options, 0, row_group_size);
+    ck_assert(broker.start());
+    for (int i = 0; i < num_batches; i++) {
+      dp::Batch batch;
+      for (guint source = 0; source < 2; source++) {
+        auto* frame = batch.add_frames();
+        frame->set_frame_num(i);
+        frame->set_source_id(source);
+        frame->set_pts(i * frame_duration);
+        for (int p = 0; p < 3; p++) {
+          auto* person = frame->add_people();
+          person->set_uid(p);
+          person->set_is_danger((i + p) % 4 == 0);
+          person->mutable_bbox()->set_left((float)(i + p));
+        }
+      }
+      broker.on_batch_payload(nullptr, &batch);
+    }
+    // the last, partial row group is written on stop
+    broker.stop();
+  }
+
+  // read it back with and without the footer
+  for (int pass = 0; pass < 2; pass++) {
+    ds::columnar::ColumnarReader reader;
+    ck_assert(reader.open(data_path));
+    ck_assert(reader.has_footer() == (pass == 0));
+    ck_assert_uint_eq(reader.num_row_groups(),
+                      (num_batches + row_group_size - 1) / row_group_size);
+    ck_assert_uint_eq(reader.num_rows(), num_batches * 2 * 3);
+
+    guint64 rows = 0;
+    guint violations[2] = {0, 0};
+    for (size_t g = 0; g < reader.num_row_groups(); g++) {
+      std::vector<uint64_t> pts, frame_num;
+      std::vector<uint32_t> source_id;
+      std::vector<uint8_t> is_danger;
+      std::vector<float> left;
+      ck_assert(reader.read_column(g, ds::columnar::COLUMN_PTS, &pts));
+      ck_assert(
+          reader.read_column(g, ds::columnar::COLUMN_FRAME_NUM, &frame_num));
+      ck_assert(
+          reader.read_column(g, ds::columnar::COLUMN_SOURCE_ID, &source_id));
+      ck_assert(
+          reader.read_column(g, ds::columnar::COLUMN_IS_DANGER, &is_danger));
+      ck_assert(reader.read_column(g, ds::columnar::COLUMN_LEFT, &left));
+      // wrong value type
+      ck_assert(!reader.read_column(g, ds::columnar::COLUMN_PTS, &left));
+      ck_assert_uint_eq(pts.front(), reader.row_group(g).min_pts);
+      ck_assert_uint_eq(pts.back(), reader.row_group(g).max_pts);
+      for (size_t i = 0; i < pts.size(); i++) {
+        ck_assert_uint_eq(pts[i], frame_num[i] * frame_duration);
+        ck_assert(left[i] >= (float)frame_num[i]);
+        violations[source_id[i]] += is_danger[i];
+      }
+      rows += pts.size();
+    }
+    ck_assert_uint_eq(rows, num_batches * 2 * 3);
+    ck_assert_uint_eq(violations[0], num_batches * 3 / 4);
+    ck_assert_uint_eq(violations[1], num_batches * 3 / 4);
+
+    if (pass == 0) {
+      // as if the writer died before closing the file
+      GStatBuf st;
+      ck_assert_int_eq(g_stat(data_path, &st), 0);
+      ck_assert_int_eq(
+          truncate(data_path,
+                   st.st_size - sizeof(ds::columnar::FooterTail) -
+                       reader.num_row_groups() *
+                           sizeof(ds::columnar::FooterEntry)),
+          0);
+    }
+  }
+
+  g_unlink(data_path);
+  g_rmdir(tmpdir);
+  g_free(data_path);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+/* aggregate tests */
+
+GST_START_TEST(test_aggregate_recording) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "rec", nullptr);
+  gchar* data_path = g_strconcat(basepath, ".agg.csv", nullptr);
+
+  // 10 s of 25 fps from 2 sources, in 1 s windows
+  const int num_batches = 250;
+  {
+    ds::AsyncFileWriter::Options options;
+    options.backend = ds::AsyncFileWriter::BACKEND_POSIX;
+    ds::AsyncFileMetaBroker broker(basepath,
+                                   ds::AsyncFileMetaBroker::aggregate,
+                                   options, 0, 0, GST_SECOND, 1.0f);
+    ck_assert(broker.start());
+    for (int i = 0; i < num_batches; i++) {
+      dp::Batch batch;
+      for (guint source = 0; source < 2; source++) {
+        auto* frame = batch.add_frames();
+        frame->set_source_id(source);
+        frame->set_pts(i * (GST_SECOND / 25));
+        for (int p = 0; p < 20; p++) {
+          frame->add_people()->mutable_bbox()->set_height(100.0f);
+        }
+      }
+      broker.on_batch_payload(nullptr, &batch);
+    }
+    // the last windows are written on stop
+    broker.stop();
+  }
+
+  gchar* contents = nullptr;
+  gsize len = 0;
+  ck_assert(g_file_get_contents(data_path, &contents, &len, nullptr));
+  ck_assert(g_str_has_prefix(contents,
+                             ds::WindowAggregator::CSV_HEADER));
+  int lines = 0;
+  for (gsize i = 0; i < len; i++) {
+    lines += contents[i] == '\n';
+  }
+  // a row per source per window instead of one per person
+  ck_assert_int_eq(lines, 1 + 10 * 2);
+  g_free(contents);
+
+  g_unlink(data_path);
+  g_rmdir(tmpdir);
+  g_free(data_path);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+/* fan out tests */
+
+GST_START_TEST(test_outputs_property) {
+  GstElement* filter;
+  filter = gst_element_factory_make(ELEMENT_NAME, nullptr);
+
+  gchar* outputs = nullptr;
+  g_object_get(filter, "outputs", &outputs, nullptr);
+  ck_assert(outputs == nullptr);
+
+  g_object_set(filter, "outputs", "property,proto,csv", nullptr);
+  g_object_get(filter, "outputs", &outputs, nullptr);
+  ck_assert_str_eq(outputs, "property,proto,csv");
+  g_free(outputs);
+
+  // unknown and repeated outputs fail to start
+  const char* bad[] = {"proto,bogus", "csv, csv", ","};
+  for (const char* value : bad) {
+    g_object_set(filter, "outputs", value, "basepath", "/nonexistent/rec",
+                 nullptr);
+    ck_assert_int_eq(gst_element_set_state(filter, GST_STATE_PAUSED),
+                     GST_STATE_CHANGE_FAILURE);
+    gst_element_set_state(filter, GST_STATE_NULL);
+  }
+
+  gst_object_unref(filter);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_fan_out_recording) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "rec", nullptr);
+  gchar* pb_path = g_strconcat(basepath, ".pb", nullptr);
+  gchar* csv_path = g_strconcat(basepath, ".csv", nullptr);
+
+  const int num_batches = 500;
+  {
+    ds::AsyncFileWriter::Options options;
+    options.backend = ds::AsyncFileWriter::BACKEND_POSIX;
+    auto proto = new ds::AsyncFileMetaBroker(
+        basepath, ds::AsyncFileMetaBroker::proto, options);
+    auto csv = new ds::AsyncFileMetaBroker(
+        basepath, ds::AsyncFileMetaBroker::csv, options);
+    ds::FanOutPayloadBroker broker;
+    broker.add(proto);
+    broker.add(csv);
+    ck_assert_uint_eq(broker.size(), 2);
+    ck_assert(proto->start());
+    ck_assert(csv->start());
+    for (int i = 0; i < num_batches; i++) {
+      dp::Batch batch;
+      auto* frame = batch.add_frames();
+      frame->set_frame_num(i);
+      frame->set_pts(i);
+      for (int p = 0; p < 2; p++) {
+        frame->add_people()->set_uid(p);
+      }
+      ck_assert(broker.on_batch_payload(nullptr, &batch));
+    }
+    proto->stop();
+    csv->stop();
+    ck_assert_uint_eq(proto->writer().dropped(), 0);
+    ck_assert_uint_eq(csv->writer().dropped(), 0);
+  }
+
+  // both outputs got every batch
+  ds::recording::RecordingReader reader;
+  ck_assert(reader.open(pb_path));
+  dp::Batch batch;
+  int batches = 0;
+  while (reader.next(&batch)) {
+    ck_assert_int_eq(batch.frames(0).frame_num(), batches);
+    batches++;
+  }
+  ck_assert_int_eq(batches, num_batches);
+  reader.close();
+
+  gchar* contents = nullptr;
+  gsize len = 0;
+  ck_assert(g_file_get_contents(csv_path, &contents, &len, nullptr));
+  int lines = 0;
+  for (gsize i = 0; i < len; i++) {
+    lines += contents[i] == '\n';
+  }
+  // header plus a row per person
+  ck_assert_int_eq(lines, 1 + num_batches * 2);
+  g_free(contents);
+
+  g_unlink(pb_path);
+  g_unlink(csv_path);
+  g_rmdir(tmpdir);
+  g_free(csv_path);
+  g_free(pb_path);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
 /* harness tests */
 /* https://gstreamer.freedesktop.org/documentation/check/gstharness.html */
 static inline void _test_harness_passthrough(const char* caps_str) {
@@ -203,6 +820,104 @@ GST_START_TEST(test_harness_rgba_passthrough) {
 GST_END_TEST;
 
 
+GST_START_TEST(test_harness_results_polling) {
+  ds::FakeScene scene(2, 4, ds::FakeScene::MOTION_LINEAR, 0.0, 1280, 720);
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  g_assert_nonnull(h);
+  g_object_set(h->element, "mode", PAYLOAD_BROKER_MODE_PROPERTY, NULL);
+  gst_harness_set_src_caps_str(h, ELEMENT_CAPS_TEST_RGBA_STR);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_RGBA_STR);
+
+  // pollers read "results" while the streaming thread publishes them, and
+  // only ever see whole batches
+  std::atomic<bool> done(false);
+  std::atomic<int> seen(0);
+  std::atomic<int> bad(0);
+  std::vector<std::thread> pollers;
+  for (int i = 0; i < 4; i++) {
+    pollers.emplace_back([h, &done, &seen, &bad] {
+      while (!done) {
+        gchar* results = nullptr;
+        g_object_get(h->element, "results", &results, NULL);
+        if (results != nullptr) {
+          dp::Batch batch;
+          if (google::protobuf::util::JsonStringToMessage(results, &batch)
+                  .ok() &&
+              batch.frames_size() == 2) {
+            seen++;
+          } else {
+            bad++;
+          }
+        }
+        g_free(results);
+      }
+    });
+  }
+  for (int i = 0; i < 1000; i++) {
+    GstBuffer* buf = gst_harness_create_buffer(h, 42);
+    ds::add_fake_batch_meta(buf, scene, i, 0);
+    fail_unless_equals_int(gst_harness_push(h, buf), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+  }
+  // the last batch stays up, so the pollers get to it sooner or later
+  for (int i = 0; i < 1000 && seen == 0; i++) {
+    g_usleep(1000);
+  }
+  done = true;
+  for (auto& poller : pollers) {
+    poller.join();
+  }
+  fail_unless_equals_int(bad, 0);
+  ck_assert_int_gt(seen, 0);
+
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+
+GST_START_TEST(test_harness_source_churn) {
+  gchar* tmpdir = g_dir_make_tmp("dspayloadbroker-XXXXXX", nullptr);
+  ck_assert(tmpdir != nullptr);
+  gchar* basepath = g_build_filename(tmpdir, "rec", nullptr);
+  gchar* data_path = g_strconcat(basepath, ".agg.csv", nullptr);
+  gchar* launch = g_strdup_printf(
+      "dspayloadbroker outputs=\"property,aggregate\" basepath=%s "
+      "sampling=rate window=1000 source-timeout=2000", basepath);
+
+  GstHarness* h = gst_harness_new_parse(launch);
+  g_assert_nonnull(h);
+  // 4 sources at a time, each replaced (after a stream eos) every second,
+  // with tracker ids churning too
+  gst_harness_add_src_parse(
+      h, "dsfakemetasrc batch-size=4 objects-per-frame=8 id-churn=0.2 "
+         "source-churn=30", TRUE);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+  // 200 s of 30 fps, with 800 sources in all
+  guint64 warm = 0;
+  guint64 bytes = 0;
+  for (guint i = 0; i < 6000; i++) {
+    gst_harness_push_from_src(h);
+    gst_buffer_unref(gst_harness_pull(h));
+    if (i == 1800) {
+      g_object_get(h->element, "source-bytes", &warm, NULL);
+    }
+  }
+  g_object_get(h->element, "source-bytes", &bytes, NULL);
+  ck_assert_uint_gt(warm, 0);
+  fail_unless_equals_uint64(bytes, warm);
+
+  gst_harness_teardown(h);
+  g_unlink(data_path);
+  g_rmdir(tmpdir);
+  g_free(launch);
+  g_free(data_path);
+  g_free(basepath);
+  g_free(tmpdir);
+}
+GST_END_TEST;
+
+
 static inline void _test_with_src(const gchar* src_str) {
   GstHarness* h;
 
@@ -240,14 +955,27 @@ static Suite* payloadbroker_suite(void) {
   tcase_add_test(bc, test_type);
   tcase_add_test(bc, test_name_property);
   tcase_add_test(bc, test_silent_property);
+  tcase_add_test(bc, test_file_properties);
+  tcase_add_test(bc, test_async_writer_rotation);
+  tcase_add_test(bc, test_async_writer_drops_when_full);
+  tcase_add_test(bc, test_async_writer_no_overwrite);
+  tcase_add_test(bc, test_async_writer_fsync_interval);
+  tcase_add_test(bc, test_indexed_recording_seek);
+  tcase_add_test(bc, test_columnar_recording);
+  tcase_add_test(bc, test_aggregate_recording);
+  tcase_add_test(bc, test_outputs_property);
+  tcase_add_test(bc, test_fan_out_recording);
 
   suite_add_tcase(s, cc);
   tcase_add_test(cc, test_pads_nv12);
   tcase_add_test(cc, test_pads_rgba);
+  tcase_add_test(cc, test_pads_sysmem);
 
   suite_add_tcase(s, hc);
   tcase_add_test(hc, test_harness_nv12_passthrough);
   tcase_add_test(hc, test_harness_rgba_passthrough);
+  tcase_add_test(hc, test_harness_results_polling);
+  tcase_add_test(hc, test_harness_source_churn);
 
   suite_add_tcase(s, ic);
   tcase_add_test(ic, test_simple_pipeline);
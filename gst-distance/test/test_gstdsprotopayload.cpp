@@ -19,6 +19,7 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include "FakeBatchMeta.hpp"
 #include "gstdsprotopayload.h"
 
 #include <gst/check/check.h>
@@ -33,6 +34,9 @@ static const char* ELEMENT_CAPS_TEST_NV12_STR =
 static const char* ELEMENT_CAPS_TEST_RGBA_STR =
     "video/x-raw(memory:NVMM), format=(string)RGBA, width=1280, height=720, "
     "framerate=(fraction)1/30";
+static const char* ELEMENT_CAPS_TEST_SYSMEM_STR =
+    "video/x-raw, format=(string)RGBA, width=1280, height=720, "
+    "framerate=(fraction)1/30";
 
 // pad templates
 static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
@@ -40,14 +44,16 @@ static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE(
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE(
     "src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
     GST_STATIC_CAPS(
-        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }")));
+        GST_VIDEO_CAPS_MAKE_WITH_FEATURES("memory:NVMM", "{ NV12, RGBA }") "; "
+            GST_VIDEO_CAPS_MAKE("{ NV12, RGBA }")));
 
 /* basic tests */
 
@@ -131,6 +137,12 @@ GST_START_TEST(test_pads_rgba) {
 GST_END_TEST;
 
 
+GST_START_TEST(test_pads_sysmem) {
+  _test_pads(ELEMENT_CAPS_TEST_SYSMEM_STR);
+}
+GST_END_TEST;
+
+
 GST_START_TEST(test_silent_property) {
   GstElement* filter;
   filter = gst_element_factory_make(ELEMENT_NAME, nullptr);
@@ -204,6 +216,82 @@ GST_START_TEST(test_harness_rgba_passthrough) {
 GST_END_TEST;
 
 
+/* PLAYING -> READY -> PLAYING, as on every camera reconnect, with a batch
+ * serialized after each restart
+ */
+GST_START_TEST(test_harness_state_cycling) {
+  const guint num_cycles = 1000;
+  ds::FakeScene scene(2, 4, ds::FakeScene::MOTION_STATIC, 0.0, 1280, 720);
+
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  g_assert_nonnull(h);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  // GST_DEBUG=4 logs every state change, thousands of lines per cycle
+  GstDebugLevel threshold = gst_debug_get_default_threshold();
+  gst_debug_set_default_threshold(GST_LEVEL_WARNING);
+
+  for (guint i = 0; i < num_cycles; i++) {
+    fail_unless_equals_int(gst_element_set_state(h->element, GST_STATE_READY),
+                           GST_STATE_CHANGE_SUCCESS);
+    fail_unless_equals_int(
+        gst_element_set_state(h->element, GST_STATE_PLAYING),
+        GST_STATE_CHANGE_SUCCESS);
+    // the sink pad dropped its sticky events on the way down
+    gst_harness_push_event(h, gst_event_new_stream_start("cycling"));
+    gst_harness_set_src_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+
+    GstBuffer* buf = gst_harness_create_buffer(h, 42);
+    ds::add_fake_batch_meta(buf, scene, i, 0);
+    fail_unless_equals_int(gst_harness_push(h, buf), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+  }
+  gst_debug_set_default_threshold(threshold);
+
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
+
+/* one batch much slower than the budget mustn't skip every later one
+ */
+GST_START_TEST(test_harness_budget_recovers) {
+  const guint num_batches = 100;
+  ds::FakeScene scene(2, 4, ds::FakeScene::MOTION_STATIC, 0.0, 1280, 720);
+  GstStructure* stats = nullptr;
+  guint64 buffers = 0;
+  guint64 skipped = 0;
+
+  GstHarness* h = gst_harness_new(ELEMENT_NAME);
+  g_assert_nonnull(h);
+  gst_harness_set_src_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  gst_harness_set_sink_caps_str(h, ELEMENT_CAPS_TEST_SYSMEM_STR);
+  // 100 ms, far more than a batch of 8 people takes to serialize
+  g_object_set(h->element, "budget", 100000, nullptr);
+  // as if the last batch took 10 s
+  GST_DSPROTOPAYLOAD(h->element)->cost = 10 * GST_SECOND;
+
+  for (guint i = 0; i < num_batches; i++) {
+    GstBuffer* buf = gst_harness_create_buffer(h, 42);
+    ds::add_fake_batch_meta(buf, scene, i, 0);
+    fail_unless_equals_int(gst_harness_push(h, buf), GST_FLOW_OK);
+    gst_buffer_unref(gst_harness_pull(h));
+  }
+
+  // some batches are skipped after the spike, then serializing resumes
+  g_object_get(h->element, "stats", &stats, "skipped-frames", &skipped,
+               nullptr);
+  g_assert_nonnull(stats);
+  g_assert_true(gst_structure_get_uint64(stats, "buffers", &buffers));
+  fail_unless(skipped > 0);
+  fail_unless(buffers > num_batches / 2);
+  fail_unless_equals_uint64(buffers + skipped / scene.sources(),
+                            num_batches);
+
+  gst_structure_free(stats);
+  gst_harness_teardown(h);
+}
+GST_END_TEST;
+
 static inline void _test_with_src(const gchar* src_str) {
   GstHarness* h;
 
@@ -245,10 +333,15 @@ static Suite* dsprotopayload_suite(void) {
   suite_add_tcase(s, cc);
   tcase_add_test(cc, test_pads_nv12);
   tcase_add_test(cc, test_pads_rgba);
+  tcase_add_test(cc, test_pads_sysmem);
 
+  // a thousand restarts take a while on a Jetson
+  tcase_set_timeout(hc, 120);
   suite_add_tcase(s, hc);
   tcase_add_test(hc, test_harness_nv12_passthrough);
   tcase_add_test(hc, test_harness_rgba_passthrough);
+  tcase_add_test(hc, test_harness_state_cycling);
+  tcase_add_test(hc, test_harness_budget_recovers);
 
   suite_add_tcase(s, ic);
   tcase_add_test(ic, test_simple_pipeline);
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "LatencyTracker.hpp"
+
+#include <gst/check/check.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+GST_START_TEST(test_buckets) {
+  ck_assert_uint_eq(ds::LatencyHistogram::bucket(0), 0);
+  ck_assert_uint_eq(ds::LatencyHistogram::bucket(15), 15);
+  size_t last = 0;
+  for (uint64_t ns = 1; ns < (1ull << 39); ns = ns * 9 / 8 + 1) {
+    size_t bucket = ds::LatencyHistogram::bucket(ns);
+    ck_assert_uint_ge(bucket, last);
+    ck_assert_uint_lt(bucket, ds::LatencyHistogram::NUM_BUCKETS);
+    // every value is within 1/16 of the start of its bucket
+    uint64_t lower = ds::LatencyHistogram::lower_bound(bucket);
+    ck_assert_uint_le(lower, ns);
+    ck_assert_uint_le(ns - lower, lower / 16 + 1);
+    last = bucket;
+  }
+  // too large values land in the last bucket
+  ck_assert_uint_eq(ds::LatencyHistogram::bucket(UINT64_MAX),
+                    ds::LatencyHistogram::NUM_BUCKETS - 1);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_quantiles) {
+  ds::LatencyHistogram histogram;
+  std::vector<uint64_t> counts(ds::LatencyHistogram::NUM_BUCKETS);
+  ck_assert_uint_eq(ds::LatencyHistogram::quantile(counts, 0.5), 0);
+
+  for (uint64_t ns = 1; ns <= 100000; ns++) {
+    histogram.record(ns * 10);
+  }
+  histogram.add_to(&counts);
+  double p50 = ds::LatencyHistogram::quantile(counts, 0.5);
+  double p99 = ds::LatencyHistogram::quantile(counts, 0.99);
+  double max = ds::LatencyHistogram::quantile(counts, 1.0);
+  ck_assert(p50 >= 500000 && p50 <= 500000 * 1.07);
+  ck_assert(p99 >= 990000 && p99 <= 990000 * 1.07);
+  ck_assert(max >= 1000000 && max <= 1000000 * 1.07);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_object_buckets) {
+  ck_assert_uint_eq(ds::LatencyTracker::object_bucket(0), 0);
+  ck_assert_uint_eq(ds::LatencyTracker::object_bucket(1), 1);
+  ck_assert_uint_eq(ds::LatencyTracker::object_bucket(10), 1);
+  ck_assert_uint_eq(ds::LatencyTracker::object_bucket(11), 2);
+  ck_assert_uint_eq(ds::LatencyTracker::object_bucket(500), 5);
+  ck_assert_uint_eq(ds::LatencyTracker::object_bucket(501), 6);
+  ck_assert_str_eq(ds::LatencyTracker::object_bucket_name(6), "501+");
+}
+GST_END_TEST;
+
+GST_START_TEST(test_threads) {
+  ds::LatencyTracker tracker;
+  ck_assert_str_eq(tracker.dump().c_str(), "");
+
+  int a = 0;
+  int b = 0;
+  std::atomic<bool> done(false);
+  // dumps while threads record
+  std::thread dumper([&tracker, &done] {
+    while (!done) {
+      tracker.dump();
+    }
+  });
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&tracker, &a, &b] {
+      for (int i = 0; i < 10000; i++) {
+        tracker.record(&a, "dsdistance0", 20, 1000);
+        tracker.record(&b, "dspayloadbroker0", 600, 50000);
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  done = true;
+  dumper.join();
+
+  std::string dump = tracker.dump();
+  ck_assert(dump.find("dsdistance0 objects=11-50 n=40000 ") !=
+            std::string::npos);
+  ck_assert(dump.find("dspayloadbroker0 objects=501+ n=40000 ") !=
+            std::string::npos);
+  ck_assert(dump.find("p50=1.0us") != std::string::npos);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_max_elements) {
+  ds::LatencyTracker tracker;
+  std::vector<int> elements(ds::LatencyTracker::MAX_ELEMENTS + 1);
+  for (size_t i = 0; i < elements.size(); i++) {
+    tracker.record(&elements[i], ("e" + std::to_string(i)).c_str(), 1, 1);
+  }
+  std::string dump = tracker.dump();
+  ck_assert(dump.find("e0 ") != std::string::npos);
+  // the one past the limit is ignored
+  ck_assert(dump.find("e32 ") == std::string::npos);
+}
+GST_END_TEST;
+
+static Suite* latencytracker_suite(void) {
+  Suite* s = suite_create("LatencyTracker");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_buckets);
+  tcase_add_test(bc, test_quantiles);
+  tcase_add_test(bc, test_object_buckets);
+  tcase_add_test(bc, test_threads);
+  tcase_add_test(bc, test_max_elements);
+
+  return s;
+}
+
+GST_CHECK_MAIN(latencytracker);
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "LoadShedder.hpp"
+
+#include <gst/check/check.h>
+
+static const int64_t LATE = 20000000;  // 20 ms
+static const int64_t EARLY = -5000000;
+
+/** count how many of the next `n` buffers would be processed */
+static unsigned processed(ds::LoadShedder* shedder, unsigned n) {
+  unsigned count = 0;
+  for (unsigned i = 0; i < n; i++) {
+    count += shedder->should_process() ? 1 : 0;
+  }
+  return count;
+}
+
+GST_START_TEST(test_on_time) {
+  ds::LoadShedder shedder;
+  for (int i = 0; i < 100; i++) {
+    ck_assert(!shedder.on_qos(0.9, EARLY));
+  }
+  ck_assert_uint_eq(shedder.level(), 0);
+  ck_assert_uint_eq(processed(&shedder, 64), 64);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_escalate) {
+  ds::LoadShedder shedder;
+  // a single late report changes nothing
+  ck_assert(!shedder.on_qos(1.5, LATE));
+  ck_assert_uint_eq(shedder.level(), 0);
+
+  unsigned changes = 0;
+  for (int i = 0; i < 100; i++) {
+    changes += shedder.on_qos(1.5, LATE) ? 1 : 0;
+  }
+  // and it stops at the top level
+  ck_assert_uint_eq(changes, ds::LoadShedder::MAX_LEVEL);
+  ck_assert_uint_eq(shedder.level(), ds::LoadShedder::MAX_LEVEL);
+  ck_assert_uint_eq(shedder.interval(), 8);
+  ck_assert_uint_eq(processed(&shedder, 64), 8);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_recover) {
+  ds::LoadShedder shedder;
+  for (unsigned i = 0; i < ds::LoadShedder::ESCALATE_AFTER * 2; i++) {
+    shedder.on_qos(1.5, LATE);
+  }
+  ck_assert_uint_eq(shedder.level(), 2);
+
+  // only just keeping up is not enough to recover
+  for (int i = 0; i < 100; i++) {
+    shedder.on_qos(1.05, EARLY);
+  }
+  ck_assert_uint_eq(shedder.level(), 2);
+
+  // a late report restarts the count
+  for (unsigned i = 0; i < ds::LoadShedder::RECOVER_AFTER - 1; i++) {
+    ck_assert(!shedder.on_qos(0.5, EARLY));
+  }
+  shedder.on_qos(1.5, LATE);
+  for (unsigned i = 0; i < ds::LoadShedder::RECOVER_AFTER - 1; i++) {
+    ck_assert(!shedder.on_qos(0.5, EARLY));
+  }
+  ck_assert(shedder.on_qos(0.5, EARLY));
+  ck_assert_uint_eq(shedder.level(), 1);
+  ck_assert_uint_eq(processed(&shedder, 64), 32);
+
+  shedder.reset();
+  ck_assert_uint_eq(shedder.level(), 0);
+}
+GST_END_TEST;
+
+static Suite* loadshedder_suite(void) {
+  Suite* s = suite_create("LoadShedder");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_on_time);
+  tcase_add_test(bc, test_escalate);
+  tcase_add_test(bc, test_recover);
+
+  return s;
+}
+
+GST_CHECK_MAIN(loadshedder);
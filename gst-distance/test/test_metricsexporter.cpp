@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "MetricsExporter.hpp"
+#include "MetricsRegistry.hpp"
+
+#include <gst/check/check.h>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+static void add_element(ds::MetricsRegistry* registry,
+                        const void* key,
+                        const char* name,
+                        ds::ElementStats* stats) {
+  registry->add(key, [name, stats](ds::MetricsSample* sample) {
+    sample->element = name;
+    sample->kind = "dsdistance";
+    sample->stats = stats->snapshot();
+  });
+}
+
+static bool contains(const std::string& text, const std::string& line) {
+  return text.find(line + "\n") != std::string::npos;
+}
+
+GST_START_TEST(test_format) {
+  ds::MetricsRegistry registry;
+  ds::ElementStats stats;
+  stats.add(10, 45, 20000);
+  stats.add(20, 190, 2000000000);
+  add_element(&registry, &stats, "dsdistance0", &stats);
+
+  std::string text = registry.scrape();
+  ck_assert(contains(text, "# TYPE gstdistance_buffers_total counter"));
+  ck_assert(contains(
+      text,
+      "gstdistance_buffers_total{element=\"dsdistance0\",kind=\"dsdistance\"} 2"));
+  ck_assert(contains(
+      text,
+      "gstdistance_objects_total{element=\"dsdistance0\",kind=\"dsdistance\"} 30"));
+  ck_assert(contains(text,
+                     "# TYPE gstdistance_buffer_duration_seconds histogram"));
+  // buckets are cumulative
+  ck_assert(contains(text,
+                     "gstdistance_buffer_duration_seconds_bucket{element=\""
+                     "dsdistance0\",kind=\"dsdistance\",le=\"0.00001\"} 0"));
+  ck_assert(contains(text,
+                     "gstdistance_buffer_duration_seconds_bucket{element=\""
+                     "dsdistance0\",kind=\"dsdistance\",le=\"0.000025\"} 1"));
+  ck_assert(contains(text,
+                     "gstdistance_buffer_duration_seconds_bucket{element=\""
+                     "dsdistance0\",kind=\"dsdistance\",le=\"+Inf\"} 2"));
+  ck_assert(contains(text,
+                     "gstdistance_buffer_duration_seconds_sum{element=\""
+                     "dsdistance0\",kind=\"dsdistance\"} 2.00002"));
+  // no queue, no queue metrics
+  ck_assert(text.find("gstdistance_queue_depth{") == std::string::npos);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_queue_and_escaping) {
+  ds::MetricsRegistry registry;
+  registry.add(&registry, [](ds::MetricsSample* sample) {
+    sample->element = "a\"b\\c";
+    sample->kind = "dspayloadbroker";
+    sample->has_queue = true;
+    sample->queue_depth = 3;
+    sample->dropped = 7;
+  });
+
+  std::string text = registry.scrape();
+  ck_assert(contains(text,
+                     "gstdistance_queue_depth{element=\"a\\\"b\\\\c\","
+                     "kind=\"dspayloadbroker\"} 3"));
+  ck_assert(contains(text,
+                     "gstdistance_dropped_total{element=\"a\\\"b\\\\c\","
+                     "kind=\"dspayloadbroker\"} 7"));
+}
+GST_END_TEST;
+
+GST_START_TEST(test_remove) {
+  ds::MetricsRegistry registry;
+  ds::ElementStats stats;
+  add_element(&registry, &stats, "first", &stats);
+  add_element(&registry, &registry, "second", &stats);
+  ck_assert_uint_eq(registry.collect().size(), 2);
+
+  registry.remove(&stats);
+  std::vector<ds::MetricsSample> samples = registry.collect();
+  ck_assert_uint_eq(samples.size(), 1);
+  ck_assert_str_eq(samples[0].element.c_str(), "second");
+}
+GST_END_TEST;
+
+/** connect to `path` and read until the exporter closes the connection */
+static std::string scrape_socket(const std::string& path) {
+  std::string text;
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+  if (connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) {
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+      text.append(buf, (size_t)n);
+    }
+  }
+  close(fd);
+  return text;
+}
+
+GST_START_TEST(test_socket) {
+  ds::MetricsRegistry registry;
+  ds::ElementStats stats;
+  add_element(&registry, &stats, "dsdistance0", &stats);
+
+  ds::MetricsExporter::Options options;
+  options.mode = ds::MetricsExporter::MODE_SOCKET;
+  options.path = "/tmp/test_metricsexporter-" + std::to_string(getpid()) +
+                 ".sock";
+  ds::MetricsExporter exporter(&registry, options);
+  ck_assert(exporter.start());
+
+  // every connection gets the current counts
+  std::string text = scrape_socket(options.path);
+  ck_assert(contains(
+      text,
+      "gstdistance_buffers_total{element=\"dsdistance0\",kind=\"dsdistance\"} 0"));
+  stats.add(5, 10, 1000);
+  text = scrape_socket(options.path);
+  ck_assert(contains(
+      text,
+      "gstdistance_buffers_total{element=\"dsdistance0\",kind=\"dsdistance\"} 1"));
+
+  exporter.stop();
+  ck_assert_int_ne(access(options.path.c_str(), F_OK), 0);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_file) {
+  ds::MetricsRegistry registry;
+  ds::ElementStats stats;
+  add_element(&registry, &stats, "dsdistance0", &stats);
+
+  ds::MetricsExporter::Options options;
+  options.mode = ds::MetricsExporter::MODE_FILE;
+  options.path = "/tmp/test_metricsexporter-" + std::to_string(getpid()) +
+                 ".prom";
+  options.interval_ms = 10;
+  ds::MetricsExporter exporter(&registry, options);
+  ck_assert(exporter.start());
+  stats.add(5, 10, 1000);
+  exporter.stop();
+
+  // the last write happens on stop
+  std::ifstream file(options.path);
+  std::stringstream text;
+  text << file.rdbuf();
+  ck_assert(contains(
+      text.str(),
+      "gstdistance_buffers_total{element=\"dsdistance0\",kind=\"dsdistance\"} 1"));
+  unlink(options.path.c_str());
+}
+GST_END_TEST;
+
+static Suite* metricsexporter_suite(void) {
+  Suite* s = suite_create("MetricsExporter");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_format);
+  tcase_add_test(bc, test_queue_and_escaping);
+  tcase_add_test(bc, test_remove);
+  tcase_add_test(bc, test_socket);
+  tcase_add_test(bc, test_file);
+
+  return s;
+}
+
+GST_CHECK_MAIN(metricsexporter);
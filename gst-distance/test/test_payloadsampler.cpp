@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "FanOutPayloadBroker.hpp"
+#include "PayloadSampler.hpp"
+
+#include <distance.pb.h>
+
+#include <gst/check/check.h>
+
+static const guint64 FRAME_DURATION = GST_SECOND / 30;
+
+/* a batch with a frame from each of `num_sources` sources */
+static void make_batch(dp::Batch* batch,
+                       int frame_num,
+                       guint num_sources,
+                       bool is_danger) {
+  batch->Clear();
+  for (guint source = 0; source < num_sources; source++) {
+    dp::Frame* frame = batch->add_frames();
+    frame->set_source_id(source);
+    frame->set_frame_num(frame_num);
+    frame->set_pts(frame_num * FRAME_DURATION);
+    frame->add_people()->set_is_danger(is_danger);
+  }
+}
+
+GST_START_TEST(test_none) {
+  ds::PayloadSampler sampler;
+  dp::Batch batch;
+  for (int i = 0; i < 100; i++) {
+    make_batch(&batch, i, 2, false);
+    ck_assert(sampler.sample(&batch));
+    ck_assert_int_eq(batch.frames_size(), 2);
+  }
+  ck_assert_uint_eq(sampler.emitted(), 100);
+  ck_assert_uint_eq(sampler.skipped(), 0);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_rate) {
+  ds::PayloadSampler sampler(ds::PayloadSampler::POLICY_RATE, 10.0);
+  dp::Batch batch;
+  int frames[3] = {0, 0, 0};
+  // 10 s at 30 fps from 3 sources
+  for (int i = 0; i < 300; i++) {
+    make_batch(&batch, i, 3, true);
+    if (sampler.sample(&batch)) {
+      // frames keep their order
+      for (int f = 1; f < batch.frames_size(); f++) {
+        ck_assert(batch.frames(f - 1).source_id() <
+                  batch.frames(f).source_id());
+      }
+    } else {
+      ck_assert_int_eq(batch.frames_size(), 0);
+    }
+    for (const auto& frame : batch.frames()) {
+      frames[frame.source_id()]++;
+    }
+  }
+  for (int count : frames) {
+    ck_assert_int_eq(count, 100);
+  }
+  ck_assert_uint_eq(sampler.emitted(), 100);
+  ck_assert_uint_eq(sampler.skipped(), 200);
+
+  // a pts that goes backwards starts sampling again
+  make_batch(&batch, 0, 3, false);
+  ck_assert(sampler.sample(&batch));
+  ck_assert_int_eq(batch.frames_size(), 3);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_rate_per_source) {
+  ds::PayloadSampler sampler(ds::PayloadSampler::POLICY_RATE, 1.0);
+  dp::Batch batch;
+  make_batch(&batch, 0, 1, false);
+  ck_assert(sampler.sample(&batch));
+  // source 0 is rate limited, a new source 1 is not
+  make_batch(&batch, 1, 2, false);
+  ck_assert(sampler.sample(&batch));
+  ck_assert_int_eq(batch.frames_size(), 1);
+  ck_assert_uint_eq(batch.frames(0).source_id(), 1);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_adaptive) {
+  ds::PayloadSampler sampler(ds::PayloadSampler::POLICY_ADAPTIVE, 1.0);
+  dp::Batch batch;
+  int emitted = 0;
+  // 10 s at 30 fps, with violations during the 3rd second
+  for (int i = 0; i < 300; i++) {
+    bool is_danger = i >= 60 && i < 90;
+    make_batch(&batch, i, 1, is_danger);
+    if (sampler.sample(&batch)) {
+      emitted++;
+    } else {
+      ck_assert(!is_danger);
+    }
+  }
+  // every violation plus about one quiet frame per second
+  ck_assert_int_ge(emitted, 30 + 8);
+  ck_assert_int_le(emitted, 30 + 10);
+  ck_assert_uint_eq(sampler.emitted(), emitted);
+  ck_assert_uint_eq(sampler.skipped(), 300 - emitted);
+}
+GST_END_TEST;
+
+class CountingBroker : public ds::PayloadBroker {
+ public:
+  explicit CountingBroker(int* frames) : frames_(frames) {}
+  virtual bool on_batch_payload(NvDsBatchMeta* batch_meta,
+                                dp::Batch* batch) override {
+    (void)batch_meta;
+    *frames_ += batch->frames_size();
+    return true;
+  }
+
+ private:
+  int* frames_;
+};
+
+GST_START_TEST(test_fan_out) {
+  int sampled = 0;
+  int unsampled = 0;
+  ds::FanOutPayloadBroker broker(ds::PayloadSampler::POLICY_RATE, 1.0);
+  broker.add(new CountingBroker(&sampled));
+  broker.add(new CountingBroker(&unsampled), false);
+  ck_assert_uint_eq(broker.size(), 2);
+  dp::Batch batch;
+  for (int i = 0; i < 300; i++) {
+    make_batch(&batch, i, 2, false);
+    ck_assert(broker.on_batch_payload(nullptr, &batch));
+  }
+  ck_assert_int_eq(sampled, 10 * 2);
+  ck_assert_int_eq(unsampled, 300 * 2);
+  ck_assert_uint_eq(broker.sampler().emitted(), 10);
+  ck_assert_uint_eq(broker.sampler().skipped(), 290);
+}
+GST_END_TEST;
+
+static Suite* payloadsampler_suite(void) {
+  Suite* s = suite_create("PayloadSampler");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_none);
+  tcase_add_test(bc, test_rate);
+  tcase_add_test(bc, test_rate_per_source);
+  tcase_add_test(bc, test_adaptive);
+  tcase_add_test(bc, test_fan_out);
+
+  return s;
+}
+
+GST_CHECK_MAIN(payloadsampler);
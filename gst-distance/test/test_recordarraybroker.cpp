@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "RecordArrayBroker.hpp"
+
+#include <distance.pb.h>
+
+#include <gst/check/check.h>
+
+#include <cstddef>
+
+static void make_batch(dp::Batch* batch, guint64 frame_num) {
+  batch->Clear();
+  for (guint source = 0; source < 2; source++) {
+    dp::Frame* frame = batch->add_frames();
+    frame->set_source_id(source);
+    frame->set_frame_num(frame_num);
+    frame->set_pts(frame_num * 1000 + source);
+    for (guint p = 0; p < 3; p++) {
+      dp::Person* person = frame->add_people();
+      person->set_uid(source * 10 + p);
+      person->set_is_danger(p == 1);
+      person->set_danger_val(0.5f * p);
+      person->mutable_bbox()->set_left(1.0f + p);
+      person->mutable_bbox()->set_top(2.0f + p);
+      person->mutable_bbox()->set_width(3.0f + p);
+      person->mutable_bbox()->set_height(4.0f + p);
+    }
+  }
+}
+
+GST_START_TEST(test_layout) {
+  // the documented numpy dtype depends on these
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, pts), 0);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, frame_num), 8);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, uid), 16);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, source_id), 24);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, danger_val), 28);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, left), 32);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, top), 36);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, width), 40);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, height), 44);
+  ck_assert_uint_eq(offsetof(ds::PersonRecord, is_danger), 48);
+  ck_assert_uint_eq(sizeof(ds::PersonRecord), 56);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_encode) {
+  dp::Batch batch;
+  make_batch(&batch, 7);
+  GBytes* bytes = ds::RecordArrayBroker::encode(batch);
+  gsize size = 0;
+  const ds::PersonRecord* records =
+      (const ds::PersonRecord*)g_bytes_get_data(bytes, &size);
+  ck_assert_uint_eq(size, 6 * sizeof(ds::PersonRecord));
+  for (guint i = 0; i < 6; i++) {
+    guint source = i / 3;
+    guint p = i % 3;
+    ck_assert_uint_eq(records[i].pts, 7000 + source);
+    ck_assert_uint_eq(records[i].frame_num, 7);
+    ck_assert_uint_eq(records[i].uid, source * 10 + p);
+    ck_assert_uint_eq(records[i].source_id, source);
+    ck_assert(records[i].danger_val == 0.5f * p);
+    ck_assert(records[i].left == 1.0f + p);
+    ck_assert(records[i].top == 2.0f + p);
+    ck_assert(records[i].width == 3.0f + p);
+    ck_assert(records[i].height == 4.0f + p);
+    ck_assert_uint_eq(records[i].is_danger, p == 1);
+    for (guint8 reserved : records[i].reserved) {
+      ck_assert_uint_eq(reserved, 0);
+    }
+  }
+  g_bytes_unref(bytes);
+
+  batch.Clear();
+  bytes = ds::RecordArrayBroker::encode(batch);
+  ck_assert_uint_eq(g_bytes_get_size(bytes), 0);
+  g_bytes_unref(bytes);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_latest) {
+  ds::RecordArrayBroker broker;
+  ck_assert(broker.get_records() == nullptr);
+
+  dp::Batch batch;
+  make_batch(&batch, 1);
+  ck_assert(broker.on_batch_payload(nullptr, &batch));
+  GBytes* first = broker.get_records();
+  ck_assert(first != nullptr);
+
+  // a newer batch does not touch an array a reader still holds
+  make_batch(&batch, 2);
+  ck_assert(broker.on_batch_payload(nullptr, &batch));
+  GBytes* second = broker.get_records();
+  ck_assert(first != second);
+  const ds::PersonRecord* records =
+      (const ds::PersonRecord*)g_bytes_get_data(first, nullptr);
+  ck_assert_uint_eq(records[0].frame_num, 1);
+  records = (const ds::PersonRecord*)g_bytes_get_data(second, nullptr);
+  ck_assert_uint_eq(records[0].frame_num, 2);
+
+  g_bytes_unref(first);
+  g_bytes_unref(second);
+}
+GST_END_TEST;
+
+static Suite* recordarraybroker_suite(void) {
+  Suite* s = suite_create("RecordArrayBroker");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_layout);
+  tcase_add_test(bc, test_encode);
+  tcase_add_test(bc, test_latest);
+
+  return s;
+}
+
+GST_CHECK_MAIN(recordarraybroker);
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "SeqlockSlot.hpp"
+
+#include <gst/check/check.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* a value that can be checked on its own: counter, size, then filler */
+static std::string make_value(guint64 counter) {
+  size_t size = 16 + (counter * 7919) % 4096;
+  std::string value(size, (char)(counter & 0xFF));
+  memcpy(&value[0], &counter, sizeof(counter));
+  guint64 size64 = size;
+  memcpy(&value[8], &size64, sizeof(size64));
+  return value;
+}
+
+static bool check_value(const std::string& value, guint64* counter) {
+  guint64 size = 0;
+  if (value.size() < 16) {
+    return false;
+  }
+  memcpy(counter, value.data(), sizeof(*counter));
+  memcpy(&size, value.data() + 8, sizeof(size));
+  if (size != value.size()) {
+    return false;
+  }
+  for (size_t i = 16; i < value.size(); i++) {
+    if (value[i] != (char)(*counter & 0xFF)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+GST_START_TEST(test_read_write) {
+  ds::SeqlockSlot slot;
+  std::string value;
+  ck_assert(!slot.read(&value));
+
+  for (guint64 i = 0; i < 100; i++) {
+    std::string written = make_value(i);
+    slot.write(written.data(), written.size());
+    ck_assert(slot.read(&value));
+    ck_assert(value == written);
+  }
+  // shrinking and empty values
+  slot.write("ab", 2);
+  ck_assert(slot.read(&value));
+  ck_assert_str_eq(value.c_str(), "ab");
+  slot.write("", 0);
+  ck_assert(slot.read(&value));
+  ck_assert_uint_eq(value.size(), 0);
+  ck_assert_uint_eq(slot.writes(), 102);
+  ck_assert_uint_eq(slot.retries(), 0);
+}
+GST_END_TEST;
+
+/* writes per second for `duration` with `num_readers` polling */
+static double stress(ds::SeqlockSlot* slot,
+                     guint64* counter,
+                     unsigned num_readers,
+                     std::chrono::milliseconds duration,
+                     std::atomic<guint64>* bad_reads,
+                     std::atomic<guint64>* reads) {
+  std::atomic<bool> done(false);
+  std::vector<std::thread> readers;
+  for (unsigned r = 0; r < num_readers; r++) {
+    readers.emplace_back([slot, &done, bad_reads, reads] {
+      std::string value;
+      guint64 last = 0;
+      while (!done) {
+        guint64 seen = 0;
+        if (!slot->read(&value)) {
+          continue;
+        }
+        // every read is whole, and never older than the previous one
+        if (!check_value(value, &seen) || seen < last) {
+          (*bad_reads)++;
+        }
+        last = seen;
+        (*reads)++;
+      }
+    });
+  }
+
+  std::string value;
+  guint64 writes = 0;
+  auto start = std::chrono::steady_clock::now();
+  auto end = start + duration;
+  while (std::chrono::steady_clock::now() < end) {
+    for (int i = 0; i < 64; i++, writes++) {
+      value = make_value(*counter);
+      (*counter)++;
+      slot->write(value.data(), value.size());
+    }
+  }
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  return (double)writes / seconds;
+}
+
+GST_START_TEST(test_stress) {
+  ds::SeqlockSlot slot;
+  guint64 counter = 1;
+  std::atomic<guint64> bad_reads(0);
+  std::atomic<guint64> reads(0);
+  unsigned cores = std::thread::hardware_concurrency();
+  unsigned num_readers = std::min(std::max(cores, 2u) - 1, 4u);
+
+  double alone = stress(&slot, &counter, 0, std::chrono::milliseconds(300),
+                        &bad_reads, &reads);
+  double polled = stress(&slot, &counter, num_readers,
+                         std::chrono::milliseconds(300), &bad_reads, &reads);
+  GST_INFO("%u readers: %.0f writes/s alone, %.0f polled, %" G_GUINT64_FORMAT
+           " reads, %" G_GUINT64_FORMAT " retries",
+           num_readers, alone, polled, (guint64)reads, slot.retries());
+
+  ck_assert_uint_eq(bad_reads, 0);
+  ck_assert_uint_gt(reads, 0);
+  // the writer never waits for readers; allow for sharing cache lines. on a
+  // single core the readers just take the writer's time slices.
+  if (cores > num_readers) {
+    ck_assert_msg(polled >= alone / 4, "%.0f writes/s polled, %.0f alone",
+                  polled, alone);
+  }
+}
+GST_END_TEST;
+
+static Suite* seqlockslot_suite(void) {
+  Suite* s = suite_create("SeqlockSlot");
+  TCase* bc = tcase_create("basic");
+
+  tcase_set_timeout(bc, 30);
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_read_write);
+  tcase_add_test(bc, test_stress);
+
+  return s;
+}
+
+GST_CHECK_MAIN(seqlockslot);
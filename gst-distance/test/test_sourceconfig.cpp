@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "SourceConfig.hpp"
+
+#include <gst/check/check.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+static const char CONFIG[] =
+    "# every source not listed\n"
+    "[default]\n"
+    "class-id = 1\n"
+    "\n"
+    "[source-3]\n"
+    "class-id=2\n"
+    "do-drawing=false\n"
+    "\n"
+    "[source-7]\n"
+    "enabled=false\n";
+
+GST_START_TEST(test_parse) {
+  std::string error;
+  auto config = ds::SourceConfig::parse(CONFIG, &error);
+  ck_assert_msg(config != nullptr, "%s", error.c_str());
+  ck_assert_uint_eq(config->size(), 2);
+
+  const ds::SourceSettings& other = config->settings(0);
+  ck_assert(other.enabled);
+  ck_assert_int_eq(other.class_id, 1);
+  ck_assert_int_eq(other.do_drawing, -1);
+
+  const ds::SourceSettings& three = config->settings(3);
+  ck_assert_int_eq(three.class_id, 2);
+  ck_assert_int_eq(three.do_drawing, 0);
+
+  // [default] fills in what a source doesn't set
+  const ds::SourceSettings& seven = config->settings(7);
+  ck_assert(!seven.enabled);
+  ck_assert_int_eq(seven.class_id, 1);
+
+  // an empty file is fine and changes nothing
+  config = ds::SourceConfig::parse("", &error);
+  ck_assert(config != nullptr);
+  ck_assert_int_eq(config->settings(0).class_id, -1);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_parse_errors) {
+  const char* bad[] = {
+      "class-id=1\n",                    // outside a group
+      "[source-1\n",                     // unterminated
+      "[camera-1]\n",                    // unknown group
+      "[source-x]\n",                    // not a number
+      "[source-1]\n[source-1]\n",        // twice
+      "[source-1]\nthreshold=2.0\n",     // unknown key
+      "[source-1]\nclass-id=-1\n",       // out of range
+      "[source-1]\nclass-id=99999\n",    // out of range
+      "[source-1]\nenabled=maybe\n",     // not a bool
+      "[source-1]\nenabled\n",           // no value
+  };
+  for (const char* text : bad) {
+    std::string error;
+    ck_assert_msg(ds::SourceConfig::parse(text, &error) == nullptr,
+                  "parsed: %s", text);
+    ck_assert(!error.empty());
+  }
+}
+GST_END_TEST;
+
+static void write_file(const std::string& path, const char* text) {
+  // like an editor: write a temporary file, then rename it into place
+  std::string tmp = path + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "w");
+  ck_assert(f != nullptr);
+  fputs(text, f);
+  fclose(f);
+  ck_assert_int_eq(rename(tmp.c_str(), path.c_str()), 0);
+}
+
+static bool wait_for_reloads(const ds::SourceConfigWatcher& watcher,
+                             uint64_t reloads) {
+  for (int i = 0; i < 500; i++) {
+    if (watcher.reloads() >= reloads) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+GST_START_TEST(test_watcher) {
+  char dir[] = "/tmp/dssourceconfig-XXXXXX";
+  ck_assert(mkdtemp(dir) != nullptr);
+  std::string path = std::string(dir) + "/sources.conf";
+  write_file(path, CONFIG);
+
+  // started before there is a path, like an element whose config-file is
+  // set while playing
+  ds::SourceConfigWatcher watcher;
+  ck_assert(watcher.start());
+  std::string error;
+  ck_assert(!watcher.set_path(path + ".missing", &error));
+  ck_assert(watcher.config() == nullptr);
+  ck_assert_msg(watcher.set_path(path, &error), "%s", error.c_str());
+  auto first = watcher.config();
+  ck_assert_int_eq(first->settings(3).class_id, 2);
+
+  write_file(path, "[source-3]\nclass-id=5\n");
+  ck_assert(wait_for_reloads(watcher, 1));
+  ck_assert_int_eq(watcher.config()->settings(3).class_id, 5);
+  // whoever still holds the old config keeps a consistent one
+  ck_assert_int_eq(first->settings(3).class_id, 2);
+
+  // a bad edit keeps the last good config
+  write_file(path, "[source-3]\nclass-id=five\n");
+  write_file(path, "[source-4]\nclass-id=6\n");
+  ck_assert(wait_for_reloads(watcher, 2));
+  ck_assert_int_eq(watcher.config()->settings(4).class_id, 6);
+
+  // other files in the directory are ignored
+  write_file(std::string(dir) + "/other.conf", "[source-3]\nclass-id=7\n");
+  std::this_thread::sleep_for(std::chrono::milliseconds(300));
+  ck_assert_uint_eq(watcher.reloads(), 2);
+
+  watcher.stop();
+  ck_assert(watcher.set_path("", &error));
+  ck_assert(watcher.config() == nullptr);
+  unlink(path.c_str());
+  unlink((std::string(dir) + "/other.conf").c_str());
+  rmdir(dir);
+}
+GST_END_TEST;
+
+static Suite* sourceconfig_suite(void) {
+  Suite* s = suite_create("SourceConfig");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_parse);
+  tcase_add_test(bc, test_parse_errors);
+  tcase_add_test(bc, test_watcher);
+
+  return s;
+}
+
+GST_CHECK_MAIN(sourceconfig);
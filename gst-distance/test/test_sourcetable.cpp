@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "SourceTable.hpp"
+
+#include <gst/check/check.h>
+
+#include <functional>
+#include <vector>
+
+/** remembers what was evicted */
+struct Evicted {
+  std::vector<uint32_t> sources;
+  void operator()(uint32_t source_id, int* value) {
+    (void)value;
+    sources.push_back(source_id);
+  }
+};
+
+GST_START_TEST(test_get_remove) {
+  ds::SourceTable<int> table;
+  Evicted evicted;
+  bool added = false;
+  int* value = table.get(3, 0, &added, std::ref(evicted));
+  ck_assert(added);
+  *value = 42;
+  value = table.get(3, 10, &added, std::ref(evicted));
+  ck_assert(!added);
+  ck_assert_int_eq(*value, 42);
+  ck_assert_uint_eq(table.size(), 1);
+
+  ck_assert(table.remove(3, std::ref(evicted)));
+  ck_assert(!table.remove(3, std::ref(evicted)));
+  ck_assert_uint_eq(evicted.sources.size(), 1);
+  ck_assert_uint_eq(evicted.sources[0], 3);
+  ck_assert_uint_eq(table.size(), 0);
+  // removing is not counted as an eviction
+  ck_assert_uint_eq(table.evicted(), 0);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_idle_timeout) {
+  ds::SourceTableLimits limits;
+  limits.idle_timeout = 1000;
+  ds::SourceTable<int> table(limits);
+  Evicted evicted;
+  bool added = false;
+  table.get(0, 0, &added, std::ref(evicted));
+  table.get(1, 0, &added, std::ref(evicted));
+  // source 0 keeps going, source 1 goes quiet
+  for (uint64_t now = 100; now <= 2000; now += 100) {
+    table.get(0, now, &added, std::ref(evicted));
+  }
+  ck_assert_uint_eq(table.size(), 1);
+  ck_assert_uint_eq(evicted.sources.size(), 1);
+  ck_assert_uint_eq(evicted.sources[0], 1);
+  ck_assert_uint_eq(table.evicted(), 1);
+
+  // going back in time (a seek) evicts nothing
+  table.get(2, 0, &added, std::ref(evicted));
+  ck_assert_uint_eq(table.size(), 2);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_memory_cap) {
+  ds::SourceTableLimits limits;
+  limits.max_bytes = 4 * 64;
+  ds::SourceTable<int> table(limits, 64);
+  ck_assert_uint_eq(table.max_entries(), 4);
+  Evicted evicted;
+  bool added = false;
+  for (uint32_t source = 0; source < 4; source++) {
+    table.get(source, source, &added, std::ref(evicted));
+  }
+  // seen again, so source 1 is now the least recently seen
+  table.get(0, 10, &added, std::ref(evicted));
+  table.get(4, 11, &added, std::ref(evicted));
+  ck_assert_uint_eq(table.size(), 4);
+  ck_assert_uint_eq(evicted.sources.size(), 1);
+  ck_assert_uint_eq(evicted.sources[0], 1);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_churn) {
+  ds::SourceTableLimits limits;
+  limits.idle_timeout = 1000;
+  ds::SourceTable<int> table(limits);
+  Evicted evicted;
+  bool added = false;
+  size_t memory = 0;
+  // 8 sources at a time, each replaced by a new id every 100 ns of pts
+  for (uint64_t now = 0; now < 1000000; now += 10) {
+    uint32_t generation = (uint32_t)(now / 100);
+    for (uint32_t source = 0; source < 8; source++) {
+      table.get(generation * 8 + source, now, &added, std::ref(evicted));
+    }
+    if (now == 10000) {
+      memory = table.memory();
+    }
+  }
+  ck_assert_uint_gt(memory, 0);
+  ck_assert_uint_eq(table.memory(), memory);
+  // the timeout, plus up to a quarter of it before the next sweep
+  ck_assert_uint_le(table.size(), 8 * (1250 / 100 + 1));
+}
+GST_END_TEST;
+
+static Suite* sourcetable_suite(void) {
+  Suite* s = suite_create("SourceTable");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_get_remove);
+  tcase_add_test(bc, test_idle_timeout);
+  tcase_add_test(bc, test_memory_cap);
+  tcase_add_test(bc, test_churn);
+
+  return s;
+}
+
+GST_CHECK_MAIN(sourcetable);
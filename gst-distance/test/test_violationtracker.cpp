@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+
+#include "ViolationTracker.hpp"
+
+#include <gst/check/check.h>
+
+#include <vector>
+
+typedef ds::ViolationTracker::Person Person;
+
+static const uint64_t MS = 1000000;
+
+/* `n` people a tenth of a height apart (one cluster), then `alone` people
+ * far from everyone */
+static std::vector<Person> crowd(uint32_t n, uint32_t alone = 0) {
+  std::vector<Person> people;
+  for (uint32_t i = 0; i < n; i++) {
+    people.push_back(Person{100.0f + 10.0f * i, 500.0f, 100.0f});
+  }
+  for (uint32_t i = 0; i < alone; i++) {
+    people.push_back(Person{10000.0f * (i + 1), 500.0f, 100.0f});
+  }
+  return people;
+}
+
+GST_START_TEST(test_largest_cluster) {
+  ds::ViolationTracker tracker(1.0f, 0);
+  ck_assert_uint_eq(tracker.largest_cluster({}), 0);
+  ck_assert_uint_eq(tracker.largest_cluster(crowd(1)), 0);
+  ck_assert_uint_eq(tracker.largest_cluster(crowd(0, 3)), 0);
+  ck_assert_uint_eq(tracker.largest_cluster(crowd(4, 2)), 4);
+  // distance is in person heights, and transitive
+  std::vector<Person> chain = {
+      {0.0f, 0.0f, 100.0f}, {90.0f, 0.0f, 100.0f}, {180.0f, 0.0f, 100.0f}};
+  ck_assert_uint_eq(tracker.largest_cluster(chain), 3);
+  tracker.set_distance(0.5f);
+  ck_assert_uint_eq(tracker.largest_cluster(chain), 0);
+  // boxes with no height are never near anyone
+  ck_assert_uint_eq(tracker.largest_cluster({{0, 0, 0}, {0, 0, 0}}), 0);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_immediate) {
+  ds::ViolationTracker tracker(1.0f, 0);
+  std::vector<ds::ViolationChange> out;
+
+  // nothing to say while nothing changes
+  tracker.add_frame(1, 0, crowd(0, 2));
+  ck_assert(!tracker.poll(0, &out));
+
+  tracker.add_frame(1, 1 * MS, crowd(2));
+  ck_assert(tracker.poll(1 * MS, &out));
+  ck_assert_uint_eq(out.size(), 1);
+  ck_assert_int_eq(out[0].state, ds::ViolationChange::STATE_STARTED);
+  ck_assert_uint_eq(out[0].previous_size, 0);
+  ck_assert_uint_eq(out[0].size, 2);
+  ck_assert_uint_eq(out[0].pts, 1 * MS);
+
+  // the same violation again is not a change
+  out.clear();
+  tracker.add_frame(1, 2 * MS, crowd(2, 1));
+  ck_assert(!tracker.poll(2 * MS, &out));
+
+  tracker.add_frame(1, 3 * MS, crowd(3));
+  ck_assert(tracker.poll(3 * MS, &out));
+  ck_assert_int_eq(out[0].state, ds::ViolationChange::STATE_CHANGED);
+  ck_assert_uint_eq(out[0].previous_size, 2);
+  ck_assert_uint_eq(out[0].size, 3);
+
+  out.clear();
+  tracker.add_frame(1, 4 * MS, crowd(1));
+  ck_assert(tracker.poll(4 * MS, &out));
+  ck_assert_int_eq(out[0].state, ds::ViolationChange::STATE_ENDED);
+  ck_assert_uint_eq(out[0].size, 0);
+  ck_assert_str_eq(ds::ViolationTracker::state_name(out[0].state), "ended");
+}
+GST_END_TEST;
+
+GST_START_TEST(test_coalesce) {
+  ds::ViolationTracker tracker(1.0f, 1000 * MS);
+  std::vector<ds::ViolationChange> out;
+
+  // flickering detections: many changes, one message
+  for (uint64_t i = 0; i < 20; i++) {
+    tracker.add_frame(1, i * 33 * MS, crowd(i % 2 ? 2 : 3 + i % 4));
+    tracker.add_frame(2, i * 33 * MS, crowd(i % 2));
+    ck_assert(!tracker.poll(i * 33 * MS, &out));
+  }
+  tracker.add_frame(1, 999 * MS, crowd(4));
+  ck_assert(!tracker.poll(999 * MS, &out));
+  ck_assert(tracker.poll(1000 * MS, &out));
+  ck_assert_uint_eq(out.size(), 1);
+  ck_assert_uint_eq(out[0].source_id, 1);
+  ck_assert_int_eq(out[0].state, ds::ViolationChange::STATE_STARTED);
+  ck_assert_uint_eq(out[0].size, 4);
+  ck_assert_uint_eq(out[0].max_size, 5);
+  ck_assert_uint_eq(out[0].changes, 21);
+  ck_assert_uint_eq(out[0].pts, 999 * MS);
+
+  // a violation that came and went in one window is still reported
+  out.clear();
+  tracker.add_frame(2, 1100 * MS, crowd(2));
+  tracker.add_frame(2, 1200 * MS, crowd(1));
+  ck_assert(!tracker.poll(1500 * MS, &out));
+  ck_assert(tracker.poll(2100 * MS, &out));
+  ck_assert_uint_eq(out.size(), 1);
+  ck_assert_int_eq(out[0].state, ds::ViolationChange::STATE_BRIEF);
+  ck_assert_uint_eq(out[0].max_size, 2);
+
+  // but one that ends as it started is not
+  out.clear();
+  tracker.add_frame(1, 2200 * MS, crowd(5));
+  tracker.add_frame(1, 2300 * MS, crowd(4));
+  ck_assert(!tracker.poll(3200 * MS, &out));
+
+  // pts going backwards ends the window
+  tracker.add_frame(1, 3300 * MS, crowd(0));
+  ck_assert(tracker.poll(0, &out));
+  ck_assert_int_eq(out[0].state, ds::ViolationChange::STATE_ENDED);
+
+  // flush doesn't wait for the window to end
+  out.clear();
+  tracker.add_frame(3, 100 * MS, crowd(2));
+  ck_assert(tracker.flush(&out));
+  ck_assert_uint_eq(out[0].source_id, 3);
+  ck_assert(!tracker.flush(&out));
+}
+GST_END_TEST;
+
+GST_START_TEST(test_remove_source) {
+  ds::SourceTableLimits limits;
+  limits.idle_timeout = 1000 * MS;
+  ds::ViolationTracker tracker(1.0f, 0, limits);
+  std::vector<ds::ViolationChange> out;
+
+  tracker.add_frame(1, 0, crowd(2));
+  tracker.add_frame(2, 0, crowd(3));
+  tracker.add_frame(3, 0, crowd(1));
+  tracker.poll(0, &out);
+  ck_assert_uint_eq(out.size(), 2);
+  ck_assert_uint_eq(tracker.sources(), 3);
+
+  // a source that goes away with a violation ends it
+  out.clear();
+  tracker.remove_source(1);
+  tracker.remove_source(3);
+  tracker.remove_source(42);
+  ck_assert_uint_eq(tracker.sources(), 1);
+  ck_assert(tracker.poll(0, &out));
+  ck_assert_uint_eq(out.size(), 1);
+  ck_assert_uint_eq(out[0].source_id, 1);
+  ck_assert_int_eq(out[0].state, ds::ViolationChange::STATE_ENDED);
+
+  // as does one that is forgotten for being idle
+  out.clear();
+  tracker.add_frame(4, 2000 * MS, crowd(0));
+  ck_assert(tracker.poll(2000 * MS, &out));
+  ck_assert_uint_eq(out.size(), 1);
+  ck_assert_uint_eq(out[0].source_id, 2);
+  ck_assert_int_eq(out[0].state, ds::ViolationChange::STATE_ENDED);
+  ck_assert_uint_eq(out[0].previous_size, 3);
+  ck_assert_uint_eq(tracker.sources(), 1);
+
+  // reset forgets everything without a word
+  out.clear();
+  tracker.add_frame(4, 2001 * MS, crowd(2));
+  tracker.reset();
+  ck_assert_uint_eq(tracker.sources(), 0);
+  ck_assert(!tracker.flush(&out));
+}
+GST_END_TEST;
+
+static Suite* violationtracker_suite(void) {
+  Suite* s = suite_create("ViolationTracker");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_largest_cluster);
+  tcase_add_test(bc, test_immediate);
+  tcase_add_test(bc, test_coalesce);
+  tcase_add_test(bc, test_remove_source);
+
+  return s;
+}
+
+GST_CHECK_MAIN(violationtracker);
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "WindowAggregator.hpp"
+
+#include <distance.pb.h>
+
+#include <gst/check/check.h>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+static const guint64 WINDOW = 5 * GST_SECOND;
+static const guint64 FRAME_DURATION = GST_SECOND / 25;
+
+/* a person standing with the bottom center of their box at (x, y) */
+static void add_person(dp::Frame* frame,
+                       float x,
+                       float y,
+                       float height,
+                       bool is_danger) {
+  dp::Person* person = frame->add_people();
+  person->set_is_danger(is_danger);
+  person->mutable_bbox()->set_left(x - height / 4.0f);
+  person->mutable_bbox()->set_top(y - height);
+  person->mutable_bbox()->set_width(height / 2.0f);
+  person->mutable_bbox()->set_height(height);
+}
+
+GST_START_TEST(test_sketch_accuracy) {
+  ds::QuantileSketch sketch;
+  ck_assert(std::isnan(sketch.quantile(0.5)));
+
+  GRand* rand = g_rand_new_with_seed(2033);
+  std::vector<double> values;
+  for (int i = 0; i < 100000; i++) {
+    // log uniform over most of the sketch's range
+    double value = std::exp(g_rand_double_range(rand, -6.0, 6.0));
+    values.push_back(value);
+    sketch.add(value);
+  }
+  g_rand_free(rand);
+  ck_assert_uint_eq(sketch.count(), values.size());
+
+  std::sort(values.begin(), values.end());
+  const double qs[] = {0.0, 0.5, 0.95, 0.99, 1.0};
+  for (double q : qs) {
+    double exact = values[(size_t)(q * (double)(values.size() - 1))];
+    double estimate = sketch.quantile(q);
+    ck_assert_msg(std::fabs(estimate - exact) <=
+                      exact * ds::QuantileSketch::RELATIVE_ACCURACY * 1.0001,
+                  "q%g: %g is not within 1%% of %g", q, estimate, exact);
+  }
+
+  // out of range values are clamped, memory stays fixed
+  sketch.clear();
+  ck_assert_uint_eq(sketch.count(), 0);
+  sketch.add(0.0);
+  sketch.add(1e9);
+  ck_assert(sketch.quantile(0.0) == 0.0);
+  ck_assert(sketch.quantile(1.0) <=
+            ds::QuantileSketch::MAX_VALUE *
+                (1.0 + ds::QuantileSketch::RELATIVE_ACCURACY));
+  ck_assert_uint_le(ds::QuantileSketch::NUM_BUCKETS, 1024);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_windows) {
+  ds::WindowAggregator aggregator(WINDOW, 1.0f);
+  std::vector<ds::WindowRecord> records;
+
+  // 12 s at 25 fps from two sources: windows [0, 5), [5, 10), [10, 15)
+  const int num_frames = 12 * 25;
+  for (int i = 0; i < num_frames; i++) {
+    dp::Batch batch;
+    for (guint source = 0; source < 2; source++) {
+      dp::Frame* frame = batch.add_frames();
+      frame->set_source_id(source);
+      frame->set_frame_num(i);
+      frame->set_pts(i * FRAME_DURATION);
+      // source 1 has one more person on odd frames
+      int num_people = 2 + (source == 1 && i % 2);
+      for (int p = 0; p < num_people; p++) {
+        add_person(frame, 1000.0f * p, 500.0f, 100.0f, p == 0);
+      }
+    }
+    aggregator.add(batch, &records);
+  }
+  // the first two windows of each source closed on their own
+  ck_assert_uint_eq(records.size(), 4);
+  aggregator.flush(&records);
+  ck_assert_uint_eq(records.size(), 6);
+
+  guint64 frames[2] = {0, 0};
+  for (const auto& record : records) {
+    ck_assert_uint_eq(record.end - record.start, WINDOW);
+    ck_assert_uint_eq(record.start % WINDOW, 0);
+    ck_assert_uint_eq(record.violations, record.frames);
+    ck_assert_uint_eq(record.max_people, 2 + record.source_id);
+    ck_assert_uint_eq(record.max_cluster, 1);
+    // everyone is 10 person heights from their neighbour
+    ck_assert(std::fabs(record.p95_distance -
+                        (record.source_id ? 20.0f : 10.0f)) <= 0.2f);
+    frames[record.source_id] += record.frames;
+  }
+  ck_assert_uint_eq(frames[0], num_frames);
+  ck_assert_uint_eq(frames[1], num_frames);
+  // the last window is only partly filled
+  ck_assert_uint_eq(records.back().start, 2 * WINDOW);
+  ck_assert_uint_eq(records.back().frames, num_frames - 10 * 25);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_clusters) {
+  ds::WindowAggregator aggregator(WINDOW, 1.0f);
+  std::vector<ds::WindowRecord> records;
+
+  dp::Batch batch;
+  dp::Frame* frame = batch.add_frames();
+  // a chain of 3 half a height apart (the ends are a full height apart),
+  // a pair, and one person alone
+  add_person(frame, 0.0f, 100.0f, 100.0f, true);
+  add_person(frame, 50.0f, 100.0f, 100.0f, true);
+  add_person(frame, 100.0f, 100.0f, 100.0f, true);
+  add_person(frame, 1000.0f, 100.0f, 100.0f, true);
+  add_person(frame, 1050.0f, 100.0f, 100.0f, true);
+  add_person(frame, 5000.0f, 100.0f, 100.0f, false);
+  aggregator.add(batch, &records);
+
+  // a later frame with fewer people does not lower the max
+  batch.Clear();
+  frame = batch.add_frames();
+  frame->set_pts(FRAME_DURATION);
+  add_person(frame, 0.0f, 100.0f, 100.0f, false);
+  aggregator.add(batch, &records);
+
+  ck_assert_uint_eq(records.size(), 0);
+  aggregator.flush(&records);
+  ck_assert_uint_eq(records.size(), 1);
+  ck_assert_uint_eq(records[0].frames, 2);
+  ck_assert_uint_eq(records[0].people, 7);
+  ck_assert_uint_eq(records[0].max_people, 6);
+  ck_assert_uint_eq(records[0].violations, 5);
+  ck_assert_uint_eq(records[0].max_cluster, 3);
+
+  // a window with nobody in it has no distances
+  records.clear();
+  batch.Clear();
+  batch.add_frames()->set_pts(0);
+  aggregator.add(batch, &records);
+  aggregator.flush(&records);
+  ck_assert_uint_eq(records.size(), 1);
+  ck_assert_uint_eq(records[0].max_cluster, 0);
+  ck_assert(std::isnan(records[0].p95_distance));
+}
+GST_END_TEST;
+
+GST_START_TEST(test_source_churn) {
+  ds::SourceTableLimits limits;
+  limits.idle_timeout = 2 * WINDOW;
+  ds::WindowAggregator aggregator(WINDOW, 1.0f, limits);
+  std::vector<ds::WindowRecord> records;
+  size_t memory = 0;
+
+  // 4 sources at a time, each replaced by a new one every 2 s, for 10 min
+  const int num_frames = 10 * 60 * 25;
+  guint64 frames = 0;
+  for (int i = 0; i < num_frames; i++) {
+    guint generation = (guint)(i / 50);
+    dp::Batch batch;
+    for (guint source = 0; source < 4; source++) {
+      dp::Frame* frame = batch.add_frames();
+      frame->set_source_id(generation * 4 + source);
+      frame->set_pts(i * FRAME_DURATION);
+      add_person(frame, 0.0f, 100.0f, 100.0f, false);
+    }
+    // every other generation is removed (eg. on stream eos), the rest idle
+    if (i % 50 == 0 && generation % 2 == 1) {
+      for (guint source = 0; source < 4; source++) {
+        aggregator.remove_source((generation - 1) * 4 + source, &records);
+      }
+    }
+    aggregator.add(batch, &records);
+    if (i == num_frames / 10) {
+      memory = aggregator.memory();
+    }
+  }
+  ck_assert_uint_gt(memory, 0);
+  ck_assert_uint_eq(aggregator.memory(), memory);
+  ck_assert_uint_le(aggregator.sources(), 4 * 8);
+
+  // every frame is in exactly one record, however its source went away
+  aggregator.flush(&records);
+  ck_assert_uint_eq(aggregator.sources(), 0);
+  for (const auto& record : records) {
+    frames += record.frames;
+  }
+  ck_assert_uint_eq(frames, (guint64)num_frames * 4);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_csv_row) {
+  ds::WindowRecord record = ds::WindowRecord();
+  record.source_id = 3;
+  record.start = 5000000000;
+  record.end = 10000000000;
+  record.frames = 150;
+  record.people = 300;
+  record.max_people = 4;
+  record.violations = 12;
+  record.max_cluster = 2;
+  record.p95_distance = 1.5f;
+  ck_assert_str_eq(ds::WindowAggregator::csv_row(record).c_str(),
+                   "3,5000000000,10000000000,150,2.000000,4,12,2,1.500000\n");
+  ck_assert_str_eq(ds::WindowAggregator::CSV_HEADER,
+                   "source_id,start,end,frames,mean_people,max_people,"
+                   "violations,max_cluster,p95_distance\n");
+}
+GST_END_TEST;
+
+static Suite* windowaggregator_suite(void) {
+  Suite* s = suite_create("WindowAggregator");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_sketch_accuracy);
+  tcase_add_test(bc, test_windows);
+  tcase_add_test(bc, test_clusters);
+  tcase_add_test(bc, test_source_churn);
+  tcase_add_test(bc, test_csv_row);
+
+  return s;
+}
+
+GST_CHECK_MAIN(windowaggregator);
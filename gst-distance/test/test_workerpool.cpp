@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+
+#include "WorkerPool.hpp"
+
+#include <gst/check/check.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock test_clock;
+
+/* a count tasks can bump and the test can wait on
+ */
+class Counter {
+ public:
+  void add() {
+    std::lock_guard<std::mutex> guard(lock_);
+    count_++;
+    cond_.notify_all();
+  }
+  bool wait_for(unsigned count) {
+    std::unique_lock<std::mutex> guard(lock_);
+    return cond_.wait_for(guard, std::chrono::seconds(10),
+                          [&] { return count_ >= count; });
+  }
+  unsigned count() {
+    std::lock_guard<std::mutex> guard(lock_);
+    return count_;
+  }
+
+ private:
+  std::mutex lock_;
+  std::condition_variable cond_;
+  unsigned count_ = 0;
+};
+
+GST_START_TEST(test_strand_order) {
+  const unsigned num_tasks = 10000;
+  ds::WorkerPool pool({4, false});
+  ck_assert_uint_eq(pool.threads(), 4);
+  ds::WorkerPool::Strand strand(&pool);
+  std::vector<unsigned> order;
+  Counter done;
+
+  // one at a time, so no lock around order
+  for (unsigned i = 0; i < num_tasks; i++) {
+    ck_assert(strand.post([&order, &done, i] {
+      order.push_back(i);
+      done.add();
+    }));
+  }
+  ck_assert(done.wait_for(num_tasks));
+  strand.close();
+  ck_assert_uint_eq(order.size(), num_tasks);
+  for (unsigned i = 0; i < num_tasks; i++) {
+    ck_assert_uint_eq(order[i], i);
+  }
+}
+GST_END_TEST;
+
+GST_START_TEST(test_fairness) {
+  const unsigned num_busy = 100;
+  // a single worker, so strands can only take turns
+  ds::WorkerPool pool({1, false});
+  ds::WorkerPool::Strand busy(&pool);
+  ds::WorkerPool::Strand quiet(&pool);
+  Counter busy_done;
+  Counter quiet_done;
+  std::atomic<unsigned> busy_before_quiet(0);
+
+  for (unsigned i = 0; i < num_busy; i++) {
+    busy.post([&busy_done] {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      busy_done.add();
+    });
+  }
+  // posted behind a hundred tasks, but it only waits for the busy strand's
+  // current turn (and maybe the next)
+  quiet.post([&] {
+    busy_before_quiet = busy_done.count();
+    quiet_done.add();
+  });
+  ck_assert(quiet_done.wait_for(1));
+  ck_assert_uint_le(busy_before_quiet.load(), 3);
+  ck_assert(busy_done.wait_for(num_busy));
+}
+GST_END_TEST;
+
+GST_START_TEST(test_stealing) {
+  const unsigned num_strands = 16;
+  ds::WorkerPool pool({4, false});
+  std::vector<std::unique_ptr<ds::WorkerPool::Strand>> strands;
+  for (unsigned i = 0; i < num_strands; i++) {
+    strands.emplace_back(new ds::WorkerPool::Strand(&pool));
+  }
+  ds::WorkerPool::Strand first(&pool);
+  Counter done;
+
+  // posted from a worker, so every strand lands on that worker's deque
+  // and the others have to steal them
+  first.post([&] {
+    for (auto& strand : strands) {
+      strand->post([&done] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        done.add();
+      });
+    }
+  });
+  auto start = test_clock::now();
+  ck_assert(done.wait_for(num_strands));
+  auto elapsed = test_clock::now() - start;
+  ck_assert_uint_gt(pool.steals(), 0);
+  // well under the 160ms it takes one worker alone
+  ck_assert(elapsed < std::chrono::milliseconds(150));
+}
+GST_END_TEST;
+
+GST_START_TEST(test_post_after) {
+  ds::WorkerPool pool({2, false});
+  ds::WorkerPool::Strand strand(&pool);
+  Counter done;
+  test_clock::time_point ran;
+
+  auto start = test_clock::now();
+  ck_assert(strand.post_after(std::chrono::milliseconds(50), [&] {
+    ran = test_clock::now();
+    done.add();
+  }));
+  ck_assert(done.wait_for(1));
+  ck_assert(ran - start >= std::chrono::milliseconds(50));
+
+  // a delayed task doesn't run once its strand is closed
+  ds::WorkerPool::Strand closed(&pool);
+  closed.post_after(std::chrono::milliseconds(20), [&] { done.add(); });
+  closed.close();
+  ck_assert(!closed.post([&] { done.add(); }));
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  ck_assert_uint_eq(done.count(), 1);
+}
+GST_END_TEST;
+
+GST_START_TEST(test_close) {
+  ds::WorkerPool pool({2, false});
+  ds::WorkerPool::Strand strand(&pool);
+  Counter started;
+  std::atomic<bool> finished(false);
+  std::atomic<unsigned> dropped_ran(0);
+
+  strand.post([&] {
+    started.add();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    finished = true;
+  });
+  strand.post([&] { dropped_ran++; });
+  ck_assert(started.wait_for(1));
+  // waits for the running task and drops the queued one
+  strand.close();
+  ck_assert(finished.load());
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  ck_assert_uint_eq(dropped_ran.load(), 0);
+
+  // and a task may close its own strand
+  ds::WorkerPool::Strand self_closing(&pool);
+  Counter closed;
+  self_closing.post([&] {
+    self_closing.close();
+    closed.add();
+  });
+  ck_assert(closed.wait_for(1));
+}
+GST_END_TEST;
+
+GST_START_TEST(test_shared) {
+  ck_assert(&ds::WorkerPool::shared() == &ds::WorkerPool::shared());
+  ck_assert_uint_gt(ds::WorkerPool::shared().threads(), 0);
+  // too late once it is running
+  ck_assert(!ds::WorkerPool::configure({1, false}));
+
+  ds::WorkerPool::Strand strand(&ds::WorkerPool::shared());
+  Counter done;
+  strand.post([&done] { done.add(); });
+  ck_assert(done.wait_for(1));
+
+  // the file writers' pool is a different one
+  ck_assert(&ds::WorkerPool::io() == &ds::WorkerPool::io());
+  ck_assert(&ds::WorkerPool::io() != &ds::WorkerPool::shared());
+  ck_assert_uint_eq(ds::WorkerPool::io().threads(), 4);
+  ck_assert(!ds::WorkerPool::configure_io({1, false}));
+}
+GST_END_TEST;
+
+static Suite* workerpool_suite(void) {
+  Suite* s = suite_create("WorkerPool");
+  TCase* bc = tcase_create("basic");
+
+  suite_add_tcase(s, bc);
+  tcase_add_test(bc, test_strand_order);
+  tcase_add_test(bc, test_fairness);
+  tcase_add_test(bc, test_stealing);
+  tcase_add_test(bc, test_post_after);
+  tcase_add_test(bc, test_close);
+  tcase_add_test(bc, test_shared);
+
+  return s;
+}
+
+GST_CHECK_MAIN(workerpool);
@@ -0,0 +1,421 @@
+/*
+ * Copyright (C) 2020 Michael de Gans <michael.john.degans@gmail.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+/* dsrecording: dump or summarize dspayloadbroker proto and columnar mode
+ * recordings.
+ *
+ * usage:
+ *   dsrecording [--csv] [--source=ID ...] [--from=S] [--to=S] FILE ...
+ *   dsrecording --summary [--bucket=3600] ... FILE ...
+ *
+ * Recordings are memory mapped and decoded in parallel (one chunk or range
+ * of row groups per thread, see RecordingScan.hpp and ColumnarReader.hpp).
+ * With a sidecar index, --from skips straight to the right place in the
+ * file; columnar row groups outside --from/--to are skipped unread.
+ *
+ * Columnar recordings hold one row per person, so in the summary frames
+ * without people are not counted and sum_danger is the sum of danger_val.
+ */
+
+#include "ColumnarReader.hpp"
+#include "CsvEncoder.hpp"
+#include "RecordingScan.hpp"
+
+#include <glib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+using ds::recording::FrameView;
+using ds::recording::PersonView;
+
+static const uint64_t NSECS_PER_SECOND = G_GUINT64_CONSTANT(1000000000);
+
+static gboolean summary = FALSE;
+static gboolean csv = FALSE;
+static gint num_threads = 0;
+static gdouble from_seconds = 0.0;
+static gdouble to_seconds = -1.0;
+static gint bucket_seconds = 3600;
+static gchar** files = nullptr;
+
+static gboolean parse_source(const gchar* option_name,
+                             const gchar* value,
+                             gpointer data,
+                             GError** error);
+
+static GOptionEntry entries[] = {
+    {"csv", 'c', 0, G_OPTION_ARG_NONE, &csv,
+     "print one csv row per person (default)", nullptr},
+    {"summary", 'S', 0, G_OPTION_ARG_NONE, &summary,
+     "print per bucket, per source statistics", nullptr},
+    {"bucket", 'b', 0, G_OPTION_ARG_INT, &bucket_seconds,
+     "summary bucket size in seconds (default 3600)", "S"},
+    {"source", 's', 0, G_OPTION_ARG_CALLBACK, (gpointer)parse_source,
+     "only this source id (may be repeated)", "ID"},
+    {"from", 'f', 0, G_OPTION_ARG_DOUBLE, &from_seconds,
+     "only frames with pts >= this many seconds", "S"},
+    {"to", 't', 0, G_OPTION_ARG_DOUBLE, &to_seconds,
+     "only frames with pts < this many seconds", "S"},
+    {"threads", 'j', 0, G_OPTION_ARG_INT, &num_threads,
+     "decoding threads (default: one per core)", "N"},
+    {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files, nullptr,
+     "FILE..."},
+    {nullptr, 0, 0, G_OPTION_ARG_NONE, nullptr, nullptr, nullptr},
+};
+
+static std::vector<uint32_t> source_ids;
+
+static gboolean parse_source(const gchar* option_name,
+                             const gchar* value,
+                             gpointer data,
+                             GError** error) {
+  (void)option_name;
+  (void)data;
+  guint64 id;
+  if (!g_ascii_string_to_unsigned(value, 10, 0, G_MAXUINT32, &id, error)) {
+    return FALSE;
+  }
+  source_ids.push_back((uint32_t)id);
+  return TRUE;
+}
+
+/* one csv row per person, into a per chunk buffer */
+class CsvVisitor : public ds::recording::FrameVisitor,
+                   public ds::recording::PersonVisitor {
+ public:
+  virtual void on_frame(const FrameView& frame) override {
+    if (frame.num_people == 0) {
+      return;
+    }
+    encoder.begin_frame(frame.source_id, frame.frame_num, frame.pts);
+    ds::recording::for_each_person(frame, this);
+  }
+
+  virtual void on_person(const FrameView& frame,
+                         const PersonView& person) override {
+    (void)frame;
+    encoder.add_person(person.uid, person.is_danger, person.danger_val,
+                       person.left, person.top, person.width, person.height);
+  }
+
+  ds::CsvEncoder encoder;
+};
+
+struct Stats {
+  uint64_t frames = 0;
+  uint64_t people = 0;
+  uint64_t violations = 0;
+  uint32_t max_people = 0;
+  float sum_danger = 0.0f;
+
+  void merge(const Stats& other) {
+    frames += other.frames;
+    people += other.people;
+    violations += other.violations;
+    max_people = std::max(max_people, other.max_people);
+    sum_danger += other.sum_danger;
+  }
+};
+
+/* (bucket, source_id) -> Stats */
+typedef std::map<std::pair<uint64_t, uint32_t>, Stats> Summary;
+
+class SummaryVisitor : public ds::recording::FrameVisitor {
+ public:
+  explicit SummaryVisitor(uint64_t bucket_ns) : bucket_ns_(bucket_ns) {}
+
+  virtual void on_frame(const FrameView& frame) override {
+    Stats& stats = summary[{frame.pts / bucket_ns_, frame.source_id}];
+    stats.frames++;
+    stats.people += frame.num_people;
+    stats.violations += frame.num_danger;
+    stats.max_people = std::max(stats.max_people, frame.num_people);
+    stats.sum_danger += frame.sum_danger;
+  }
+
+  Summary summary;
+
+ private:
+  uint64_t bucket_ns_;
+};
+
+static bool dump_csv(const ds::recording::RecordingReader& reader,
+                     const ds::recording::ScanOptions& options,
+                     unsigned threads) {
+  std::vector<std::unique_ptr<CsvVisitor>> visitors;
+  std::vector<ds::recording::FrameVisitor*> pointers;
+  for (unsigned i = 0; i < threads; i++) {
+    visitors.emplace_back(new CsvVisitor());
+    pointers.push_back(visitors.back().get());
+  }
+  bool ok = ds::recording::scan_parallel(reader, options, pointers);
+  for (const auto& visitor : visitors) {
+    fwrite(visitor->encoder.data(), 1, visitor->encoder.size(), stdout);
+  }
+  return ok;
+}
+
+static bool summarize(const ds::recording::RecordingReader& reader,
+                      const ds::recording::ScanOptions& options,
+                      unsigned threads,
+                      Summary* total) {
+  std::vector<std::unique_ptr<SummaryVisitor>> visitors;
+  std::vector<ds::recording::FrameVisitor*> pointers;
+  for (unsigned i = 0; i < threads; i++) {
+    visitors.emplace_back(
+        new SummaryVisitor((uint64_t)bucket_seconds * NSECS_PER_SECOND));
+    pointers.push_back(visitors.back().get());
+  }
+  bool ok = ds::recording::scan_parallel(reader, options, pointers);
+  for (const auto& visitor : visitors) {
+    for (const auto& item : visitor->summary) {
+      (*total)[item.first].merge(item.second);
+    }
+  }
+  return ok;
+}
+
+/* columnar recordings */
+
+using ds::columnar::ColumnarReader;
+
+static bool selected(const ds::recording::ScanOptions& options,
+                     uint64_t pts,
+                     uint32_t source_id) {
+  if (pts < options.begin || pts >= options.end) {
+    return false;
+  }
+  return options.sources.empty() ||
+         std::find(options.sources.begin(), options.sources.end(),
+                   source_id) != options.sources.end();
+}
+
+/* call `visit(group, worker)` for every row group overlapping the options,
+ * with worker i handling the i-th contiguous range of groups */
+template <typename Visit>
+static bool for_each_row_group(const ColumnarReader& reader,
+                               const ds::recording::ScanOptions& options,
+                               unsigned threads,
+                               Visit visit) {
+  std::vector<size_t> groups;
+  for (size_t g = 0; g < reader.num_row_groups(); g++) {
+    const auto& group = reader.row_group(g);
+    if (group.max_pts >= options.begin && group.min_pts < options.end) {
+      groups.push_back(g);
+    }
+  }
+  std::atomic<bool> ok(true);
+  std::vector<std::thread> workers;
+  for (unsigned t = 0; t < threads; t++) {
+    size_t begin = groups.size() * t / threads;
+    size_t end = groups.size() * (t + 1) / threads;
+    workers.emplace_back([&groups, &ok, &visit, begin, end, t] {
+      for (size_t i = begin; i < end; i++) {
+        if (!visit(groups[i], t)) {
+          ok = false;
+          return;
+        }
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return ok;
+}
+
+static bool columnar_csv(const ColumnarReader& reader,
+                         const ds::recording::ScanOptions& options,
+                         unsigned threads) {
+  using namespace ds::columnar;
+  std::vector<ds::CsvEncoder> encoders(threads);
+  bool ok = for_each_row_group(
+      reader, options, threads, [&](size_t g, unsigned worker) {
+        std::vector<uint64_t> pts, frame_num, uid;
+        std::vector<uint32_t> source_id;
+        std::vector<uint8_t> is_danger;
+        std::vector<float> danger_val, left, top, width, height;
+        if (!reader.read_column(g, COLUMN_PTS, &pts) ||
+            !reader.read_column(g, COLUMN_SOURCE_ID, &source_id) ||
+            !reader.read_column(g, COLUMN_FRAME_NUM, &frame_num) ||
+            !reader.read_column(g, COLUMN_UID, &uid) ||
+            !reader.read_column(g, COLUMN_IS_DANGER, &is_danger) ||
+            !reader.read_column(g, COLUMN_DANGER_VAL, &danger_val) ||
+            !reader.read_column(g, COLUMN_LEFT, &left) ||
+            !reader.read_column(g, COLUMN_TOP, &top) ||
+            !reader.read_column(g, COLUMN_WIDTH, &width) ||
+            !reader.read_column(g, COLUMN_HEIGHT, &height)) {
+          return false;
+        }
+        ds::CsvEncoder& encoder = encoders[worker];
+        for (size_t i = 0; i < pts.size(); i++) {
+          if (!selected(options, pts[i], source_id[i])) {
+            continue;
+          }
+          encoder.begin_frame(source_id[i], frame_num[i], pts[i]);
+          encoder.add_person(uid[i], is_danger[i], danger_val[i], left[i],
+                             top[i], width[i], height[i]);
+        }
+        return true;
+      });
+  for (const auto& encoder : encoders) {
+    fwrite(encoder.data(), 1, encoder.size(), stdout);
+  }
+  return ok;
+}
+
+static bool columnar_summary(const ColumnarReader& reader,
+                             const ds::recording::ScanOptions& options,
+                             unsigned threads,
+                             Summary* total) {
+  using namespace ds::columnar;
+  const uint64_t bucket_ns = (uint64_t)bucket_seconds * NSECS_PER_SECOND;
+  std::vector<Summary> summaries(threads);
+  bool ok = for_each_row_group(
+      reader, options, threads, [&](size_t g, unsigned worker) {
+        // only the columns a summary needs are decompressed
+        std::vector<uint64_t> pts, frame_num;
+        std::vector<uint32_t> source_id;
+        std::vector<uint8_t> is_danger;
+        std::vector<float> danger_val;
+        if (!reader.read_column(g, COLUMN_PTS, &pts) ||
+            !reader.read_column(g, COLUMN_SOURCE_ID, &source_id) ||
+            !reader.read_column(g, COLUMN_FRAME_NUM, &frame_num) ||
+            !reader.read_column(g, COLUMN_IS_DANGER, &is_danger) ||
+            !reader.read_column(g, COLUMN_DANGER_VAL, &danger_val)) {
+          return false;
+        }
+        Summary& partial = summaries[worker];
+        Stats* stats = nullptr;
+        uint32_t people = 0;
+        for (size_t i = 0; i < pts.size(); i++) {
+          if (!selected(options, pts[i], source_id[i])) {
+            continue;
+          }
+          // the rows of a frame are contiguous
+          if (stats == nullptr || i == 0 || frame_num[i] != frame_num[i - 1] ||
+              source_id[i] != source_id[i - 1]) {
+            stats = &partial[{pts[i] / bucket_ns, source_id[i]}];
+            stats->frames++;
+            people = 0;
+          }
+          people++;
+          stats->people++;
+          stats->violations += is_danger[i];
+          stats->max_people = std::max(stats->max_people, people);
+          stats->sum_danger += danger_val[i];
+        }
+        return true;
+      });
+  for (const auto& partial : summaries) {
+    for (const auto& item : partial) {
+      (*total)[item.first].merge(item.second);
+    }
+  }
+  return ok;
+}
+
+static void print_summary(const Summary& total) {
+  printf("bucket_start,source_id,frames,people,mean_people,max_people,"
+         "violations,sum_danger\n");
+  for (const auto& item : total) {
+    const Stats& stats = item.second;
+    printf("%" PRIu64 ",%u,%" PRIu64 ",%" PRIu64 ",%f,%u,%" PRIu64 ",%f\n",
+           item.first.first * (uint64_t)bucket_seconds, item.first.second,
+           stats.frames, stats.people,
+           stats.frames ? (double)stats.people / stats.frames : 0.0,
+           stats.max_people, stats.violations, stats.sum_danger);
+  }
+}
+
+int main(int argc, char** argv) {
+  GError* error = nullptr;
+  GOptionContext* context = g_option_context_new("- read broker recordings");
+  g_option_context_add_main_entries(context, entries, nullptr);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    g_clear_error(&error);
+    g_option_context_free(context);
+    return 1;
+  }
+  g_option_context_free(context);
+  if (files == nullptr || bucket_seconds <= 0) {
+    g_printerr("usage: dsrecording [OPTION...] FILE...\n");
+    return 1;
+  }
+
+  ds::recording::ScanOptions options;
+  options.sources = source_ids;
+  options.begin = (uint64_t)(from_seconds * 1e9);
+  if (to_seconds >= 0.0) {
+    options.end = (uint64_t)(to_seconds * 1e9);
+  }
+  unsigned threads = num_threads > 0 ? (unsigned)num_threads
+                                     : std::thread::hardware_concurrency();
+  threads = std::max(threads, 1u);
+
+  int ret = 0;
+  Summary total;
+  if (!summary) {
+    fputs(ds::CsvEncoder::HEADER, stdout);
+  }
+  for (gchar** file = files; *file != nullptr; file++) {
+    if (ds::columnar::is_columnar(*file)) {
+      ColumnarReader reader;
+      if (!reader.open(*file)) {
+        g_printerr("could not open %s\n", *file);
+        ret = 1;
+        continue;
+      }
+      bool ok = summary ? columnar_summary(reader, options, threads, &total)
+                        : columnar_csv(reader, options, threads);
+      if (!ok) {
+        g_printerr("%s: malformed row group, output is incomplete\n", *file);
+        ret = 1;
+      }
+      continue;
+    }
+    ds::recording::RecordingReader reader;
+    if (!reader.open(*file)) {
+      g_printerr("could not open %s\n", *file);
+      ret = 1;
+      continue;
+    }
+    bool ok = summary ? summarize(reader, options, threads, &total)
+                      : dump_csv(reader, options, threads);
+    if (!ok) {
+      g_printerr("%s: malformed record, output is incomplete\n", *file);
+      ret = 1;
+    }
+  }
+  if (summary) {
+    print_summary(total);
+  }
+  g_strfreev(files);
+  return ret;
+}